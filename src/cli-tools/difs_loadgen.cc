@@ -0,0 +1,604 @@
+/*
+ * Copyright 2018-2021 Board of Trustees of Stanford University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Open-loop load generator for QueryOnline on the frontend or a worker.
+//
+// Requests are issued at their scheduled arrival times whether or not
+// earlier requests have finished (up to a cap on outstanding requests), and
+// latency is measured from the scheduled time. A slow server therefore
+// shows up as higher latency instead of as a lower offered load.
+//
+// With diffusion parameters set, requests carry them like real diffusion
+// queries do, so batching, coalescing and result caching take part. Image
+// seeds cycle over --distinct_seeds values, which sets how often identical
+// queries repeat.
+
+#include <getopt.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <grpcpp/grpcpp.h>
+
+#include "master/worker_channel_pool.h"
+#include "query.grpc.pb.h"
+#include "queryfe.grpc.pb.h"
+
+using grpc::ClientAsyncResponseReader;
+using grpc::ClientContext;
+using grpc::CompletionQueue;
+using grpc::Status;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+// Log-linear latency histogram in the style of HdrHistogram: values (usec)
+// are recorded with 3 significant digits from 1 usec up to ~19 hours, in
+// constant memory.
+class LatencyHistogram {
+public:
+  LatencyHistogram()
+      : counts_(sub_count + max_shift * half_count, 0),
+        total_(0), sum_(0), max_(0) {}
+
+  void Record(uint64_t v) {
+    counts_[Index(v)]++;
+    total_++;
+    sum_ += v;
+    max_ = std::max(max_, v);
+  }
+
+  uint64_t Count() const { return total_; }
+  uint64_t Max() const { return max_; }
+  double Mean() const { return total_ ? (double)sum_ / total_ : 0.0; }
+
+  // Smallest recorded-bucket upper bound covering q (0..100) of the values.
+  uint64_t Percentile(double q) const {
+    if (total_ == 0) { return 0; }
+    uint64_t target = (uint64_t)std::ceil(total_ * q / 100.0);
+    target = std::max<uint64_t>(target, 1);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+      seen += counts_[i];
+      if (seen >= target) { return std::min(UpperBound(i), max_); }
+    }
+    return max_;
+  }
+
+private:
+  static const int sub_bits = 11;  // 2048 sub-buckets: 3 significant digits
+  static const uint64_t sub_count = 1 << sub_bits;
+  static const uint64_t half_count = sub_count / 2;
+  static const int max_shift = 26;
+
+  static size_t Index(uint64_t v) {
+    if (v < sub_count) { return v; }
+    int msb = 63 - __builtin_clzll(v);
+    int shift = std::min(msb - (sub_bits - 1), max_shift);
+    uint64_t sub = std::min<uint64_t>(v >> shift, sub_count - 1);
+    return sub_count + (shift - 1) * half_count + (sub - half_count);
+  }
+
+  static uint64_t UpperBound(size_t idx) {
+    if (idx < sub_count) { return idx; }
+    size_t off = idx - sub_count;
+    int shift = off / half_count + 1;
+    uint64_t sub = off % half_count + half_count;
+    return ((sub + 1) << shift) - 1;
+  }
+
+  std::vector<uint64_t> counts_;
+  uint64_t total_;
+  uint64_t sum_;
+  uint64_t max_;
+};
+
+enum ArrivalType { ARRIVAL_POISSON, ARRIVAL_CONSTANT, ARRIVAL_TRACE };
+
+struct LoadgenConfig {
+  std::string server = "localhost:50052";
+  bool to_worker = false;
+  std::string model;
+  ArrivalType arrival = ARRIVAL_POISSON;
+  double rate = 1.0;           // Requests per second
+  double duration_s = 10.0;
+  uint64_t max_requests = 0;   // 0 = no limit
+  std::string trace_file;
+  std::string prompt = "a photograph of an astronaut riding a horse";
+  int concurrency = 256;       // Most requests in flight
+  double slo_ms = 0;           // 0 = no SLO
+  int deadline_ms = 60000;
+  uint32_t seed = 1;           // Seeds the arrival process
+  // Diffusion parameters; zeros select the model's defaults
+  bool diffusion = false;      // Set if any of these was given
+  int32_t steps = 0;
+  float guidance = 0;
+  int32_t width = 0;
+  int32_t height = 0;
+  int32_t image_seed = 0;      // 0 = a random image every time
+  uint32_t distinct_seeds = 1; // Request i uses image_seed + i % this
+  int32_t format = 0;          // ImageFormat
+  int32_t quality = 0;
+  std::string csv_file;
+  std::string json_file;
+};
+
+// One scheduled request: when to send it and what to send.
+struct Arrival {
+  double offset_ms;
+  std::string prompt;
+  int32_t image_seed;
+};
+
+struct CallBase {
+  ClientContext ctx;
+  Status status;
+  Clock::time_point scheduled;
+  virtual ~CallBase() {}
+  virtual bool Succeeded() const = 0;
+};
+
+template <class Reply>
+struct Call : public CallBase {
+  Reply reply;
+  std::unique_ptr<ClientAsyncResponseReader<Reply>> rpc;
+};
+
+struct FeCall : public Call<infaaspublic::infaasqueryfe::QueryOnlineResponse> {
+  bool Succeeded() const override {
+    return status.ok() &&
+           reply.status().status() == infaaspublic::RequestReplyEnum::SUCCESS;
+  }
+};
+
+struct WorkerCall
+    : public Call<infaas::internal::QueryOnlineResponse> {
+  bool Succeeded() const override {
+    return status.ok() && reply.status().status() ==
+                              infaas::internal::InfaasRequestStatusEnum::SUCCESS;
+  }
+};
+
+void usage() {
+  std::cout << "Usage: difs_loadgen -m model [-s host:port] [-w] "
+               "[-a poisson|constant|trace] [-r rate] [-t seconds] "
+               "[-n max_requests] [-f trace_file] [-p prompt] "
+               "[-c concurrency] [-l slo_ms] [-D deadline_ms] [-S seed] "
+               "[--csv file] [--json file] [--steps n] [--guidance g] "
+               "[--width px] [--height px] [--image_seed s] "
+               "[--distinct_seeds k] [--format png|jpeg|webp|raw] "
+               "[--quality q]"
+            << std::endl;
+  std::cout << "-w: send to a worker (infaas.internal.Query) instead of the "
+               "frontend" << std::endl;
+  std::cout << "-S: seeds the arrival process; --image_seed seeds the "
+               "images (0 = random, so no two queries are identical)"
+            << std::endl;
+  std::cout << "trace_file: one request per line, either '<prompt>' (arrival "
+               "times follow -a/-r; prompts are cycled, e.g. a COCO caption "
+               "set) or '<offset_ms>\\t<prompt>' with -a trace" << std::endl;
+}
+
+bool LoadTrace(const LoadgenConfig& cfg, std::vector<Arrival>* trace) {
+  std::ifstream in(cfg.trace_file);
+  if (!in) {
+    std::cerr << "Cannot open trace file " << cfg.trace_file << std::endl;
+    return false;
+  }
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty()) { continue; }
+    Arrival a;
+    a.offset_ms = -1;
+    a.image_seed = 0;
+    size_t tab = line.find('\t');
+    if (cfg.arrival == ARRIVAL_TRACE) {
+      if (tab == std::string::npos) {
+        std::cerr << "Trace line without '<offset_ms>\\t': " << line
+                  << std::endl;
+        return false;
+      }
+      a.offset_ms = std::stod(line.substr(0, tab));
+      a.prompt = line.substr(tab + 1);
+    } else {
+      a.prompt = line;
+    }
+    trace->push_back(a);
+  }
+  if (trace->empty()) {
+    std::cerr << "Trace file " << cfg.trace_file << " is empty" << std::endl;
+    return false;
+  }
+  if (cfg.arrival == ARRIVAL_TRACE) {
+    std::sort(trace->begin(), trace->end(),
+              [](const Arrival& x, const Arrival& y) {
+                return x.offset_ms < y.offset_ms;
+              });
+  }
+  return true;
+}
+
+// Builds the full arrival schedule up front so generating it costs nothing
+// while the run is in progress.
+std::vector<Arrival> BuildSchedule(const LoadgenConfig& cfg,
+                                   const std::vector<Arrival>& trace) {
+  std::vector<Arrival> schedule;
+  auto image_seed = [&cfg](const size_t i) -> int32_t {
+    if (cfg.image_seed == 0) { return 0; }
+    return cfg.image_seed + (int32_t)(i % cfg.distinct_seeds);
+  };
+  if (cfg.arrival == ARRIVAL_TRACE) {
+    for (const Arrival& a : trace) {
+      if (a.offset_ms > cfg.duration_s * 1000.0) { break; }
+      if (cfg.max_requests && schedule.size() >= cfg.max_requests) { break; }
+      schedule.push_back(a);
+      schedule.back().image_seed = image_seed(schedule.size() - 1);
+    }
+    return schedule;
+  }
+
+  std::mt19937_64 rng(cfg.seed);
+  std::exponential_distribution<double> gap(cfg.rate / 1000.0);
+  double t = 0;
+  size_t next_prompt = 0;
+  while (true) {
+    t += (cfg.arrival == ARRIVAL_POISSON) ? gap(rng) : 1000.0 / cfg.rate;
+    if (t > cfg.duration_s * 1000.0) { break; }
+    if (cfg.max_requests && schedule.size() >= cfg.max_requests) { break; }
+    Arrival a;
+    a.offset_ms = t;
+    a.image_seed = image_seed(schedule.size());
+    if (trace.empty()) {
+      a.prompt = cfg.prompt;
+    } else {
+      a.prompt = trace[next_prompt++ % trace.size()].prompt;
+    }
+    schedule.push_back(a);
+  }
+  return schedule;
+}
+
+struct Results {
+  LatencyHistogram latency_us;
+  uint64_t sent = 0;
+  uint64_t ok = 0;
+  uint64_t errors = 0;
+  uint64_t within_slo = 0;
+  double elapsed_s = 0;
+};
+
+void WriteReports(const LoadgenConfig& cfg, const Results& r) {
+  static const char* arrival_names[] = {"poisson", "constant", "trace"};
+  double throughput = r.elapsed_s > 0 ? r.ok / r.elapsed_s : 0;
+  double goodput = r.elapsed_s > 0 ? r.within_slo / r.elapsed_s : 0;
+  auto ms = [](uint64_t us) { return us / 1000.0; };
+
+  std::ostringstream row;
+  row << arrival_names[cfg.arrival] << "," << cfg.rate << ","
+      << cfg.concurrency << "," << cfg.slo_ms << "," << r.sent << "," << r.ok
+      << "," << r.errors << "," << r.elapsed_s << "," << throughput << ","
+      << goodput << "," << ms(r.latency_us.Percentile(50)) << ","
+      << ms(r.latency_us.Percentile(90)) << ","
+      << ms(r.latency_us.Percentile(99)) << ","
+      << ms(r.latency_us.Percentile(99.9)) << ","
+      << r.latency_us.Mean() / 1000.0 << "," << ms(r.latency_us.Max());
+  const std::string header =
+      "arrival,rate,concurrency,slo_ms,sent,ok,errors,elapsed_s,throughput,"
+      "goodput,p50_ms,p90_ms,p99_ms,p999_ms,mean_ms,max_ms";
+
+  std::cout << header << std::endl << row.str() << std::endl;
+
+  if (!cfg.csv_file.empty()) {
+    // Append so repeated runs build one table; header only for a new file.
+    bool exists = std::ifstream(cfg.csv_file).good();
+    std::ofstream csv(cfg.csv_file, std::ios::app);
+    if (!exists) { csv << header << std::endl; }
+    csv << row.str() << std::endl;
+  }
+
+  if (!cfg.json_file.empty()) {
+    std::ofstream json(cfg.json_file);
+    json << "{\"arrival\": \"" << arrival_names[cfg.arrival] << "\", "
+         << "\"rate\": " << cfg.rate << ", "
+         << "\"concurrency\": " << cfg.concurrency << ", "
+         << "\"slo_ms\": " << cfg.slo_ms << ", "
+         << "\"sent\": " << r.sent << ", \"ok\": " << r.ok << ", "
+         << "\"errors\": " << r.errors << ", "
+         << "\"elapsed_s\": " << r.elapsed_s << ", "
+         << "\"throughput\": " << throughput << ", "
+         << "\"goodput\": " << goodput << ", "
+         << "\"latency_ms\": {"
+         << "\"p50\": " << ms(r.latency_us.Percentile(50)) << ", "
+         << "\"p90\": " << ms(r.latency_us.Percentile(90)) << ", "
+         << "\"p99\": " << ms(r.latency_us.Percentile(99)) << ", "
+         << "\"p99.9\": " << ms(r.latency_us.Percentile(99.9)) << ", "
+         << "\"mean\": " << r.latency_us.Mean() / 1000.0 << ", "
+         << "\"max\": " << ms(r.latency_us.Max()) << "}}" << std::endl;
+  }
+}
+
+// Starts one QueryOnline on the frontend.
+void StartFeCall(infaaspublic::infaasqueryfe::Query::Stub* stub,
+                      const LoadgenConfig& cfg, const Arrival& a,
+                      Clock::time_point when, CompletionQueue* cq) {
+  infaaspublic::infaasqueryfe::QueryOnlineRequest request;
+  request.add_raw_input(a.prompt);
+  request.set_model_variant(cfg.model);
+  request.set_submitter("difs_loadgen");
+  if (cfg.slo_ms > 0) {
+    // Read as milliseconds by the frontend and the worker, despite its name
+    request.mutable_slo()->set_latencyinusec((int64_t)cfg.slo_ms);
+  }
+  if (cfg.diffusion) {
+    infaaspublic::infaasqueryfe::DiffusionParams* params =
+        request.mutable_diffusion();
+    params->set_steps(cfg.steps);
+    params->set_guidancescale(cfg.guidance);
+    params->set_seed(a.image_seed);
+    params->set_width(cfg.width);
+    params->set_height(cfg.height);
+    params->set_format(
+        static_cast<infaaspublic::infaasqueryfe::ImageFormat>(cfg.format));
+    params->set_quality(cfg.quality);
+  }
+  FeCall* call = new FeCall();
+  call->scheduled = when;
+  call->ctx.set_deadline(std::chrono::system_clock::now() +
+                         std::chrono::milliseconds(cfg.deadline_ms));
+  call->rpc = stub->AsyncQueryOnline(&call->ctx, request, cq);
+  call->rpc->Finish(&call->reply, &call->status, call);
+}
+
+// Starts one QueryOnline directly on a worker.
+void StartWorkerCall(infaas::internal::Query::Stub* stub,
+                          const LoadgenConfig& cfg, const Arrival& a,
+                          Clock::time_point when, CompletionQueue* cq) {
+  infaas::internal::QueryOnlineRequest request;
+  request.add_raw_input(a.prompt);
+  request.add_model(cfg.model);
+  request.set_submitter("difs_loadgen");
+  if (cfg.slo_ms > 0) {
+    request.mutable_slo()->set_latencyinusec((int64_t)cfg.slo_ms);
+  }
+  if (cfg.diffusion) {
+    infaas::internal::InternalDiffusionQuery* params =
+        request.mutable_diffusion();
+    params->set_steps(cfg.steps);
+    params->set_guidancescale(cfg.guidance);
+    params->set_seed(a.image_seed);
+    params->set_width(cfg.width);
+    params->set_height(cfg.height);
+    params->set_format(
+        static_cast<infaas::internal::ImageFormat>(cfg.format));
+    params->set_quality(cfg.quality);
+  }
+  WorkerCall* call = new WorkerCall();
+  call->scheduled = when;
+  call->ctx.set_deadline(std::chrono::system_clock::now() +
+                         std::chrono::milliseconds(cfg.deadline_ms));
+  call->rpc = stub->AsyncQueryOnline(&call->ctx, request, cq);
+  call->rpc->Finish(&call->reply, &call->status, call);
+}
+
+Results Run(const LoadgenConfig& cfg, const std::vector<Arrival>& schedule) {
+  size_t colon = cfg.server.rfind(':');
+  infaas::internal::WorkerChannelPool channel_pool(1);
+  auto channel = channel_pool.GetChannel(
+      {cfg.server.substr(0, colon), cfg.server.substr(colon + 1)});
+  auto fe_stub = infaaspublic::infaasqueryfe::Query::NewStub(channel);
+  auto worker_stub = infaas::internal::Query::NewStub(channel);
+
+  CompletionQueue cq;
+  Results r;
+  std::mutex mu;
+  std::condition_variable slot_cv;
+  int in_flight = 0;
+
+  // Completions are handled on their own thread so the sender never falls
+  // behind its schedule while replies are being processed.
+  std::thread reaper([&]() {
+    void* tag;
+    bool ok;
+    while (cq.Next(&tag, &ok)) {
+      CallBase* call = static_cast<CallBase*>(tag);
+      uint64_t lat_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                            Clock::now() - call->scheduled)
+                            .count();
+      {
+        std::lock_guard<std::mutex> lock(mu);
+        if (ok && call->Succeeded()) {
+          r.ok++;
+          r.latency_us.Record(lat_us);
+          if ((cfg.slo_ms <= 0) || (lat_us <= cfg.slo_ms * 1000)) {
+            r.within_slo++;
+          }
+        } else {
+          r.errors++;
+        }
+        in_flight--;
+      }
+      slot_cv.notify_one();
+      delete call;
+    }
+  });
+
+  Clock::time_point start = Clock::now();
+  for (const Arrival& a : schedule) {
+    Clock::time_point when =
+        start + std::chrono::microseconds((int64_t)(a.offset_ms * 1000));
+    std::this_thread::sleep_until(when);
+    {
+      // At the concurrency cap the request waits, but its latency still
+      // counts from its scheduled time.
+      std::unique_lock<std::mutex> lock(mu);
+      slot_cv.wait(lock, [&] { return in_flight < cfg.concurrency; });
+      in_flight++;
+      r.sent++;
+    }
+    if (cfg.to_worker) {
+      StartWorkerCall(worker_stub.get(), cfg, a, when, &cq);
+    } else {
+      StartFeCall(fe_stub.get(), cfg, a, when, &cq);
+    }
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(mu);
+    slot_cv.wait(lock, [&] { return in_flight == 0; });
+  }
+  r.elapsed_s =
+      std::chrono::duration<double>(Clock::now() - start).count();
+  cq.Shutdown();
+  reaper.join();
+  return r;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  LoadgenConfig cfg;
+
+  struct option long_options[] = {
+      {"server", required_argument, nullptr, 's'},
+      {"worker", no_argument, nullptr, 'w'},
+      {"model", required_argument, nullptr, 'm'},
+      {"arrival", required_argument, nullptr, 'a'},
+      {"rate", required_argument, nullptr, 'r'},
+      {"duration", required_argument, nullptr, 't'},
+      {"num_requests", required_argument, nullptr, 'n'},
+      {"trace", required_argument, nullptr, 'f'},
+      {"prompt", required_argument, nullptr, 'p'},
+      {"concurrency", required_argument, nullptr, 'c'},
+      {"slo", required_argument, nullptr, 'l'},
+      {"deadline", required_argument, nullptr, 'D'},
+      {"seed", required_argument, nullptr, 'S'},
+      {"csv", required_argument, nullptr, 'C'},
+      {"json", required_argument, nullptr, 'J'},
+      {"steps", required_argument, nullptr, 'T'},
+      {"guidance", required_argument, nullptr, 'G'},
+      {"width", required_argument, nullptr, 'W'},
+      {"height", required_argument, nullptr, 'H'},
+      {"image_seed", required_argument, nullptr, 'E'},
+      {"distinct_seeds", required_argument, nullptr, 'K'},
+      {"format", required_argument, nullptr, 'F'},
+      {"quality", required_argument, nullptr, 'Q'},
+      {nullptr, 0, nullptr, 0},
+  };
+
+  while (true) {
+    const int opt = getopt_long(argc, argv, "s:wm:a:r:t:n:f:p:c:l:D:S:",
+                                long_options, NULL);
+    if (opt == -1) { break; }
+
+    switch (opt) {
+      case 's': cfg.server = optarg; break;
+      case 'w': cfg.to_worker = true; break;
+      case 'm': cfg.model = optarg; break;
+      case 'a': {
+        std::string a(optarg);
+        if (a == "poisson") {
+          cfg.arrival = ARRIVAL_POISSON;
+        } else if (a == "constant") {
+          cfg.arrival = ARRIVAL_CONSTANT;
+        } else if (a == "trace") {
+          cfg.arrival = ARRIVAL_TRACE;
+        } else {
+          std::cerr << "Unknown arrival process: " << a << std::endl;
+          usage();
+          return 1;
+        }
+        break;
+      }
+      case 'r': cfg.rate = std::stod(optarg); break;
+      case 't': cfg.duration_s = std::stod(optarg); break;
+      case 'n': cfg.max_requests = std::stoull(optarg); break;
+      case 'f': cfg.trace_file = optarg; break;
+      case 'p': cfg.prompt = optarg; break;
+      case 'c': cfg.concurrency = std::stoi(optarg); break;
+      case 'l': cfg.slo_ms = std::stod(optarg); break;
+      case 'D': cfg.deadline_ms = std::stoi(optarg); break;
+      case 'S': cfg.seed = std::stoul(optarg); break;
+      case 'C': cfg.csv_file = optarg; break;
+      case 'J': cfg.json_file = optarg; break;
+      case 'T': cfg.steps = std::stoi(optarg); cfg.diffusion = true; break;
+      case 'G': cfg.guidance = std::stof(optarg); cfg.diffusion = true; break;
+      case 'W': cfg.width = std::stoi(optarg); cfg.diffusion = true; break;
+      case 'H': cfg.height = std::stoi(optarg); cfg.diffusion = true; break;
+      case 'E':
+        cfg.image_seed = std::stoi(optarg);
+        cfg.diffusion = true;
+        break;
+      case 'K': cfg.distinct_seeds = std::stoul(optarg); break;
+      case 'F': {
+        static const char* formats[] = {"png", "jpeg", "webp", "raw"};
+        const std::string f(optarg);
+        cfg.format = -1;
+        for (int i = 0; i < 4; ++i) {
+          if (f == formats[i]) { cfg.format = i; }
+        }
+        if (cfg.format < 0) {
+          std::cerr << "Unknown image format: " << f << std::endl;
+          usage();
+          return 1;
+        }
+        cfg.diffusion = true;
+        break;
+      }
+      case 'Q': cfg.quality = std::stoi(optarg); cfg.diffusion = true; break;
+      default:
+        usage();
+        return 1;
+    }
+  }
+
+  if (cfg.model.empty() || (cfg.server.find(':') == std::string::npos) ||
+      (cfg.arrival != ARRIVAL_TRACE && cfg.rate <= 0) ||
+      (cfg.arrival == ARRIVAL_TRACE && cfg.trace_file.empty()) ||
+      (cfg.concurrency < 1) || (cfg.distinct_seeds < 1)) {
+    usage();
+    return 1;
+  }
+
+  std::vector<Arrival> trace;
+  if (!cfg.trace_file.empty() && !LoadTrace(cfg, &trace)) { return 1; }
+
+  std::vector<Arrival> schedule = BuildSchedule(cfg, trace);
+  std::cout << "Sending " << schedule.size() << " requests to "
+            << (cfg.to_worker ? "worker " : "frontend ") << cfg.server
+            << std::endl;
+
+  Results r = Run(cfg, schedule);
+  WriteReports(cfg, r);
+  return 0;
+}
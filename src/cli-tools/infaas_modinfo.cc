@@ -27,8 +27,7 @@
 #include "constants.h" //PNB: (2025.11.28)
 #include "master/modelreg_client.h"
 #include "master/queryfe_client.h"
-
-static const int MAX_GRPC_MESSAGE_SIZE = INT32_MAX;
+#include "master/worker_channel_pool.h"
 
 int main(int argc, char** argv) {
   if (argc < 2) {
@@ -41,11 +40,9 @@ int main(int argc, char** argv) {
   std::string parent_model(argv[1]);
 
   // Ask for model info
-  grpc::ChannelArguments arguments;
-  arguments.SetMaxSendMessageSize(MAX_GRPC_MESSAGE_SIZE);
-  arguments.SetMaxReceiveMessageSize(MAX_GRPC_MESSAGE_SIZE);
-  infaaspublic::infaasqueryfe::QueryFEClient queryfe(grpc::CreateCustomChannel(
-      "localhost:50052", grpc::InsecureChannelCredentials(), arguments));
+  infaas::internal::WorkerChannelPool channel_pool(1);
+  infaaspublic::infaasqueryfe::QueryFEClient queryfe(
+      channel_pool.GetChannel({"localhost", "50052"}));
 
   infaaspublic::QueryModelReply query_reply =
       queryfe.QueryModelInfo(parent_model);
@@ -28,8 +28,7 @@
 #include "constants.h" //PNB: (2025.12.18)
 #include "master/modelreg_client.h"
 #include "master/queryfe_client.h"
-
-static const int MAX_GRPC_MESSAGE_SIZE = INT32_MAX;
+#include "master/worker_channel_pool.h"
 
 int main(int argc, char** argv) {
   if (argc < 4) {
@@ -46,11 +45,9 @@ int main(int argc, char** argv) {
   std::string model_architecture = std::string(argv[3]);
 
   // Submit the offline job
-  grpc::ChannelArguments arguments;
-  arguments.SetMaxSendMessageSize(MAX_GRPC_MESSAGE_SIZE);
-  arguments.SetMaxReceiveMessageSize(MAX_GRPC_MESSAGE_SIZE);
-  infaaspublic::infaasqueryfe::QueryFEClient queryfe(grpc::CreateCustomChannel(
-      "localhost:50052", grpc::InsecureChannelCredentials(), arguments));
+  infaas::internal::WorkerChannelPool channel_pool(1);
+  infaaspublic::infaasqueryfe::QueryFEClient queryfe(
+      channel_pool.GetChannel({"localhost", "50052"}));
 
   infaaspublic::RequestReply query_reply =
       queryfe.QueryOffline(input_url, model_architecture, "", output_url, 0.0);
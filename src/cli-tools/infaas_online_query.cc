@@ -42,9 +42,9 @@
 #include "constants.h" //PNB: (2025.11.28)
 #include "master/modelreg_client.h"
 #include "master/queryfe_client.h"
+#include "master/worker_channel_pool.h"
 
 static const bool debug = false;
-static const int MAX_GRPC_MESSAGE_SIZE = INT32_MAX;
 
 void usage() {
   std::cout << "Usage: infaas_online_query -i input -d input_dim [-a "
@@ -256,11 +256,9 @@ int main(int argc, char** argv) {
   }
 
   // Set up online query
-  grpc::ChannelArguments arguments;
-  arguments.SetMaxSendMessageSize(MAX_GRPC_MESSAGE_SIZE);
-  arguments.SetMaxReceiveMessageSize(MAX_GRPC_MESSAGE_SIZE);
-  infaaspublic::infaasqueryfe::QueryFEClient queryfe(grpc::CreateCustomChannel(
-      "localhost:50052", grpc::InsecureChannelCredentials(), arguments));
+  infaas::internal::WorkerChannelPool channel_pool(1);
+  infaaspublic::infaasqueryfe::QueryFEClient queryfe(
+      channel_pool.GetChannel({"localhost", "50052"}));
 
   // Prepare inputs
   std::cout << "Preparing inputs..." << std::endl;
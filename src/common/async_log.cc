@@ -0,0 +1,331 @@
+#include "async_log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace infaas {
+namespace internal {
+
+namespace {
+
+// Records per thread ring; must be a power of two.
+const size_t ring_capacity = 1024;
+// How often the writer drains the rings when nobody asks it to.
+const int writer_interval_ms = 10;
+const int max_sinks = 256;
+
+// One fixed-size slot. A line longer than text is spread over consecutive
+// slots that share time_ns.
+struct LogRecord {
+  uint64_t time_ns;
+  uint16_t length;
+  uint8_t sink;
+  uint8_t level;
+  char text[244];
+};
+static_assert(sizeof(LogRecord) == 256, "log records should stay compact");
+
+// Single-producer (the owning thread), single-consumer (the writer) ring.
+struct LogRing {
+  alignas(64) std::atomic<uint64_t> head{0};  // Next slot the writer reads
+  alignas(64) std::atomic<uint64_t> tail{0};  // Next slot the owner fills
+  std::atomic<bool> orphaned{false};          // Owning thread has exited
+  LogRecord slots[ring_capacity];
+};
+
+uint64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+LogLevel InitialLevel() {
+  LogLevel level = LOGLEVEL_INFO;
+  const char* env = getenv("INFAAS_LOG_LEVEL");
+  if ((env != nullptr) && !ParseLogLevel(env, &level)) {
+    fprintf(stderr, "Unknown INFAAS_LOG_LEVEL '%s', using info\n", env);
+  }
+  return level;
+}
+
+class LogWriter {
+public:
+  static LogWriter& Get() {
+    static LogWriter* writer = new LogWriter();  // Outlives static dtors
+    return *writer;
+  }
+
+  LogRing* ThreadRing();
+  bool Push(const LogLevel level, const int sink, const char* text,
+            const size_t length);
+  int OpenSink(const std::string& path);
+  void Flush();
+  void Wake() { cv_.notify_one(); }
+
+  std::atomic<uint64_t> dropped{0};
+
+private:
+  LogWriter();
+  void Run();
+  // Moves every pending record out of the rings. Returns false if there
+  // were none.
+  bool Drain(std::vector<LogRecord>* batch);
+  void Write(std::vector<LogRecord>* batch);
+
+  std::mutex mutex_;  // Guards rings_, sinks_ and the flush counters
+  std::condition_variable cv_;
+  std::condition_variable flushed_cv_;
+  std::vector<std::shared_ptr<LogRing>> rings_;
+  std::vector<FILE*> sinks_;
+  uint64_t flush_requested_ = 0;
+  uint64_t flush_done_ = 0;
+  std::thread thread_;
+};
+
+// Hands the ring back to the writer when its thread exits; the writer frees
+// it once it is empty.
+struct RingOwner {
+  std::shared_ptr<LogRing> ring;
+  ~RingOwner() {
+    if (ring) { ring->orphaned.store(true, std::memory_order_release); }
+  }
+};
+
+LogWriter::LogWriter() {
+  sinks_.push_back(stdout);
+  thread_ = std::thread(&LogWriter::Run, this);
+  thread_.detach();
+  // Whatever is still queued when the process exits normally gets written
+  atexit([] { LogWriter::Get().Flush(); });
+}
+
+LogRing* LogWriter::ThreadRing() {
+  thread_local RingOwner owner;
+  if (!owner.ring) {
+    owner.ring = std::make_shared<LogRing>();
+    std::lock_guard<std::mutex> lock(mutex_);
+    rings_.push_back(owner.ring);
+  }
+  return owner.ring.get();
+}
+
+bool LogWriter::Push(const LogLevel level, const int sink, const char* text,
+                     const size_t length) {
+  if ((sink < 0) || (sink >= max_sinks)) { return false; }
+  const size_t per_slot = sizeof(LogRecord::text);
+  const size_t num_slots =
+      std::max<size_t>(1, (length + per_slot - 1) / per_slot);
+
+  LogRing* ring = ThreadRing();
+  const uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+  const uint64_t head = ring->head.load(std::memory_order_acquire);
+  if (tail + num_slots - head > ring_capacity) {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  const uint64_t now = NowNs();
+  size_t offset = 0;
+  for (size_t i = 0; i < num_slots; ++i) {
+    LogRecord& rec = ring->slots[(tail + i) & (ring_capacity - 1)];
+    const size_t n = std::min(per_slot, length - offset);
+    rec.time_ns = now;
+    rec.length = n;
+    rec.sink = sink;
+    rec.level = level;
+    memcpy(rec.text, text + offset, n);
+    offset += n;
+  }
+  ring->tail.store(tail + num_slots, std::memory_order_release);
+
+  // Errors should reach the sink promptly
+  if (level >= LOGLEVEL_ERROR) { Wake(); }
+  return true;
+}
+
+int LogWriter::OpenSink(const std::string& path) {
+  FILE* f = fopen(path.c_str(), "w");
+  if (f == nullptr) { return -1; }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (sinks_.size() >= max_sinks) {
+    fclose(f);
+    return -1;
+  }
+  sinks_.push_back(f);
+  return sinks_.size() - 1;
+}
+
+void LogWriter::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  const uint64_t ticket = ++flush_requested_;
+  cv_.notify_one();
+  flushed_cv_.wait_for(lock, std::chrono::seconds(5),
+                       [&] { return flush_done_ >= ticket; });
+}
+
+bool LogWriter::Drain(std::vector<LogRecord>* batch) {
+  std::vector<std::shared_ptr<LogRing>> rings;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rings = rings_;
+  }
+
+  bool any = false;
+  for (auto& ring : rings) {
+    // Read orphaned before tail so a ring is only dropped once it is empty
+    const bool orphaned = ring->orphaned.load(std::memory_order_acquire);
+    const uint64_t head = ring->head.load(std::memory_order_relaxed);
+    const uint64_t tail = ring->tail.load(std::memory_order_acquire);
+    for (uint64_t i = head; i < tail; ++i) {
+      batch->push_back(ring->slots[i & (ring_capacity - 1)]);
+    }
+    ring->head.store(tail, std::memory_order_release);
+    any = any || (tail != head);
+
+    if (orphaned) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      rings_.erase(std::remove(rings_.begin(), rings_.end(), ring),
+                   rings_.end());
+    }
+  }
+  return any;
+}
+
+void LogWriter::Write(std::vector<LogRecord>* batch) {
+  // Interleave threads by time; continuation slots share a timestamp and
+  // stable_sort keeps them together.
+  std::stable_sort(batch->begin(), batch->end(),
+                   [](const LogRecord& a, const LogRecord& b) {
+                     return a.time_ns < b.time_ns;
+                   });
+
+  std::vector<FILE*> sinks;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sinks = sinks_;
+  }
+  std::vector<std::string> out(sinks.size());
+  for (const LogRecord& rec : *batch) {
+    if (rec.sink < out.size()) { out[rec.sink].append(rec.text, rec.length); }
+  }
+  for (size_t i = 0; i < out.size(); ++i) {
+    if (out[i].empty()) { continue; }
+    fwrite(out[i].data(), 1, out[i].size(), sinks[i]);
+    fflush(sinks[i]);
+  }
+
+  const uint64_t dropped_now = dropped.exchange(0, std::memory_order_relaxed);
+  if (dropped_now > 0) {
+    fprintf(stderr, "[LOG]: %llu log lines dropped (ring full)\n",
+            (unsigned long long)dropped_now);
+  }
+}
+
+void LogWriter::Run() {
+  std::vector<LogRecord> batch;
+  batch.reserve(ring_capacity);
+  while (true) {
+    uint64_t ticket;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait_for(lock, std::chrono::milliseconds(writer_interval_ms),
+                   [&] { return flush_requested_ > flush_done_; });
+      ticket = flush_requested_;
+    }
+
+    batch.clear();
+    if (Drain(&batch)) { Write(&batch); }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (ticket > flush_done_) {
+      flush_done_ = ticket;
+      flushed_cv_.notify_all();
+    }
+  }
+}
+
+}  // namespace
+
+std::atomic<uint8_t> current_log_level(InitialLevel());
+
+void SetLogLevel(const LogLevel level) {
+  current_log_level.store(level, std::memory_order_relaxed);
+}
+
+LogLevel GetLogLevel() {
+  return static_cast<LogLevel>(
+      current_log_level.load(std::memory_order_relaxed));
+}
+
+bool ParseLogLevel(const std::string& name, LogLevel* level) {
+  static const char* names[] = {"debug", "info", "warn", "error", "off"};
+  for (uint8_t i = 0; i <= LOGLEVEL_OFF; ++i) {
+    if (name == names[i]) {
+      *level = static_cast<LogLevel>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+int OpenLogSink(const std::string& path) {
+  return LogWriter::Get().OpenSink(path);
+}
+
+void FlushLog() { LogWriter::Get().Flush(); }
+
+uint64_t LogDropped() {
+  return LogWriter::Get().dropped.load(std::memory_order_relaxed);
+}
+
+LogLine::LogLine(const LogLevel level, const int sink)
+    : level_(level), sink_(sink), stream_(&buf_) {}
+
+LogLine::~LogLine() {
+  char* data = buf_.data();
+  size_t size = buf_.size();
+  data[size++] = '\n';
+  LogWriter::Get().Push(level_, sink_, data, size);
+}
+
+LogStream::StreamBuf::StreamBuf(const LogLevel level, const int sink)
+    : level_(level), sink_(sink) {
+  setp(buf_, buf_ + sizeof(buf_));
+}
+
+int LogStream::StreamBuf::overflow(int c) {
+  sync();  // Buffer full: submit what we have and start over
+  if (c != traits_type::eof()) {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+int LogStream::StreamBuf::sync() {
+  const size_t size = pptr() - pbase();
+  if ((size > 0) && (sink_ >= 0) && LogEnabled(level_)) {
+    LogWriter::Get().Push(level_, sink_, pbase(), size);
+  }
+  setp(buf_, buf_ + sizeof(buf_));
+  return 0;
+}
+
+LogStream::LogStream(const std::string& path, const LogLevel level)
+    : std::ostream(nullptr), buf_(level, OpenLogSink(path)) {
+  rdbuf(&buf_);
+}
+
+LogStream::~LogStream() { buf_.pubsync(); }
+
+}  // namespace internal
+}  // namespace infaas
@@ -0,0 +1,136 @@
+#ifndef INFAAS_ASYNC_LOG_H
+#define INFAAS_ASYNC_LOG_H
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+// Asynchronous logging.
+//
+// A log statement formats its line into a stack buffer and copies it into a
+// ring buffer owned by the calling thread; no lock, no syscall, no flush. A
+// background writer drains every thread's ring, orders the records by time
+// and writes them to their sink in one batch. When a ring is full the line is
+// dropped and counted rather than blocking the caller.
+//
+//   INFAAS_LOG(INFO) << "[LOG]: Model variant selected is: " << model;
+//
+// Operands are not evaluated when the level is disabled. The level starts
+// from $INFAAS_LOG_LEVEL (debug, info, warn, error, off; default info) and
+// can be changed at any time with SetLogLevel.
+
+namespace infaas {
+namespace internal {
+
+enum LogLevel : uint8_t {
+  LOGLEVEL_DEBUG = 0,
+  LOGLEVEL_INFO = 1,
+  LOGLEVEL_WARN = 2,
+  LOGLEVEL_ERROR = 3,
+  LOGLEVEL_OFF = 4
+};
+
+// Sink 0 is stdout; files get their own sink from OpenLogSink.
+static const int log_stdout = 0;
+
+// Longest line a single statement produces; the rest is cut.
+static const size_t log_line_max = 4096;
+
+extern std::atomic<uint8_t> current_log_level;
+
+inline bool LogEnabled(const LogLevel level) {
+  return level >= current_log_level.load(std::memory_order_relaxed);
+}
+
+void SetLogLevel(const LogLevel level);
+LogLevel GetLogLevel();
+
+// Parses debug/info/warn/error/off. Returns false on an unknown name.
+bool ParseLogLevel(const std::string& name, LogLevel* level);
+
+// Opens (truncates) a file for log output. Returns its sink id, or -1.
+int OpenLogSink(const std::string& path);
+
+// Blocks until everything logged before the call has been written.
+void FlushLog();
+
+// Lines dropped so far because a thread's ring was full.
+uint64_t LogDropped();
+
+// Formats one line into a fixed buffer; the destructor hands it to the
+// calling thread's ring.
+class LogLine {
+public:
+  LogLine(const LogLevel level, const int sink);
+  ~LogLine();
+
+  std::ostream& stream() { return stream_; }
+
+private:
+  class LineBuf : public std::streambuf {
+  public:
+    LineBuf() { setp(buf_, buf_ + sizeof(buf_) - 1); }  // Room for '\n'
+    char* data() { return buf_; }
+    size_t size() const { return pptr() - pbase(); }
+
+  private:
+    char buf_[log_line_max];
+  };
+
+  const LogLevel level_;
+  const int sink_;
+  LineBuf buf_;
+  std::ostream stream_;
+};
+
+// Turns the stream expression into void so it fits the ?: in INFAAS_LOG.
+struct LogVoidify {
+  void operator&(std::ostream&) {}
+};
+
+/**
+ * An output stream for long-running monitors that used to write to a
+ * std::ofstream. Text is collected per stream and submitted as one record
+ * whenever the stream is flushed (std::endl), so the monitor never waits on
+ * the file.
+ */
+class LogStream : public std::ostream {
+public:
+  explicit LogStream(const std::string& path,
+                     const LogLevel level = LOGLEVEL_INFO);
+  ~LogStream();
+
+private:
+  class StreamBuf : public std::streambuf {
+  public:
+    StreamBuf(const LogLevel level, const int sink);
+
+  protected:
+    int overflow(int c) override;
+    int sync() override;
+
+  private:
+    const LogLevel level_;
+    const int sink_;
+    char buf_[log_line_max];
+  };
+
+  StreamBuf buf_;
+};
+
+}  // namespace internal
+}  // namespace infaas
+
+#define INFAAS_LOG_TO(sink, level)                                     \
+  !::infaas::internal::LogEnabled(::infaas::internal::LOGLEVEL_##level) \
+      ? (void)0                                                        \
+      : ::infaas::internal::LogVoidify() &                             \
+            ::infaas::internal::LogLine(                               \
+                ::infaas::internal::LOGLEVEL_##level, (sink))          \
+                .stream()
+
+#define INFAAS_LOG(level) INFAAS_LOG_TO(::infaas::internal::log_stdout, level)
+
+#endif
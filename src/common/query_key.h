@@ -0,0 +1,68 @@
+#ifndef INFAAS_QUERY_KEY_H
+#define INFAAS_QUERY_KEY_H
+
+#include <cstdint>
+#include <string>
+
+// Keys that identify a diffusion query by everything that determines its
+// output, so identical queries can share one. The frontend coalesces
+// concurrent queries on them and the worker caches results under them; both
+// build them here so the two agree on what makes queries identical.
+
+namespace infaas {
+namespace internal {
+
+// Appends one field to *key: its size, then its bytes, so that no two
+// sequences of fields encode to the same key.
+inline void AppendKeyField(std::string* key, const void* data,
+                           const size_t size) {
+  const uint64_t len = size;
+  key->append(reinterpret_cast<const char*>(&len), sizeof(len));
+  key->append(reinterpret_cast<const char*>(data), size);
+}
+
+inline void AppendKeyField(std::string* key, const std::string& field) {
+  AppendKeyField(key, field.data(), field.size());
+}
+
+// Key of a query: the model and its version, the generation parameters and
+// every input. Request is the frontend's or the worker's QueryOnlineRequest;
+// their diffusion messages have the same accessors. Empty if the output is
+// not reproducible (no diffusion parameters, or seed 0 asking for a random
+// image), in which case the query must not share another query's result.
+template <class Request>
+std::string DiffusionQueryKey(const std::string& model,
+                              const std::string& version,
+                              const Request& request) {
+  if (!request.has_diffusion() || (request.diffusion().seed() == 0)) {
+    return "";
+  }
+  const auto& params = request.diffusion();
+  const int32_t steps = params.steps();
+  const float guidance = params.guidancescale();
+  const int32_t seed = params.seed();
+  const int32_t width = params.width();
+  const int32_t height = params.height();
+  const int32_t format = params.format();
+  const int32_t quality = params.quality();
+
+  std::string key;
+  AppendKeyField(&key, model);
+  AppendKeyField(&key, version);
+  AppendKeyField(&key, &steps, sizeof(steps));
+  AppendKeyField(&key, &guidance, sizeof(guidance));
+  AppendKeyField(&key, &seed, sizeof(seed));
+  AppendKeyField(&key, &width, sizeof(width));
+  AppendKeyField(&key, &height, sizeof(height));
+  AppendKeyField(&key, &format, sizeof(format));
+  AppendKeyField(&key, &quality, sizeof(quality));
+  for (const std::string& input : request.raw_input()) {
+    AppendKeyField(&key, input);
+  }
+  return key;
+}
+
+}  // namespace internal
+}  // namespace infaas
+
+#endif
@@ -0,0 +1,272 @@
+/*
+ * Copyright 2018-2021 Board of Trustees of Stanford University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "admission_queue.h"
+
+namespace infaas {
+namespace internal {
+
+namespace {
+
+// Weight of the newest call in a variant's service time average
+const double service_time_alpha = 0.2;
+
+double ElapsedMs(const AdmissionQueue::TimePoint from,
+                 const AdmissionQueue::TimePoint to) {
+  return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+}  // namespace
+
+AdmissionQueue::AdmissionQueue(const int16_t slots_per_worker)
+    : slots_(slots_per_worker > 0 ? slots_per_worker : 1), next_id_(0),
+      stopping_(false) {
+  timer_ = std::thread(&AdmissionQueue::TimerLoop, this);
+}
+
+AdmissionQueue::~AdmissionQueue() {
+  {
+    std::lock_guard<std::mutex> lock(timer_mutex_);
+    stopping_ = true;
+  }
+  timer_cv_.notify_all();
+  timer_.join();
+}
+
+std::shared_ptr<AdmissionQueue::WorkerQueue> AdmissionQueue::Queue(
+    const std::string& worker) {
+  std::lock_guard<std::mutex> lock(queues_mutex_);
+  std::shared_ptr<WorkerQueue>& queue = queues_[worker];
+  if (queue == nullptr) { queue = std::make_shared<WorkerQueue>(); }
+  return queue;
+}
+
+double AdmissionQueue::ServiceTime(const std::string& model,
+                                   const double profiled_ms) {
+  ServiceStats stats;
+  if (service_.Get(model, &stats) && (stats.samples > 0)) {
+    return stats.mean_ms;
+  }
+  return std::max(0.0, profiled_ms);
+}
+
+double AdmissionQueue::PredictWait(const WorkerQueue& queue,
+                                   const TimePoint now,
+                                   const TimePoint deadline) const {
+  // Equal deadlines are served in arrival order, so they count as ahead
+  size_t ahead = 0;
+  double work_ms = 0.0;
+  for (const Waiter& w : queue.waiting) {
+    if (w.deadline > deadline) { break; }
+    ++ahead;
+    work_ms += w.service_ms;
+  }
+  if (queue.running.size() + ahead < (size_t)slots_) { return 0.0; }
+
+  for (const auto& r : queue.running) {
+    const double left = r.second.service_ms - ElapsedMs(r.second.start, now);
+    work_ms += std::max(0.0, left);
+  }
+  return work_ms / slots_;
+}
+
+bool AdmissionQueue::Feasible(const std::string& worker,
+                              const TimePoint deadline,
+                              const double service_ms) {
+  if (deadline == TimePoint::max()) { return true; }
+  std::shared_ptr<WorkerQueue> queue = Queue(worker);
+  const TimePoint now = Clock::now();
+  double wait_ms;
+  {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    wait_ms = PredictWait(*queue, now, deadline);
+  }
+  return wait_ms + service_ms <= ElapsedMs(now, deadline);
+}
+
+uint64_t AdmissionQueue::Acquire(const std::string& worker,
+                                 const std::string& model,
+                                 const TimePoint deadline,
+                                 const double service_ms,
+                                 const AdmitFn& on_admitted) {
+  std::shared_ptr<WorkerQueue> queue = Queue(worker);
+  Pending p;
+  p.waiter = {deadline, next_id_.fetch_add(1), service_ms};
+  p.model = model;
+  // A bounded query must start by latest_start to finish in time
+  p.latest_start = TimePoint::max();
+  if (deadline != TimePoint::max()) {
+    p.latest_start =
+        deadline - std::chrono::duration_cast<Clock::duration>(
+                       std::chrono::duration<double, std::milli>(service_ms));
+  }
+  p.on_admitted = on_admitted;
+  const uint64_t id = p.waiter.id;
+  const TimePoint latest_start = p.latest_start;
+
+  Callbacks ready;
+  bool waiting;
+  {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    queue->waiting.insert(p.waiter);
+    queue->pending.emplace(id, std::move(p));
+    Dispatch(worker, queue.get(), &ready);
+    waiting = (queue->pending.count(id) > 0);
+  }
+  if (waiting && (latest_start != TimePoint::max())) {
+    std::lock_guard<std::mutex> lock(timer_mutex_);
+    const bool soonest =
+        expiries_.empty() || (latest_start < expiries_.begin()->first);
+    expiries_.emplace(latest_start, std::make_pair(worker, id));
+    if (soonest) { timer_cv_.notify_all(); }
+  }
+  for (const auto& fn : ready) { fn(); }
+  return id;
+}
+
+bool AdmissionQueue::Acquire(const std::string& worker,
+                             const std::string& model,
+                             const TimePoint deadline,
+                             const double service_ms, Ticket* ticket) {
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool decided = false;
+  bool admitted = false;
+  Acquire(worker, model, deadline, service_ms,
+          [&](bool ok, const Ticket& t) {
+            std::lock_guard<std::mutex> lock(mutex);
+            admitted = ok;
+            if (ok) { *ticket = t; }
+            decided = true;
+            cv.notify_all();
+          });
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, [&] { return decided; });
+  return admitted;
+}
+
+bool AdmissionQueue::TryAcquire(const std::string& worker,
+                                const std::string& model,
+                                const double service_ms, Ticket* ticket) {
+  std::shared_ptr<WorkerQueue> queue = Queue(worker);
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  if (!queue->waiting.empty() || (queue->running.size() >= (size_t)slots_)) {
+    return false;
+  }
+  ticket->worker = worker;
+  ticket->model = model;
+  ticket->id = next_id_.fetch_add(1);
+  ticket->start = Clock::now();
+  queue->running[ticket->id] = {ticket->start, service_ms};
+  return true;
+}
+
+void AdmissionQueue::Cancel(const std::string& worker, const uint64_t id) {
+  std::shared_ptr<WorkerQueue> queue = Queue(worker);
+  Callbacks ready;
+  {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    auto it = queue->pending.find(id);
+    if (it == queue->pending.end()) { return; }  // Already decided
+    AdmitFn on_admitted = std::move(it->second.on_admitted);
+    queue->waiting.erase(it->second.waiter);
+    queue->pending.erase(it);
+    ready.push_back([on_admitted] { on_admitted(false, Ticket()); });
+    // The next waiter may be first now
+    Dispatch(worker, queue.get(), &ready);
+  }
+  for (const auto& fn : ready) { fn(); }
+}
+
+void AdmissionQueue::Release(const Ticket& ticket, const bool success) {
+  std::shared_ptr<WorkerQueue> queue = Queue(ticket.worker);
+  const double elapsed_ms = ElapsedMs(ticket.start, Clock::now());
+  Callbacks ready;
+  {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    queue->running.erase(ticket.id);
+    Dispatch(ticket.worker, queue.get(), &ready);
+  }
+  for (const auto& fn : ready) { fn(); }
+
+  if (!success) { return; }
+  service_.Update(ticket.model, [&](ServiceStats& stats, bool) {
+    if (stats.samples == 0) {
+      stats.mean_ms = elapsed_ms;
+    } else {
+      stats.mean_ms += service_time_alpha * (elapsed_ms - stats.mean_ms);
+    }
+    ++stats.samples;
+  });
+}
+
+/*********************** Private Functions ***********************/
+
+void AdmissionQueue::Dispatch(const std::string& worker, WorkerQueue* queue,
+                              Callbacks* ready) {
+  const TimePoint now = Clock::now();
+  while (!queue->waiting.empty() &&
+         (queue->running.size() < (size_t)slots_)) {
+    const Waiter head = *queue->waiting.begin();
+    queue->waiting.erase(queue->waiting.begin());
+    auto it = queue->pending.find(head.id);
+    AdmitFn on_admitted = std::move(it->second.on_admitted);
+    const bool late = (now >= it->second.latest_start);
+    Ticket ticket;
+    if (!late) {
+      ticket.worker = worker;
+      ticket.model = it->second.model;
+      ticket.id = head.id;
+      ticket.start = now;
+      queue->running[head.id] = {now, head.service_ms};
+    }
+    queue->pending.erase(it);
+    ready->push_back(
+        [on_admitted, late, ticket] { on_admitted(!late, ticket); });
+  }
+}
+
+void AdmissionQueue::TimerLoop() {
+  std::unique_lock<std::mutex> lock(timer_mutex_);
+  while (!stopping_) {
+    if (expiries_.empty()) {
+      timer_cv_.wait(lock);
+      continue;
+    }
+    const TimePoint due = expiries_.begin()->first;
+    if (Clock::now() < due) {
+      timer_cv_.wait_until(lock, due);
+      continue;
+    }
+    const std::pair<std::string, uint64_t> waiter =
+        expiries_.begin()->second;
+    expiries_.erase(expiries_.begin());
+    lock.unlock();
+    Cancel(waiter.first, waiter.second);
+    lock.lock();
+  }
+}
+
+}  // namespace internal
+}  // namespace infaas
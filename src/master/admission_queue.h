@@ -0,0 +1,191 @@
+/*
+ * Copyright 2018-2021 Board of Trustees of Stanford University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ADMISSION_QUEUE_H
+#define ADMISSION_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "frontend_state.h"
+
+namespace infaas {
+namespace internal {
+
+// Deadline-aware admission of online queries into workers.
+//
+// Each worker gets a fixed number of slots, i.e. queries the frontend lets
+// run on it at once. A query that finds no free slot waits in the worker's
+// queue, which is served earliest deadline first. Before queueing, the
+// frontend asks Feasible() whether the query can still finish in time: the
+// predicted completion is the work already in flight plus the work queued
+// ahead of it (earlier deadlines), spread over the worker's slots, plus the
+// query's own service time. A waiter also gives up once starting now would
+// miss its deadline, so an overloaded worker sheds the queries it would have
+// served late instead of serving all of them late.
+//
+// Waiting does not hold a thread: Acquire queues the query with a callback,
+// which runs once the query holds a slot or has given up. Slots are handed
+// out by the thread that frees one (Release), and waiters give up on the
+// queue's timer thread.
+//
+// Service times are per variant: an exponentially weighted average of the
+// worker calls seen by this frontend, or the caller's profiled estimate
+// until the first call completes. All methods are thread-safe.
+class AdmissionQueue {
+public:
+  typedef std::chrono::steady_clock Clock;
+  typedef Clock::time_point TimePoint;
+
+  // A slot held on a worker; returned by Acquire, given back to Release.
+  struct Ticket {
+    std::string worker;
+    std::string model;
+    uint64_t id = 0;
+    TimePoint start;
+  };
+
+  // Outcome of Acquire: admitted with the query's ticket, or not.
+  typedef std::function<void(bool admitted, const Ticket& ticket)> AdmitFn;
+
+  explicit AdmissionQueue(const int16_t slots_per_worker = 8);
+  ~AdmissionQueue();
+
+  // Predicted service time of one query on model, in ms.
+  double ServiceTime(const std::string& model, const double profiled_ms);
+
+  // Whether a query with service_ms of work, queued on worker now, is
+  // predicted to finish by deadline. TimePoint::max() is never late.
+  bool Feasible(const std::string& worker, const TimePoint deadline,
+                const double service_ms);
+
+  // Queues the query for one of the worker's slots and returns at once.
+  // on_admitted runs exactly once: with true and the ticket when the query
+  // gets a slot, or with false when it can no longer start in time to meet
+  // deadline or is cancelled. It runs on the calling thread if a slot is
+  // free now, else on the thread that frees one or on the timer thread, so
+  // it must not block. Returns the id to Cancel the wait with.
+  uint64_t Acquire(const std::string& worker, const std::string& model,
+                   const TimePoint deadline, const double service_ms,
+                   const AdmitFn& on_admitted);
+
+  // Blocking form, for callers on a thread of their own. Returns false,
+  // without a slot, if the query can no longer start in time.
+  bool Acquire(const std::string& worker, const std::string& model,
+               const TimePoint deadline, const double service_ms,
+               Ticket* ticket);
+
+  // Takes a slot only if one is free and no query waits for it: for extra
+  // work such as a hedge, which may use spare capacity but must not push
+  // queued queries back. Returns false, without a slot, otherwise.
+  bool TryAcquire(const std::string& worker, const std::string& model,
+                  const double service_ms, Ticket* ticket);
+
+  // Stops waiting for a slot: on_admitted runs with false, unless it has
+  // already run.
+  void Cancel(const std::string& worker, const uint64_t id);
+
+  // Gives the slot back. A successful call's duration updates the service
+  // time of the ticket's model; failures return early and would skew it.
+  void Release(const Ticket& ticket, const bool success);
+
+private:
+  struct Waiter {
+    TimePoint deadline;
+    uint64_t id;  // Arrival order among equal deadlines
+    double service_ms;
+    bool operator<(const Waiter& other) const {
+      return (deadline < other.deadline) ||
+             ((deadline == other.deadline) && (id < other.id));
+    }
+  };
+
+  // What a waiter needs once it is decided
+  struct Pending {
+    Waiter waiter;
+    std::string model;
+    TimePoint latest_start;  // max() if unbounded
+    AdmitFn on_admitted;
+  };
+
+  struct Running {
+    TimePoint start;
+    double service_ms;
+  };
+
+  struct WorkerQueue {
+    std::mutex mutex;
+    std::set<Waiter> waiting;
+    std::map<uint64_t, Pending> pending;  // By waiter id
+    std::map<uint64_t, Running> running;
+  };
+
+  typedef std::vector<std::function<void()>> Callbacks;
+
+  std::shared_ptr<WorkerQueue> Queue(const std::string& worker);
+  // Time, in ms, until a query with deadline would start on queue (locked)
+  double PredictWait(const WorkerQueue& queue, const TimePoint now,
+                     const TimePoint deadline) const;
+  // Hands the worker's free slots to the waiters at the head of queue
+  // (locked), and drops head waiters that can no longer start in time. Their
+  // callbacks are added to ready, to be run once the lock is released.
+  void Dispatch(const std::string& worker, WorkerQueue* queue,
+                Callbacks* ready);
+  // Gives up the waits whose latest start has passed
+  void TimerLoop();
+
+  const int16_t slots_;
+
+  std::mutex queues_mutex_;
+  std::map<std::string, std::shared_ptr<WorkerQueue>> queues_;
+  std::atomic<uint64_t> next_id_;
+
+  struct ServiceStats {
+    double mean_ms = 0.0;
+    uint64_t samples = 0;
+  };
+  ShardedMap<ServiceStats> service_;
+
+  // Latest starts of bounded waiters: (worker, id), soonest first. Entries
+  // of waiters that got a slot are dropped when they come due.
+  std::mutex timer_mutex_;
+  std::condition_variable timer_cv_;
+  std::multimap<TimePoint, std::pair<std::string, uint64_t>> expiries_;
+  bool stopping_;
+  std::thread timer_;
+};
+
+}  // namespace internal
+}  // namespace infaas
+
+#endif
@@ -0,0 +1,225 @@
+/*
+ * Copyright 2018-2021 Board of Trustees of Stanford University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "admission_queue.h"
+
+#define FAIL(x) printf("[FAIL]: " #x "\n")
+#define PASS(x) printf("[PASS]: " #x "\n")
+
+using infaas::internal::AdmissionQueue;
+
+static const std::string worker = "iw-0";
+static const std::string model = "mymodel_trt";
+
+// Records the outcomes of the Acquire calls made with its callbacks
+struct Outcomes {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<std::string> admitted;  // Names, in the order admitted
+  std::vector<std::string> rejected;
+  std::vector<AdmissionQueue::Ticket> tickets;
+  std::thread::id rejected_on;
+
+  AdmissionQueue::AdmitFn Fn(const std::string& name) {
+    return [this, name](bool ok, const AdmissionQueue::Ticket& ticket) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (ok) {
+        admitted.push_back(name);
+        tickets.push_back(ticket);
+      } else {
+        rejected.push_back(name);
+        rejected_on = std::this_thread::get_id();
+      }
+      cv.notify_all();
+    };
+  }
+
+  // Waits up to timeout for n rejections
+  bool WaitRejected(const size_t n, const std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return cv.wait_for(lock, timeout, [&] { return rejected.size() >= n; });
+  }
+};
+
+static AdmissionQueue::TimePoint in_ms(const int64_t ms) {
+  return AdmissionQueue::Clock::now() + std::chrono::milliseconds(ms);
+}
+
+int main() {
+  // One slot per worker, so every query after the first has to wait
+  AdmissionQueue admission(1);
+  AdmissionQueue::Ticket held;
+
+  // TryAcquire takes a free slot, and only a free one
+  if (!admission.TryAcquire(worker, model, 1.0, &held)) {
+    FAIL("TryAcquire takes a free slot");
+    return 1;
+  }
+  AdmissionQueue::Ticket extra;
+  if (admission.TryAcquire(worker, model, 1.0, &extra)) {
+    FAIL("TryAcquire fails while the slot is held");
+    return 1;
+  }
+  PASS("TryAcquire");
+
+  // Waiters are served earliest deadline first, not in arrival order
+  Outcomes order;
+  admission.Acquire(worker, model, in_ms(10000), 1.0, order.Fn("late"));
+  admission.Acquire(worker, model, in_ms(3000), 1.0, order.Fn("early"));
+  admission.Acquire(worker, model, in_ms(6000), 1.0, order.Fn("middle"));
+  if (!order.admitted.empty() || !order.rejected.empty()) {
+    FAIL("Waiters wait for the held slot");
+    return 1;
+  }
+  // TryAcquire must not jump the queue even once the slot is free
+  admission.Release(held, false);
+  if (admission.TryAcquire(worker, model, 1.0, &extra)) {
+    FAIL("TryAcquire does not take a slot a waiter is due");
+    return 1;
+  }
+  for (int i = 1; i < 3; ++i) {
+    admission.Release(order.tickets.back(), false);
+  }
+  const std::vector<std::string> expected = {"early", "middle", "late"};
+  if (order.admitted == expected) {
+    PASS("Deadline order");
+  } else {
+    FAIL("Deadline order");
+    return 1;
+  }
+  admission.Release(order.tickets.back(), false);
+
+  // A freed slot goes to the next query at once
+  Outcomes released;
+  admission.Acquire(worker, model, in_ms(5000), 1000.0, released.Fn("next"));
+  if ((released.admitted.size() == 1) &&
+      !admission.TryAcquire(worker, model, 1.0, &extra)) {
+    PASS("Acquire takes a released slot");
+  } else {
+    FAIL("Acquire takes a released slot");
+    return 1;
+  }
+  held = released.tickets.back();
+
+  // A waiter that can no longer start in time is rejected by the timer
+  // thread, without anyone releasing a slot
+  Outcomes timed;
+  const AdmissionQueue::TimePoint start = AdmissionQueue::Clock::now();
+  admission.Acquire(worker, model, in_ms(100), 50.0, timed.Fn("doomed"));
+  if (!timed.WaitRejected(1, std::chrono::milliseconds(2000))) {
+    FAIL("Late waiter rejected by the timer thread");
+    return 1;
+  }
+  const double waited_ms = std::chrono::duration<double, std::milli>(
+                               AdmissionQueue::Clock::now() - start)
+                               .count();
+  if (timed.admitted.empty() && (waited_ms >= 45.0) && (waited_ms < 1000.0) &&
+      (timed.rejected_on != std::this_thread::get_id())) {
+    PASS("Late waiter rejected by the timer thread");
+  } else {
+    FAIL("Late waiter rejected by the timer thread");
+    return 1;
+  }
+
+  // Feasible counts the work running ahead of a query: about 1 s on worker,
+  // none on an idle one
+  if (!admission.Feasible(worker, AdmissionQueue::TimePoint::max(), 1e9) ||
+      admission.Feasible(worker, in_ms(500), 100.0) ||
+      !admission.Feasible("iw-1", in_ms(500), 100.0)) {
+    FAIL("Feasible");
+    return 1;
+  }
+  PASS("Feasible");
+
+  // Cancel stops a wait, and the callback runs once with false
+  Outcomes cancelled;
+  const uint64_t waiting_id = admission.Acquire(worker, model, in_ms(5000),
+                                                1.0, cancelled.Fn("waiter"));
+  admission.Cancel(worker, waiting_id);
+  admission.Cancel(worker, waiting_id);
+  if ((cancelled.rejected.size() == 1) && cancelled.admitted.empty()) {
+    PASS("Cancel while waiting");
+  } else {
+    FAIL("Cancel while waiting");
+    return 1;
+  }
+
+  // Cancel after admission does nothing: the query keeps its slot
+  admission.Release(held, false);
+  Outcomes kept;
+  const uint64_t admitted_id =
+      admission.Acquire(worker, model, in_ms(5000), 1.0, kept.Fn("runner"));
+  admission.Cancel(worker, admitted_id);
+  if ((kept.admitted.size() == 1) && kept.rejected.empty() &&
+      !admission.TryAcquire(worker, model, 1.0, &extra)) {
+    PASS("Cancel after admission");
+  } else {
+    FAIL("Cancel after admission");
+    return 1;
+  }
+
+  // Releasing the slot frees it; only successful calls update the service
+  // time of their model
+  if (admission.ServiceTime(model, 99.0) != 99.0) {
+    FAIL("Profiled service time before any call");
+    return 1;
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  admission.Release(kept.tickets.back(), true);
+  const double learned_ms = admission.ServiceTime(model, 99.0);
+  if ((learned_ms < 15.0) || (learned_ms > 90.0)) {
+    FAIL("Service time learned from a successful call");
+    return 1;
+  }
+  if (!admission.TryAcquire(worker, model, 1.0, &held)) {
+    FAIL("Slot release");
+    return 1;
+  }
+  admission.Release(held, false);
+  if (admission.ServiceTime(model, 99.0) != learned_ms) {
+    FAIL("Failed calls leave the service time alone");
+    return 1;
+  }
+  PASS("Slot release");
+
+  // The blocking form, for callers on a thread of their own
+  AdmissionQueue::Ticket blocking;
+  if (!admission.Acquire(worker, model, in_ms(5000), 1.0, &blocking)) {
+    FAIL("Blocking Acquire");
+    return 1;
+  }
+  admission.Release(blocking, false);
+  PASS("Blocking Acquire");
+
+  std::cout << "All tests passed!!" << std::endl;
+  return 0;
+}
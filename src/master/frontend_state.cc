@@ -0,0 +1,211 @@
+/*
+ * Copyright 2018-2021 Board of Trustees of Stanford University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <random>
+
+#include "frontend_state.h"
+
+namespace infaas {
+namespace internal {
+
+MruList::MruList(const size_t capacity)
+    : capacity_(capacity),
+      list_(std::make_shared<const std::vector<std::string>>()) {}
+
+std::shared_ptr<const std::vector<std::string>> MruList::Snapshot() const {
+  return std::atomic_load(&list_);
+}
+
+bool MruList::Touch(const std::string& name) {
+  std::shared_ptr<const std::vector<std::string>> cur = std::atomic_load(&list_);
+  while (true) {
+    // Already the most recent: nothing to publish
+    if (!cur->empty() && (cur->front() == name)) { return true; }
+
+    bool found = false;
+    std::shared_ptr<std::vector<std::string>> next =
+        std::make_shared<std::vector<std::string>>();
+    next->reserve(capacity_);
+    next->push_back(name);
+    for (const std::string& n : *cur) {
+      if (n == name) {
+        found = true;
+      } else if (next->size() < capacity_) {
+        next->push_back(n);
+      }
+    }
+
+    std::shared_ptr<const std::vector<std::string>> desired = next;
+    if (std::atomic_compare_exchange_weak(&list_, &cur, desired)) {
+      return found;
+    }
+    // cur now holds the list another thread published; redo on top of it
+  }
+}
+
+WorkerLoad::WorkerLoad(const int max_report_age_ms)
+    : max_report_age_(max_report_age_ms) {}
+
+void WorkerLoad::Start(const std::string& worker) {
+  workers_.Update(worker, [](Entry& e, bool) { ++e.outstanding; });
+}
+
+void WorkerLoad::Finish(const std::string& worker,
+                        const int64_t reported_depth) {
+  const std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now();
+  workers_.Update(worker, [&](Entry& e, bool) {
+    if (e.outstanding > 0) { --e.outstanding; }
+    if (reported_depth >= 0) {
+      e.reported = reported_depth;
+      e.outstanding_at_report = e.outstanding;
+      e.report_time = now;
+      e.has_report = true;
+    }
+  });
+}
+
+int64_t WorkerLoad::Load(const std::string& worker) const {
+  Entry e;
+  if (!workers_.Get(worker, &e)) { return 0; }
+  if (!e.has_report ||
+      (std::chrono::steady_clock::now() - e.report_time > max_report_age_)) {
+    return e.outstanding;
+  }
+  // Our own queries are part of the report; only count what changed since
+  return std::max(e.outstanding,
+                  e.reported + e.outstanding - e.outstanding_at_report);
+}
+
+std::string WorkerLoad::PickLeastLoaded(
+    const std::vector<std::string>& candidates, const size_t d) const {
+  thread_local std::mt19937 gen(std::random_device{}());
+  std::vector<size_t> order(candidates.size());
+  for (size_t i = 0; i < order.size(); ++i) { order[i] = i; }
+
+  std::string best;
+  int64_t best_load = 0;
+  const size_t samples = std::min(d, candidates.size());
+  for (size_t i = 0; i < samples; ++i) {
+    // Partial Fisher-Yates: order[i] becomes a fresh random pick
+    std::uniform_int_distribution<size_t> pick(i, order.size() - 1);
+    std::swap(order[i], order[pick(gen)]);
+    const std::string& worker = candidates[order[i]];
+    const int64_t load = Load(worker);
+    if (best.empty() || (load < best_load)) {
+      best = worker;
+      best_load = load;
+    }
+  }
+  return best;
+}
+
+LatencyWindow::LatencyWindow(const size_t window)
+    : window_(window > 0 ? window : 1) {}
+
+void LatencyWindow::Record(const std::string& key, const double ms) {
+  rings_.Update(key, [&](Ring& ring, bool) {
+    if (ring.samples.size() < window_) {
+      ring.samples.push_back(ms);
+    } else {
+      ring.samples[ring.next] = ms;
+    }
+    ring.next = (ring.next + 1) % window_;
+  });
+}
+
+bool LatencyWindow::Percentile(const std::string& key, const double p,
+                               const size_t min_samples, double* ms) const {
+  Ring ring;
+  if (!rings_.Get(key, &ring) || ring.samples.empty() ||
+      (ring.samples.size() < min_samples)) {
+    return false;
+  }
+  std::vector<double>& v = ring.samples;
+  const size_t rank = std::min(v.size() - 1, (size_t)(p * v.size()));
+  std::nth_element(v.begin(), v.begin() + rank, v.end());
+  *ms = v[rank];
+  return true;
+}
+
+HedgeBudget::HedgeBudget(const double fraction, const double max_tokens)
+    : fraction_(fraction), max_tokens_(max_tokens), tokens_(0.0) {}
+
+void HedgeBudget::Earn() {
+  if (!enabled()) { return; }
+  std::lock_guard<std::mutex> lock(mutex_);
+  tokens_ = std::min(max_tokens_, tokens_ + fraction_);
+}
+
+bool HedgeBudget::TrySpend() {
+  if (!enabled()) { return false; }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (tokens_ < 1.0) { return false; }
+  tokens_ -= 1.0;
+  return true;
+}
+
+TaskPool::TaskPool(const size_t num_threads) : stopping_(false) {
+  for (size_t i = 0; i < std::max(num_threads, (size_t)1); ++i) {
+    threads_.push_back(std::thread(&TaskPool::Loop, this));
+  }
+}
+
+TaskPool::~TaskPool() { Stop(); }
+
+void TaskPool::Run(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) { return; }
+    tasks_.push_back(std::move(task));
+  }
+  cv_.notify_one();
+}
+
+void TaskPool::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  for (std::thread& t : threads_) {
+    if (t.joinable()) { t.join(); }
+  }
+}
+
+void TaskPool::Loop() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+      if (tasks_.empty()) { return; }  // Stopping, and nothing left to run
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+}  // namespace internal
+}  // namespace infaas
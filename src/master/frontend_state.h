@@ -0,0 +1,322 @@
+/*
+ * Copyright 2018-2021 Board of Trustees of Stanford University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FRONTEND_STATE_H
+#define FRONTEND_STATE_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace infaas {
+namespace internal {
+
+// Concurrency-safe containers for the routing state the frontend keeps
+// between requests. Every gRPC thread reads and updates this state, so each
+// container keeps the common path free of a global lock.
+
+// Number of lock shards in a ShardedMap.
+static const size_t state_num_shards = 64;
+
+// A string-keyed map split into independently locked shards. Requests for
+// different keys rarely touch the same lock.
+template <class V>
+class ShardedMap {
+public:
+  // Copies the value for key into *value. Returns false if key is absent
+  bool Get(const std::string& key, V* value) const {
+    const Shard& s = ShardFor(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto it = s.map.find(key);
+    if (it == s.map.end()) { return false; }
+    *value = it->second;
+    return true;
+  }
+
+  bool Contains(const std::string& key) const {
+    const Shard& s = ShardFor(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.map.count(key) > 0;
+  }
+
+  void Set(const std::string& key, const V& value) {
+    Shard& s = ShardFor(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.map[key] = value;
+  }
+
+  // Inserts only if key is absent. Returns true if it inserted
+  bool Insert(const std::string& key, const V& value) {
+    Shard& s = ShardFor(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.map.insert(std::make_pair(key, value)).second;
+  }
+
+  // Returns true if key was present
+  bool Erase(const std::string& key) {
+    Shard& s = ShardFor(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.map.erase(key) > 0;
+  }
+
+  // Removes key, moving its value into *value. Returns false if key was
+  // absent
+  bool Take(const std::string& key, V* value) {
+    Shard& s = ShardFor(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto it = s.map.find(key);
+    if (it == s.map.end()) { return false; }
+    *value = std::move(it->second);
+    s.map.erase(it);
+    return true;
+  }
+
+  // Runs fn(value, inserted) atomically on key's entry, creating a default
+  // value (inserted = true) if key was absent.
+  void Update(const std::string& key, const std::function<void(V&, bool)>& fn) {
+    Shard& s = ShardFor(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto res = s.map.insert(std::make_pair(key, V()));
+    fn(res.first->second, res.second);
+  }
+
+private:
+  struct Shard {
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, V> map;
+    char pad[64];  // Keep neighbouring shards' locks off one cache line
+  };
+
+  Shard& ShardFor(const std::string& key) const {
+    return shards_[std::hash<std::string>()(key) % state_num_shards];
+  }
+
+  mutable std::array<Shard, state_num_shards> shards_;
+};
+
+// A value that is replaced whole rather than modified in place. Readers get
+// an immutable snapshot that stays valid however long they hold it; writers
+// publish a new version with one atomic pointer swap.
+template <class T>
+class EpochPtr {
+public:
+  EpochPtr() : ptr_(std::make_shared<const T>()) {}
+  explicit EpochPtr(T value) : ptr_(std::make_shared<const T>(std::move(value))) {}
+
+  std::shared_ptr<const T> Load() const { return std::atomic_load(&ptr_); }
+
+  void Store(T value) {
+    std::atomic_store(&ptr_, std::shared_ptr<const T>(
+                                 std::make_shared<const T>(std::move(value))));
+  }
+
+private:
+  std::shared_ptr<const T> ptr_;
+};
+
+// Round-robin position shared by all threads.
+class RoundRobinCounter {
+public:
+  RoundRobinCounter() : next_(0) {}
+
+  // Next index in [0, n). n may change between calls (workers come and go)
+  size_t Next(size_t n) {
+    return (n == 0) ? 0 : next_.fetch_add(1, std::memory_order_relaxed) % n;
+  }
+
+private:
+  std::atomic<uint64_t> next_;
+};
+
+// Bounded most-recently-used list of names. Reads take a snapshot without
+// locking; updates copy the (small) list and publish it with compare-and-swap,
+// retrying if another thread published first.
+class MruList {
+public:
+  explicit MruList(const size_t capacity);
+
+  // Current contents, most recent first
+  std::shared_ptr<const std::vector<std::string>> Snapshot() const;
+
+  // Moves name to the front, evicting the oldest entry when full. Returns
+  // true if name was already in the list
+  bool Touch(const std::string& name);
+
+private:
+  const size_t capacity_;
+  std::shared_ptr<const std::vector<std::string>> list_;
+};
+
+// Outstanding-request load of each worker, for power-of-d-choices routing.
+// The frontend counts the queries it has in flight to each worker. Worker
+// replies also carry the worker's own in-flight count, which includes other
+// frontends' queries; that report is carried forward by what this frontend
+// started or finished since, and ignored once older than max_report_age_ms.
+class WorkerLoad {
+public:
+  explicit WorkerLoad(const int max_report_age_ms = 1000);
+
+  // A query was sent to worker
+  void Start(const std::string& worker);
+  // It came back; reported_depth is the depth in the reply, or -1 if none
+  void Finish(const std::string& worker, const int64_t reported_depth);
+
+  int64_t Load(const std::string& worker) const;
+
+  // Samples up to d distinct candidates at random and returns the least
+  // loaded one (the first sampled on ties). Empty if there are no candidates.
+  std::string PickLeastLoaded(const std::vector<std::string>& candidates,
+                              const size_t d) const;
+
+private:
+  struct Entry {
+    int64_t outstanding = 0;
+    int64_t reported = 0;
+    int64_t outstanding_at_report = 0;
+    std::chrono::steady_clock::time_point report_time;
+    bool has_report = false;
+  };
+
+  ShardedMap<Entry> workers_;
+  const std::chrono::milliseconds max_report_age_;
+};
+
+// The most recent latencies of each key (variant), for percentile estimates.
+class LatencyWindow {
+public:
+  explicit LatencyWindow(const size_t window = 256);
+
+  void Record(const std::string& key, const double ms);
+
+  // The p-th quantile (0 < p < 1) of key's window. Returns false if fewer
+  // than min_samples have been recorded.
+  bool Percentile(const std::string& key, const double p,
+                  const size_t min_samples, double* ms) const;
+
+private:
+  struct Ring {
+    std::vector<double> samples;
+    size_t next = 0;
+  };
+
+  const size_t window_;
+  ShardedMap<Ring> rings_;
+};
+
+// Caps hedged (duplicate) requests at a fraction of all requests. Each
+// request earns fraction of a token and each hedge spends a whole one; at
+// most max_tokens are saved up, so a quiet period cannot fund a burst.
+class HedgeBudget {
+public:
+  explicit HedgeBudget(const double fraction, const double max_tokens = 10.0);
+
+  bool enabled() const { return fraction_ > 0.0; }
+  void Earn();
+  // Returns true, and spends a token, if a hedge is allowed now
+  bool TrySpend();
+
+private:
+  const double fraction_;
+  const double max_tokens_;
+  std::mutex mutex_;
+  double tokens_;
+};
+
+// A fixed set of threads that run tasks in the order they are queued. It
+// keeps blocking work (metadata lookups) off the completion-queue threads,
+// which must never wait.
+class TaskPool {
+public:
+  explicit TaskPool(const size_t num_threads);
+  ~TaskPool();
+
+  // Queues task. Tasks queued after Stop are dropped
+  void Run(std::function<void()> task);
+
+  // Runs the tasks already queued, then joins the threads
+  void Stop();
+
+private:
+  void Loop();
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> tasks_;
+  bool stopping_;
+  std::vector<std::thread> threads_;
+};
+
+// Collapses concurrent calls that would compute the same thing. The first
+// caller for a key leads the call and does the work; callers that arrive
+// while it is in flight wait for it and get the same result instead of
+// repeating it. Nothing is kept once the call completes, so this is not a
+// cache. Nobody blocks: waiters are handed the result by callback.
+template <class R>
+class SingleFlight {
+public:
+  // Gets the result of a call waited on; null if the call failed and the
+  // waiter has to do the work itself.
+  typedef std::function<void(std::shared_ptr<const R>)> ResultFn;
+
+  // Returns true if no call for key is in flight: the caller leads a new
+  // one and must end it with Finish. Otherwise the caller waits on the
+  // running call and on_result runs on the leader's thread once it
+  // finishes, so it must not block. A waiter that gives up early (deadline
+  // passed, client gone) just ignores on_result when it comes; the call goes
+  // on for its other callers.
+  bool Join(const std::string& key, const ResultFn& on_result) {
+    bool leads = false;
+    calls_.Update(key, [&](std::vector<ResultFn>& waiters, bool inserted) {
+      leads = inserted;
+      if (!inserted) { waiters.push_back(on_result); }
+    });
+    return leads;
+  }
+
+  // Ends the call led for key and hands result (null if it failed) to the
+  // callers waiting on it.
+  void Finish(const std::string& key, const std::shared_ptr<const R>& result) {
+    // Later arrivals start a new call rather than reuse this result
+    std::vector<ResultFn> waiters;
+    calls_.Take(key, &waiters);
+    for (const ResultFn& on_result : waiters) { on_result(result); }
+  }
+
+private:
+  ShardedMap<std::vector<ResultFn>> calls_;
+};
+
+}  // namespace internal
+}  // namespace infaas
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ * Copyright 2018-2021 Board of Trustees of Stanford University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frontend_state.h"
+
+#define FAIL(x) printf("[FAIL]: " #x "\n")
+#define PASS(x) printf("[PASS]: " #x "\n")
+
+using infaas::internal::SingleFlight;
+
+// A follower's view of the call it waited on
+struct Follower {
+  bool called = false;
+  std::shared_ptr<const std::string> result;
+
+  SingleFlight<std::string>::ResultFn Fn() {
+    return [this](std::shared_ptr<const std::string> r) {
+      called = true;
+      result = r;
+    };
+  }
+};
+
+int main() {
+  SingleFlight<std::string> flights;
+  const std::string key = "mymodel_trt|input";
+
+  // The first caller for a key leads; the others follow until it finishes
+  Follower leader_fn, first, second, other_key;
+  if (!flights.Join(key, leader_fn.Fn())) {
+    FAIL("First caller leads");
+    return 1;
+  }
+  if (flights.Join(key, first.Fn()) || flights.Join(key, second.Fn())) {
+    FAIL("Later callers follow");
+    return 1;
+  }
+  if (!flights.Join("other|input", other_key.Fn())) {
+    FAIL("Calls for other keys lead their own");
+    return 1;
+  }
+  if (first.called || second.called) {
+    FAIL("Followers wait for the leader");
+    return 1;
+  }
+  PASS("Leader and follower join");
+
+  // The leader's result goes to every follower, and not to the leader
+  flights.Finish(key, std::make_shared<const std::string>("output"));
+  if (leader_fn.called || !first.called || !second.called ||
+      (first.result == nullptr) || (*first.result != "output") ||
+      (second.result != first.result) || other_key.called) {
+    FAIL("Followers get the leader's result");
+    return 1;
+  }
+  PASS("Followers get the leader's result");
+
+  // Nothing is kept: the next caller leads a new call
+  Follower late;
+  if (!flights.Join(key, late.Fn())) {
+    FAIL("A finished call is not reused");
+    return 1;
+  }
+  PASS("A finished call is not reused");
+
+  // A failed call hands its followers null, so each does the work itself
+  Follower failed;
+  flights.Join(key, failed.Fn());
+  flights.Finish(key, nullptr);
+  if (!failed.called || (failed.result != nullptr)) {
+    FAIL("Followers of a failed call get null");
+    return 1;
+  }
+  if (!flights.Join(key, late.Fn())) {
+    FAIL("A follower of a failed call can lead a new one");
+    return 1;
+  }
+  flights.Finish(key, nullptr);
+  flights.Finish("other|input", nullptr);
+  PASS("Failure fallback");
+
+  // Concurrent callers: exactly one leads, and every follower is answered
+  const int num_threads = 8;
+  const int rounds = 1000;
+  std::atomic<int> leaders(0);
+  std::atomic<int> answered(0);
+  std::atomic<int> followers(0);
+  for (int round = 0; round < rounds; ++round) {
+    const std::string k = "round" + std::to_string(round);
+    std::atomic<int> round_leaders(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+      threads.push_back(std::thread([&] {
+        if (flights.Join(k, [&](std::shared_ptr<const std::string>) {
+              ++answered;
+            })) {
+          ++round_leaders;
+        } else {
+          ++followers;
+        }
+      }));
+    }
+    for (auto& t : threads) { t.join(); }
+    flights.Finish(k, std::make_shared<const std::string>(k));
+    if (round_leaders.load() == 1) { ++leaders; }
+  }
+  if ((leaders.load() == rounds) && (answered.load() == followers.load()) &&
+      (followers.load() == rounds * (num_threads - 1))) {
+    PASS("Concurrent joins");
+  } else {
+    FAIL("Concurrent joins");
+    return 1;
+  }
+
+  std::cout << "All tests passed!!" << std::endl;
+  return 0;
+}
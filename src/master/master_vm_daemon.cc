@@ -44,6 +44,7 @@
 #include "constants.h" //PNB: (2025.11.28)
 #include "metadata-store/redis_metadata.h"
 #include "worker/query_client.h"
+#include "worker_channel_pool.h"
 
 /*
 The master's VM scaling daemon calls out to the shell to start a VM because
@@ -74,6 +75,10 @@ int16_t vm_shutdown_thresh = 15;
 std::map<INSTANCETYPE, int16_t> inst_type_map;
 std::map<INSTANCETYPE, int16_t> inst_type_min;
 
+// Warm channels to workers, shared by the startup heartbeats. Entries are
+// dropped whenever a worker is deleted from the metadata store.
+infaas::internal::WorkerChannelPool worker_channels;
+
 std::string stop_script = "scripts/stop_worker.sh";
 std::string start_vm_script = "scripts/start_vm.sh";
 
@@ -246,6 +251,7 @@ int main(int argc, char **argv) {
       // of the scaler.
       if (curr_cpu_util < 0.0) {
         rm_.delete_executor(min_cpu);
+        worker_channels.RemoveWorker(min_cpu);
       } else {
         avg_cpu_util += curr_cpu_util;
       }
@@ -276,6 +282,7 @@ int main(int argc, char **argv) {
       // of the scaler.
       if (curr_gpu_util < 0.0) {
         rm_.delete_executor(min_gpu);
+        worker_channels.RemoveWorker(min_gpu);
       } else if (curr_gpu_util < 100.0) {
         avg_gpu_util += curr_gpu_util;
         avg_gpu_counter++;
@@ -306,6 +313,7 @@ int main(int argc, char **argv) {
       // of the scaler.
       if (curr_inferentia_util < 0.0) {
         rm_.delete_executor(min_inferentia);
+        worker_channels.RemoveWorker(min_inferentia);
       } else if (curr_inferentia_util < 100.0) {
         avg_inferentia_util += curr_inferentia_util;
         avg_inferentia_counter++;
@@ -431,18 +439,18 @@ int main(int argc, char **argv) {
         }
 
         // Wait until the worker is ready before sending requests
-        grpc::ChannelArguments arguments;
-        arguments.SetMaxSendMessageSize(MAX_GRPC_MESSAGE_SIZE);
-        arguments.SetMaxReceiveMessageSize(MAX_GRPC_MESSAGE_SIZE);
-
-        infaas::internal::QueryClient query_client(grpc::CreateCustomChannel(
-            RedisMetadata::Address_to_str({exec_ip, exec_port}),
-            grpc::InsecureChannelCredentials(), arguments));
+        infaas::internal::QueryClient query_client(
+            worker_channels.GetChannel(next_worker, {exec_ip, exec_port}));
         auto worker_reply = query_client.Heartbeat();
         while (worker_reply.status() !=
                infaas::internal::InfaasRequestStatusEnum::SUCCESS) {
           std::cout << "[LOG]: Waiting for " << next_worker << " to respond..."
                     << std::endl;
+          // A failed heartbeat drops the worker's channels; reconnect.
+          if (worker_channels.ReportFailure(next_worker)) {
+            query_client = infaas::internal::QueryClient(
+                worker_channels.GetChannel(next_worker, {exec_ip, exec_port}));
+          }
           worker_reply = query_client.Heartbeat();
           usleep(respond_sleep_seconds);
         }
@@ -638,6 +646,7 @@ int main(int argc, char **argv) {
 
             // Remove the worker from the metadata store
             int8_t rc = rm_.delete_executor(victim_worker);
+            worker_channels.RemoveWorker(victim_worker);
             if (rc == -1) {
               std::cerr << "Failure to delete " << victim_worker;
               std::cerr << " from metadata store!" << std::endl;
@@ -118,6 +118,48 @@ std::vector<std::string> QueryFEClient::QueryOnline(
   }
 }
 
+std::vector<std::string> QueryFEClient::QueryOnlineStream(
+    const std::vector<std::string>& input, const std::string& model_variant,
+    const PreviewFn& on_preview, const DiffusionParams* params,
+    const std::string& submitter, const int64_t& latency) {
+  QueryOnlineRequest request;
+  for (auto inp : input) { request.add_raw_input(inp); }
+  request.set_model_variant(model_variant);
+  request.set_submitter(submitter);
+  request.mutable_slo()->set_latencyinusec(latency);
+  if (params != nullptr) { request.mutable_diffusion()->CopyFrom(*params); }
+
+  ClientContext context;
+  set_grpc_deadline(&context);
+  std::unique_ptr<grpc::ClientReader<QueryOnlineProgress>> reader(
+      stub_->QueryOnlineStream(&context, request));
+
+  // Previews until the message with a status, which carries the outputs
+  QueryOnlineProgress msg;
+  QueryOnlineProgress result;
+  while (reader->Read(&msg)) {
+    if (msg.has_status()) {
+      result.Swap(&msg);
+    } else if (on_preview && !on_preview(msg)) {
+      context.TryCancel();
+    }
+  }
+  Status status = reader->Finish();
+
+  if (!status.ok()) {
+    std::cout << "RPC error code: " << status.error_code() << ": "
+              << status.error_message() << std::endl;
+    return {status.error_message()};
+  }
+  if (result.status().status() != RequestReplyEnum::SUCCESS) {
+    std::cout << "INFaaS reply error status: " << result.status().msg()
+              << std::endl;
+    return {result.status().msg()};
+  }
+  return std::vector<std::string>(result.raw_output().begin(),
+                                  result.raw_output().end());
+}
+
 RequestReply QueryFEClient::QueryOffline(const std::string& input_url,
                                          const std::string& model,
                                          const std::string& submitter,
@@ -24,6 +24,7 @@
 #define QUERYFE_H
 
 #include <cstdint>
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -47,6 +48,18 @@ public:
       const int64_t& latency = 0, const double& minacc = 0,
       const double& maxcost = 0);
 
+  // Gets every preview of QueryOnlineStream; returning false cancels the
+  // query.
+  typedef std::function<bool(const QueryOnlineProgress&)> PreviewFn;
+
+  // QueryOnline request that streams previews while the output is generated.
+  // params (optional) sets the generation parameters, including how often
+  // a preview is sent. Returns the outputs, or the error message.
+  std::vector<std::string> QueryOnlineStream(
+      const std::vector<std::string>& input, const std::string& model_variant,
+      const PreviewFn& on_preview, const DiffusionParams* params = nullptr,
+      const std::string& submitter = "", const int64_t& latency = 0);
+
   // QueryOffline request
   RequestReply QueryOffline(const std::string& input_url,
                             const std::string& model,
@@ -23,14 +23,16 @@
 #include <algorithm> // sort, set_intersection, min, max, shuffle
 #include <chrono>
 #include <cstdint>
-#include <deque>
 #include <exception>
+#include <functional>
+#include <iomanip>
 #include <iostream>
 #include <map>
 #include <memory>
 #include <random>
 #include <set>
 #include <string>
+#include <thread>
 #include <time.h>
 #include <utility>
 #include <vector>
@@ -57,20 +59,31 @@ Aws::S3::S3Client UNUSED_S3_CLIENT;
 //#include "include/constants.h"
 #include "constants.h" //PNB: (2025.11.28)
 #include "common/local_paths.h" //PNB: (2025.11.28)
+#include "common/async_log.h"
+#include "common/query_key.h"
 #include "filesystem_utils.h"
 
+#include "metadata-store/metadata_cache.h"
 #include "metadata-store/redis_metadata.h"
 #include "queryfe.grpc.pb.h"
+#include <grpcpp/alarm.h>
 #include <grpcpp/grpcpp.h>
 
 #include "worker/query_client.h"
+#include "admission_queue.h"
+#include "frontend_state.h"
+#include "variant_index.h"
+#include "worker_channel_pool.h"
 #include "query.pb.h"
 #include "infaas_request_status.pb.h"
 // #include "protos/internal/diffusion_service.grpc.pb.h" //PNB: (2026.01.15)
 
 using grpc::Server;
+using grpc::ServerAsyncResponseWriter;
 using grpc::ServerBuilder;
+using grpc::ServerCompletionQueue;
 using grpc::ServerContext;
+using grpc::ServerWriter;
 using grpc::Status;
 
 
@@ -87,8 +100,38 @@ using grpc::Status;
 //// Constants and global variables ////
 static const int MAX_GRPC_MESSAGE_SIZE = INT32_MAX;
 
+// Number of server completion queues (each drained by its own thread) used
+// when none is given on the command line.
+static const int16_t default_num_cqs = 4;
+
+// Threads per completion queue that make the metadata store lookups of
+// online queries, which would otherwise block the completion-queue threads.
+static const int16_t routing_threads_per_cq = 4;
+
+// A worker call may run this long past its query's SLO, for the reply to
+// come back; calls for queries without an SLO get no_slo_worker_deadline_ms.
+static const int worker_deadline_margin_ms = 1000;
+static const int no_slo_worker_deadline_ms = 10000;
+
+// Number of warm channels kept open to each worker.
+static const int16_t channels_per_worker = 2;
+
+// Online queries the frontend lets run on one worker at once when none is
+// given on the command line; the others wait in the worker's deadline-ordered
+// admission queue.
+static const int16_t default_admission_slots = 8;
+
+// POWEROFDCHOICES: replicas sampled per query, out of at most
+// pod_max_replicas running the variant.
+static const size_t pod_choices = 2;
+static const int8_t pod_max_replicas = 32;
+
+// Hedging: a query still running after this quantile of its variant's recent
+// latencies is also sent to a second worker, once enough latencies are known.
+static const double hedge_quantile = 0.95;
+static const size_t hedge_min_samples = 20;
+
 // Decision-making constants
-static const double gmod_md_lat = 0.600;
 static const int16_t gmod_max_lru = 5;
 
 // Scale-based-on-QPS constants.
@@ -109,7 +152,8 @@ enum MasterDecisions {
   GPUSHARETRIGGER = 4,
   CPUBLISTCHECK = 5,
   GPUSHARETRIGGER_SKIPBLIST = 6,
-  ROUNDROBIN_DYNAMIC = 7
+  ROUNDROBIN_DYNAMIC = 7,
+  POWEROFDCHOICES = 8
 };
 
 namespace infaaspublic {
@@ -149,46 +193,229 @@ void parse_s3_url(const std::string &src_url, std::string *src_bucket,
 
   *src_bucket = ""; // Unused in local mode
   *obj_name = path; // Full local path
-  std::cout << "[LOCAL MODE] Reading input from: " << path << std::endl;
+  INFAAS_LOG(INFO) << "[LOCAL MODE] Reading input from: " << path;
 #endif
 }
 
+// Concurrent identical queries share one worker call. The frontend does not
+// know model versions; queries only coalesce while they are in flight.
+std::string coalesce_key(const std::string &model,
+                         const infaaspublic::infaasqueryfe::QueryOnlineRequest
+                             &request) {
+  return infaas::internal::DiffusionQueryKey(model, "", request);
+}
+
+// The client's deadline for a call on the steady clock; max() if it set none.
+std::chrono::steady_clock::time_point client_deadline(
+    const ServerContext &context) {
+  const std::chrono::system_clock::time_point deadline = context.deadline();
+  if (deadline == std::chrono::system_clock::time_point::max()) {
+    return std::chrono::steady_clock::time_point::max();
+  }
+  return std::chrono::steady_clock::now() +
+         std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+             deadline - std::chrono::system_clock::now());
+}
+
+// The gRPC deadline, in ms from now, of a worker call for a query due at
+// deadline.
+int worker_call_deadline_ms(
+    const std::chrono::steady_clock::time_point deadline) {
+  if (deadline == std::chrono::steady_clock::time_point::max()) {
+    return no_slo_worker_deadline_ms;
+  }
+  const int64_t left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                           deadline - std::chrono::steady_clock::now())
+                           .count();
+  return (int)std::min<int64_t>(std::max<int64_t>(left, 0),
+                                INT32_MAX - worker_deadline_margin_ms) +
+         worker_deadline_margin_ms;
+}
+
+// The generation parameters of a query, as the worker takes them.
+infaas::internal::InternalDiffusionQuery worker_diffusion_params(
+    const infaaspublic::infaasqueryfe::DiffusionParams &params) {
+  infaas::internal::InternalDiffusionQuery diffusion;
+  diffusion.set_steps(params.steps());
+  diffusion.set_guidancescale(params.guidancescale());
+  diffusion.set_seed(params.seed());
+  diffusion.set_width(params.width());
+  diffusion.set_height(params.height());
+  diffusion.set_previewevery(params.previewevery());
+  diffusion.set_previewsize(params.previewsize());
+  diffusion.set_format(
+      static_cast<infaas::internal::ImageFormat>(params.format()));
+  diffusion.set_quality(params.quality());
+  return diffusion;
+}
+
+// A worker's answer to one online query, shared by the identical queries
+// that were coalesced with it.
+struct WorkerOutcome {
+  infaas::internal::InfaasRequestStatus status;
+  google::protobuf::RepeatedPtrField<std::string> raw_output;
+  // The SLO could not be met, so the query was never sent
+  bool rejected = false;
+};
+
+// A steady-clock time point on the system clock, as gRPC deadlines take it.
+std::chrono::system_clock::time_point system_deadline(
+    const std::chrono::steady_clock::time_point deadline) {
+  return std::chrono::system_clock::now() +
+         std::chrono::duration_cast<std::chrono::system_clock::duration>(
+             deadline - std::chrono::steady_clock::now());
+}
+
+// Completion-queue tag. Every tag on the frontend's queues is one of these;
+// the thread draining a queue hands each event to the tag's Proceed.
+class CallDataBase {
+public:
+  virtual ~CallDataBase() {}
+  virtual void Proceed(bool ok) = 0;
+};
+
+// Tag for a single event: runs fn with the event's ok bit, then deletes
+// itself
+class OnceTag final : public CallDataBase {
+public:
+  explicit OnceTag(std::function<void(bool)> fn) : fn_(std::move(fn)) {}
+  void Proceed(bool ok) override {
+    fn_(ok);
+    delete this;
+  }
+
+private:
+  std::function<void(bool)> fn_;
+};
+
+// Runs fn(true) on cq's thread at deadline, or fn(false) as soon as alarm
+// is cancelled or destroyed before then.
+void set_alarm(grpc::Alarm *alarm, grpc::CompletionQueue *cq,
+               const std::chrono::steady_clock::time_point deadline,
+               std::function<void(bool)> fn) {
+  alarm->Set(cq, system_deadline(deadline), new OnceTag(std::move(fn)));
+}
+
+// Runs fn on cq's thread once the caller has moved on, so that a callback
+// fired on some other thread resumes its query where the query lives.
+void post(grpc::CompletionQueue *cq, std::function<void()> fn) {
+  grpc::Alarm *alarm = new grpc::Alarm;
+  alarm->Set(cq, gpr_now(GPR_CLOCK_MONOTONIC), new OnceTag([alarm, fn](bool) {
+               fn();
+               delete alarm;
+             }));
+}
+
+// One call of an online query to a worker
+struct WorkerAttempt {
+  std::string worker;
+  infaas::internal::AdmissionQueue::Ticket ticket;  // Its slot on worker
+  std::unique_ptr<infaas::internal::QueryClient> client;
+  infaas::internal::QueryClient::AsyncOnlineCall call;
+  std::chrono::steady_clock::time_point start;
+  bool done = false;
+  WorkerOutcome outcome;
+};
+
+// A QueryOnline call on its way through the frontend. It never holds a
+// thread while it waits: it is routed on the frontend's routing pool, and
+// every later step (waiting for an identical query, for admission, for the
+// worker and its hedge) resumes it on cq. cq has a single thread, so those
+// steps never run concurrently and the fields below need no lock. respond
+// sends the reply and is called once; context, request and reply are gone
+// after it, and events that come later (a losing hedge, a wait given up)
+// only clean up.
+struct OnlineQuery {
+  ServerContext *context = nullptr;
+  const QueryOnlineRequest *request = nullptr;
+  QueryOnlineResponse *reply = nullptr;
+  grpc::CompletionQueue *cq = nullptr;
+  std::function<void(const Status &)> respond;
+  bool cancelled = false;  // The client went away
+
+  // Routing
+  struct timeval arrival_tv;
+  infaas::internal::AdmissionQueue::TimePoint deadline;
+  std::string model;
+  std::string worker;
+  struct Address addr;
+  bool pinned = false;
+  infaas::internal::InternalDiffusionQuery diffusion;
+
+  // Coalescing: the key of the call this query leads, if any, and whether
+  // it waits (until wait_alarm) for an identical query to finish
+  std::string flight_key;
+  bool waiting = false;
+  infaas::internal::AdmissionQueue::TimePoint wait_until;
+  grpc::Alarm wait_alarm;
+
+  // Admission: the variants to try in turn with their service times, and
+  // the wait in progress
+  std::vector<std::pair<std::string, double>> candidates;
+  size_t next_candidate = 0;
+  bool downgrades_listed = false;
+  bool admitting = false;
+  uint64_t admission_id = 0;
+  infaas::internal::AdmissionQueue::Ticket ticket;
+
+  // Worker calls: the primary, then the hedge if one is sent
+  WorkerAttempt attempts[2];
+  int started = 0;
+  bool answered = false;
+  grpc::Alarm hedge_alarm;
+};
+
 } // namespace
 
 // Logic and data behind the server's behavior.
 class QueryServiceImpl final : public Query::Service {
 public:
   QueryServiceImpl(const struct Address redis_addr,
-                   const int8_t decision_policy, const int16_t slack_gpu)
-      : redis_addr_(redis_addr), all_exec_counter_(0), all_exec_gpu_counter_(0),
-        all_exec_inferentia_counter_(0), slack_gpu_(slack_gpu),
-        last_worker_picked_("") {
+                   const int8_t decision_policy, const int16_t slack_gpu,
+                   const double hedge_budget, const int16_t admission_slots,
+                   const int16_t routing_threads)
+      : redis_addr_(redis_addr), gmod_cache_(gmod_max_lru),
+        admission_(admission_slots), hedge_budget_(hedge_budget),
+        slack_gpu_(slack_gpu), worker_channels_(channels_per_worker),
+        routing_pool_(routing_threads) {
     rm_ = std::unique_ptr<RedisMetadata>(new RedisMetadata(redis_addr_));
+    // Static per-variant metadata is served from memory; dynamic state (QPS,
+    // running and blacklist flags) is still read through rm_. The cache's
+    // subscriber also drops the channels of deleted workers.
+    mc_ = std::unique_ptr<MetadataCache>(new MetadataCache(
+        redis_addr_, rm_.get(), [this](const std::string &key) {
+          worker_channels_.RemoveWorker(key);
+        }));
+    variant_index_ = std::unique_ptr<infaas::internal::VariantIndex>(
+        new infaas::internal::VariantIndex(rm_.get(), mc_.get()));
 
     if (decision_policy == 0) {
       master_decision_ = INFAAS_ALL;
-      std::cout << "Using mode: INFAAS_ALL" << std::endl;
+      INFAAS_LOG(INFO) << "Using mode: INFAAS_ALL";
     } else if (decision_policy == 1) {
       master_decision_ = INFAAS_NOQPSLAT;
-      std::cout << "Using mode: INFAAS_NOQPSLAT" << std::endl;
+      INFAAS_LOG(INFO) << "Using mode: INFAAS_NOQPSLAT";
     } else if (decision_policy == 2) {
       master_decision_ = ROUNDROBIN;
-      std::cout << "Using mode: ROUNDROBIN" << std::endl;
+      INFAAS_LOG(INFO) << "Using mode: ROUNDROBIN";
     } else if (decision_policy == 3) {
       master_decision_ = ROUNDROBIN_STATIC;
-      std::cout << "Using mode: ROUNDROBIN_STATIC" << std::endl;
+      INFAAS_LOG(INFO) << "Using mode: ROUNDROBIN_STATIC";
     } else if (decision_policy == 4) {
       master_decision_ = GPUSHARETRIGGER;
-      std::cout << "Using mode: GPUSHARETRIGGER" << std::endl;
+      INFAAS_LOG(INFO) << "Using mode: GPUSHARETRIGGER";
     } else if (decision_policy == 5) {
       master_decision_ = CPUBLISTCHECK;
-      std::cout << "Using mode: CPUBLISTCHECK" << std::endl;
+      INFAAS_LOG(INFO) << "Using mode: CPUBLISTCHECK";
     } else if (decision_policy == 6) {
       master_decision_ = GPUSHARETRIGGER_SKIPBLIST;
-      std::cout << "Using mode: GPUSHARETRIGGER_SKIPBLIST" << std::endl;
+      INFAAS_LOG(INFO) << "Using mode: GPUSHARETRIGGER_SKIPBLIST";
     } else if (decision_policy == 7) {
       master_decision_ = ROUNDROBIN_DYNAMIC;
-      std::cout << "Using mode: ROUNDROBIN_DYNAMIC" << std::endl;
+      INFAAS_LOG(INFO) << "Using mode: ROUNDROBIN_DYNAMIC";
+    } else if (decision_policy == 8) {
+      master_decision_ = POWEROFDCHOICES;
+      INFAAS_LOG(INFO) << "Using mode: POWEROFDCHOICES";
     } else {
       std::cerr << (int16_t)decision_policy << " is not a valid decision policy"
                 << std::endl;
@@ -201,8 +428,7 @@ public:
         (master_decision_ == ROUNDROBIN_DYNAMIC)) {
       // Get all executors
       all_exec_ = rm_->get_all_executors();
-      std::cout << "[LOG]: There are " << all_exec_.size() << " workers";
-      std::cout << std::endl;
+      INFAAS_LOG(INFO) << "[LOG]: There are " << all_exec_.size() << " workers";
       for (std::string ae : all_exec_) {
         if (!rm_->is_exec_onlycpu(ae) && !rm_->is_exec_inferentia(ae)) {
           all_gpu_exec_.push_back(ae);
@@ -213,6 +439,13 @@ public:
     }
   }
 
+  ~QueryServiceImpl() {
+    // Stop the cache's subscriber before worker_channels_, which it updates,
+    // goes away
+    variant_index_.reset();
+    mc_.reset();
+  }
+
 // #ifdef ENABLE_DIFFUSION
 //     // === CallDiffusionContainer begin ===
 //     //PNB: Diffusion model implementation related (2025.12.19)
@@ -252,6 +485,17 @@ public:
  
 
 private:
+  // Next worker from workers in round-robin order. The counter is shared by
+  //// all handler threads, so concurrent requests still spread out.
+  static std::string
+  PickRoundRobin(const std::vector<std::string> &workers,
+                 infaas::internal::RoundRobinCounter *counter) {
+    if (workers.empty()) {
+      throw std::runtime_error("No workers available to service request!");
+    }
+    return workers[counter->Next(workers.size())];
+  }
+
   // The assumption for this function is that BOTH an accuracy and a latency
   //// constraint are provided. The search will first check for models that
   /// satisfy the / accuracy constraint before moving on to finding one that
@@ -273,61 +517,49 @@ private:
       int8_t *is_running, MasterDecisions dec_policy) {
     // Do a tailored fast check search using the last couple of queries.
     // If there is a valid running model, use it.
-    // Otherwise, check a subset of options.
-    if (!gmod_cache_.empty()) {
+    // Otherwise, search the grandparent's variants.
+    std::shared_ptr<const infaas::internal::VariantTable> gtable =
+        variant_index_->Grandparent(gparent_model);
+    std::shared_ptr<const std::vector<std::string>> gmod_snapshot =
+        gmod_cache_.Snapshot();
+    if (!gmod_snapshot->empty()) {
       std::string candidate_model;
-      for (std::string avl : gmod_cache_) {
-        std::cout << "[LOG]: GPAR fast check -- currently considering model "
-                     "variant: ";
-        std::cout << avl << std::endl;
+      for (std::string avl : *gmod_snapshot) {
+        INFAAS_LOG(DEBUG) << "[LOG]: GPAR fast check -- currently considering "
+                             "model variant: " << avl;
+
+        // The cache is shared by all grandparents
+        int64_t row = gtable->Find(avl);
+        if (row < 0) {
+          continue;
+        }
 
         // Check that batch size is valid
-        std::string mv_batch = rm_->get_model_info(avl, "max_batch");
-        int16_t mv_batch_int = std::stoi(mv_batch);
-        if (mv_batch != "FAIL") {
-          if (mv_batch_int < batch_size) { // Not supported
-            continue;
-          }
-        } else {
-          return {};
+        int16_t mv_batch_int = gtable->max_batch[row];
+        if (mv_batch_int < batch_size) { // Not supported
+          continue;
         }
 
-        std::cout << "[LOG]: Passes batch" << std::endl;
+        INFAAS_LOG(DEBUG) << "[LOG]: Passes batch";
 
         // Check that the accuracy is valid
-        double mv_acc = rm_->get_accuracy(avl);
-        if (mv_acc > 0.0) {
-          if (mv_acc < accuracy_constraint) {
-            continue;
-          }
-        } else {
-          return {};
+        if (gtable->accuracy[row] < accuracy_constraint) {
+          continue;
         }
 
-        std::cout << "[LOG]: Passes accuracy" << std::endl;
+        INFAAS_LOG(DEBUG) << "[LOG]: Passes accuracy";
 
         // Get its inference latency based on slope and intercept computed
         // during registration
-        double mv_inf_lat, slope, intercept, batch_for_compute;
         if (latency_constraint > 0) {
-          slope = std::stod(rm_->get_model_info(avl, "slope"));
-          intercept = std::stod(rm_->get_model_info(avl, "intercept"));
-
-          if (mv_batch_int > 64) { // CPU model
-            batch_for_compute = (double)batch_size;
-          } else {
-            batch_for_compute = ((double)std::min((int16_t)32, mv_batch_int));
-          }
-
-          mv_inf_lat = slope * batch_for_compute + intercept;
+          double mv_inf_lat = gtable->PredictLatency(row, batch_size);
           if (mv_inf_lat > 0.0) {
             if (mv_inf_lat > latency_constraint) {
               continue;
             } else if ((latency_constraint > 100.0) && (mv_inf_lat < 100.0)) {
               // Don't pick GPU for CPU constraint
-              std::cout << "[LOG]: GPAR fast-check: Skipping GPU variant for "
-                           "loose latency";
-              std::cout << std::endl;
+              INFAAS_LOG(DEBUG) << "[LOG]: GPAR fast-check: Skipping GPU "
+                                   "variant for loose latency";
               continue;
             }
           } else {
@@ -335,11 +567,11 @@ private:
           }
         }
 
-        std::cout << "[LOG]: Passes latency" << std::endl;
+        INFAAS_LOG(DEBUG) << "[LOG]: Passes latency";
 
         // Check if it's running
         if (rm_->is_model_running(avl)) {
-          std::cout << "[LOG]: " << avl << " is running" << std::endl;
+          INFAAS_LOG(INFO) << "[LOG]: " << avl << " is running";
 
           if (dec_policy == INFAAS_NOQPSLAT) { // Just pick the model
             *is_running = 1;
@@ -349,18 +581,16 @@ private:
 
           // If model is being unloaded, skip it
           if (rm_->get_model_load_unload(avl)) {
-            std::cout << "[LOG] GPAR fast-check: " << avl
-                      << " is being unloaded";
-            std::cout << std::endl;
+            INFAAS_LOG(INFO) << "[LOG] GPAR fast-check: " << avl
+                             << " is being unloaded";
             continue;
           }
 
           // Check if the minimum QPS replica has been blacklisted
           std::vector<std::string> min_worker_name = rm_->min_qps_name(avl, 1);
           if (min_worker_name.empty()) {
-            std::cout << "[LOG]: Model set to running, but min_qps_name query "
-                         "failed.";
-            std::cout << "Continuing search" << std::endl;
+            INFAAS_LOG(INFO) << "[LOG]: Model set to running, but "
+                                "min_qps_name query failed. Continuing search";
             continue;
           }
 
@@ -371,29 +601,28 @@ private:
             throw std::runtime_error(
                 "Failed to check if model was blacklisted");
           } else if (!is_blisted) {
-            std::cout << "[LOG]: Meets blacklist check, picking ";
-            std::cout << avl << std::endl;
+            INFAAS_LOG(INFO) << "[LOG]: Meets blacklist check, picking " << avl;
             *is_running = 1;
             candidate_model = avl;
             break;
           } else { // It's blacklisted
-            std::cout << "[LOG]: Failed blacklist check" << std::endl;
+            INFAAS_LOG(INFO) << "[LOG]: Failed blacklist check";
             // If it's a GPU fast check, return it, but set is_running to 0
             if (mv_batch_int < 64) {
-              std::cout << "[LOG]: Picking blacklisted GPU model in fast-check"
-                        << std::endl;
+              INFAAS_LOG(INFO) << "[LOG]: Picking blacklisted GPU model in "
+                                  "fast-check";
               if ((dec_policy == GPUSHARETRIGGER) ||
                   (dec_policy == GPUSHARETRIGGER_SKIPBLIST) ||
                   (dec_policy == CPUBLISTCHECK)) {
                 // Ask for new VM from autoscaler
-                if (rm_->get_model_info(avl, "framework") != "inferentia") {
-                  std::cout << "[LOG]: GPU model blacklisted in fast-check,";
-                  std::cout << " triggering new VM" << std::endl;
+                if (gtable->framework[row] != "inferentia") {
+                  INFAAS_LOG(INFO) << "[LOG]: GPU model blacklisted in "
+                                      "fast-check, triggering new VM";
                   rm_->set_vm_scale();
                 } else {
-                  std::cout << "[LOG]: GPAR -- Picking blacklisted Inferentia";
-                  std::cout << " variant, which shouldn't occur..."
-                            << std::endl;
+                  INFAAS_LOG(INFO) << "[LOG]: GPAR -- Picking blacklisted "
+                                      "Inferentia variant, which shouldn't "
+                                      "occur...";
                 }
               }
               *is_running = 0;
@@ -404,21 +633,17 @@ private:
         }
       }
       if (candidate_model.empty()) {
-        std::cout
-            << "[LOG]: No models running for GPAR fast-check, switching to";
-        std::cout << " general search (SLO will be violated)" << std::endl;
+        INFAAS_LOG(INFO) << "[LOG]: No models running for GPAR fast-check, "
+                            "switching to general search (SLO will be "
+                            "violated)";
       } else {
         // Update the cache order
-        std::cout << "[LOG]: Found in cache, updating and returning"
-                  << std::endl;
-        gmod_cache_.erase(
-            std::find(gmod_cache_.begin(), gmod_cache_.end(), candidate_model));
-        gmod_cache_.push_front(candidate_model);
+        INFAAS_LOG(INFO) << "[LOG]: Found in cache, updating and returning";
+        gmod_cache_.Touch(candidate_model);
         return {candidate_model};
       }
     }
 
-    std::vector<std::string> acc_opts;
     double min_latency = (latency_constraint > 100.0) ? 100.0 : 0.0;
     std::pair<std::string, double> candidate_variant("dummy", 100000.0);
     std::pair<std::string, double> best_cpu("dummy", 100000.0);
@@ -426,129 +651,84 @@ private:
     bool general_valid_model = false;
     bool cpu_blacklisted = false;
 
-    // Automatically set max number of search results based on user latency.
-    // Using 15% of user latency (which can change, but should be fine since
-    // at this point we're no longer relying on the cache to save us)
-    double fraction = latency_constraint * 0.15;
-    int16_t gmod_max_results = (int16_t)(fraction / gmod_md_lat);
-    // Search for at least 3
-    gmod_max_results = std::max(gmod_max_results, (int16_t)3);
-    // Search for at most 20
-    // gmod_max_results = std::min(gmod_max_results, (int16_t) 20);
-    std::cout << "[LOG]: Searching a maximum of: " << gmod_max_results
-              << std::endl;
-
-    // Get feasible models based on accuracy
-    acc_opts =
-        rm_->gpar_acc_bin(gparent_model, accuracy_constraint, gmod_max_results);
+    // Variants of the lowest qualifying accuracy bin that support the batch
+    // and are predicted to meet the latency constraint, in accuracy order.
+    std::vector<infaas::internal::VariantMatch> acc_opts;
+    infaas::internal::VariantIndex::AccuracySearch(
+        *gtable, accuracy_constraint, batch_size, latency_constraint,
+        &acc_opts);
 
     if (acc_opts.size() == 0) {
-      std::cout << "[LOG]: Accuracy bin search returned no models!"
-                << std::endl;
+      INFAAS_LOG(INFO) << "[LOG]: Accuracy bin search returned no models!";
       return {};
     }
 
-    std::cout << "[LOG]: Reviewing " << acc_opts.size() << " variants for ";
-    std::cout << gparent_model << std::endl;
+    INFAAS_LOG(INFO) << "[LOG]: Reviewing " << acc_opts.size()
+                     << " variants for " << gparent_model;
 
-    // Go through all model variants and find first one that satisfies
-    // 1) batch, 2) latency, 3) is loaded.
+    // Go through the candidates and find the one that is loaded.
     // If no model is loaded, find the one with the lowest total latency
-    for (std::string av : acc_opts) {
-      std::cout << "[LOG]: Currently considering model variant: " << av
-                << std::endl;
+    // Resolve the running status of every candidate in one round trip
+    std::vector<std::string> acc_opts_names;
+    acc_opts_names.reserve(acc_opts.size());
+    for (const infaas::internal::VariantMatch& m : acc_opts) {
+      acc_opts_names.push_back(gtable->name[m.row]);
+    }
+    std::vector<int8_t> acc_opts_running =
+        rm_->is_model_running_multi(acc_opts_names);
+    for (size_t i = 0; i < acc_opts.size(); ++i) {
+      const uint32_t row = acc_opts[i].row;
+      const std::string& av = gtable->name[row];
+      INFAAS_LOG(DEBUG) << "[LOG]: Currently considering model variant: " << av;
 
       bool better_batch = false;
+      int16_t mv_batch_int = gtable->max_batch[row];
+      double mv_inf_lat = acc_opts[i].inf_lat;
 
-      // Get its batch size
-      std::string mv_batch = rm_->get_model_info(av, "max_batch");
-      int16_t mv_batch_int = std::stoi(mv_batch);
-      if (mv_batch != "FAIL") {
-        if (mv_batch_int < batch_size) { // Not supported
-          continue;
-        } else { // Batch size supported
-          if (mv_batch_int < min_valid_batch) {
-            std::cout << "[LOG]: " << av << " (batch-" << mv_batch_int;
-            std::cout << ") is the current best batch fit" << std::endl;
-            min_valid_batch = mv_batch_int;
-            better_batch = true;
-          }
-        }
-      } else {
-        return {};
+      if ((latency_constraint > 100.0) && (mv_inf_lat < 100.0)) {
+        // Don't pick GPU for CPU constraint
+        INFAAS_LOG(DEBUG) << "[LOG]: Skipping GPU variant for loose latency";
+        continue;
       }
 
-      std::cout << "[LOG]: Passes batch" << std::endl;
-
-      // Get its inference latency based on slope and intercept computed during
-      // registration
-      double mv_inf_lat, slope, intercept, batch_for_compute;
-      if (latency_constraint > 0) {
-        slope = std::stod(rm_->get_model_info(av, "slope"));
-        intercept = std::stod(rm_->get_model_info(av, "intercept"));
-
-        if (mv_batch_int > 64) { // CPU model
-          batch_for_compute = (double)batch_size;
-        } else {
-          batch_for_compute = ((double)std::min((int16_t)32, mv_batch_int));
-        }
-
-        mv_inf_lat = slope * batch_for_compute + intercept;
-        if (mv_inf_lat > 0.0) {
-          if (mv_inf_lat > latency_constraint) {
-            continue;
-          } else if ((latency_constraint > 100.0) && (mv_inf_lat < 100.0)) {
-            // Don't pick GPU for CPU constraint
-            std::cout << "[LOG]: Skipping GPU variant for loose latency";
-            std::cout << std::endl;
-            continue;
-          }
-        } else {
-          return {};
-        }
+      if (mv_batch_int < min_valid_batch) {
+        INFAAS_LOG(INFO) << "[LOG]: " << av << " (batch-" << mv_batch_int
+                         << ") is the current best batch fit";
+        min_valid_batch = mv_batch_int;
+        better_batch = true;
       }
 
-      std::cout << "[LOG]: Passes latency" << std::endl;
-
       // Check if it's running
       bool valid_model_running = false;
-      if (rm_->is_model_running(av)) {
-        std::cout << "[LOG]: " << av << " is running" << std::endl;
+      if (acc_opts_running[i]) {
+        INFAAS_LOG(INFO) << "[LOG]: " << av << " is running";
 
         if (dec_policy == INFAAS_NOQPSLAT) { // Just pick the model
           *is_running = 1;
-          auto it = std::find(gmod_cache_.begin(), gmod_cache_.end(), av);
-          if (it == gmod_cache_.end()) {
-            // Update cache
-            std::cout << "[LOG]: Was not in cache, adding..." << std::endl;
-            if (gmod_cache_.size() == gmod_max_lru) {
-              gmod_cache_.pop_back();
-            }
+          if (!gmod_cache_.Touch(av)) {
+            INFAAS_LOG(INFO) << "[LOG]: Was not in cache, adding...";
           } else {
             // If found, it means the model wasn't running
-            std::cout << "[LOG]: Was in cache, but not running. Moving to front"
-                      << std::endl;
-            gmod_cache_.erase(it);
+            INFAAS_LOG(INFO) << "[LOG]: Was in cache, but not running. Moving "
+                                "to front";
           }
-          gmod_cache_.push_front(av);
           return {av};
         }
 
         // If model is being unloaded, skip it
         if (rm_->get_model_load_unload(av)) {
-          std::cout << "[LOG]: " << av << " is being unloaded" << std::endl;
+          INFAAS_LOG(INFO) << "[LOG]: " << av << " is being unloaded";
           continue;
         }
 
         // Check if the minimum QPS replica has been blacklisted
         std::vector<std::string> min_worker_name = rm_->min_qps_name(av, 1);
         if (min_worker_name.empty()) {
-          std::cout
-              << "[LOG]: Model set to running, but min_qps_name query failed.";
-          std::cout << "Taking not running path" << std::endl;
+          INFAAS_LOG(INFO) << "[LOG]: Model set to running, but min_qps_name "
+                              "query failed.Taking not running path";
         } else {
           if (mv_batch_int > 64) {
-            std::string parent_model = rm_->get_parent_model(av);
+            std::string parent_model = mc_->get_parent_model(av);
             int8_t pmod_scaledown =
                 rm_->get_parent_scaledown(min_worker_name[0], parent_model);
 
@@ -556,13 +736,13 @@ private:
               throw std::runtime_error(
                   "Failed to check if model was in scaledown mode");
             } else if (!pmod_scaledown) {
-              std::cout << "[LOG]: Passes scaledown check for CPU" << std::endl;
+              INFAAS_LOG(INFO) << "[LOG]: Passes scaledown check for CPU";
               valid_model_running = true;
             } else {
-              std::cout << "[LOG]: Failed scaledown check for CPU" << std::endl;
+              INFAAS_LOG(INFO) << "[LOG]: Failed scaledown check for CPU";
             }
           } else {
-            std::cout << "[LOG]: Passes scaledown check" << std::endl;
+            INFAAS_LOG(INFO) << "[LOG]: Passes scaledown check";
             valid_model_running = true;
           }
         }
@@ -575,17 +755,17 @@ private:
             throw std::runtime_error(
                 "Failed to check if model was blacklisted");
           } else if (!is_blisted) {
-            std::cout << "[LOG]: Meets blacklist check" << std::endl;
+            INFAAS_LOG(INFO) << "[LOG]: Meets blacklist check";
             double lat_diff = latency_constraint - mv_inf_lat;
             if ((lat_diff >= 0.0) && (lat_diff < candidate_variant.second)) {
-              std::cout << "[LOG]: Current best: " << av << std::endl;
+              INFAAS_LOG(INFO) << "[LOG]: Current best: " << av;
               *is_running = 1;
               general_valid_model = true;
               candidate_variant.first = av;
               candidate_variant.second = lat_diff;
             }
           } else { // It's blacklisted
-            std::cout << "[LOG]: Failed blacklist check" << std::endl;
+            INFAAS_LOG(INFO) << "[LOG]: Failed blacklist check";
             if (mv_batch_int > 64) {
               cpu_blacklisted = true;
             } else {
@@ -593,8 +773,8 @@ private:
               //// set a flag to indicate that it should not be seen as running.
               double lat_diff = latency_constraint - mv_inf_lat;
               if ((lat_diff >= 0.0) && (lat_diff < candidate_variant.second)) {
-                std::cout << "[LOG]: Making blacklisted GPU model a candidate"
-                          << std::endl;
+                INFAAS_LOG(INFO) << "[LOG]: Making blacklisted GPU model a "
+                                    "candidate";
                 *is_running = 0;
                 candidate_variant.first = av;
                 candidate_variant.second = lat_diff;
@@ -603,8 +783,8 @@ private:
                   (dec_policy == GPUSHARETRIGGER_SKIPBLIST) ||
                   (dec_policy == CPUBLISTCHECK)) {
                 // Ask for new VM from autoscaler
-                std::cout << "[LOG]: GPU model blacklisted, triggering new VM"
-                          << std::endl;
+                INFAAS_LOG(INFO) << "[LOG]: GPU model blacklisted, triggering "
+                                    "new VM";
                 rm_->set_vm_scale();
               }
             }
@@ -622,17 +802,15 @@ private:
         // small
         //// models it is possible for these models to look "better" than loaded
         /// models
-        std::cout << "[LOG]: Model not running, recording total latency"
-                  << std::endl;
-        double mv_load_lat = rm_->get_load_lat(av);
-        double mv_total_lat = 1000.0 + mv_load_lat + mv_inf_lat;
+        INFAAS_LOG(INFO) << "[LOG]: Model not running, recording total latency";
+        double mv_total_lat = 1000.0 + gtable->load_lat[row] + mv_inf_lat;
         if (better_batch && (mv_total_lat < candidate_variant.second)) {
           *is_running = 0;
           candidate_variant.first = av;
           candidate_variant.second = mv_total_lat;
         }
         if ((min_latency == 100.0) && (mv_batch_int == 128)) { // CPU models
-          std::cout << "[LOG]: Checking CPU for total latency" << std::endl;
+          INFAAS_LOG(DEBUG) << "[LOG]: Checking CPU for total latency";
           if (mv_total_lat < best_cpu.second) {
             best_cpu.first = av;
             best_cpu.second = mv_total_lat;
@@ -647,50 +825,33 @@ private:
     // start a CPU
     if ((best_cpu.first != "dummy") && !general_valid_model &&
         !cpu_blacklisted) {
-      std::cout
-          << "[LOG]: No model running, constraint dictates picking a CPU model";
-      std::cout << std::endl;
+      INFAAS_LOG(INFO) << "[LOG]: No model running, constraint dictates "
+                          "picking a CPU model";
       *is_running = 0;
-      auto it =
-          std::find(gmod_cache_.begin(), gmod_cache_.end(), best_cpu.first);
-      if (it == gmod_cache_.end()) {
-        // Update cache
-        std::cout << "[LOG]: Was not in cache, adding..." << std::endl;
-        if (gmod_cache_.size() == gmod_max_lru) {
-          gmod_cache_.pop_back();
-        }
+      if (!gmod_cache_.Touch(best_cpu.first)) {
+        INFAAS_LOG(INFO) << "[LOG]: Was not in cache, adding...";
       } else {
         // If found, it means the model wasn't running
-        std::cout << "[LOG]: Was in cache, but not running. Moving to front"
-                  << std::endl;
-        gmod_cache_.erase(it);
+        INFAAS_LOG(INFO) << "[LOG]: Was in cache, but not running. Moving to "
+                            "front";
       }
-      gmod_cache_.push_front(best_cpu.first);
       return {best_cpu.first};
     }
 
     // Otherwise, if candidate model is valid, return it
     if (candidate_variant.first != "dummy") {
-      std::cout << "[LOG]: Valid running model was found" << std::endl;
-      auto it = std::find(gmod_cache_.begin(), gmod_cache_.end(),
-                          candidate_variant.first);
-      if (it == gmod_cache_.end()) {
-        // Update cache
-        std::cout << "[LOG]: Was not in cache, adding..." << std::endl;
-        if (gmod_cache_.size() == gmod_max_lru) {
-          gmod_cache_.pop_back();
-        }
+      INFAAS_LOG(INFO) << "[LOG]: Valid running model was found";
+      if (!gmod_cache_.Touch(candidate_variant.first)) {
+        INFAAS_LOG(INFO) << "[LOG]: Was not in cache, adding...";
       } else {
         // If found, it means the model wasn't running
-        std::cout << "[LOG]: Was in cache, but not running. Moving to front"
-                  << std::endl;
-        gmod_cache_.erase(it);
+        INFAAS_LOG(INFO) << "[LOG]: Was in cache, but not running. Moving to "
+                            "front";
       }
-      gmod_cache_.push_front(candidate_variant.first);
       return {candidate_variant.first};
     }
 
-    std::cout << "[LOG]: GPAR: No model found! This will fail..." << std::endl;
+    INFAAS_LOG(INFO) << "[LOG]: GPAR: No model found! This will fail...";
     return {};
   }
 
@@ -711,30 +872,36 @@ private:
     // found
     //// and running, return it. Otherwise, do an exhaustive search.
     double min_latency = (latency_constraint > 100.0) ? 100.0 : 0.0;
-    std::vector<std::string> lowest_tot =
-        rm_->inf_lat_bin(parent_model, min_latency, latency_constraint, 5);
+    std::shared_ptr<const infaas::internal::VariantTable> ptable =
+        variant_index_->Parent(parent_model);
+    std::vector<uint32_t> lowest_tot_rows =
+        infaas::internal::VariantIndex::LatencyRange(*ptable, min_latency,
+                                                     latency_constraint, 5);
+    std::vector<std::string> lowest_tot;
+    for (uint32_t r : lowest_tot_rows) {
+      lowest_tot.push_back(ptable->name[r]);
+    }
     if (!lowest_tot.empty()) {
-      for (std::string avl : lowest_tot) {
-        std::cout
-            << "[LOG]: Fast check -- currently considering model variant: ";
-        std::cout << avl << std::endl;
+      // Resolve the running status of every candidate in one round trip
+      std::vector<int8_t> lowest_tot_running =
+          rm_->is_model_running_multi(lowest_tot);
+      for (size_t i = 0; i < lowest_tot.size(); ++i) {
+        const uint32_t row = lowest_tot_rows[i];
+        std::string avl = lowest_tot[i];
+        INFAAS_LOG(DEBUG) << "[LOG]: Fast check -- currently considering "
+                             "model variant: " << avl;
 
         // Check that batch size is valid
-        std::string mv_batch = rm_->get_model_info(avl, "max_batch");
-        int16_t mv_batch_int = std::stoi(mv_batch);
-        if (mv_batch != "FAIL") {
-          if (mv_batch_int < batch_size) { // Not supported
-            continue;
-          }
-        } else {
-          return {};
+        int16_t mv_batch_int = ptable->max_batch[row];
+        if (mv_batch_int < batch_size) { // Not supported
+          continue;
         }
 
-        std::cout << "[LOG]: Passes batch" << std::endl;
+        INFAAS_LOG(DEBUG) << "[LOG]: Passes batch";
 
         // Check if it's running
-        if (rm_->is_model_running(avl)) {
-          std::cout << "[LOG]: " << avl << " is running" << std::endl;
+        if (lowest_tot_running[i]) {
+          INFAAS_LOG(INFO) << "[LOG]: " << avl << " is running";
 
           if (dec_policy == INFAAS_NOQPSLAT) { // Just pick the model
             *is_running = 1;
@@ -743,17 +910,16 @@ private:
 
           // If model is being unloaded, skip it
           if (rm_->get_model_load_unload(avl)) {
-            std::cout << "[LOG] PAR fast-check: " << avl << " is being unloaded"
-                      << std::endl;
+            INFAAS_LOG(INFO) << "[LOG] PAR fast-check: " << avl
+                             << " is being unloaded";
             continue;
           }
 
           // Check if the minimum QPS replica has been blacklisted
           std::vector<std::string> min_worker_name = rm_->min_qps_name(avl, 1);
           if (min_worker_name.empty()) {
-            std::cout << "[LOG]: Model set to running, but min_qps_name query "
-                         "failed.";
-            std::cout << "Continuing search" << std::endl;
+            INFAAS_LOG(INFO) << "[LOG]: Model set to running, but "
+                                "min_qps_name query failed. Continuing search";
             continue;
           }
 
@@ -767,64 +933,60 @@ private:
             if (dec_policy == CPUBLISTCHECK) {
               // If it's a CPU model and it's in the set, skip it
               if (mv_batch_int > 64) {
-                if (cpu_blist_.find(avl) != cpu_blist_.end()) {
-                  std::cout << "[LOG]: " << avl << " in cpu_blist_, skipping..."
-                            << std::endl;
+                if (cpu_blist_.Contains(avl)) {
+                  INFAAS_LOG(INFO) << "[LOG]: " << avl << " in cpu_blist_, "
+                                                          "skipping...";
                   continue;
                 }
               }
             }
-            std::cout << "[LOG]: Meets blacklist check, picking ";
-            std::cout << avl << std::endl;
+            INFAAS_LOG(INFO) << "[LOG]: Meets blacklist check, picking " << avl;
             *is_running = 1;
             return {avl};
           } else { // It's blacklisted
-            std::cout << "[LOG]: Failed blacklist check" << std::endl;
+            INFAAS_LOG(INFO) << "[LOG]: Failed blacklist check";
             blist_fast_check_avl = avl;
             // If it's a GPU fast check, return it, but set is_running to 0
             if (mv_batch_int < 64) {
-              std::cout << "[LOG]: Picking blacklisted GPU model in fast-check"
-                        << std::endl;
+              INFAAS_LOG(INFO) << "[LOG]: Picking blacklisted GPU model in "
+                                  "fast-check";
               if ((dec_policy == GPUSHARETRIGGER) ||
                   (dec_policy == GPUSHARETRIGGER_SKIPBLIST) ||
                   (dec_policy == CPUBLISTCHECK)) {
-                if (rm_->get_model_info(avl, "framework") != "inferentia") {
+                if (ptable->framework[row] != "inferentia") {
                   // Ask for new VM from autoscaler
-                  std::cout << "[LOG]: GPU model blacklisted in fast-check,";
-                  std::cout << " triggering new VM" << std::endl;
+                  INFAAS_LOG(INFO) << "[LOG]: GPU model blacklisted in "
+                                      "fast-check, triggering new VM";
                   rm_->set_vm_scale();
                 } else {
-                  std::cout << "[LOG]: PAR -- Picking blacklisted Inferentia";
-                  std::cout << " variant, which shouldn't occur..."
-                            << std::endl;
+                  INFAAS_LOG(INFO) << "[LOG]: PAR -- Picking blacklisted "
+                                      "Inferentia variant, which shouldn't "
+                                      "occur...";
                 }
               }
               *is_running = 0;
               return {avl};
             } else {
               // Skip scaledown if it's a CPU
-              std::cout << "[LOG] Skipping future scaledown checks"
-                        << std::endl;
+              INFAAS_LOG(DEBUG) << "[LOG] Skipping future scaledown checks";
               skip_scaledown = true;
             }
           }
         }
       }
-      std::cout << "[LOG]: No models running for fast-check, switching to";
-      std::cout << " general search (SLO will be violated)" << std::endl;
+      INFAAS_LOG(INFO) << "[LOG]: No models running for fast-check, switching "
+                          "to general search (SLO will be violated)";
     }
 
     // Get all model variants
-    std::vector<std::string> all_var =
-        rm_->get_all_model_variants(parent_model);
+    const std::vector<std::string>& all_var = ptable->name;
 
     if (all_var.size() == 0) {
-      std::cout << "[LOG]: All variant query returned no models!" << std::endl;
+      INFAAS_LOG(INFO) << "[LOG]: All variant query returned no models!";
       return {};
     }
 
-    std::cout << "[LOG]: Parent has " << all_var.size() << " variants"
-              << std::endl;
+    INFAAS_LOG(INFO) << "[LOG]: Parent has " << all_var.size() << " variants";
 
     // Go through all model variants and find first one that satisfies
     // 1) batch, 2) latency, 3) is loaded.
@@ -839,51 +1001,39 @@ private:
     bool cpuonly_blisted = false;
     std::string val_cpu_running = "dummy";
     std::string val_gpu_running = "dummy";
-    for (std::string av : all_var) {
-      std::cout << "[LOG]: Currently considering model variant: " << av
-                << std::endl;
+    // Resolve the running status of every candidate in one round trip
+    std::vector<int8_t> all_var_running = rm_->is_model_running_multi(all_var);
+    for (size_t i = 0; i < all_var.size(); ++i) {
+      const std::string& av = all_var[i];
+      INFAAS_LOG(DEBUG) << "[LOG]: Currently considering model variant: " << av;
 
       // Get its batch size
-      std::string mv_batch = rm_->get_model_info(av, "max_batch");
-      int16_t mv_batch_int = std::stoi(mv_batch);
-      if (mv_batch != "FAIL") {
-        if (mv_batch_int < batch_size) { // Not supported
+      int16_t mv_batch_int = ptable->max_batch[i];
+      if (mv_batch_int < batch_size) { // Not supported
+        continue;
+      } else { // Batch size supported
+        // Skip CPU models if the latency constraint is low
+        if (mv_batch_int == 128 && (latency_constraint <= 50.0)) {
+          INFAAS_LOG(DEBUG) << "[LOG]: Skipping CPU model for latency "
+                               "constraint of " << latency_constraint;
           continue;
-        } else { // Batch size supported
-          // Skip CPU models if the latency constraint is low
-          if (mv_batch_int == 128 && (latency_constraint <= 50.0)) {
-            std::cout << "[LOG]: Skipping CPU model for latency constraint of ";
-            std::cout << latency_constraint << std::endl;
-            continue;
-          }
+        }
 
-          if (mv_batch_int < min_valid_batch.second) {
-            std::cout << "[LOG]: Saving " << av << " (batch-" << mv_batch_int;
-            std::cout << ") for later" << std::endl;
-            min_valid_batch.first = av;
-            min_valid_batch.second = mv_batch_int;
-          }
+        if (mv_batch_int < min_valid_batch.second) {
+          INFAAS_LOG(INFO) << "[LOG]: Saving " << av << " (batch-"
+                           << mv_batch_int << ") for later";
+          min_valid_batch.first = av;
+          min_valid_batch.second = mv_batch_int;
         }
-      } else {
-        return {};
       }
 
-      std::cout << "[LOG]: Passes batch" << std::endl;
+      INFAAS_LOG(DEBUG) << "[LOG]: Passes batch";
 
       // Get its inference latency based on slope and intercept computed during
       // registration
-      double mv_inf_lat, slope, intercept, batch_for_compute;
+      double mv_inf_lat = 0.0;
       if (latency_constraint > 0) {
-        slope = std::stod(rm_->get_model_info(av, "slope"));
-        intercept = std::stod(rm_->get_model_info(av, "intercept"));
-
-        if (mv_batch_int > 64) { // CPU model
-          batch_for_compute = (double)batch_size;
-        } else {
-          batch_for_compute = ((double)std::min((int16_t)32, mv_batch_int));
-        }
-
-        mv_inf_lat = slope * batch_for_compute + intercept;
+        mv_inf_lat = ptable->PredictLatency(i, batch_size);
         if (mv_inf_lat > 0.0) {
           if (mv_inf_lat > latency_constraint) {
             continue;
@@ -893,14 +1043,14 @@ private:
         }
       }
 
-      std::cout << "[LOG]: Passes latency" << std::endl;
+      INFAAS_LOG(DEBUG) << "[LOG]: Passes latency";
 
       // At this point, we know the model exists
       model_exists = true;
 
       // Check if it's running
-      if (rm_->is_model_running(av)) {
-        std::cout << "[LOG]: " << av << " is running" << std::endl;
+      if (all_var_running[i]) {
+        INFAAS_LOG(INFO) << "[LOG]: " << av << " is running";
 
         if (dec_policy == INFAAS_NOQPSLAT) { // Just pick the model
           *is_running = 1;
@@ -909,16 +1059,15 @@ private:
 
         // If model is being unloaded, skip it
         if (rm_->get_model_load_unload(av)) {
-          std::cout << "[LOG]: " << av << " is being unloaded" << std::endl;
+          INFAAS_LOG(INFO) << "[LOG]: " << av << " is being unloaded";
           continue;
         }
 
         // Check if the minimum QPS replica has been blacklisted
         std::vector<std::string> min_worker_name = rm_->min_qps_name(av, 1);
         if (min_worker_name.empty()) {
-          std::cout
-              << "[LOG]: Model set to running, but min_qps_name query failed.";
-          std::cout << "Continuing search" << std::endl;
+          INFAAS_LOG(INFO) << "[LOG]: Model set to running, but min_qps_name "
+                              "query failed. Continuing search";
           continue;
         } else {
           // Check if parent model scaledown flag has been set.
@@ -931,14 +1080,14 @@ private:
               throw std::runtime_error(
                   "Failed to check if model was in scaledown mode");
             } else if (pmod_scaledown && (min_latency == 100.0)) {
-              std::cout << "[LOG]: Scaledown set and user asked for a CPU"
-                        << std::endl;
+              INFAAS_LOG(INFO) << "[LOG]: Scaledown set and user asked for a "
+                                  "CPU";
               break;
             }
 
-            std::cout << "[LOG]: Passes scaledown check" << std::endl;
+            INFAAS_LOG(INFO) << "[LOG]: Passes scaledown check";
           } else {
-            std::cout << "[LOG]: Skipped scaledown check" << std::endl;
+            INFAAS_LOG(INFO) << "[LOG]: Skipped scaledown check";
           }
 
           int8_t is_blisted =
@@ -956,8 +1105,8 @@ private:
               if (mv_batch_int < 64) {
                 val_gpu_running = av;
                 if (val_cpu_running != "dummy") {
-                  std::cout << "[LOG]: Valid CPU running, but " << av;
-                  std::cout << " will overwrite it" << std::endl;
+                  INFAAS_LOG(INFO) << "[LOG]: Valid CPU running, but " << av
+                                   << " will overwrite it";
                   double lat_diff = latency_constraint - mv_inf_lat;
                   candidate_variant.first = av;
                   candidate_variant.second = lat_diff;
@@ -968,14 +1117,14 @@ private:
               } else {
                 val_cpu_running = av;
                 if (val_gpu_running != "dummy") {
-                  std::cout << "[LOG]: Skipping " << av << " because";
-                  std::cout << " a valid GPU is running" << std::endl;
+                  INFAAS_LOG(DEBUG) << "[LOG]: Skipping " << av
+                                    << " because a valid GPU is running";
                   continue;
                 }
               }
             }
 
-            std::cout << "[LOG]: Meets blacklist check" << std::endl;
+            INFAAS_LOG(INFO) << "[LOG]: Meets blacklist check";
             double lat_diff = latency_constraint - mv_inf_lat;
             if ((lat_diff >= 0.0) && (lat_diff < candidate_variant.second)) {
               candidate_variant.first = av;
@@ -985,7 +1134,7 @@ private:
                   false; // Reset flag; it should be seen as running
             }
           } else { // It's blacklisted
-            std::cout << "[LOG]: Failed blacklist check" << std::endl;
+            INFAAS_LOG(INFO) << "[LOG]: Failed blacklist check";
             if (mv_batch_int > max_batch_blisted) {
               max_batch_blisted = mv_batch_int;
             }
@@ -994,8 +1143,8 @@ private:
             if (mv_batch_int < 64) {
               double lat_diff = latency_constraint - mv_inf_lat;
               if ((lat_diff >= 0.0) && (lat_diff < candidate_variant.second)) {
-                std::cout << "[LOG]: Making blacklisted GPU model a candidate"
-                          << std::endl;
+                INFAAS_LOG(INFO) << "[LOG]: Making blacklisted GPU model a "
+                                    "candidate";
                 candidate_variant.first = av;
                 candidate_variant.second = lat_diff;
                 gpu_blisted = true;
@@ -1004,29 +1153,25 @@ private:
                   (dec_policy == GPUSHARETRIGGER_SKIPBLIST) ||
                   (dec_policy == CPUBLISTCHECK)) {
                 // Ask for new VM from autoscaler
-                std::cout << "[LOG]: GPU model blacklisted, triggering new VM"
-                          << std::endl;
+                INFAAS_LOG(INFO) << "[LOG]: GPU model blacklisted, triggering "
+                                    "new VM";
                 rm_->set_vm_scale();
               }
             } else { // CPU is blacklisted
               if (dec_policy == CPUBLISTCHECK) {
-                std::cout << "[LOG] Adding " << av << " to cpu_blist_"
-                          << std::endl;
-                if (cpu_blist_.find(val_cpu_running) == cpu_blist_.end()) {
-                  cpu_blist_.insert(val_cpu_running);
-                }
+                INFAAS_LOG(INFO) << "[LOG] Adding " << av << " to cpu_blist_";
+                cpu_blist_.Insert(val_cpu_running, true);
 
                 // If model is a PyTorch one, blacklist, but still possibly pick
                 // it
                 if (rm_->is_pytorch_only(parent_model) == 1) {
-                  std::cout << "[LOG]: " << av
-                            << " is a blacklisted PyTorch variant";
-                  std::cout << std::endl;
+                  INFAAS_LOG(INFO) << "[LOG]: " << av << " is a blacklisted "
+                                                         "PyTorch variant";
                   double lat_diff = latency_constraint - mv_inf_lat;
                   if ((lat_diff >= 0.0) &&
                       (lat_diff < candidate_variant.second)) {
-                    std::cout << "[LOG]: Making blacklisted Pytorch model";
-                    std::cout << " a candidate" << std::endl;
+                    INFAAS_LOG(INFO) << "[LOG]: Making blacklisted Pytorch "
+                                        "model a candidate";
                     candidate_variant.first = av;
                     candidate_variant.second = lat_diff;
                     cpuonly_blisted = true;
@@ -1041,10 +1186,10 @@ private:
           // If it's a CPU model and it's in the set,
           //// it is no longer running. Remove it.
           if (mv_batch_int > 64) {
-            if (cpu_blist_.find(av) != cpu_blist_.end()) {
-              std::cout << "[LOG]: Removing " << av << " from cpu_blist_"
-                        << std::endl;
-              cpu_blist_.erase(av);
+            if (cpu_blist_.Contains(av)) {
+              INFAAS_LOG(INFO) << "[LOG]: Removing " << av
+                               << " from cpu_blist_";
+              cpu_blist_.Erase(av);
             }
           }
         }
@@ -1058,8 +1203,7 @@ private:
     // If candidate model is valid, return it
     if (candidate_variant.first != "dummy") {
       if (gpu_blisted || cpuonly_blisted) {
-        std::cout << "[LOG]: Picking a blacklisted GPU/PyTorch model"
-                  << std::endl;
+        INFAAS_LOG(INFO) << "[LOG]: Picking a blacklisted GPU/PyTorch model";
         *is_running = 0;
       } else {
         *is_running = 1;
@@ -1071,45 +1215,42 @@ private:
         // If min_latency == 100, it means the parent model has no CPU variants.
         //// Run search again, but expand to all variants.
         if (min_latency == 100.0) {
-          std::cout
-              << "[LOG]: PAR: No models running, and no CPU variants available";
-          std::cout << std::endl;
-          std::vector<std::string> lowest_tot_cpu =
-              rm_->inf_lat_bin(parent_model, 0, latency_constraint, 1);
+          INFAAS_LOG(INFO) << "[LOG]: PAR: No models running, and no CPU "
+                              "variants available";
+          std::vector<uint32_t> lowest_tot_cpu =
+              infaas::internal::VariantIndex::LatencyRange(
+                  *ptable, 0, latency_constraint, 1);
           if (!lowest_tot_cpu.empty()) {
-            return lowest_tot_cpu;
+            return {ptable->name[lowest_tot_cpu[0]]};
           }
         }
-        std::cout << "[LOG]: PAR: No model found! This will fail..."
-                  << std::endl;
+        INFAAS_LOG(INFO) << "[LOG]: PAR: No model found! This will fail...";
         return {};
       }
 
       *is_running = 0;
       if (max_batch_blisted == 0) {
-        std::cout << "[LOG]: Valid models found, but none were running..."
-                  << std::endl;
+        INFAAS_LOG(INFO) << "[LOG]: Valid models found, but none were "
+                            "running...";
         if (min_latency == 100.0) {
-          std::cout << "[LOG]: Latency contraint permits returning a CPU model"
-                    << std::endl;
+          INFAAS_LOG(INFO) << "[LOG]: Latency contraint permits returning a "
+                              "CPU model";
           return {lowest_tot[0]};
         } else {
           // Submit minimum valid batch model
           if (min_valid_batch.first != "dummy") {
-            std::cout << "[LOG]: " << min_valid_batch.first
-                      << " meets batch constraint";
-            std::cout << std::endl;
+            INFAAS_LOG(INFO) << "[LOG]: " << min_valid_batch.first
+                             << " meets batch constraint";
             return {min_valid_batch.first};
           } else {
-            std::cout
-                << "[LOG]: No valid batch size model for max_batch_blist=0";
-            std::cout << " (SHOULD NEVER BE REACHED!)" << std::endl;
+            INFAAS_LOG(INFO) << "[LOG]: No valid batch size model for "
+                                "max_batch_blist=0 (SHOULD NEVER BE REACHED!)";
             return {};
           }
         }
       } else { // Model(s) running, but blacklisted
-        std::cout << "[LOG]: Valid models found, but were blacklisted..."
-                  << std::endl;
+        INFAAS_LOG(INFO) << "[LOG]: Valid models found, but were "
+                            "blacklisted...";
         *is_running = 0; // Model not running; ask master to pick a worker
         // If max_batch_blisted is a CPU model, move to the first valid batch
         // model on GPU
@@ -1122,100 +1263,127 @@ private:
           double rand_blist_val = uniformRG(gen);
           if ((rand_blist_val < blist_skip_thresh) &&
               (blist_fast_check_avl != "dummy")) {
-            std::cout << "[LOG]: Sending to blacklisted model: ";
-            std::cout << blist_fast_check_avl << std::endl;
+            INFAAS_LOG(INFO) << "[LOG]: Sending to blacklisted model: "
+                             << blist_fast_check_avl;
 
             return {blist_fast_check_avl};
           }
-          std::cout << "[LOG]: " << min_valid_batch.first
-                    << " meets batch constraint";
-          std::cout << " from blacklist" << std::endl;
+          INFAAS_LOG(INFO) << "[LOG]: " << min_valid_batch.first
+                           << " meets batch constraint from blacklist";
           return {min_valid_batch.first};
         } else {
-          std::cout
-              << "[LOG]: No valid batch size model for max_batch_blist!=0";
-          std::cout << " (SHOULD NEVER BE REACHED!)" << std::endl;
+          INFAAS_LOG(INFO) << "[LOG]: No valid batch size model for "
+                              "max_batch_blist!=0 (SHOULD NEVER BE REACHED!)";
           return {};
         }
       }
     }
   }
 
-  Status QueryOnline(ServerContext *context, const QueryOnlineRequest *request,
-                     QueryOnlineResponse *reply) override {
-
-    //PNB: Diffusion model implementation related (2025.12.19)
-      // ==== Diffusion task handling (Stable Diffusion) ====
-
-    //    const std::string& model_name = request->model();
-    const std::string& model_name = request->model_variant();//PNB: (2025.12.27)
-
-    // ================= DIFFUSION FAST PATH =================
-// if (request->has_diffusion()) {
-//   // 3.2 Extract diffusion request
-//   const auto& dreq = request->diffusion();
-
-//   infaas::internal::QueryOnlineRequest worker_req;
-//   worker_req.set_model_name(model_name);
-//   // worker_req.mutable_diffusion()->CopyFrom(dreq);
-//   worker_req.set_model(model_name);
-//   worker_req.set_model_type(infaas::internal::MODEL_DIFFUSION);
-//   worker_req.set_input(request->input());
-
-//   infaas::internal::QueryOnlineResponse worker_resp;
-
-//   // 3.3 Forward directly to worker (no SLO routing)
-//   // int8_t rc = cpu_model_manager_->QueryModelOnline(
-//   //     model_name,
-//   //     &worker_req,
-//   //     &worker_resp,
-//   //     redis_md_,
-//   //     s3_client_);
-
-//   if (rc != 0) {
-//     reply->mutable_status()->set_status(
-//         infaaspublic::RequestReplyEnum::ERROR);
-//     reply->mutable_status()->set_msg("Diffusion worker execution failed");
-//     return grpc::Status::OK;
-//   }
-
-//   // Return diffusion output verbatim
-//   //  reply->add_raw_output(worker_resp.raw_output());
-//   for (const auto& s : worker_resp.raw_output()) { // PNB: added (2026.01.16)
-//     reply->add_raw_output(s);
-//   }
-//   reply->mutable_status()->set_status(
-//       infaaspublic::RequestReplyEnum::SUCCESS);
-//   reply->mutable_status()->set_msg("OK");
-//   return grpc::Status::OK;
-// }
-// =======================================================
-
-
-    
-
-//     // Get model metadata to check its task.
-// if (!rm_->model_registered(model_name)) {
-//     return grpc::Status(grpc::StatusCode::NOT_FOUND, "Model not found");
-
-
-//     }
-
-  // ==== end diffusion branch ====
+  // Predicted service time of batch_size inputs on model, for admission.
+  double admission_service_ms(const std::string &model,
+                              const int16_t batch_size) {
+    std::shared_ptr<const infaas::internal::VariantTable> ptable =
+        variant_index_->Parent(mc_->get_parent_model(model));
+    const int64_t row = ptable->Find(model);
+    const double profiled = (row < 0)
+                                ? mc_->get_inf_lat(model)
+                                : ptable->PredictLatency(row, batch_size);
+    return admission_.ServiceTime(model, profiled);
+  }
 
+  // Variants a query of model may be downgraded to on next_worker when model
+  // cannot finish in time there: the faster variants of the same parent
+  // that run on next_worker, support batch_size and meet min_acc, next
+  // fastest first, with their service times.
+  std::vector<std::pair<std::string, double>>
+  downgrade_variants(const std::string &next_worker, const std::string &model,
+                     const double min_acc, const int16_t batch_size) {
+    std::vector<std::pair<std::string, double>> variants;
+    const std::string parent = mc_->get_parent_model(model);
+    std::shared_ptr<const infaas::internal::VariantTable> ptable =
+        variant_index_->Parent(parent);
+    const int64_t row = ptable->Find(model);
+    // Row 0 of a parent table is already its fastest variant
+    if (row <= 0) { return variants; }
+
+    std::vector<std::string> on_worker =
+        rm_->get_parents_variants_on_executor(parent, next_worker);
+    for (int64_t r = row - 1; r >= 0; --r) {
+      const std::string &variant = ptable->name[r];
+      if ((ptable->accuracy[r] < min_acc) ||
+          (ptable->max_batch[r] < batch_size) ||
+          (std::find(on_worker.begin(), on_worker.end(), variant) ==
+           on_worker.end())) {
+        continue;
+      }
+      variants.emplace_back(variant,
+                            admission_.ServiceTime(
+                                variant, ptable->PredictLatency(r, batch_size)));
+    }
+    return variants;
+  }
 
- // for everything else not in DIFFUSION branch
-    struct timeval time1, time2, time3;
-    gettimeofday(&time1, NULL);
+  // Takes a slot on next_worker for an online query of model, waiting in
+  // deadline order. If model cannot finish by the deadline there, the query
+  // is downgraded to a variant from downgrade_variants that can; a variant
+  // named by the user is never replaced. Returns false if nothing can meet
+  // the deadline; otherwise ticket->model is the variant to query. Blocks
+  // while the query waits, so it is only for QueryOnlineStream, which has a
+  // thread of its own; QueryOnline admits the same way without blocking.
+  bool admit_query(const std::string &next_worker, const std::string &model,
+                   const bool pinned, const double min_acc,
+                   const int16_t batch_size,
+                   const infaas::internal::AdmissionQueue::TimePoint deadline,
+                   infaas::internal::AdmissionQueue::Ticket *ticket) {
+    const double service_ms = admission_service_ms(model, batch_size);
+    if (admission_.Feasible(next_worker, deadline, service_ms) &&
+        admission_.Acquire(next_worker, model, deadline, service_ms, ticket)) {
+      return true;
+    }
+    if (pinned) { return false; }
+
+    for (const auto &variant :
+         downgrade_variants(next_worker, model, min_acc, batch_size)) {
+      if (admission_.Feasible(next_worker, deadline, variant.second) &&
+          admission_.Acquire(next_worker, variant.first, deadline,
+                             variant.second, ticket)) {
+        INFAAS_LOG(INFO) << "[LOG]: Downgraded " << model << " to "
+                         << variant.first << " to meet the deadline on "
+                         << next_worker;
+        return true;
+      }
+    }
+    return false;
+  }
 
-    infaaspublic::RequestReply *rs = reply->mutable_status();
+  // Least loaded replica of model other than primary, for a hedge. Returns
+  // false if there is none or it is blacklisted. Reads the metadata store,
+  // so it runs on routing_pool_.
+  bool hedge_target(const std::string &model, const std::string &primary,
+                    std::string *worker, struct Address *addr) {
+    std::vector<std::string> others;
+    for (const std::string &r : rm_->min_qps_name(model, pod_max_replicas)) {
+      if (r != primary) { others.push_back(r); }
+    }
+    *worker = worker_load_.PickLeastLoaded(others, others.size());
+    if (worker->empty() || rm_->is_blacklisted(*worker)) { return false; }
+    *addr = rm_->get_executor_addr(*worker);
+    return !RedisMetadata::is_empty_address(*addr);
+  }
 
+  // Picks the variant and the worker that serve an online query, and the
+  // worker's address. Returns false, with rs set, if the query cannot be
+  // routed.
+  bool route_online_query(const QueryOnlineRequest *request,
+                          infaaspublic::RequestReply *rs,
+                          std::string *model_out, std::string *worker_out,
+                          struct Address *addr_out) {
     // User should submit empty string if empty
     std::string grandparent_model = request->grandparent_model();
     std::string parent_model = request->parent_model();
     std::string model = request->model_variant();
 
-    std::string submitter = request->submitter();
     auto slo = request->slo();
 
     std::string next_worker = "dummy";
@@ -1226,7 +1394,7 @@ private:
       if (!rm_->model_registered(model)) {
         rs->set_status(infaaspublic::RequestReplyEnum::UNAVAILABLE);
         rs->set_msg("Model has not been registered");
-        return Status::OK;
+        return false;
       }
 
       // Check if model is running
@@ -1243,7 +1411,7 @@ private:
       if (!rm_->parent_model_registered(parent_model)) {
         rs->set_status(infaaspublic::RequestReplyEnum::UNAVAILABLE);
         rs->set_msg("Parent model has not been registered");
-        return Status::OK;
+        return false;
       }
 
       // Right now, assumption is that latency and accuracy are set to 0 if they
@@ -1251,8 +1419,8 @@ private:
       int64_t latency = slo.latencyinusec();
       double accuracy = slo.minaccuracy();
       if ((latency == 0) && (accuracy == 0.0)) {
-        std::cout << "No hints given, send to some available running model"
-                  << std::endl;
+        INFAAS_LOG(INFO) << "No hints given, send to some available running "
+                            "model";
       }
 
       std::vector<std::string> meets_slo =
@@ -1264,7 +1432,7 @@ private:
         rs->set_status(infaaspublic::RequestReplyEnum::UNAVAILABLE);
         rs->set_msg("PAR: No model can satisfy this request. Try a different "
                     "accuracy/latency");
-        return Status::OK;
+        return false;
       }
 
       model = meets_slo[0];
@@ -1272,7 +1440,7 @@ private:
       if (!rm_->gparent_model_registered(grandparent_model)) {
         rs->set_status(infaaspublic::RequestReplyEnum::UNAVAILABLE);
         rs->set_msg("Grandparent model has not been registered");
-        return Status::OK;
+        return false;
       }
 
       // For grandparent model, assumption is that BOTH latency and accuracy
@@ -1280,8 +1448,8 @@ private:
       int64_t latency = slo.latencyinusec();
       double accuracy = slo.minaccuracy();
       if ((latency == 0) || (accuracy == 0.0)) {
-        std::cout << "For a grandparent-only query, ";
-        std::cout << "latency and accuracy are required" << std::endl;
+        INFAAS_LOG(INFO) << "For a grandparent-only query, latency and "
+                            "accuracy are required";
       }
 
       std::vector<std::string> meets_slo = gpar_lat_acc_search(
@@ -1293,41 +1461,42 @@ private:
         rs->set_status(infaaspublic::RequestReplyEnum::UNAVAILABLE);
         rs->set_msg("GPAR: No model can satisfy this request. Try a different "
                     "accuracy/latency");
-        return Status::OK;
+        return false;
       }
 
       model = meets_slo[0];
     }
 
     // By this point, we have a model
-    std::cout << "[LOG]: Model variant selected is: " << model << std::endl;
+    INFAAS_LOG(INFO) << "[LOG]: Model variant selected is: " << model;
 
     // Track QPS for GPU variants
     std::chrono::time_point<std::chrono::system_clock> curr_time =
         std::chrono::system_clock::now();
 
-    if ((std::stoi(rm_->get_model_info(model, "max_batch")) < 64) &&
-        (rm_->get_model_info(model, "framework") != "inferentia")) {
-      std::cout << "[LOG]: Logging GPU variant's QPS" << std::endl;
-      if (variant_qps_tracker_.find(model) == variant_qps_tracker_.end()) {
-        // Not seen before
-        variant_qps_tracker_.insert(
-            std::pair<
-                std::string,
-                std::pair<std::chrono::time_point<std::chrono::system_clock>,
-                          int16_t>>(
-                model,
-                std::pair<std::chrono::time_point<std::chrono::system_clock>,
-                          int16_t>(curr_time, 1)));
-      } else {
-        // Seen before
-        auto time_difference =
-            std::chrono::duration_cast<std::chrono::milliseconds>(
-                curr_time - variant_qps_tracker_[model].first)
-                .count();
+    if ((std::stoi(mc_->get_model_info(model, "max_batch")) < 64) &&
+        (mc_->get_model_info(model, "framework") != "inferentia")) {
+      INFAAS_LOG(INFO) << "[LOG]: Logging GPU variant's QPS";
+      // Read and update the tracker under its shard lock so concurrent
+      //// requests for the same variant do not lose counts
+      bool seen_before = false;
+      int64_t time_difference = 0;
+      variant_qps_tracker_.Update(
+          model, [&](BurstState& state, bool inserted) {
+            if (inserted) {
+              state.count = 1;
+            } else {
+              seen_before = true;
+              time_difference =
+                  std::chrono::duration_cast<std::chrono::milliseconds>(
+                      curr_time - state.first)
+                      .count();
+            }
+            state.first = curr_time; // Update time
+          });
 
-        std::cout << "[LOG]: Interval: " << time_difference << std::endl;
-        variant_qps_tracker_[model].first = curr_time; // Update time
+      if (seen_before) {
+        INFAAS_LOG(DEBUG) << "[LOG]: Interval: " << time_difference;
 
         // If this variant is already exclusively on a GPU, check that
         //// the variant is still running on it and that the worker
@@ -1335,8 +1504,8 @@ private:
         // If yes to both, pick it. Otherwise, reset the variant to
         //// be eligible for sharing a GPU again
 
-        if (model_to_exclusive_.find(model) != model_to_exclusive_.end()) {
-          std::string candidate_worker = model_to_exclusive_[model];
+        std::string candidate_worker;
+        if (model_to_exclusive_.Get(model, &candidate_worker)) {
           // Always send to candidate worker if running.
           // The problem is that the model will not show up as running
           //// fast enough, so the master will think it is not exclusive
@@ -1346,40 +1515,47 @@ private:
           // if (rm_->is_model_running(model, candidate_worker) == 1) {
           if (rm_->executor_exists(candidate_worker)) {
             next_worker = candidate_worker;
-            std::cout << "[LOG]: Picking " << next_worker << " for ";
-            std::cout << model << " from exclusive" << std::endl;
+            INFAAS_LOG(INFO) << "[LOG]: Picking " << next_worker << " for "
+                             << model << " from exclusive";
           } else {
-            variant_qps_tracker_[model].second = 0;
-            model_to_exclusive_.erase(model);
-            std::cout << "[LOG]: Resetting " << model;
-            std::cout << " from exclusive" << std::endl;
+            variant_qps_tracker_.Update(
+                model, [](BurstState& state, bool) { state.count = 0; });
+            model_to_exclusive_.Erase(model);
+            INFAAS_LOG(INFO) << "[LOG]: Resetting " << model
+                             << " from exclusive";
           }
         } else {
           // If the interval is less than one second and the QPS exceeds
           //// the threshold, assign this variant an exclusive GPU
           //// and start a new slack GPU worker
           if (time_difference < qps_vm_scale_time_interval) {
-            std::cout << "[LOG]: Less than one second between requests ";
-            std::cout << "to " << model << std::endl;
-            int16_t curr_model_qps = ++variant_qps_tracker_[model].second;
+            INFAAS_LOG(INFO) << "[LOG]: Less than one second between requests "
+                                "to " << model;
+            // Only the request that reaches the limit resets the counter,
+            //// so exactly one of them goes looking for a slack worker
+            bool reached_limit = false;
+            variant_qps_tracker_.Update(
+                model, [&](BurstState& state, bool) {
+                  if (++state.count == qps_model_query_limit) {
+                    state.count = 0;
+                    reached_limit = true;
+                  }
+                });
 
-            if (curr_model_qps == qps_model_query_limit) {
-              std::cout << "[LOG]: " << model << " becoming exclusive";
-              std::cout << std::endl;
+            if (reached_limit) {
+              INFAAS_LOG(INFO) << "[LOG]: " << model << " becoming exclusive";
 
               // Find first available slack worker
               //// If all taken, go to shared worker picking
               std::vector<std::string> gpu_cand = rm_->min_gpu_util_name(10);
               for (auto gc : gpu_cand) {
                 std::string check_slack = rm_->is_exec_slack(gc);
-                std::cout << "[LOG]: Slack for " << gc << " is ";
-                std::cout << check_slack << std::endl;
+                INFAAS_LOG(INFO) << "[LOG]: Slack for " << gc << " is "
+                                 << check_slack;
                 if (check_slack == "0") {
-                  std::cout << "[LOG]: Found slack worker " << gc;
-                  std::cout << std::endl;
+                  INFAAS_LOG(INFO) << "[LOG]: Found slack worker " << gc;
                   rm_->set_exec_slack(gc, model);
-                  model_to_exclusive_.insert(
-                      std::pair<std::string, std::string>(model, gc));
+                  model_to_exclusive_.Insert(model, gc);
                   next_worker = gc;
                   // Set slack scale to add another slack worker
                   rm_->set_slack_scale();
@@ -1388,19 +1564,20 @@ private:
               }
 
               if (next_worker != "dummy") {
-                std::cout << "[LOG]: " << next_worker << " GPU is now ";
-                std::cout << "exclusively serving " << model << std::endl;
+                INFAAS_LOG(INFO) << "[LOG]: " << next_worker << " GPU is now "
+                                                                "exclusively "
+                                                                "serving "
+                                 << model;
               } else {
-                std::cout << "[LOG]: No exclusive option found for ";
-                std::cout << model << ", going to shared..." << std::endl;
+                INFAAS_LOG(INFO) << "[LOG]: No exclusive option found for "
+                                 << model << ", going to shared...";
               }
-
-              variant_qps_tracker_[model].second = 0;
             }
           } else {
-            std::cout << "[LOG]: Over one second between variant requests, ";
-            std::cout << "resetting counter" << std::endl;
-            variant_qps_tracker_[model].second = 0;
+            INFAAS_LOG(INFO) << "[LOG]: Over one second between variant "
+                                "requests, resetting counter";
+            variant_qps_tracker_.Update(
+                model, [](BurstState& state, bool) { state.count = 0; });
           }
         }
       }
@@ -1409,61 +1586,65 @@ private:
     // If the GPU exclusive tracking selected a worker, skip worker selection
     bool valid_is_running = false;
     if (next_worker != "dummy") {
-      std::cout << "[LOG]: GPu exclusive already picked worker" << std::endl;
+      INFAAS_LOG(INFO) << "[LOG]: GPu exclusive already picked worker";
       valid_is_running = true;
     } else if (is_running < 0) {
       // Since we have already checked if the model is registered,
       // if is_running < 0, the Redis query failed
-      std::cout << "[LOG]: is_running is negative!" << std::endl;
+      INFAAS_LOG(INFO) << "[LOG]: is_running is negative!";
       throw std::runtime_error("Query to Redis failed");
     } else if (is_running) {
-      std::vector<std::string> dest_name = rm_->min_qps_name(model, 3);
+      std::vector<std::string> dest_name = rm_->min_qps_name(
+          model, (master_decision_ == POWEROFDCHOICES) ? pod_max_replicas : 3);
       if (dest_name.empty()) {
         // If this happens, it means the model was shut down in the time that a
         //// decision was made. Just leave valid_is_running as false.
-        std::cout
-            << "[LOG]: Model was said to be running, but min_qps_name query";
-        std::cout << " is empty. Leaving valid_is_running as false."
-                  << std::endl;
+        INFAAS_LOG(INFO) << "[LOG]: Model was said to be running, but "
+                            "min_qps_name query is empty. Leaving "
+                            "valid_is_running as false.";
       } else {
-        std::cout << "[LOG]: " << dest_name.size()
-                  << " options for running workers";
-        std::cout << std::endl;
+        INFAAS_LOG(INFO) << "[LOG]: " << dest_name.size() << " options for "
+                                                             "running workers";
 
-        std::cout << "[LOG]: BEFORE..." << std::endl;
+        INFAAS_LOG(INFO) << "[LOG]: BEFORE...";
         for (std::string d : dest_name) {
-          std::cout << "\t" << d << std::endl;
+          INFAAS_LOG(INFO) << "\t" << d;
         }
 
         if ((master_decision_ == GPUSHARETRIGGER) ||
             (master_decision_ == GPUSHARETRIGGER_SKIPBLIST) ||
-            (master_decision_ == CPUBLISTCHECK)) {
+            (master_decision_ == CPUBLISTCHECK) ||
+            (master_decision_ == POWEROFDCHOICES)) {
           // Seed for shuffle
           uint64_t seed =
               std::chrono::system_clock::now().time_since_epoch().count();
           std::shuffle(dest_name.begin(), dest_name.end(), std::mt19937(seed));
-          std::cout << "[LOG]: AFTER..." << std::endl;
+          INFAAS_LOG(INFO) << "[LOG]: AFTER...";
           for (std::string d : dest_name) {
-            std::cout << "\t" << d << std::endl;
+            INFAAS_LOG(INFO) << "\t" << d;
           }
         }
 
         // Now walk through the candidates and select the first one that passes
-        //// both blacklist checks and is not exclusive
+        //// both blacklist checks and is not exclusive.
+        // POWEROFDCHOICES instead collects the first pod_choices that pass
+        //// (a random sample, since dest_name was shuffled) and picks the
+        //// least loaded of them below
+        std::vector<std::string> sampled;
         for (std::string d : dest_name) {
-          std::cout << "[LOG]: Checking " << d << std::endl;
+          INFAAS_LOG(INFO) << "[LOG]: Checking " << d;
           if (rm_->is_blacklisted(d)) {
-            std::cout << "[LOG]: " << d << " is blacklisted.";
+            INFAAS_LOG(INFO) << "[LOG]: " << d << " is blacklisted.";
             continue;
           } else if (rm_->is_exec_slack(d) != "NS") {
-            std::cout << "[LOG]: " << d << " is exclusive.";
+            INFAAS_LOG(INFO) << "[LOG]: " << d << " is exclusive.";
             continue;
           } else {
             if (master_decision_ == GPUSHARETRIGGER_SKIPBLIST) {
               // Pick the worker regardless of whether the variant
               //// is blacklisted on it
-              std::cout << "[LOG]: Not checking model blacklist, picking ";
-              std::cout << d << std::endl;
+              INFAAS_LOG(INFO) << "[LOG]: Not checking model blacklist, "
+                                  "picking " << d;
 
               next_worker = d;
               valid_is_running = true;
@@ -1473,8 +1654,11 @@ private:
               // requested worker, leave valid_is_running as false
               int8_t is_blisted = rm_->get_model_avglat_blacklist(d, model);
               if (is_blisted) {
-                std::cout << "[LOG]: " << d << " has blacklisted " << model
-                          << std::endl;
+                INFAAS_LOG(INFO) << "[LOG]: " << d << " has blacklisted "
+                                 << model;
+              } else if (master_decision_ == POWEROFDCHOICES) {
+                sampled.push_back(d);
+                if (sampled.size() == pod_choices) { break; }
               } else {
                 next_worker = d;
                 valid_is_running = true;
@@ -1483,13 +1667,20 @@ private:
             }
           }
         }
+
+        if (!sampled.empty()) {
+          next_worker = worker_load_.PickLeastLoaded(sampled, pod_choices);
+          valid_is_running = true;
+          INFAAS_LOG(INFO) << "[LOG]: Picking " << next_worker << " (load "
+                           << worker_load_.Load(next_worker) << ") of "
+                           << sampled.size() << " sampled replicas";
+        }
       }
 
       // If valid_is_running was false, none of the explored workers were valid.
       if (!valid_is_running) {
-        std::cout
-            << "[LOG]: Warning: all explored workers failed blacklist checks";
-        std::cout << " or model is not running anymore." << std::endl;
+        INFAAS_LOG(INFO) << "[LOG]: Warning: all explored workers failed "
+                            "blacklist checks or model is not running anymore.";
       }
     }
 
@@ -1499,14 +1690,14 @@ private:
           (master_decision_ != ROUNDROBIN_STATIC) &&
           (master_decision_ != ROUNDROBIN_DYNAMIC)) {
         // Use this to figure out if a model needs a GPU
-        std::string mv_batch = rm_->get_model_info(model, "max_batch");
-        std::string mv_framework = rm_->get_model_info(model, "framework");
+        std::string mv_batch = mc_->get_model_info(model, "max_batch");
+        std::string mv_framework = mc_->get_model_info(model, "framework");
         bool needs_gpu =
             (std::stoi(mv_batch) < 64) && (mv_framework != "inferentia");
         bool needs_inferentia = (mv_framework == "inferentia");
-        std::cout << "[LOG]: Needs GPU: " << (int16_t)needs_gpu << std::endl;
-        std::cout << "[LOG]: Needs Inferentia: " << (int16_t)needs_inferentia
-                  << std::endl;
+        INFAAS_LOG(INFO) << "[LOG]: Needs GPU: " << (int16_t)needs_gpu;
+        INFAAS_LOG(INFO) << "[LOG]: Needs Inferentia: "
+                         << (int16_t)needs_inferentia;
 
         // Get workers with minimum CPU utilization
         std::vector<std::string> min_cpu = rm_->min_cpu_util_name(15);
@@ -1566,21 +1757,20 @@ private:
             next_worker = min_cpu[0];
           } else {
             for (const std::string mc : min_cpu) {
-              std::cout << "[LOG]: Min CPU, considering: " << mc << std::endl;
+              INFAAS_LOG(DEBUG) << "[LOG]: Min CPU, considering: " << mc;
               if (needs_gpu && rm_->is_exec_onlycpu(mc)) {
-                std::cout << "[LOG]: Skipping " << mc
-                          << " because it is CPU only";
-                std::cout << std::endl;
+                INFAAS_LOG(DEBUG) << "[LOG]: Skipping " << mc << " because it "
+                                                                 "is CPU only";
                 continue;
               }
-              if (last_worker_picked_ != mc) {
+              if (*last_worker_picked_.Load() != mc) {
                 next_worker = mc;
-                last_worker_picked_ = mc;
+                last_worker_picked_.Store(mc);
                 break;
               } else {
-                std::cout << "[LOG]: Skipping " << mc
-                          << " because it was last picked";
-                std::cout << std::endl;
+                INFAAS_LOG(DEBUG) << "[LOG]: Skipping " << mc << " because it "
+                                                                 "was last "
+                                                                 "picked";
               }
             }
           }
@@ -1590,27 +1780,26 @@ private:
           } else {
             // Walk through "intersected" options
             for (const std::string inter : intersection) {
-              std::cout << "[LOG]: Intersection, considering: " << inter;
-              std::cout << std::endl;
+              INFAAS_LOG(DEBUG) << "[LOG]: Intersection, considering: "
+                                << inter;
               int8_t is_only_cpu = rm_->is_exec_onlycpu(inter);
               int8_t is_inferentia = rm_->is_exec_inferentia(inter);
               if ((needs_gpu || needs_inferentia) && is_only_cpu) {
-                std::cout << "[LOG]: Skipping " << inter
-                          << " because it is CPU only";
-                std::cout << std::endl;
+                INFAAS_LOG(DEBUG) << "[LOG]: Skipping " << inter
+                                  << " because it is CPU only";
                 continue;
               } else if (needs_gpu && is_inferentia) {
-                std::cout << "[LOG]: Skipping " << inter
-                          << " because it is Inferentia and GPU is needed";
-                std::cout << std::endl;
+                INFAAS_LOG(DEBUG) << "[LOG]: Skipping " << inter
+                                  << " because it is Inferentia and GPU is "
+                                     "needed";
                 continue;
               } else if (needs_gpu && (rm_->is_exec_slack(inter) != "NS")) {
-                std::cout << "[LOG]: Skipping " << inter;
-                std::cout << " because it is exclusive" << std::endl;
+                INFAAS_LOG(DEBUG) << "[LOG]: Skipping " << inter
+                                  << " because it is exclusive";
                 continue;
               } else if (needs_inferentia && !is_inferentia) {
-                std::cout << "[LOG]: Skipping " << inter;
-                std::cout << " because it doesn't have Inferentia" << std::endl;
+                INFAAS_LOG(DEBUG) << "[LOG]: Skipping " << inter
+                                  << " because it doesn't have Inferentia";
                 continue;
               }
 
@@ -1629,9 +1818,8 @@ private:
                 last_worker_picked_ = inter;
                 break;
               } else {
-                std::cout << "[LOG]: Skipping " << inter
-                          << " because it was last picked";
-                std::cout << std::endl;
+                INFAAS_LOG(DEBUG) << "[LOG]: Skipping " << inter
+                                  << " because it was last picked";
               }
               */
             }
@@ -1643,70 +1831,68 @@ private:
         //// one GPU instance, and it was last picked.
         // NOTE: this should no longer occur.
         if (next_worker == "dummy") {
-          std::cout << "[LOG]: Warning: next_worker is empty.";
-          std::cout << " NOTE: THIS SHOULD NOT OCCUR!!" << std::endl;
+          INFAAS_LOG(INFO) << "[LOG]: Warning: next_worker is empty. NOTE: "
+                              "THIS SHOULD NOT OCCUR!!";
           // next_worker = last_worker_picked_;
         }
       } else { // Any of the RRs
         if ((master_decision_ == ROUNDROBIN_STATIC) ||
             (master_decision_ == ROUNDROBIN_DYNAMIC)) {
           bool need_new_worker = true;
-          if (static_model_worker_map_.find(model) !=
-              static_model_worker_map_.end()) {
-            std::cout << "[LOG]: " << model << " previously queried"
-                      << std::endl;
+          if (static_model_worker_map_.Contains(model)) {
+            INFAAS_LOG(INFO) << "[LOG]: " << model << " previously queried";
 
             // If ROUNDROBIN_DYNAMIC, check if worker is blacklisted.
             // If so, ask for it to be updated.
             if (master_decision_ == ROUNDROBIN_DYNAMIC) {
-              std::string check_worker = static_model_worker_map_[model];
+              std::string check_worker;
+              static_model_worker_map_.Get(model, &check_worker);
               int8_t is_blisted =
                   rm_->get_model_avglat_blacklist(check_worker, model);
               if (is_blisted < 0) {
-                std::cout << "[LOG]: For RR_DYNAMIC, " << check_worker;
-                std::cout << " is either not running " << model;
-                std::cout << "or got shut down, getting new worker"
-                          << std::endl;
+                INFAAS_LOG(INFO) << "[LOG]: For RR_DYNAMIC, " << check_worker
+                                 << " is either not running " << model
+                                 << "or got shut down, getting new worker";
               } else if (is_blisted == 1) {
-                std::cout << "[LOG]: For RR_DYNAMIC, " << check_worker;
-                std::cout << " has blacklisted " << model;
-                std::cout << ", getting new worker" << std::endl;
+                INFAAS_LOG(INFO) << "[LOG]: For RR_DYNAMIC, " << check_worker
+                                 << " has blacklisted " << model
+                                 << ", getting new worker";
               } else {
-                std::cout << "[LOG]: For RR_DYNAMIC, " << check_worker;
-                std::cout << " passes blacklist." << std::endl;
+                INFAAS_LOG(INFO) << "[LOG]: For RR_DYNAMIC, " << check_worker
+                                 << " passes blacklist.";
                 next_worker = check_worker;
                 need_new_worker = false;
               }
             } else {
-              next_worker = static_model_worker_map_[model];
+              static_model_worker_map_.Get(model, &next_worker);
               need_new_worker = false;
             }
           }
 
           if (need_new_worker) {
-            std::cout << "[LOG]: " << model << " not seen before";
-            std::cout << " or worker was blacklisted; using RR" << std::endl;
+            INFAAS_LOG(INFO) << "[LOG]: " << model << " not seen before or "
+                                                      "worker was "
+                                                      "blacklisted; using RR";
 
             // Pick the next worker and increment the round robin counter
             // If a GPU is needed, walk through all workers until a GPU is
             // found. The same goes for Inferentia.
-            std::string mv_batch = rm_->get_model_info(model, "max_batch");
-            std::string mv_framework = rm_->get_model_info(model, "framework");
+            std::string mv_batch = mc_->get_model_info(model, "max_batch");
+            std::string mv_framework = mc_->get_model_info(model, "framework");
             bool needs_gpu =
                 (std::stoi(mv_batch) < 64) && (mv_framework != "inferentia");
             bool needs_inferentia = (mv_framework == "inferentia");
-            std::cout << "[LOG]: Needs GPU: " << (int16_t)needs_gpu
-                      << std::endl;
-            std::cout << "[LOG]: Needs Inferentia: "
-                      << (int16_t)needs_inferentia << std::endl;
+            INFAAS_LOG(INFO) << "[LOG]: Needs GPU: " << (int16_t)needs_gpu;
+            INFAAS_LOG(INFO) << "[LOG]: Needs Inferentia: "
+                             << (int16_t)needs_inferentia;
 
             if (master_decision_ == ROUNDROBIN_DYNAMIC) {
               // Since the # of workers can dynamically change, we need to
               //// first get all workers, and second collect all
               //// GPU/Inferentia workers if needed
               std::vector<std::string> all_exec_rrd = rm_->get_all_executors();
-              std::cout << "[LOG]: RRD => " << all_exec_rrd.size();
-              std::cout << " workers" << std::endl;
+              INFAAS_LOG(INFO) << "[LOG]: RRD => " << all_exec_rrd.size()
+                               << " workers";
               if (needs_gpu) {
                 std::vector<std::string> all_gpu_exec_rrd;
                 for (std::string ae : all_exec_rrd) {
@@ -1715,14 +1901,11 @@ private:
                     all_gpu_exec_rrd.push_back(ae);
                   }
                 }
-                std::cout << "[LOG]: RRD => Considering "
-                          << all_gpu_exec_rrd.size();
-                std::cout << " GPU workers" << std::endl;
-
-                // Mod counter before, in case number of workers decreased
-                all_exec_gpu_counter_ %= all_gpu_exec_rrd.size();
-                next_worker = all_gpu_exec_rrd[all_exec_gpu_counter_];
-                all_exec_gpu_counter_++;
+                INFAAS_LOG(DEBUG) << "[LOG]: RRD => Considering "
+                                  << all_gpu_exec_rrd.size() << " GPU workers";
+
+                next_worker = PickRoundRobin(all_gpu_exec_rrd,
+                                             &all_exec_gpu_counter_);
               } else if (needs_inferentia) {
                 std::vector<std::string> all_inferentia_exec_rrd;
                 for (std::string ae : all_exec_rrd) {
@@ -1730,41 +1913,30 @@ private:
                     all_inferentia_exec_rrd.push_back(ae);
                   }
                 }
-                std::cout << "[LOG]: RRD => Considering "
-                          << all_inferentia_exec_rrd.size();
-                std::cout << " Inferentia workers" << std::endl;
+                INFAAS_LOG(DEBUG) << "[LOG]: RRD => Considering "
+                                  << all_inferentia_exec_rrd.size()
+                                  << " Inferentia workers";
 
-                // Mod counter before, in case number of workers decreased
-                all_exec_inferentia_counter_ %= all_inferentia_exec_rrd.size();
-                next_worker =
-                    all_inferentia_exec_rrd[all_exec_inferentia_counter_];
-                all_exec_inferentia_counter_++;
+                next_worker = PickRoundRobin(all_inferentia_exec_rrd,
+                                             &all_exec_inferentia_counter_);
               } else {
-                // Mod counter before, in case number of workers decreased
-                all_exec_counter_ %= all_exec_rrd.size();
-                next_worker = all_exec_rrd[all_exec_counter_];
-                all_exec_counter_++;
+                next_worker =
+                    PickRoundRobin(all_exec_rrd, &all_exec_counter_);
               }
 
-              static_model_worker_map_[model] = next_worker;
+              static_model_worker_map_.Set(model, next_worker);
             } else { // RR_STATIC
               if (needs_gpu) {
-                next_worker = all_gpu_exec_[all_exec_gpu_counter_];
-                all_exec_gpu_counter_ =
-                    (all_exec_gpu_counter_ + 1) % all_gpu_exec_.size();
+                next_worker = PickRoundRobin(all_gpu_exec_,
+                                             &all_exec_gpu_counter_);
               } else if (needs_inferentia) {
-                next_worker =
-                    all_inferentia_exec_[all_exec_inferentia_counter_];
-                all_exec_inferentia_counter_ =
-                    (all_exec_inferentia_counter_ + 1) %
-                    all_inferentia_exec_.size();
+                next_worker = PickRoundRobin(all_inferentia_exec_,
+                                             &all_exec_inferentia_counter_);
               } else {
-                next_worker = all_exec_[all_exec_counter_];
-                all_exec_counter_ = (all_exec_counter_ + 1) % all_exec_.size();
+                next_worker = PickRoundRobin(all_exec_, &all_exec_counter_);
               }
 
-              static_model_worker_map_.insert(
-                  std::pair<std::string, std::string>(model, next_worker));
+              static_model_worker_map_.Insert(model, next_worker);
             }
           }
         } else { // Regular ROUNDROBIN
@@ -1772,8 +1944,7 @@ private:
           std::vector<std::string> all_exec_ = rm_->get_all_executors();
 
           // Pick the next worker and increment the round robin counter
-          next_worker = all_exec_[all_exec_counter_];
-          all_exec_counter_ = (all_exec_counter_ + 1) % all_exec_.size();
+          next_worker = PickRoundRobin(all_exec_, &all_exec_counter_);
         }
       }
     }
@@ -1782,50 +1953,59 @@ private:
     if (RedisMetadata::is_empty_address(dest_addr)) {
       rs->set_status(infaaspublic::RequestReplyEnum::INVALID);
       rs->set_msg("Destination address is empty");
-      std::cout << "[LOG]: Destination address is empty" << std::endl;
-      return Status::OK;
+      INFAAS_LOG(INFO) << "[LOG]: Destination address is empty";
+      return false;
     } else {
-      std::cout << "[LOG]: Model will be serviced by: ";
-      std::cout << next_worker << " (";
-      std::cout << RedisMetadata::Address_to_str(dest_addr) << ")" << std::endl;
+      INFAAS_LOG(INFO) << "[LOG]: Model will be serviced by: " << next_worker
+                       << " (" << RedisMetadata::Address_to_str(dest_addr)
+                       << ")";
     }
 
     // Update qps worker map
     // curr_time set above in variant QPS tracking
-    if (qps_worker_scaler_.find(next_worker) == qps_worker_scaler_.end()) {
-      qps_worker_scaler_.insert(
-          std::pair<
-              std::string,
-              std::pair<std::chrono::time_point<std::chrono::system_clock>,
-                        int16_t>>(
-              next_worker,
-              std::pair<std::chrono::time_point<std::chrono::system_clock>,
-                        int16_t>(curr_time, 1)));
-    } else {
-      auto time_difference =
-          std::chrono::duration_cast<std::chrono::milliseconds>(
-              curr_time - qps_worker_scaler_[next_worker].first)
-              .count();
+    // The counter is stepped under its shard lock; the Redis side effects
+    //// run afterwards, once, by the request that hit the limit
+    bool seen_before = false;
+    bool overloaded = false;
+    int64_t time_difference = 0;
+    qps_worker_scaler_.Update(
+        next_worker, [&](BurstState& state, bool inserted) {
+          if (inserted) {
+            state.first = curr_time;
+            state.count = 1;
+            return;
+          }
+          seen_before = true;
+          time_difference =
+              std::chrono::duration_cast<std::chrono::milliseconds>(
+                  curr_time - state.first)
+                  .count();
+          if (time_difference < qps_vm_scale_time_interval) {
+            if (++state.count == qps_vm_scale_query_limit) {
+              overloaded = true;
+              state.first = curr_time;
+              state.count = 0;
+            }
+          } else {
+            state.first = curr_time;
+            state.count = 0;
+          }
+        });
 
-      std::cout << "[LOG]: Interval: " << time_difference << std::endl;
+    if (seen_before) {
+      INFAAS_LOG(DEBUG) << "[LOG]: Interval: " << time_difference;
       if (time_difference < qps_vm_scale_time_interval) {
-        qps_worker_scaler_[next_worker].second++;
-        std::cout << "[LOG]: Less than one second between requests"
-                  << std::endl;
-        if (qps_worker_scaler_[next_worker].second ==
-            qps_vm_scale_query_limit) {
-          std::cout << "[LOG]: " << next_worker << " is overloaded";
-          std::cout << std::endl;
+        INFAAS_LOG(INFO) << "[LOG]: Less than one second between requests";
+        if (overloaded) {
+          INFAAS_LOG(INFO) << "[LOG]: " << next_worker << " is overloaded";
 
           // Only set VM scale if this is ROUNDROBIN_DYNAMIC.
           // Otherwise, scaling known to be unstable
           if (master_decision_ == ROUNDROBIN_DYNAMIC) {
-            std::cout << "[LOG]: RR_DYNAMIC, setting VM scale" << std::endl;
+            INFAAS_LOG(INFO) << "[LOG]: RR_DYNAMIC, setting VM scale";
             rm_->set_vm_scale();
           }
 
-          qps_worker_scaler_[next_worker].first = curr_time;
-          qps_worker_scaler_[next_worker].second = 0;
           // If there is more than one worker, blacklist this worker
           // Do not blacklist Inferentia workers
           if ((rm_->get_num_executors() > 1) &&
@@ -1836,51 +2016,494 @@ private:
           }
         }
       } else {
-        std::cout
-            << "[LOG]: Over one second between requests; resetting counter"
-            << std::endl;
-        qps_worker_scaler_[next_worker].first = curr_time;
-        qps_worker_scaler_[next_worker].second = 0;
+        INFAAS_LOG(INFO) << "[LOG]: Over one second between requests; "
+                            "resetting counter";
       }
     }
 
+    *model_out = model;
+    *worker_out = next_worker;
+    *addr_out = dest_addr;
+    return true;
+  }
+
+public:
+  // Serves query, which has just arrived on a completion-queue thread.
+  // Routing reads the metadata store, so it runs on routing_pool_; the query
+  // then moves to query->cq and resumes there after each wait (see
+  // OnlineQuery), replying through query->respond.
+  void StartQueryOnline(const std::shared_ptr<OnlineQuery> &query) {
+    gettimeofday(&query->arrival_tv, NULL);
+    const infaas::internal::AdmissionQueue::TimePoint arrival =
+        infaas::internal::AdmissionQueue::Clock::now();
+    routing_pool_.Run([this, query, arrival] { route_online(query, arrival); });
+  }
+
+  // Tells query that its client has gone away. A query waiting for an
+  // identical one stops and replies CANCELLED, as does one waiting for
+  // admission that no identical query waits on; a query already sent to a
+  // worker runs to the end.
+  void CancelQueryOnline(const std::shared_ptr<OnlineQuery> &query) {
+    post(query->cq, [this, query] {
+      query->cancelled = true;
+      if (query->waiting) {
+        query->waiting = false;
+        query->wait_alarm.Cancel();
+        query->respond(
+            Status(grpc::StatusCode::CANCELLED, "Cancelled by the client"));
+      } else if (query->admitting && query->flight_key.empty()) {
+        admission_.Cancel(query->worker, query->admission_id);
+      }
+    });
+  }
+
+  // Finishes the lookups queued on the routing pool. Called once no query
+  // can arrive any more, before the completion queues they post to shut
+  // down.
+  void StopRouting() { routing_pool_.Stop(); }
+
+private:
+  // Routes query on routing_pool_, then hands it to query->cq, which
+  // replies at once if it could not be routed. Nothing else touches the
+  // query until then.
+  void route_online(const std::shared_ptr<OnlineQuery> &query,
+                    const infaas::internal::AdmissionQueue::TimePoint arrival) {
+    const QueryOnlineRequest *request = query->request;
+    struct timeval time2;
+    infaaspublic::RequestReply *rs = query->reply->mutable_status();
+    bool routed = false;
+    try {
+      routed = route_online_query(request, rs, &query->model, &query->worker,
+                                  &query->addr);
+    } catch (const std::exception &e) {
+      INFAAS_LOG(ERROR) << "[LOG]: Failed to route a query: " << e.what();
+      rs->set_status(infaaspublic::RequestReplyEnum::INVALID);
+      rs->set_msg(e.what());
+    }
+    if (!routed) {
+      post(query->cq, [query] { query->respond(Status::OK); });
+      return;
+    }
+
     gettimeofday(&time2, NULL);
-    printf("[queryfe_server.cc] Master decision-making total time: %.4lf ms.\n",
-           ts_to_ms(time1, time2));
-    fflush(stdout);
-
-    grpc::ChannelArguments arguments;
-    arguments.SetMaxSendMessageSize(MAX_GRPC_MESSAGE_SIZE);
-    arguments.SetMaxReceiveMessageSize(MAX_GRPC_MESSAGE_SIZE);
-
-    infaas::internal::QueryClient query_client(grpc::CreateCustomChannel(
-        RedisMetadata::Address_to_str(dest_addr),
-        grpc::InsecureChannelCredentials(), arguments));
-    auto worker_reply = query_client.QueryOnline(
-        request->raw_input(), {model}, submitter, reply->mutable_raw_output(),
-        slo.latencyinusec(), slo.minaccuracy(), slo.maxcost());
+    INFAAS_LOG(INFO) << "[queryfe_server.cc] Master decision-making total "
+                        "time: "
+                     << std::fixed << std::setprecision(4)
+                     << ts_to_ms(query->arrival_tv, time2) << " ms.";
+
+    if (request->has_diffusion()) {
+      query->diffusion = worker_diffusion_params(request->diffusion());
+    }
+
+    // The variant searches compare the latency SLO with registered
+    //// latencies, which are in ms; the deadline uses the same unit
+    const auto &slo = request->slo();
+    query->deadline = infaas::internal::AdmissionQueue::TimePoint::max();
+    if (slo.latencyinusec() > 0) {
+      query->deadline = arrival + std::chrono::milliseconds(slo.latencyinusec());
+    }
+    query->pinned = !request->model_variant().empty();
+    // An identical query is waited for no longer than the SLO or the client
+    // allow
+    query->wait_until =
+        std::min(query->deadline, client_deadline(*query->context));
+
+    post(query->cq, [this, query] { coalesce_online(query); });
+  }
+
+  // Identical queries in flight at the same time run once on the worker
+  // and share the output: the first leads, the others wait for its outcome.
+  void coalesce_online(const std::shared_ptr<OnlineQuery> &query) {
+    if (query->cancelled) {
+      query->respond(
+          Status(grpc::StatusCode::CANCELLED, "Cancelled by the client"));
+      return;
+    }
+    const std::string key = coalesce_key(query->model, *query->request);
+    if (key.empty()) {
+      admit_online(query);
+      return;
+    }
+    const bool leads = inflight_queries_.Join(
+        key, [this, query](std::shared_ptr<const WorkerOutcome> outcome) {
+          post(query->cq,
+               [this, query, outcome] { on_shared_outcome(query, outcome); });
+        });
+    if (leads) {
+      query->flight_key = key;
+      admit_online(query);
+      return;
+    }
+
+    query->waiting = true;
+    if (query->wait_until ==
+        infaas::internal::AdmissionQueue::TimePoint::max()) {
+      return;
+    }
+    set_alarm(&query->wait_alarm, query->cq, query->wait_until,
+              [query](bool fired) {
+                if (!fired || !query->waiting) { return; }
+                query->waiting = false;
+                INFAAS_LOG(INFO) << "[LOG]: Identical " << query->model
+                                 << " query did not finish within the SLO";
+                infaaspublic::RequestReply *rs =
+                    query->reply->mutable_status();
+                rs->set_status(infaaspublic::RequestReplyEnum::UNAVAILABLE);
+                rs->set_msg("Query did not finish within the latency SLO");
+                query->respond(Status::OK);
+              });
+  }
+
+  // The identical query that query waited for is over; null if it failed,
+  // in which case query runs on its own.
+  void on_shared_outcome(const std::shared_ptr<OnlineQuery> &query,
+                         const std::shared_ptr<const WorkerOutcome> &outcome) {
+    if (!query->waiting) { return; }  // Gave up on it already
+    query->waiting = false;
+    query->wait_alarm.Cancel();
+    if (outcome == nullptr) {
+      admit_online(query);
+      return;
+    }
+    INFAAS_LOG(INFO) << "[LOG]: Shared the output of an identical "
+                     << query->model << " query";
+    respond_online(query, *outcome, true);
+  }
+
+  // Queues query for a slot on its worker as the next variant it may run
+  // as: the routed one, then (unless pinned) its downgrade_variants, each
+  // only if it can still finish in time. The query resumes in on_admission
+  // once the worker decides; if no variant is left it is rejected.
+  void admit_online(const std::shared_ptr<OnlineQuery> &query) {
+    const QueryOnlineRequest *request = query->request;
+    const int16_t batch_size = request->raw_input().size();
+    if (query->candidates.empty()) {
+      query->candidates.emplace_back(
+          query->model, admission_service_ms(query->model, batch_size));
+    }
+    while (true) {
+      if (query->next_candidate == query->candidates.size()) {
+        if (query->pinned || query->downgrades_listed) {
+          WorkerOutcome outcome;
+          outcome.rejected = true;
+          complete_online(query, std::move(outcome));
+          return;
+        }
+        query->downgrades_listed = true;
+        for (auto &variant :
+             downgrade_variants(query->worker, query->model,
+                                request->slo().minaccuracy(), batch_size)) {
+          query->candidates.push_back(std::move(variant));
+        }
+        continue;
+      }
+      const std::pair<std::string, double> &candidate =
+          query->candidates[query->next_candidate++];
+      if (!admission_.Feasible(query->worker, query->deadline,
+                               candidate.second)) {
+        continue;
+      }
+      query->admitting = true;
+      query->admission_id = admission_.Acquire(
+          query->worker, candidate.first, query->deadline, candidate.second,
+          [this, query](
+              bool admitted,
+              const infaas::internal::AdmissionQueue::Ticket &ticket) {
+            post(query->cq, [this, query, admitted, ticket] {
+              on_admission(query, admitted, ticket);
+            });
+          });
+      return;
+    }
+  }
+
+  void on_admission(const std::shared_ptr<OnlineQuery> &query,
+                    const bool admitted,
+                    const infaas::internal::AdmissionQueue::Ticket &ticket) {
+    query->admitting = false;
+    if (!admitted) {
+      if (query->cancelled && query->flight_key.empty()) {
+        query->respond(
+            Status(grpc::StatusCode::CANCELLED, "Cancelled by the client"));
+        return;
+      }
+      admit_online(query);
+      return;
+    }
+    if (ticket.model != query->model) {
+      INFAAS_LOG(INFO) << "[LOG]: Downgraded " << query->model << " to "
+                       << ticket.model << " to meet the deadline on "
+                       << query->worker;
+    }
+    query->ticket = ticket;
+    call_worker(query);
+  }
+
+  // Sends query to its worker. With hedging on, once the variant's recent
+  // latency quantile is known, a call still running after it is also sent
+  // to another replica if the hedge budget allows and that replica has a
+  // free slot. The first successful reply wins and the other call is
+  // cancelled.
+  void call_worker(const std::shared_ptr<OnlineQuery> &query) {
+    hedge_budget_.Earn();
+    start_attempt(query, query->worker, query->addr, query->ticket);
+    double after_ms = 0.0;
+    if (!hedge_budget_.enabled() ||
+        !latency_window_.Percentile(query->ticket.model, hedge_quantile,
+                                    hedge_min_samples, &after_ms)) {
+      return;
+    }
+    set_alarm(&query->hedge_alarm, query->cq,
+              std::chrono::steady_clock::now() +
+                  std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                      std::chrono::duration<double, std::milli>(after_ms)),
+              [this, query, after_ms](bool fired) {
+                if (fired) { hedge_online(query, after_ms); }
+              });
+  }
+
+  // The primary call has run past after_ms: looks for a replica on the
+  // routing pool, then sends the hedge from query->cq, unless the query is
+  // answered by then or there is no replica, slot or budget for it. The
+  // hedge holds its slot on the replica like any other query.
+  void hedge_online(const std::shared_ptr<OnlineQuery> &query,
+                    const double after_ms) {
+    if (query->answered) { return; }
+    const std::string variant = query->ticket.model;
+    const std::string primary = query->worker;
+    routing_pool_.Run([this, query, after_ms, variant, primary] {
+      std::string second;
+      struct Address second_addr;
+      if (!hedge_target(variant, primary, &second, &second_addr)) { return; }
+      post(query->cq, [this, query, after_ms, second, second_addr] {
+        send_hedge(query, after_ms, second, second_addr);
+      });
+    });
+  }
+
+  void send_hedge(const std::shared_ptr<OnlineQuery> &query,
+                  const double after_ms, const std::string &second,
+                  const struct Address &second_addr) {
+    if (query->answered) { return; }
+    const std::string &variant = query->ticket.model;
+    infaas::internal::AdmissionQueue::Ticket ticket;
+    if (!admission_.TryAcquire(
+            second, variant,
+            admission_service_ms(variant, query->request->raw_input().size()),
+            &ticket)) {
+      return;
+    }
+    if (!hedge_budget_.TrySpend()) {
+      admission_.Release(ticket, false);
+      return;
+    }
+    INFAAS_LOG(INFO) << "[LOG]: " << variant << " on " << query->worker
+                     << " is past its p" << (int)(hedge_quantile * 100)
+                     << " (" << after_ms << " ms), hedging on " << second;
+    start_attempt(query, second, second_addr, ticket);
+  }
+
+  void start_attempt(const std::shared_ptr<OnlineQuery> &query,
+                     const std::string &worker, const struct Address &addr,
+                     const infaas::internal::AdmissionQueue::Ticket &ticket) {
+    const int i = query->started++;
+    WorkerAttempt &attempt = query->attempts[i];
+    attempt.worker = worker;
+    attempt.ticket = ticket;
+    attempt.client.reset(new infaas::internal::QueryClient(
+        worker_channels_.GetChannel(worker, addr)));
+    attempt.start = std::chrono::steady_clock::now();
+    worker_load_.Start(worker);
+
+    const QueryOnlineRequest *request = query->request;
+    const auto &slo = request->slo();
+    attempt.client->AsyncQueryOnline(
+        query->cq,
+        new OnceTag([this, query, i](bool) { on_worker_reply(query, i); }),
+        &attempt.call, request->raw_input(), {query->ticket.model},
+        request->submitter(), slo.latencyinusec(), slo.minaccuracy(),
+        slo.maxcost(), worker_call_deadline_ms(query->deadline),
+        request->has_diffusion() ? &query->diffusion : nullptr);
+  }
+
+  // Call i of query is over, and gives back its slot. The first success
+  // answers the query, as does the last call to fail (with the primary's
+  // error); a call that ends after the answer only updates the bookkeeping.
+  void on_worker_reply(const std::shared_ptr<OnlineQuery> &query,
+                       const int i) {
+    WorkerAttempt &attempt = query->attempts[i];
+    int64_t queue_depth = -1;
+    attempt.outcome.status = infaas::internal::QueryClient::FinishQueryOnline(
+        &attempt.call, &attempt.outcome.raw_output, &queue_depth);
+    worker_load_.Finish(attempt.worker, queue_depth);
+    attempt.done = true;
+    const bool succeeded = (attempt.outcome.status.status() ==
+                            infaas::internal::InfaasRequestStatusEnum::SUCCESS);
+    if (succeeded) {
+      latency_window_.Record(query->ticket.model,
+                             std::chrono::duration<double, std::milli>(
+                                 std::chrono::steady_clock::now() -
+                                 attempt.start)
+                                 .count());
+    }
+    admission_.Release(attempt.ticket, succeeded);
+    if (query->answered) { return; }
+
+    int winner = i;
+    if (!succeeded) {
+      for (int j = 0; j < query->started; ++j) {
+        if (!query->attempts[j].done) { return; }  // It may still succeed
+      }
+      winner = 0;
+    }
+    query->answered = true;
+    query->hedge_alarm.Cancel();
+    if (query->started > 1) {
+      query->attempts[1 - winner].call.context.TryCancel();
+    }
+    complete_online(query, std::move(query->attempts[winner].outcome));
+  }
+
+  // query has its outcome: shares it with the identical queries waiting on
+  // query, if it leads them, and replies. Only an output is shared: a
+  // rejection was judged against query's own SLO, and a failure may be its
+  // worker's, so the waiting queries then run on their own.
+  void complete_online(const std::shared_ptr<OnlineQuery> &query,
+                       WorkerOutcome outcome) {
+    std::shared_ptr<const WorkerOutcome> shared =
+        std::make_shared<const WorkerOutcome>(std::move(outcome));
+    if (!query->flight_key.empty()) {
+      const bool succeeded =
+          !shared->rejected &&
+          (shared->status.status() ==
+           infaas::internal::InfaasRequestStatusEnum::SUCCESS);
+      inflight_queries_.Finish(query->flight_key,
+                               succeeded ? shared : nullptr);
+    }
+    respond_online(query, *shared, false);
+  }
+
+  // Replies to query with outcome. shared says the worker call was made
+  // for an identical query, whose worker is not this query's to blame.
+  void respond_online(const std::shared_ptr<OnlineQuery> &query,
+                      const WorkerOutcome &outcome, const bool shared) {
+    QueryOnlineResponse *reply = query->reply;
+    infaaspublic::RequestReply *rs = reply->mutable_status();
+    const infaas::internal::InfaasRequestStatus &worker_reply = outcome.status;
+    *reply->mutable_raw_output() = outcome.raw_output;
+    struct timeval time3;
     gettimeofday(&time3, NULL);
-    printf("[queryfe_server.cc] Master QueryOnline total time: %.4lf ms.\n",
-           ts_to_ms(time1, time3));
-    fflush(stdout);
+    INFAAS_LOG(INFO) << "[queryfe_server.cc] Master QueryOnline total "
+                        "time: "
+                     << std::fixed << std::setprecision(4)
+                     << ts_to_ms(query->arrival_tv, time3) << " ms.";
 
     // For logging purposes
-    std::cout << "===================================================="
-              << std::endl;
+    INFAAS_LOG(INFO) << "====================================================";
 
-    if (worker_reply.status() !=
-        infaas::internal::InfaasRequestStatusEnum::SUCCESS) {
-      std::cout << "[FAIL]: error msg: " << worker_reply.msg() << std::endl;
+    if (outcome.rejected) {
+      INFAAS_LOG(INFO) << "[LOG]: " << query->worker << " cannot serve "
+                       << query->model << " within the SLO, rejecting";
+      rs->set_status(infaaspublic::RequestReplyEnum::UNAVAILABLE);
+      rs->set_msg("No model can meet the latency SLO under the current load");
+    } else if (worker_reply.status() !=
+               infaas::internal::InfaasRequestStatusEnum::SUCCESS) {
+      INFAAS_LOG(INFO) << "[FAIL]: error msg: " << worker_reply.msg();
+      if (!shared) { worker_channels_.ReportFailure(query->worker); }
+      rs->set_status(infaaspublic::RequestReplyEnum::INVALID);
+      rs->set_msg("Query failed: " + worker_reply.msg());
+    } else {
+      rs->set_status(infaaspublic::RequestReplyEnum::SUCCESS);
+      rs->set_msg("Successfully executed query");
+    }
+    query->respond(Status::OK);
+  }
+
+  // Routed and admitted like QueryOnline, but the query runs alone on the
+  // worker (no coalescing, batching or hedging) and its previews are
+  // relayed to the client as they come. A client that goes away cancels
+  // the generation on the worker.
+  Status QueryOnlineStream(ServerContext *context,
+                           const QueryOnlineRequest *request,
+                           ServerWriter<QueryOnlineProgress> *writer) override {
+    const infaas::internal::AdmissionQueue::TimePoint arrival =
+        infaas::internal::AdmissionQueue::Clock::now();
+    QueryOnlineProgress result;
+    infaaspublic::RequestReply *rs = result.mutable_status();
+
+    std::string model;
+    std::string next_worker;
+    struct Address dest_addr = {"0", "0"};
+    if (!route_online_query(request, rs, &model, &next_worker, &dest_addr)) {
+      writer->Write(result);
+      return Status::OK;
+    }
+
+    auto slo = request->slo();
+    infaas::internal::AdmissionQueue::TimePoint deadline =
+        infaas::internal::AdmissionQueue::TimePoint::max();
+    if (slo.latencyinusec() > 0) {
+      deadline = arrival + std::chrono::milliseconds(slo.latencyinusec());
+    }
+    infaas::internal::AdmissionQueue::Ticket ticket;
+    if (!admit_query(next_worker, model, !request->model_variant().empty(),
+                     slo.minaccuracy(), request->raw_input().size(), deadline,
+                     &ticket)) {
+      INFAAS_LOG(INFO) << "[LOG]: " << next_worker << " cannot serve " << model
+                       << " within the SLO, rejecting";
+      rs->set_status(infaaspublic::RequestReplyEnum::UNAVAILABLE);
+      rs->set_msg("No model can meet the latency SLO under the current load");
+      writer->Write(result);
+      return Status::OK;
+    }
+
+    infaas::internal::InternalDiffusionQuery diffusion;
+    if (request->has_diffusion()) {
+      diffusion = worker_diffusion_params(request->diffusion());
+    }
+    auto on_preview =
+        [&](const infaas::internal::QueryOnlineProgress &progress) -> bool {
+          if (context->IsCancelled()) { return false; }
+          QueryOnlineProgress msg;
+          msg.set_step(progress.step());
+          msg.set_total_steps(progress.total_steps());
+          msg.set_index(progress.index());
+          msg.set_preview(progress.preview());
+          return writer->Write(msg);
+        };
+
+    infaas::internal::QueryClient query_client(
+        worker_channels_.GetChannel(next_worker, dest_addr));
+    worker_load_.Start(next_worker);
+    infaas::internal::InfaasRequestStatus worker_reply =
+        query_client.QueryOnlineStream(
+            request->raw_input(), {ticket.model}, request->submitter(),
+            result.mutable_raw_output(), on_preview, slo.latencyinusec(),
+            slo.minaccuracy(), slo.maxcost(), worker_call_deadline_ms(deadline),
+            request->has_diffusion() ? &diffusion : nullptr);
+    worker_load_.Finish(next_worker, -1);
+    const bool succeeded = (worker_reply.status() ==
+                            infaas::internal::InfaasRequestStatusEnum::SUCCESS);
+    admission_.Release(ticket, succeeded);
+
+    if (context->IsCancelled()) {
+      INFAAS_LOG(INFO) << "[LOG]: Client cancelled a " << ticket.model
+                       << " stream";
+      return Status(grpc::StatusCode::CANCELLED, "Cancelled by the client");
+    }
+    if (!succeeded) {
+      INFAAS_LOG(INFO) << "[FAIL]: error msg: " << worker_reply.msg();
+      worker_channels_.ReportFailure(next_worker);
       rs->set_status(infaaspublic::RequestReplyEnum::INVALID);
       rs->set_msg("Query failed: " + worker_reply.msg());
+      writer->Write(result);
       return Status::OK;
     }
 
     rs->set_status(infaaspublic::RequestReplyEnum::SUCCESS);
     rs->set_msg("Successfully executed query");
+    writer->Write(result);
     return Status::OK;
-  
-    
   }
 
   Status QueryOffline(ServerContext *context,
@@ -1980,7 +2603,7 @@ private:
     // matches the preset framework
     std::string model_var = "";
     for (std::string av : all_var) {
-      std::string framework = rm_->get_model_info(av, "framework");
+      std::string framework = mc_->get_model_info(av, "framework");
       if (framework == offline_framework) {
         model_var = av;
         break;
@@ -2019,27 +2642,25 @@ private:
       } else {
         int16_t num_cpu_workers = rm_->get_num_cpu_executors();
         for (const std::string mc : min_cpu) {
-          if (last_worker_picked_ != mc) {
+          if (*last_worker_picked_.Load() != mc) {
             if (num_cpu_workers > 0) {
               if (rm_->is_exec_onlycpu(mc)) {
-                std::cout << "[LOG]: Offline job going to CPU-only worker: ";
-                std::cout << mc << std::endl;
+                INFAAS_LOG(INFO) << "[LOG]: Offline job going to CPU-only "
+                                    "worker: " << mc;
                 next_worker = mc;
-                last_worker_picked_ = mc;
+                last_worker_picked_.Store(mc);
                 break;
               }
             } else {
-              std::cout
-                  << "[LOG]: Offline job going to GPU/Inferentia worker: ";
-              std::cout << mc << std::endl;
+              INFAAS_LOG(INFO) << "[LOG]: Offline job going to GPU/Inferentia "
+                                  "worker: " << mc;
               next_worker = mc;
-              last_worker_picked_ = mc;
+              last_worker_picked_.Store(mc);
               break;
             }
           } else {
-            std::cout << "[LOG]: Skipping " << mc
-                      << " because it was last picked";
-            std::cout << std::endl;
+            INFAAS_LOG(DEBUG) << "[LOG]: Skipping " << mc << " because it was "
+                                                             "last picked";
           }
         }
       }
@@ -2047,61 +2668,61 @@ private:
       if ((master_decision_ == ROUNDROBIN_STATIC) ||
           (master_decision_ == ROUNDROBIN_DYNAMIC)) {
         bool need_new_worker = true;
-        if (static_model_worker_map_.find(model_var) !=
-            static_model_worker_map_.end()) {
-          std::cout << "[LOG]: " << model_var << " previously queried"
-                    << std::endl;
+        if (static_model_worker_map_.Contains(model_var)) {
+          INFAAS_LOG(INFO) << "[LOG]: " << model_var << " previously queried";
 
           // If ROUNDROBIN_DYNAMIC, check if worker is blacklisted.
           // If so, ask for it to be updated.
           if (master_decision_ == ROUNDROBIN_DYNAMIC) {
-            std::string check_worker = static_model_worker_map_[model_var];
+            std::string check_worker;
+            static_model_worker_map_.Get(model_var, &check_worker);
             int8_t is_blisted =
                 rm_->get_model_avglat_blacklist(check_worker, model_var);
             if (is_blisted < 0) {
-              std::cout << "[LOG]: For RR_DYNAMIC, " << check_worker;
-              std::cout << " is either not running " << model_var;
-              std::cout << "or got shut down, getting new worker" << std::endl;
+              INFAAS_LOG(INFO) << "[LOG]: For RR_DYNAMIC, " << check_worker
+                               << " is either not running " << model_var
+                               << "or got shut down, getting new worker";
             } else if (is_blisted == 1) {
-              std::cout << "[LOG]: For RR_DYNAMIC, " << check_worker;
-              std::cout << " has blacklisted " << model_var;
-              std::cout << ", getting new worker" << std::endl;
+              INFAAS_LOG(INFO) << "[LOG]: For RR_DYNAMIC, " << check_worker
+                               << " has blacklisted " << model_var
+                               << ", getting new worker";
             } else {
-              std::cout << "[LOG]: For RR_DYNAMIC, " << check_worker;
-              std::cout << " passes blacklist." << std::endl;
+              INFAAS_LOG(INFO) << "[LOG]: For RR_DYNAMIC, " << check_worker
+                               << " passes blacklist.";
               next_worker = check_worker;
               need_new_worker = false;
             }
           } else {
-            next_worker = static_model_worker_map_[model_var];
+            static_model_worker_map_.Get(model_var, &next_worker);
             need_new_worker = false;
           }
         }
 
         if (need_new_worker) {
-          std::cout << "[LOG]: " << model_var << " not seen before";
-          std::cout << " or worker was blacklisted; using RR" << std::endl;
+          INFAAS_LOG(INFO) << "[LOG]: " << model_var << " not seen before or "
+                                                        "worker was "
+                                                        "blacklisted; using RR";
 
           // Pick the next worker and increment the round robin counter
           // If a GPU is needed, walk through all workers until a GPU is found.
           // The same goes for Inferentia.
-          std::string mv_batch = rm_->get_model_info(model_var, "max_batch");
+          std::string mv_batch = mc_->get_model_info(model_var, "max_batch");
           std::string mv_framework =
-              rm_->get_model_info(model_var, "framework");
+              mc_->get_model_info(model_var, "framework");
           bool needs_gpu =
               (std::stoi(mv_batch) < 64) && (mv_framework != "inferentia");
           bool needs_inferentia = (mv_framework == "inferentia");
-          std::cout << "[LOG]: Needs GPU: " << (int16_t)needs_gpu << std::endl;
-          std::cout << "[LOG]: Needs Inferentia: " << (int16_t)needs_inferentia
-                    << std::endl;
+          INFAAS_LOG(INFO) << "[LOG]: Needs GPU: " << (int16_t)needs_gpu;
+          INFAAS_LOG(INFO) << "[LOG]: Needs Inferentia: "
+                           << (int16_t)needs_inferentia;
 
           if (master_decision_ == ROUNDROBIN_DYNAMIC) {
             // Since the # of workers can dynamically change, we need to
             //// first get all workers, and second collect all
             //// GPU/Inferentia workers if needed
             std::vector<std::string> all_exec_rrd = rm_->get_all_executors();
-            std::cout << "[LOG]: RRD => " << all_exec_rrd.size();
-            std::cout << " workers" << std::endl;
+            INFAAS_LOG(INFO) << "[LOG]: RRD => " << all_exec_rrd.size()
+                             << " workers";
             if (needs_gpu) {
               std::vector<std::string> all_gpu_exec_rrd;
               for (std::string ae : all_exec_rrd) {
@@ -2109,14 +2730,11 @@ private:
                   all_gpu_exec_rrd.push_back(ae);
                 }
               }
-              std::cout << "[LOG]: RRD => Considering "
-                        << all_gpu_exec_rrd.size();
-              std::cout << " GPU workers" << std::endl;
-
-              // Mod counter before, in case number of workers decreased
-              all_exec_gpu_counter_ %= all_gpu_exec_rrd.size();
-              next_worker = all_gpu_exec_rrd[all_exec_gpu_counter_];
-              all_exec_gpu_counter_++;
+              INFAAS_LOG(DEBUG) << "[LOG]: RRD => Considering "
+                                << all_gpu_exec_rrd.size() << " GPU workers";
+
+              next_worker = PickRoundRobin(all_gpu_exec_rrd,
+                                           &all_exec_gpu_counter_);
             } else if (needs_inferentia) {
               std::vector<std::string> all_inferentia_exec_rrd;
               for (std::string ae : all_exec_rrd) {
@@ -2124,40 +2742,29 @@ private:
                   all_inferentia_exec_rrd.push_back(ae);
                 }
               }
-              std::cout << "[LOG]: RRD => Considering "
-                        << all_inferentia_exec_rrd.size();
-              std::cout << " Inferentia workers" << std::endl;
-
-              // Mod counter before, in case number of workers decreased
-              all_exec_inferentia_counter_ %= all_inferentia_exec_rrd.size();
-              next_worker =
-                  all_inferentia_exec_rrd[all_exec_inferentia_counter_];
-              all_exec_inferentia_counter_++;
+              INFAAS_LOG(DEBUG) << "[LOG]: RRD => Considering "
+                                << all_inferentia_exec_rrd.size()
+                                << " Inferentia workers";
+
+              next_worker = PickRoundRobin(all_inferentia_exec_rrd,
+                                           &all_exec_inferentia_counter_);
             } else {
-              // Mod counter before, in case number of workers decreased
-              all_exec_counter_ %= all_exec_rrd.size();
-              next_worker = all_exec_rrd[all_exec_counter_];
-              all_exec_counter_++;
+              next_worker = PickRoundRobin(all_exec_rrd, &all_exec_counter_);
             }
 
-            static_model_worker_map_[model_var] = next_worker;
+            static_model_worker_map_.Set(model_var, next_worker);
           } else { // RR or RR_STATIC
             if (needs_gpu) {
-              next_worker = all_gpu_exec_[all_exec_gpu_counter_];
-              all_exec_gpu_counter_ =
-                  (all_exec_gpu_counter_ + 1) % all_gpu_exec_.size();
+              next_worker = PickRoundRobin(all_gpu_exec_,
+                                           &all_exec_gpu_counter_);
             } else if (needs_inferentia) {
-              next_worker = all_inferentia_exec_[all_exec_inferentia_counter_];
-              all_exec_inferentia_counter_ =
-                  (all_exec_inferentia_counter_ + 1) %
-                  all_inferentia_exec_.size();
+              next_worker = PickRoundRobin(all_inferentia_exec_,
+                                           &all_exec_inferentia_counter_);
             } else {
-              next_worker = all_exec_[all_exec_counter_];
-              all_exec_counter_ = (all_exec_counter_ + 1) % all_exec_.size();
+              next_worker = PickRoundRobin(all_exec_, &all_exec_counter_);
             }
 
-            static_model_worker_map_.insert(
-                std::pair<std::string, std::string>(model_var, next_worker));
+            static_model_worker_map_.Insert(model_var, next_worker);
           }
         }
       } else { // Regular ROUNDROBIN
@@ -2165,37 +2772,31 @@ private:
         std::vector<std::string> all_exec_ = rm_->get_all_executors();
 
         // Pick the next worker and increment the round robin counter
-        next_worker = all_exec_[all_exec_counter_];
-        all_exec_counter_ = (all_exec_counter_ + 1) % all_exec_.size();
+        next_worker = PickRoundRobin(all_exec_, &all_exec_counter_);
       }
     }
 
     // Update last_worker_picked_
-    last_worker_picked_ = next_worker;
+    last_worker_picked_.Store(next_worker);
 
     struct Address dest_addr = rm_->get_executor_addr(next_worker);
 
-    std::cout << "[LOG]: Offline query will be serviced by: ";
-    std::cout << next_worker << " (";
-    std::cout << RedisMetadata::Address_to_str(dest_addr) << ")" << std::endl;
+    INFAAS_LOG(INFO) << "[LOG]: Offline query will be serviced by: "
+                     << next_worker << " ("
+                     << RedisMetadata::Address_to_str(dest_addr) << ")";
 
     // Forward request to worker
-    grpc::ChannelArguments arguments;
-    arguments.SetMaxSendMessageSize(MAX_GRPC_MESSAGE_SIZE);
-    arguments.SetMaxReceiveMessageSize(MAX_GRPC_MESSAGE_SIZE);
-
-    infaas::internal::QueryClient query_client(grpc::CreateCustomChannel(
-        RedisMetadata::Address_to_str(dest_addr),
-        grpc::InsecureChannelCredentials(), arguments));
+    infaas::internal::QueryClient query_client(
+        worker_channels_.GetChannel(next_worker, dest_addr));
     auto worker_reply = query_client.QueryOffline(
         input_url, {model_var}, submitter, output_url, maxcost);
 
     // For logging purposes
-    std::cout << "===================================================="
-              << std::endl;
+    INFAAS_LOG(INFO) << "====================================================";
 
     if (worker_reply.status() !=
         infaas::internal::InfaasRequestStatusEnum::SUCCESS) {
+      worker_channels_.ReportFailure(next_worker);
       rs->set_status(infaaspublic::RequestReplyEnum::INVALID);
       rs->set_msg("Failure to start Offline job");
       return Status::OK;
@@ -2248,8 +2849,8 @@ private:
 
     rs.set_status(infaaspublic::RequestReplyEnum::SUCCESS);
     rs.set_msg("Successful info query");
-    qmir->set_img_dim(std::stoi(rm_->get_model_info(mod_var[0], "img_dim")));
-    qmir->set_accuracy(rm_->get_accuracy(mod_var[0]));
+    qmir->set_img_dim(std::stoi(mc_->get_model_info(mod_var[0], "img_dim")));
+    qmir->set_accuracy(mc_->get_accuracy(mod_var[0]));
     qmir->mutable_status()->CopyFrom(rs);
 
     // Copy all mod_var
@@ -2276,79 +2877,397 @@ private:
   // Private variables
   const struct Address redis_addr_;
   std::unique_ptr<RedisMetadata> rm_;
+  std::unique_ptr<MetadataCache> mc_;
+  // Sorted, parsed view of mc_'s variant metadata for the SLO searches
+  std::unique_ptr<infaas::internal::VariantIndex> variant_index_;
 
-  std::deque<std::string> gmod_cache_;
+  // Everything below is shared by all handler threads; see frontend_state.h.
+  infaas::internal::MruList gmod_cache_;
 
-  std::string last_worker_picked_;
-  std::map<std::string, std::string> static_model_worker_map_;
+  infaas::internal::EpochPtr<std::string> last_worker_picked_;
+  infaas::internal::ShardedMap<std::string> static_model_worker_map_;
 
   MasterDecisions master_decision_;
-  int16_t all_exec_counter_;
-  int16_t all_exec_gpu_counter_;
-  int16_t all_exec_inferentia_counter_;
+  infaas::internal::RoundRobinCounter all_exec_counter_;
+  infaas::internal::RoundRobinCounter all_exec_gpu_counter_;
+  infaas::internal::RoundRobinCounter all_exec_inferentia_counter_;
+  // Filled once in the constructor and read-only afterwards
   std::vector<std::string> all_exec_;
   std::vector<std::string> all_gpu_exec_;
   std::vector<std::string> all_inferentia_exec_;
 
-  std::set<std::string> cpu_blist_;
+  infaas::internal::ShardedMap<bool> cpu_blist_;
 
-  std::map<
-      std::string,
-      std::pair<std::chrono::time_point<std::chrono::system_clock>, int16_t>>
-      qps_worker_scaler_;
+  // Online queries currently running on a worker, by coalesce_key
+  infaas::internal::SingleFlight<WorkerOutcome> inflight_queries_;
 
-  std::map<
-      std::string,
-      std::pair<std::chrono::time_point<std::chrono::system_clock>, int16_t>>
-      variant_qps_tracker_;
+  // Per-worker EDF queues that hold online queries back from busy workers
+  infaas::internal::AdmissionQueue admission_;
+  // In-flight queries per worker, for POWEROFDCHOICES and hedging
+  infaas::internal::WorkerLoad worker_load_;
+  // Recent worker call latencies per variant, and the share of extra calls
+  // hedging may add
+  infaas::internal::LatencyWindow latency_window_;
+  infaas::internal::HedgeBudget hedge_budget_;
 
-  std::map<std::string, std::string> model_to_exclusive_;
+  // Burst counters: requests seen since `first` within the scale interval
+  struct BurstState {
+    std::chrono::time_point<std::chrono::system_clock> first;
+    int16_t count = 0;
+  };
+  infaas::internal::ShardedMap<BurstState> qps_worker_scaler_;
+  infaas::internal::ShardedMap<BurstState> variant_qps_tracker_;
+
+  infaas::internal::ShardedMap<std::string> model_to_exclusive_;
 
   int16_t slack_gpu_;
+
+  infaas::internal::WorkerChannelPool worker_channels_;
+
+  // Runs the metadata lookups of route_online and hedge_target off the
+  // completion-queue threads
+  infaas::internal::TaskPool routing_pool_;
+};
+
+// Completion-queue tag for AsyncNotifyWhenDone: hands the event to its call
+class DoneTag final : public CallDataBase {
+public:
+  explicit DoneTag(std::function<void()> on_done) : on_done_(on_done) {}
+  void Proceed(bool) override { on_done_(); }
+
+private:
+  std::function<void()> on_done_;
+};
+
+// Per-RPC state machine for the asynchronous frontend. Each object owns the
+// context, request and reply of exactly one call. It first asks the async
+// service for a new call (CREATE), runs the matching QueryServiceImpl handler
+// once the call arrives (PROCESS), and deletes itself once Finish has
+// completed (FINISH) and gRPC has reported the call done. A fresh object is
+// spawned on PROCESS so the queue always has an outstanding request for that
+// RPC. Asking to be told when the call is done is also what makes
+// ServerContext::IsCancelled safe to call on an asynchronous call.
+template <typename RequestT, typename ResponseT>
+class CallData final : public CallDataBase {
+public:
+  typedef std::function<void(ServerContext *, RequestT *,
+                             ServerAsyncResponseWriter<ResponseT> *,
+                             ServerCompletionQueue *, void *)>
+      RequestFn;
+  typedef std::function<Status(ServerContext *, const RequestT *, ResponseT *)>
+      HandlerFn;
+
+  CallData(ServerCompletionQueue *cq, RequestFn request_fn,
+           HandlerFn handler_fn)
+      : cq_(cq), request_fn_(request_fn), handler_fn_(handler_fn),
+        responder_(&ctx_), status_(CREATE), pending_(2),
+        done_tag_([this] { Release(); }) {
+    Proceed(true);
+  }
+
+  void Proceed(bool ok) override {
+    if (status_ == CREATE) {
+      status_ = PROCESS;
+      ctx_.AsyncNotifyWhenDone(&done_tag_);
+      request_fn_(&ctx_, &request_, &responder_, cq_, this);
+    } else if (status_ == PROCESS) {
+      // The queue is shutting down: no call was matched to this tag, and
+      // none will be reported done.
+      if (!ok) {
+        delete this;
+        return;
+      }
+      new CallData<RequestT, ResponseT>(cq_, request_fn_, handler_fn_);
+
+      Status rpc_status = handler_fn_(&ctx_, &request_, &reply_);
+      status_ = FINISH;
+      responder_.Finish(reply_, rpc_status, this);
+    } else {
+      Release();
+    }
+  }
+
+private:
+  enum CallStatus { CREATE, PROCESS, FINISH };
+
+  // Called for the FINISH and done events; the second one deletes the call
+  void Release() {
+    if (pending_.fetch_sub(1) == 1) { delete this; }
+  }
+
+  ServerCompletionQueue *cq_;
+  RequestFn request_fn_;
+  HandlerFn handler_fn_;
+
+  ServerContext ctx_;
+  RequestT request_;
+  ResponseT reply_;
+  ServerAsyncResponseWriter<ResponseT> responder_;
+  CallStatus status_;
+  std::atomic<int> pending_;
+  DoneTag done_tag_;
+};
+
+// The unary RPCs are served from the completion queues. QueryOnlineStream
+// blocks its thread for a whole generation, so it stays synchronous and runs
+// on gRPC's own thread pool instead of holding up a completion queue.
+typedef Query::WithAsyncMethod_QueryOnline<
+    Query::WithAsyncMethod_QueryOffline<Query::WithAsyncMethod_AllParentInfo<
+        Query::WithAsyncMethod_QueryModelInfo<
+            Query::WithAsyncMethod_Heartbeat<Query::Service>>>>>
+    FrontendServiceBase;
+
+class FrontendService final : public FrontendServiceBase {
+public:
+  explicit FrontendService(Query::Service *impl) : impl_(impl) {}
+
+  Status QueryOnlineStream(ServerContext *context,
+                           const QueryOnlineRequest *request,
+                           ServerWriter<QueryOnlineProgress> *writer) override {
+    return impl_->QueryOnlineStream(context, request, writer);
+  }
+
+private:
+  Query::Service *impl_;
+};
+
+// QueryOnline's state machine. Unlike CallData it does not run a handler to
+// completion on PROCESS: it hands the call to QueryServiceImpl as an
+// OnlineQuery that lives on worker_cq, and the query replies through it
+// from there once it is served. It is deleted like CallData; a client that
+// goes away first cancels the query.
+class OnlineCall final : public CallDataBase {
+public:
+  OnlineCall(FrontendService *async_service, QueryServiceImpl *impl,
+             ServerCompletionQueue *cq, grpc::CompletionQueue *worker_cq)
+      : async_service_(async_service), impl_(impl), cq_(cq),
+        worker_cq_(worker_cq), responder_(&ctx_), status_(CREATE),
+        pending_(2), done_tag_([this] { OnDone(); }) {
+    Proceed(true);
+  }
+
+  void Proceed(bool ok) override {
+    if (status_ == CREATE) {
+      status_ = PROCESS;
+      ctx_.AsyncNotifyWhenDone(&done_tag_);
+      async_service_->RequestQueryOnline(&ctx_, &request_, &responder_, cq_,
+                                         cq_, this);
+    } else if (status_ == PROCESS) {
+      // The queue is shutting down: no call was matched to this tag, and
+      // none will be reported done.
+      if (!ok) {
+        delete this;
+        return;
+      }
+      new OnlineCall(async_service_, impl_, cq_, worker_cq_);
+
+      status_ = FINISH;
+      query_ = std::make_shared<OnlineQuery>();
+      query_->context = &ctx_;
+      query_->request = &request_;
+      query_->reply = &reply_;
+      query_->cq = worker_cq_;
+      query_->respond = [this](const Status &rpc_status) {
+        responder_.Finish(reply_, rpc_status, this);
+      };
+      impl_->StartQueryOnline(query_);
+    } else {
+      Release();
+    }
+  }
+
+private:
+  enum CallStatus { CREATE, PROCESS, FINISH };
+
+  void OnDone() {
+    if (ctx_.IsCancelled()) { impl_->CancelQueryOnline(query_); }
+    Release();
+  }
+
+  // Called for the FINISH and done events; the second one deletes the call
+  void Release() {
+    if (pending_.fetch_sub(1) == 1) { delete this; }
+  }
+
+  FrontendService *async_service_;
+  QueryServiceImpl *impl_;
+  ServerCompletionQueue *cq_;
+  grpc::CompletionQueue *worker_cq_;
+
+  ServerContext ctx_;
+  QueryOnlineRequest request_;
+  QueryOnlineResponse reply_;
+  ServerAsyncResponseWriter<QueryOnlineResponse> responder_;
+  CallStatus status_;
+  std::atomic<int> pending_;
+  DoneTag done_tag_;
+  std::shared_ptr<OnlineQuery> query_;
 };
 
+// Registers one outstanding call per unary RPC on the given completion
+// queue. The handlers are the ones in QueryServiceImpl, reached through the
+// public Query::Service interface; QueryOnline's queries continue on
+// worker_cq, where their worker calls complete.
+void SpawnCallData(FrontendService *async_service, QueryServiceImpl *impl,
+                   ServerCompletionQueue *cq,
+                   grpc::CompletionQueue *worker_cq) {
+  new OnlineCall(async_service, impl, cq, worker_cq);
+
+  Query::Service *service = impl;
+
+  new CallData<QueryOfflineRequest, QueryOfflineResponse>(
+      cq,
+      [async_service](ServerContext *ctx, QueryOfflineRequest *req,
+                      ServerAsyncResponseWriter<QueryOfflineResponse> *resp,
+                      ServerCompletionQueue *q, void *tag) {
+        async_service->RequestQueryOffline(ctx, req, resp, q, q, tag);
+      },
+      [service](ServerContext *ctx, const QueryOfflineRequest *req,
+             QueryOfflineResponse *reply) {
+        return service->QueryOffline(ctx, req, reply);
+      });
+
+  new CallData<AllParRequest, AllParResponse>(
+      cq,
+      [async_service](ServerContext *ctx, AllParRequest *req,
+                      ServerAsyncResponseWriter<AllParResponse> *resp,
+                      ServerCompletionQueue *q, void *tag) {
+        async_service->RequestAllParentInfo(ctx, req, resp, q, q, tag);
+      },
+      [service](ServerContext *ctx, const AllParRequest *req,
+             AllParResponse *reply) {
+        return service->AllParentInfo(ctx, req, reply);
+      });
+
+  new CallData<QueryModelInfoRequest, QueryModelInfoResponse>(
+      cq,
+      [async_service](ServerContext *ctx, QueryModelInfoRequest *req,
+                      ServerAsyncResponseWriter<QueryModelInfoResponse> *resp,
+                      ServerCompletionQueue *q, void *tag) {
+        async_service->RequestQueryModelInfo(ctx, req, resp, q, q, tag);
+      },
+      [service](ServerContext *ctx, const QueryModelInfoRequest *req,
+             QueryModelInfoResponse *reply) {
+        return service->QueryModelInfo(ctx, req, reply);
+      });
+
+  new CallData<HeartbeatRequest, HeartbeatResponse>(
+      cq,
+      [async_service](ServerContext *ctx, HeartbeatRequest *req,
+                      ServerAsyncResponseWriter<HeartbeatResponse> *resp,
+                      ServerCompletionQueue *q, void *tag) {
+        async_service->RequestHeartbeat(ctx, req, resp, q, q, tag);
+      },
+      [service](ServerContext *ctx, const HeartbeatRequest *req,
+             HeartbeatResponse *reply) {
+        return service->Heartbeat(ctx, req, reply);
+      });
+}
+
+// Drains one completion queue until it is shut down.
+void HandleRpcs(grpc::CompletionQueue *cq) {
+  void *tag;
+  bool ok;
+  while (cq->Next(&tag, &ok)) {
+    static_cast<CallDataBase *>(tag)->Proceed(ok);
+  }
+}
+
 } // namespace infaasqueryfe
 } // namespace infaaspublic
 
 void RunQueryFEServer(const struct Address &redis_addr,
-                      const int8_t decision_policy, const int16_t slack_gpu) {
+                      const int8_t decision_policy, const int16_t slack_gpu,
+                      const int16_t num_cqs, const double hedge_budget,
+                      const int16_t admission_slots) {
   std::string server_address("0.0.0.0:50052");
   infaaspublic::infaasqueryfe::QueryServiceImpl service(
-      redis_addr, decision_policy, slack_gpu);
+      redis_addr, decision_policy, slack_gpu, hedge_budget, admission_slots,
+      num_cqs * routing_threads_per_cq);
+  infaaspublic::infaasqueryfe::FrontendService async_service(&service);
 
   ServerBuilder builder;
   // Listen on the given address without any authentication mechanism.
   builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
-  // Register "service" as the instance through which we'll communicate with
-  // clients. In this case it corresponds to an *synchronous* service.
-  builder.RegisterService(&service);
+  // Register the service; all but the streaming RPC are *asynchronous* and
+  // dispatched from the completion queues below to the handlers in "service".
+  builder.RegisterService(&async_service);
 
   // Set max message size.
   builder.SetMaxMessageSize(MAX_GRPC_MESSAGE_SIZE);
 
+  std::vector<std::unique_ptr<ServerCompletionQueue>> cqs;
+  for (int16_t i = 0; i < num_cqs; ++i) {
+    cqs.push_back(builder.AddCompletionQueue());
+  }
+
   // Finally assemble the server.
   std::unique_ptr<Server> server(builder.BuildAndStart());
-  std::cout << "Server listening on " << server_address << std::endl;
+  std::cout << "Server listening on " << server_address << " with "
+            << num_cqs << " completion queues" << std::endl;
+
+  // One thread per completion queue, each with its own set of pending calls.
+  // Every server queue is paired with a queue of its own for the worker
+  // calls, waits and resumptions of its online queries, also with one
+  // thread.
+  std::vector<std::unique_ptr<grpc::CompletionQueue>> worker_cqs;
+  std::vector<std::thread> cq_threads;
+  std::vector<std::thread> worker_cq_threads;
+  for (auto &cq : cqs) {
+    worker_cqs.emplace_back(new grpc::CompletionQueue);
+    infaaspublic::infaasqueryfe::SpawnCallData(&async_service, &service,
+                                               cq.get(),
+                                               worker_cqs.back().get());
+    cq_threads.push_back(
+        std::thread(&infaaspublic::infaasqueryfe::HandleRpcs, cq.get()));
+    worker_cq_threads.push_back(std::thread(
+        &infaaspublic::infaasqueryfe::HandleRpcs, worker_cqs.back().get()));
+  }
 
   // Wait for the server to shutdown. Note that some other thread must be
   // responsible for shutting down the server for this call to ever return.
   server->Wait();
+
+  for (auto &cq : cqs) {
+    cq->Shutdown();
+  }
+  for (auto &t : cq_threads) {
+    t.join();
+  }
+  service.StopRouting();
+  for (auto &cq : worker_cqs) {
+    cq->Shutdown();
+  }
+  for (auto &t : worker_cq_threads) {
+    t.join();
+  }
 }
 
 int main(int argc, char **argv) {
   if (argc < 4) {
     std::cout << "Usage: ./queryfe_server <redis_ip> <redis_port> ";
-    std::cout << "<decision_policy> [slack-gpu]" << std::endl;
+    std::cout << "<decision_policy> [slack-gpu] [num-cqs] [log-level] ";
+    std::cout << "[hedge-budget] [admission-slots]" << std::endl;
     // IMPORTANT: it is assumed that slack-gpu is valid from start_infaas
     // Example: INFaaS starts with 4 GPUs, up to 3 can be slack.
     std::cout << "slack-gpu: number of slack GPUs to use for exclusively ";
     std::cout << "running popular models on GPU. Default is 0 ";
     std::cout << "(i.e., no GPUs used for exclusive)" << std::endl;
+    std::cout << "num-cqs: number of completion queues, each served by ";
+    std::cout << "its own thread. Default is " << default_num_cqs << std::endl;
+    std::cout << "log-level: debug, info, warn, error or off. Default is ";
+    std::cout << "$INFAAS_LOG_LEVEL, or info" << std::endl;
+    std::cout << "hedge-budget: extra worker calls hedging may add, as a ";
+    std::cout << "fraction of all calls (e.g. 0.05). Default is 0 ";
+    std::cout << "(no hedging)" << std::endl;
+    std::cout << "admission-slots: online queries let run on one worker at ";
+    std::cout << "once; the others queue. Default is "
+              << default_admission_slots << std::endl;
     std::cout << "decision_policy: 0=INFAAS_ALL, 1=INFAAS_NOQPSLAT, ";
     std::cout << "2=ROUNDROBIN, 3=ROUNDROBIN_STATIC, ";
     std::cout << "4=GPUSHARETRIGGER, 5=CPUBLISTCHECK, ";
-    std::cout << "6=GPUSHARETRIGGER_SKIPBLIST, 7=ROUNDROBIN_DYNAMIC";
-    std::cout << std::endl;
+    std::cout << "6=GPUSHARETRIGGER_SKIPBLIST, 7=ROUNDROBIN_DYNAMIC, ";
+    std::cout << "8=POWEROFDCHOICES" << std::endl;
 
     std::cout << "INFAAS_ALL: Use all features of INFAAS" << std::endl;
     std::cout << "INFAAS_NOQPSLAT: Only consider if model is running, ";
@@ -2369,6 +3288,9 @@ int main(int argc, char **argv) {
     std::cout << "ROUNDROBIN_DYNAMIC: Same as ROUNDROBIN_STATIC, ";
     std::cout << "but updates worker using round-robin if the ";
     std::cout << "worker gets blacklisted" << std::endl;
+    std::cout << "POWEROFDCHOICES: Same as INFAAS_ALL, but sends to the ";
+    std::cout << "least loaded of " << pod_choices << " random replicas, ";
+    std::cout << "by queries in flight" << std::endl;
     return 1;
   }
 
@@ -2381,11 +3303,48 @@ int main(int argc, char **argv) {
   const int8_t decision_policy = std::stoi(argv[3]);
 
   int16_t slack_gpu = 0;
-  if (argc == 5) {
+  if (argc >= 5) {
     slack_gpu = std::stoi(argv[4]);
   }
 
-  RunQueryFEServer(redis_addr, decision_policy, slack_gpu);
+  int16_t num_cqs = default_num_cqs;
+  if (argc >= 6) {
+    num_cqs = std::stoi(argv[5]);
+    if (num_cqs < 1) {
+      std::cout << "num-cqs must be at least 1" << std::endl;
+      return 1;
+    }
+  }
+
+  if (argc >= 7) {
+    infaas::internal::LogLevel log_level;
+    if (!infaas::internal::ParseLogLevel(argv[6], &log_level)) {
+      std::cout << "Invalid log-level: " << argv[6] << std::endl;
+      return 1;
+    }
+    infaas::internal::SetLogLevel(log_level);
+  }
+
+  double hedge_budget = 0.0;
+  if (argc >= 8) {
+    hedge_budget = std::stod(argv[7]);
+    if ((hedge_budget < 0.0) || (hedge_budget > 1.0)) {
+      std::cout << "hedge-budget must be between 0 and 1" << std::endl;
+      return 1;
+    }
+  }
+
+  int16_t admission_slots = default_admission_slots;
+  if (argc >= 9) {
+    admission_slots = std::stoi(argv[8]);
+    if (admission_slots < 1) {
+      std::cout << "admission-slots must be at least 1" << std::endl;
+      return 1;
+    }
+  }
+
+  RunQueryFEServer(redis_addr, decision_policy, slack_gpu, num_cqs,
+                   hedge_budget, admission_slots);
 
   return 0;
 }
@@ -0,0 +1,252 @@
+/*
+ * Copyright 2018-2021 Board of Trustees of Stanford University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "common/async_log.h"
+#include "variant_index.h"
+
+namespace infaas {
+namespace internal {
+
+namespace {
+
+// Parses a number written by add_model. Returns false on "FAIL" or garbage
+bool ParseNumber(const std::string& s, double* value) {
+  if (s.empty() || (s == "FAIL")) { return false; }
+  char* end = nullptr;
+  *value = strtod(s.c_str(), &end);
+  return (end != s.c_str()) && (*end == '\0');
+}
+
+// Same bin rule as RedisMetadata::add_model
+int8_t AccuracyBin(const double accuracy) {
+  int8_t i;
+  for (i = 0; i < (num_gpar_bins - 1); ++i) {
+    if ((accuracy >= gpar_accuracy_bins[i]) &&
+        (accuracy <= gpar_accuracy_bins[i + 1])) {
+      break;
+    }
+  }
+  return i;
+}
+
+}  // namespace
+
+int64_t VariantTable::Find(const std::string& model_name) const {
+  auto it = rows.find(model_name);
+  return (it == rows.end()) ? -1 : it->second;
+}
+
+VariantIndex::VariantIndex(RedisMetadata* rm, MetadataCache* mc,
+                           const int refresh_ms)
+    : rm_(rm), mc_(mc), refresh_(refresh_ms) {}
+
+std::shared_ptr<const VariantTable> VariantIndex::Grandparent(
+    const std::string& gparent_model) {
+  return Lookup("g:" + gparent_model, gparent_model, true);
+}
+
+std::shared_ptr<const VariantTable> VariantIndex::Parent(
+    const std::string& parent_model) {
+  return Lookup("p:" + parent_model, parent_model, false);
+}
+
+void VariantIndex::AccuracySearch(const VariantTable& table,
+                                  const double min_acc,
+                                  const int16_t batch_size,
+                                  const double max_lat,
+                                  std::vector<VariantMatch>* matches) {
+  matches->clear();
+  auto first = std::lower_bound(table.accuracy.begin(), table.accuracy.end(),
+                                min_acc);
+  if (first == table.accuracy.end()) { return; }
+
+  // Accuracy order is also bin order, so the bin to search is the bin of the
+  // first qualifying row, and it ends where the next bin starts.
+  const size_t begin = first - table.accuracy.begin();
+  const int8_t bin = table.acc_bin[begin];
+  size_t end = begin;
+  while ((end < table.size()) && (table.acc_bin[end] == bin)) { ++end; }
+
+  Scan(table, begin, end, batch_size, max_lat, matches);
+}
+
+std::vector<uint32_t> VariantIndex::LatencyRange(const VariantTable& table,
+                                                 const double min_lat,
+                                                 const double max_lat,
+                                                 const size_t max_results) {
+  std::vector<uint32_t> rows;
+  auto first =
+      std::lower_bound(table.inf_lat.begin(), table.inf_lat.end(), min_lat);
+  for (size_t r = first - table.inf_lat.begin();
+       (r < table.size()) && (table.inf_lat[r] <= max_lat) &&
+       (rows.size() < max_results);
+       ++r) {
+    rows.push_back(r);
+  }
+  return rows;
+}
+
+void VariantIndex::Scan(const VariantTable& table, const size_t begin,
+                        const size_t end, const int16_t batch_size,
+                        const double max_lat,
+                        std::vector<VariantMatch>* matches) {
+  matches->clear();
+  if (begin >= end) { return; }
+  const double bound =
+      (max_lat > 0.0) ? max_lat : std::numeric_limits<double>::infinity();
+  const double batch = batch_size;
+
+  // First pass has no branches or stores into the output so the compiler can
+  // vectorize it; the second compacts the rows that passed.
+  thread_local std::vector<double> lat;
+  lat.resize(end - begin);
+  const double* slope = table.slope.data() + begin;
+  const double* intercept = table.intercept.data() + begin;
+  const int16_t* max_batch = table.max_batch.data() + begin;
+  for (size_t i = 0; i < lat.size(); ++i) {
+    const double b = (max_batch[i] > 64) ? batch
+                                         : std::min(32.0, (double)max_batch[i]);
+    lat[i] = slope[i] * b + intercept[i];
+  }
+  for (size_t i = 0; i < lat.size(); ++i) {
+    if ((max_batch[i] >= batch_size) && (lat[i] > 0.0) && (lat[i] <= bound)) {
+      matches->push_back({(uint32_t)(begin + i), lat[i]});
+    }
+  }
+}
+
+/*********************** Private Functions ***********************/
+
+bool VariantIndex::Fresh(const Entry& entry, const uint64_t epoch) const {
+  if (mc_->enabled()) { return entry.epoch == epoch; }
+  return (std::chrono::steady_clock::now() - entry.built) < refresh_;
+}
+
+std::shared_ptr<const VariantTable> VariantIndex::Lookup(
+    const std::string& key, const std::string& group, const bool is_gparent) {
+  Entry entry;
+  uint64_t epoch = mc_->epoch();
+  if (tables_.Get(key, &entry) && Fresh(entry, epoch)) { return entry.table; }
+
+  std::shared_ptr<std::mutex> build_mutex = BuildMutex(key);
+  std::lock_guard<std::mutex> lock(*build_mutex);
+  // Someone else may have rebuilt it while we waited
+  epoch = mc_->epoch();
+  if (tables_.Get(key, &entry) && Fresh(entry, epoch)) { return entry.table; }
+
+  std::vector<std::string> variants =
+      is_gparent ? rm_->get_all_gpar_variants(group)
+                 : rm_->get_all_model_variants(group);
+  entry.table = Build(variants, is_gparent);
+  // Tagged with the epoch read before the build, so an invalidation that
+  // races with it forces another build next time.
+  entry.epoch = epoch;
+  entry.built = std::chrono::steady_clock::now();
+  tables_.Set(key, entry);
+
+  INFAAS_LOG(INFO) << "[LOG]: Indexed " << entry.table->size()
+                   << " variants of " << group;
+  return entry.table;
+}
+
+std::shared_ptr<std::mutex> VariantIndex::BuildMutex(const std::string& key) {
+  std::lock_guard<std::mutex> lock(build_mutexes_mutex_);
+  std::shared_ptr<std::mutex>& build_mutex = build_mutexes_[key];
+  if (!build_mutex) { build_mutex = std::make_shared<std::mutex>(); }
+  return build_mutex;
+}
+
+std::shared_ptr<const VariantTable> VariantIndex::Build(
+    const std::vector<std::string>& variants, const bool by_accuracy) {
+  struct Row {
+    std::string name;
+    double accuracy, slope, intercept, max_batch, peak_memory;
+    double load_lat, inf_lat;
+    std::string framework;
+  };
+
+  std::vector<Row> rows;
+  rows.reserve(variants.size());
+  for (const std::string& v : variants) {
+    Row row;
+    row.name = v;
+    row.framework = mc_->get_model_info(v, "framework");
+    row.accuracy = mc_->get_accuracy(v);
+    row.load_lat = mc_->get_load_lat(v);
+    row.inf_lat = mc_->get_inf_lat(v);
+    if ((row.framework == "FAIL") || (row.accuracy < 0.0) ||
+        (row.load_lat < 0.0) || (row.inf_lat < 0.0) ||
+        !ParseNumber(mc_->get_model_info(v, "max_batch"), &row.max_batch) ||
+        !ParseNumber(mc_->get_model_info(v, "slope"), &row.slope) ||
+        !ParseNumber(mc_->get_model_info(v, "intercept"), &row.intercept) ||
+        !ParseNumber(mc_->get_model_info(v, "peak_memory"),
+                     &row.peak_memory)) {
+      // Half-registered or being deleted; leave it out of this build
+      INFAAS_LOG(WARN) << "[LOG]: Incomplete metadata for " << v
+                       << ", not indexed";
+      continue;
+    }
+    rows.push_back(row);
+  }
+
+  std::sort(rows.begin(), rows.end(), [by_accuracy](const Row& a, const Row& b) {
+    const double ka = by_accuracy ? a.accuracy : a.inf_lat;
+    const double kb = by_accuracy ? b.accuracy : b.inf_lat;
+    return (ka < kb) || ((ka == kb) && (a.name < b.name));
+  });
+
+  std::shared_ptr<VariantTable> table = std::make_shared<VariantTable>();
+  const size_t n = rows.size();
+  table->name.reserve(n);
+  table->accuracy.reserve(n);
+  table->slope.reserve(n);
+  table->intercept.reserve(n);
+  table->max_batch.reserve(n);
+  table->framework.reserve(n);
+  table->peak_memory.reserve(n);
+  table->load_lat.reserve(n);
+  table->inf_lat.reserve(n);
+  table->acc_bin.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    const Row& row = rows[i];
+    table->name.push_back(row.name);
+    table->accuracy.push_back(row.accuracy);
+    table->slope.push_back(row.slope);
+    table->intercept.push_back(row.intercept);
+    table->max_batch.push_back((int16_t)row.max_batch);
+    table->framework.push_back(row.framework);
+    table->peak_memory.push_back(row.peak_memory);
+    table->load_lat.push_back(row.load_lat);
+    table->inf_lat.push_back(row.inf_lat);
+    table->acc_bin.push_back(AccuracyBin(row.accuracy));
+    table->rows[row.name] = i;
+  }
+  return table;
+}
+
+}  // namespace internal
+}  // namespace infaas
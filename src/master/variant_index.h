@@ -0,0 +1,159 @@
+/*
+ * Copyright 2018-2021 Board of Trustees of Stanford University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef VARIANT_INDEX_H
+#define VARIANT_INDEX_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "frontend_state.h"
+#include "metadata-store/metadata_cache.h"
+#include "metadata-store/redis_metadata.h"
+
+namespace infaas {
+namespace internal {
+
+// Registration metadata of a group of model variants, kept column by column
+// so a search only reads the numbers it filters on. Grandparent tables are in
+// ascending accuracy order and parent tables in ascending batch-1 inference
+// latency, the same order as the Redis sorted sets they stand in for (ties
+// broken by name, as Redis does).
+struct VariantTable {
+  std::vector<std::string> name;
+  std::vector<double> accuracy;
+  std::vector<double> slope;
+  std::vector<double> intercept;
+  std::vector<int16_t> max_batch;
+  std::vector<std::string> framework;
+  std::vector<double> peak_memory;
+  std::vector<double> load_lat;
+  std::vector<double> inf_lat;   // Batch-1
+  std::vector<int8_t> acc_bin;   // Grandparent accuracy bin
+
+  std::unordered_map<std::string, uint32_t> rows;
+
+  size_t size() const { return name.size(); }
+
+  // Row of a variant, or -1 if it is not in this table
+  int64_t Find(const std::string& model_name) const;
+
+  // Inference latency at batch_size from the slope and intercept measured at
+  // registration. CPU variants (max_batch > 64) run the whole batch; the
+  // others were profiled up to batch 32.
+  double PredictLatency(const uint32_t row, const int16_t batch_size) const {
+    const double batch =
+        (max_batch[row] > 64)
+            ? (double)batch_size
+            : (double)std::min((int16_t)32, max_batch[row]);
+    return slope[row] * batch + intercept[row];
+  }
+};
+
+// A row that passed a search and its predicted latency.
+struct VariantMatch {
+  uint32_t row;
+  double inf_lat;
+};
+
+// In-memory index over the static metadata of registered variants, so the
+// frontend answers "which variants meet accuracy A and latency L at batch B"
+// with a binary search and a scan over a few arrays instead of one Redis
+// lookup and string parse per candidate.
+//
+// Tables are built on first use per grandparent/parent and rebuilt when the
+// MetadataCache reports an invalidation (a variant was added or deleted). If
+// the cache has no keyspace notifications, tables are rebuilt after
+// refresh_ms instead.
+class VariantIndex {
+public:
+  VariantIndex(RedisMetadata* rm, MetadataCache* mc,
+               const int refresh_ms = 1000);
+
+  // Never null; the table is empty if the group has no variants or the
+  // lookup failed.
+  std::shared_ptr<const VariantTable> Grandparent(
+      const std::string& gparent_model);
+  std::shared_ptr<const VariantTable> Parent(const std::string& parent_model);
+
+  // Rows of a grandparent table in the lowest accuracy bin holding a variant
+  // with accuracy >= min_acc (the bin RedisMetadata::gpar_acc_bin searches),
+  // in accuracy order, that support batch_size and are predicted to finish
+  // within max_lat. max_lat <= 0 means no latency bound.
+  static void AccuracySearch(const VariantTable& table, const double min_acc,
+                             const int16_t batch_size, const double max_lat,
+                             std::vector<VariantMatch>* matches);
+
+  // Rows of a parent table with batch-1 inference latency in
+  // [min_lat, max_lat], fastest first, at most max_results (the same rows as
+  // RedisMetadata::inf_lat_bin).
+  static std::vector<uint32_t> LatencyRange(const VariantTable& table,
+                                            const double min_lat,
+                                            const double max_lat,
+                                            const size_t max_results);
+
+  // Rows in [begin, end) that support batch_size and are predicted to finish
+  // within max_lat, in table order.
+  static void Scan(const VariantTable& table, const size_t begin,
+                   const size_t end, const int16_t batch_size,
+                   const double max_lat, std::vector<VariantMatch>* matches);
+
+private:
+  struct Entry {
+    std::shared_ptr<const VariantTable> table;
+    uint64_t epoch;
+    std::chrono::steady_clock::time_point built;
+  };
+
+  std::shared_ptr<const VariantTable> Lookup(const std::string& key,
+                                             const std::string& group,
+                                             const bool is_gparent);
+  bool Fresh(const Entry& entry, const uint64_t epoch) const;
+  std::shared_ptr<const VariantTable> Build(
+      const std::vector<std::string>& variants, const bool by_accuracy);
+
+  RedisMetadata* rm_;
+  MetadataCache* mc_;
+  const std::chrono::milliseconds refresh_;
+
+  // Mutex serializing the builds of one table
+  std::shared_ptr<std::mutex> BuildMutex(const std::string& key);
+
+  ShardedMap<Entry> tables_;
+  // Per table, so concurrent misses on a group wait for the first build while
+  // lookups and builds of other groups go ahead. Entries are never removed;
+  // there is one per registered grandparent and parent.
+  std::mutex build_mutexes_mutex_;
+  std::unordered_map<std::string, std::shared_ptr<std::mutex>>
+      build_mutexes_;
+};
+
+}  // namespace internal
+}  // namespace infaas
+
+#endif
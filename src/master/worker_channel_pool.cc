@@ -0,0 +1,134 @@
+/*
+ * Copyright 2018-2021 Board of Trustees of Stanford University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "worker_channel_pool.h"
+
+using grpc::Channel;
+
+static const int MAX_GRPC_MESSAGE_SIZE = INT32_MAX;
+
+namespace infaas {
+namespace internal {
+namespace {
+bool same_address(const struct Address& a, const struct Address& b) {
+  return (a.ip == b.ip) && (a.port == b.port);
+}
+
+bool channel_dead(const std::shared_ptr<Channel>& channel) {
+  grpc_connectivity_state state = channel->GetState(false);
+  return (state == GRPC_CHANNEL_TRANSIENT_FAILURE) ||
+         (state == GRPC_CHANNEL_SHUTDOWN);
+}
+
+}  // namespace
+
+WorkerChannelPool::WorkerChannelPool(const int16_t channels_per_worker)
+    : channels_per_worker_(channels_per_worker > 0 ? channels_per_worker : 1) {
+}
+
+grpc::ChannelArguments WorkerChannelPool::DefaultChannelArguments() {
+  grpc::ChannelArguments arguments;
+  arguments.SetMaxSendMessageSize(MAX_GRPC_MESSAGE_SIZE);
+  arguments.SetMaxReceiveMessageSize(MAX_GRPC_MESSAGE_SIZE);
+  return arguments;
+}
+
+std::shared_ptr<Channel> WorkerChannelPool::NewChannel(
+    const struct Address& addr) {
+  grpc::ChannelArguments arguments = DefaultChannelArguments();
+  // Without a local subchannel pool, channels with identical arguments to the
+  // same target would share one connection.
+  arguments.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+  std::shared_ptr<Channel> channel =
+      grpc::CreateCustomChannel(RedisMetadata::Address_to_str(addr),
+                                grpc::InsecureChannelCredentials(), arguments);
+  // Start connecting now so the first request does not pay the handshake.
+  channel->GetState(true);
+  return channel;
+}
+
+std::shared_ptr<Channel> WorkerChannelPool::GetChannel(
+    const std::string& worker_name, const struct Address& addr) {
+  std::lock_guard<std::mutex> lock(pool_mutex_);
+  auto it = workers_.find(worker_name);
+  if ((it != workers_.end()) && !same_address(it->second.addr, addr)) {
+    std::cout << "[LOG]: " << worker_name << " moved to "
+              << RedisMetadata::Address_to_str(addr)
+              << "; rebuilding its channels" << std::endl;
+    workers_.erase(it);
+    it = workers_.end();
+  }
+  if (it == workers_.end()) {
+    WorkerChannels wc;
+    wc.addr = addr;
+    wc.next = 0;
+    for (int16_t i = 0; i < channels_per_worker_; ++i) {
+      wc.channels.push_back(NewChannel(addr));
+    }
+    it = workers_.insert(std::make_pair(worker_name, wc)).first;
+  }
+
+  WorkerChannels& wc = it->second;
+  uint32_t idx = wc.next;
+  wc.next = (wc.next + 1) % wc.channels.size();
+  if (wc.channels[idx]->GetState(false) == GRPC_CHANNEL_SHUTDOWN) {
+    wc.channels[idx] = NewChannel(addr);
+  }
+  return wc.channels[idx];
+}
+
+std::shared_ptr<Channel> WorkerChannelPool::GetChannel(
+    const struct Address& addr) {
+  return GetChannel(RedisMetadata::Address_to_str(addr), addr);
+}
+
+void WorkerChannelPool::RemoveWorker(const std::string& worker_name) {
+  std::lock_guard<std::mutex> lock(pool_mutex_);
+  workers_.erase(worker_name);
+}
+
+bool WorkerChannelPool::ReportFailure(const std::string& worker_name) {
+  std::lock_guard<std::mutex> lock(pool_mutex_);
+  auto it = workers_.find(worker_name);
+  if (it == workers_.end()) { return false; }
+  for (const auto& channel : it->second.channels) {
+    if (channel_dead(channel)) {
+      std::cout << "[LOG]: Dropping channels to " << worker_name << std::endl;
+      workers_.erase(it);
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t WorkerChannelPool::NumWorkers() {
+  std::lock_guard<std::mutex> lock(pool_mutex_);
+  return workers_.size();
+}
+
+}  // namespace internal
+}  // namespace infaas
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2018-2021 Board of Trustees of Stanford University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WORKER_CHANNEL_POOL_H
+#define WORKER_CHANNEL_POOL_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <grpcpp/grpcpp.h>
+
+#include "metadata-store/redis_metadata.h"
+
+namespace infaas {
+namespace internal {
+
+// Keeps a small set of warm gRPC channels per worker so that callers do not
+// pay a TCP/HTTP2 handshake for every request. Channels are keyed by worker
+// (executor) name and handed out round-robin. Each channel uses its own
+// subchannel pool, so the channels of one worker are distinct connections.
+// A worker's entry is rebuilt if its address changes and dropped when the
+// worker is removed or reported as failed. All methods are thread-safe.
+class WorkerChannelPool {
+public:
+  WorkerChannelPool(const int16_t channels_per_worker = 2);
+
+  // Returns the next channel to the worker, creating the worker's channels on
+  // first use. Channels that have been shut down are replaced in place.
+  std::shared_ptr<grpc::Channel> GetChannel(const std::string& worker_name,
+                                            const struct Address& addr);
+
+  // Same as above, keyed by the address string (for endpoints that have no
+  // executor name, e.g. the query frontend).
+  std::shared_ptr<grpc::Channel> GetChannel(const struct Address& addr);
+
+  // Drops all channels of a worker; a name the pool does not hold is
+  // ignored. Called after RedisMetadata::delete_executor: directly by
+  // master_vm_daemon, and in the frontend through MetadataCache, which
+  // reports every key deleted from the store.
+  void RemoveWorker(const std::string& worker_name);
+
+  // Called after a failed request to a worker. Drops the worker's channels if
+  // any of them is in TRANSIENT_FAILURE or SHUTDOWN, so the next request
+  // reconnects. Returns true if the entry was dropped.
+  bool ReportFailure(const std::string& worker_name);
+
+  // Number of workers that currently hold channels.
+  size_t NumWorkers();
+
+  // Channel arguments shared by every channel created by the pool.
+  static grpc::ChannelArguments DefaultChannelArguments();
+
+private:
+  struct WorkerChannels {
+    struct Address addr;
+    std::vector<std::shared_ptr<grpc::Channel>> channels;
+    uint32_t next;
+  };
+
+  std::shared_ptr<grpc::Channel> NewChannel(const struct Address& addr);
+
+  const int16_t channels_per_worker_;
+  std::mutex pool_mutex_;
+  std::map<std::string, WorkerChannels> workers_;
+};
+
+}  // namespace internal
+}  // namespace infaas
+
+#endif  // #ifndef WORKER_CHANNEL_POOL_H
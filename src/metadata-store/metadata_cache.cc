@@ -0,0 +1,268 @@
+/*
+ * Copyright 2018-2021 Board of Trustees of Stanford University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "metadata_cache.h"
+
+using namespace redox;
+
+// Keyspace event classes needed for invalidation: K = keyspace channel,
+// E = keyevent channel, $ = string (SET), h = hash (HMSET),
+// z = sorted set (ZADD/ZREM), g = DEL.
+static const std::string keyspace_flags = "KE$hgz";
+static const std::string keyspace_prefix = "__keyspace@*__:";
+// Its messages are the deleted keys
+static const std::string del_channel = "__keyevent@*__:del";
+
+namespace {
+bool ends_with(const std::string& s, const std::string& suffix) {
+  return (s.size() >= suffix.size()) &&
+         (s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0);
+}
+
+}  // namespace
+
+MetadataCache::MetadataCache(struct Address redis_server, RedisMetadata* rm,
+                             KeyDeletedFn on_key_deleted)
+    : rm_(rm), enabled_(false), epoch_(0), hits_(0), misses_(0) {
+  uint16_t redis_port = stoi(redis_server.port);
+  if (!rdx_.connect(redis_server.ip, redis_port)) {
+    std::cout << "[Metadata Cache]: Failed to connect; cache disabled"
+              << std::endl;
+    return;
+  }
+
+  // Turn on the keyspace notifications we need, keeping any already set.
+  std::string flags = "";
+  Command<std::vector<std::string>>& c_get =
+      rdx_.commandSync<std::vector<std::string>>(
+          {"CONFIG", "GET", "notify-keyspace-events"});
+  if (c_get.ok() && (c_get.reply().size() == 2)) { flags = c_get.reply()[1]; }
+  c_get.free();
+  for (char f : keyspace_flags) {
+    if (flags.find(f) == std::string::npos) { flags += f; }
+  }
+  Command<std::string>& c_set = rdx_.commandSync<std::string>(
+      {"CONFIG", "SET", "notify-keyspace-events", flags});
+  bool config_ok = c_set.ok();
+  c_set.free();
+  if (!config_ok) {
+    std::cout << "[Metadata Cache]: Failed to enable keyspace events; ";
+    std::cout << "cache disabled" << std::endl;
+    return;
+  }
+
+  if (!sub_.connect(redis_server.ip, redis_port)) {
+    std::cout << "[Metadata Cache]: Subscriber failed to connect; ";
+    std::cout << "cache disabled" << std::endl;
+    return;
+  }
+
+  // The message is only the event name; the key is in the channel
+  auto on_event = [this](const std::string& channel, const std::string&) {
+    size_t pos = channel.find("__:");
+    if (pos == std::string::npos) { return; }
+    invalidate(channel.substr(pos + 3));
+  };
+  const std::vector<std::string> suffixes = {
+      std::string("-") + MODINFO_SUFF, std::string("-") + PARENT_SUFF,
+      ACCURACY_SUFF, LOADLAT_SUFF, INFLAT_SUFF};
+  for (const std::string& suff : suffixes) {
+    sub_.psubscribe(keyspace_prefix + "*" + suff, on_event);
+  }
+  if (on_key_deleted) {
+    sub_.psubscribe(del_channel,
+                    [on_key_deleted](const std::string&,
+                                     const std::string& key) {
+                      on_key_deleted(key);
+                    });
+  }
+
+  enabled_ = true;
+  std::cout << "[Metadata Cache]: Subscribed to keyspace notifications"
+            << std::endl;
+}
+
+MetadataCache::~MetadataCache() {
+  if (enabled_) { sub_.disconnect(); }
+  rdx_.disconnect();
+}
+
+std::string MetadataCache::get_model_info(const std::string& model_name,
+                                          const std::string& info) {
+  if (!enabled_) { return rm_->get_model_info(model_name, info); }
+
+  uint64_t epoch;
+  {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    auto it = info_.find(model_name);
+    if (it != info_.end()) {
+      auto fit = it->second.find(info);
+      if (fit != it->second.end()) {
+        hits_++;
+        return fit->second;
+      }
+    }
+    epoch = epoch_;
+  }
+
+  misses_++;
+  std::string reply = rm_->get_model_info(model_name, info);
+  if (reply == "FAIL") { return reply; }
+
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  if (epoch == epoch_) { info_[model_name][info] = reply; }
+  return reply;
+}
+
+std::string MetadataCache::get_parent_model(const std::string& model_name) {
+  if (!enabled_) { return rm_->get_parent_model(model_name); }
+
+  uint64_t epoch;
+  {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    auto it = parent_.find(model_name);
+    if (it != parent_.end()) {
+      hits_++;
+      return it->second;
+    }
+    epoch = epoch_;
+  }
+
+  misses_++;
+  std::string reply = rm_->get_parent_model(model_name);
+  if ((reply == "FAIL") || reply.empty()) { return reply; }
+
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  if (epoch == epoch_) { parent_[model_name] = reply; }
+  return reply;
+}
+
+double MetadataCache::get_accuracy(const std::string& model_name) {
+  if (!enabled_) { return rm_->get_accuracy(model_name); }
+
+  double value;
+  uint64_t epoch;
+  {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    if (lookup(accuracy_, model_name, &value)) { return value; }
+    epoch = epoch_;
+  }
+  value = rm_->get_accuracy(model_name);
+  insert(&accuracy_, model_name, value, epoch);
+  return value;
+}
+
+double MetadataCache::get_load_lat(const std::string& model_name) {
+  if (!enabled_) { return rm_->get_load_lat(model_name); }
+
+  double value;
+  uint64_t epoch;
+  {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    if (lookup(load_lat_, model_name, &value)) { return value; }
+    epoch = epoch_;
+  }
+  value = rm_->get_load_lat(model_name);
+  insert(&load_lat_, model_name, value, epoch);
+  return value;
+}
+
+double MetadataCache::get_inf_lat(const std::string& model_name) {
+  if (!enabled_) { return rm_->get_inf_lat(model_name); }
+
+  double value;
+  uint64_t epoch;
+  {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    if (lookup(inf_lat_, model_name, &value)) { return value; }
+    epoch = epoch_;
+  }
+  value = rm_->get_inf_lat(model_name);
+  insert(&inf_lat_, model_name, value, epoch);
+  return value;
+}
+
+void MetadataCache::clear() {
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  epoch_++;
+  info_.clear();
+  parent_.clear();
+  accuracy_.clear();
+  load_lat_.clear();
+  inf_lat_.clear();
+}
+
+uint64_t MetadataCache::epoch() {
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  return epoch_;
+}
+
+/*********************** Private Functions ***********************/
+
+void MetadataCache::invalidate(const std::string& key) {
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  epoch_++;
+
+  const std::string info_suff = std::string("-") + MODINFO_SUFF;
+  const std::string parent_suff = std::string("-") + PARENT_SUFF;
+  if (ends_with(key, info_suff)) {
+    info_.erase(key.substr(0, key.size() - info_suff.size()));
+  } else if (ends_with(key, parent_suff)) {
+    const std::string model = key.substr(0, key.size() - parent_suff.size());
+    parent_.erase(model);
+    accuracy_.erase(model);
+    load_lat_.erase(model);
+    inf_lat_.erase(model);
+  } else if (ends_with(key, ACCURACY_SUFF)) {
+    // These sorted sets are keyed by parent and the event does not say which
+    // member changed. They only change on model registration/deletion, so
+    // dropping the whole table is cheap.
+    accuracy_.clear();
+  } else if (ends_with(key, LOADLAT_SUFF)) {
+    load_lat_.clear();
+  } else if (ends_with(key, INFLAT_SUFF)) {
+    inf_lat_.clear();
+  }
+}
+
+bool MetadataCache::lookup(const std::unordered_map<std::string, double>& cache,
+                           const std::string& key, double* value) {
+  auto it = cache.find(key);
+  if (it == cache.end()) { return false; }
+  hits_++;
+  *value = it->second;
+  return true;
+}
+
+void MetadataCache::insert(std::unordered_map<std::string, double>* cache,
+                           const std::string& key, const double& value,
+                           const uint64_t& epoch) {
+  misses_++;
+  if (value < 0.0) { return; }
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  if (epoch == epoch_) { (*cache)[key] = value; }
+}
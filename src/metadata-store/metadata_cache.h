@@ -0,0 +1,112 @@
+/*
+ * Copyright 2018-2021 Board of Trustees of Stanford University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef METADATA_CACHE_H
+#define METADATA_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <redox.hpp>
+
+#include "redis_metadata.h"
+
+// Read-through cache over RedisMetadata for per-variant metadata that only
+// changes when a model variant is added or deleted (everything add_model
+// writes: the info hash, parent link, accuracy and load/inference latency).
+// Entries are filled on first use and invalidated by a subscriber that listens
+// for Redis keyspace notifications on those keys. Dynamic state (QPS,
+// running/blacklist flags, utilization) is NOT cached and should still be read
+// through RedisMetadata.
+// If the subscriber cannot be started, the cache is disabled and every call
+// goes straight to Redis.
+class MetadataCache {
+public:
+  // Called on the subscriber thread with each key deleted from Redis. An
+  // executor's address is kept under the executor's name, so this is how
+  // owners of per-executor state (e.g. WorkerChannelPool) learn that
+  // delete_executor removed one; keys they do not know are to be ignored.
+  typedef std::function<void(const std::string&)> KeyDeletedFn;
+
+  MetadataCache(struct Address redis_server, RedisMetadata* rm,
+                KeyDeletedFn on_key_deleted = nullptr);
+  ~MetadataCache();
+
+  // Same semantics as the RedisMetadata methods of the same name. Failures
+  // ("FAIL" or -1.0) are returned but not cached.
+  std::string get_model_info(const std::string& model_name,
+                             const std::string& info);
+  std::string get_parent_model(const std::string& model_name);
+  double get_accuracy(const std::string& model_name);
+  double get_load_lat(const std::string& model_name);
+  double get_inf_lat(const std::string& model_name);
+
+  // Drop every cached entry (e.g., after FLUSHALL, which sends no keyspace
+  // events).
+  void clear();
+
+  // Whether invalidation is active and values are being cached.
+  bool enabled() const { return enabled_; }
+
+  // Changes whenever cached metadata is invalidated. Callers that derive their
+  // own structures from this metadata compare it to know when to rebuild.
+  uint64_t epoch();
+
+  // Hit/miss counters, for logging.
+  uint64_t hits() const { return hits_; }
+  uint64_t misses() const { return misses_; }
+
+private:
+  // Called from the subscriber thread for every keyspace event.
+  void invalidate(const std::string& key);
+
+  bool lookup(const std::unordered_map<std::string, double>& cache,
+              const std::string& key, double* value);
+  void insert(std::unordered_map<std::string, double>* cache,
+              const std::string& key, const double& value,
+              const uint64_t& epoch);
+
+  RedisMetadata* rm_;
+  redox::Redox rdx_;
+  redox::Subscriber sub_;
+  bool enabled_;
+
+  std::mutex cache_mutex_;
+  // Bumped on every invalidation. A value read from Redis is only inserted if
+  // no invalidation happened while it was being fetched.
+  uint64_t epoch_;
+  std::unordered_map<std::string, std::map<std::string, std::string>> info_;
+  std::unordered_map<std::string, std::string> parent_;
+  std::unordered_map<std::string, double> accuracy_;
+  std::unordered_map<std::string, double> load_lat_;
+  std::unordered_map<std::string, double> inf_lat_;
+
+  std::atomic<uint64_t> hits_;
+  std::atomic<uint64_t> misses_;
+};
+
+#endif
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2018-2021 Board of Trustees of Stanford University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>  // min
+#include <iostream>
+#include <map>
+#include <stdexcept>  // If connection to Redis fails in constructor
+
+#include "redis_connection_pool.h"
+#include "redis_metadata.h"
+
+using namespace redox;
+
+namespace {
+// Reconnect backoff: first retry after min, doubling up to max
+const int reconnect_backoff_min_ms = 50;
+const int reconnect_backoff_max_ms = 5000;
+
+std::atomic<uint64_t> next_pool_id(0);
+}  // namespace
+
+RedisConnectionPool::RedisConnectionPool(const struct Address& redis_server,
+                                         const int pool_size)
+    : redis_ip_(redis_server.ip),
+      redis_port_(stoi(redis_server.port)),
+      pool_id_(next_pool_id++),
+      next_slot_(0),
+      num_reconnects_(0) {
+  int n = std::max(1, pool_size);
+  for (int i = 0; i < n; ++i) {
+    std::unique_ptr<Slot> slot(new Slot());
+    if (!connect_slot(slot.get())) {
+      throw std::runtime_error("Failed to connect to Redis server");
+    }
+    slots_.push_back(std::move(slot));
+  }
+}
+
+RedisConnectionPool::~RedisConnectionPool() {
+  for (auto& slot : slots_) {
+    if (slot->rdx) { slot->rdx->disconnect(); }
+  }
+}
+
+Redox& RedisConnectionPool::get() {
+  // Slot of this thread in each pool it has used
+  thread_local std::map<uint64_t, uint32_t> thread_slot;
+  auto it = thread_slot.find(pool_id_);
+  if (it == thread_slot.end()) {
+    uint32_t idx = next_slot_++ % slots_.size();
+    it = thread_slot.emplace(pool_id_, idx).first;
+  }
+
+  Slot* slot = slots_[it->second].get();
+  // connect_slot swaps rdx and broken under the slot mutex
+  std::lock_guard<std::mutex> lock(slot->mutex);
+  if (slot->broken->load()) { maybe_reconnect(slot); }
+  return *slot->rdx;
+}
+
+/*********************** Private Functions ***********************/
+
+bool RedisConnectionPool::connect_slot(Slot* slot) {
+  std::shared_ptr<std::atomic<bool>> broken(new std::atomic<bool>(false));
+  std::unique_ptr<Redox> rdx(new Redox());
+  bool ok = rdx->connect(redis_ip_, redis_port_, [broken](int state) {
+    if ((state == Redox::DISCONNECTED) || (state == Redox::CONNECT_ERROR) ||
+        (state == Redox::DISCONNECT_ERROR)) {
+      broken->store(true);
+    }
+  });
+  if (!ok) { broken->store(true); }
+
+  if (slot->rdx) {
+    std::lock_guard<std::mutex> lock(retired_mutex_);
+    retired_.push_back(std::move(slot->rdx));
+  }
+  slot->rdx = std::move(rdx);
+  slot->broken = broken;
+  return ok;
+}
+
+void RedisConnectionPool::maybe_reconnect(Slot* slot) {
+  auto now = std::chrono::steady_clock::now();
+  if (now < slot->next_attempt) { return; }
+
+  if (connect_slot(slot)) {
+    std::cout << "[Redis Metadata]: Reconnected after " << slot->failures
+              << " failed attempts" << std::endl;
+    slot->failures = 0;
+    num_reconnects_++;
+    return;
+  }
+
+  int backoff_ms = reconnect_backoff_max_ms;
+  if (slot->failures < 16) {
+    backoff_ms = std::min(reconnect_backoff_max_ms,
+                          reconnect_backoff_min_ms << slot->failures);
+  }
+  slot->failures++;
+  slot->next_attempt = now + std::chrono::milliseconds(backoff_ms);
+  std::cout << "[Redis Metadata]: Reconnect failed; retrying in "
+            << backoff_ms << " ms" << std::endl;
+}
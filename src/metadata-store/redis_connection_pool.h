@@ -0,0 +1,94 @@
+/*
+ * Copyright 2018-2021 Board of Trustees of Stanford University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef REDIS_CONNECTION_POOL_H
+#define REDIS_CONNECTION_POOL_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <redox.hpp>
+
+struct Address;
+
+// Default number of connections per RedisMetadata
+static const int default_redis_pool_size = 4;
+
+// A fixed set of Redis connections shared by the threads of one process.
+// Each thread is assigned a connection round-robin the first time it asks,
+// and keeps it, so up to pool-size threads talk to Redis in parallel
+// instead of queueing behind a single connection.
+// A connection that drops is replaced the next time it is requested.
+// Failed reconnects back off exponentially; in between, callers get the
+// broken connection and their commands fail fast.
+class RedisConnectionPool {
+public:
+  RedisConnectionPool(const struct Address& redis_server,
+                      const int pool_size = default_redis_pool_size);
+  ~RedisConnectionPool();
+
+  // Connection for the calling thread
+  redox::Redox& get();
+
+  int size() const { return static_cast<int>(slots_.size()); }
+
+  // Number of successful reconnects since the pool was created
+  uint64_t num_reconnects() const { return num_reconnects_.load(); }
+
+private:
+  struct Slot {
+    std::mutex mutex;  // Guards everything below
+    std::unique_ptr<redox::Redox> rdx;
+    // Set from the redox event loop when the connection goes down
+    std::shared_ptr<std::atomic<bool>> broken;
+    int failures = 0;
+    std::chrono::steady_clock::time_point next_attempt;
+  };
+
+  // Opens a new connection for slot. Returns false if it could not connect.
+  // Called with slot->mutex held, except from the constructor.
+  bool connect_slot(Slot* slot);
+
+  // Replaces slot's broken connection if its backoff has passed. Called with
+  // slot->mutex held.
+  void maybe_reconnect(Slot* slot);
+
+  const std::string redis_ip_;
+  const int redis_port_;
+  const uint64_t pool_id_;
+
+  std::vector<std::unique_ptr<Slot>> slots_;
+  std::atomic<uint32_t> next_slot_;
+  std::atomic<uint64_t> num_reconnects_;
+
+  // Replaced connections are kept until the pool goes away: another thread
+  // may still hold a Command that belongs to one of them.
+  std::mutex retired_mutex_;
+  std::vector<std::unique_ptr<redox::Redox>> retired_;
+};
+
+#endif
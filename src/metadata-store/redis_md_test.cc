@@ -21,12 +21,16 @@
  */
 
 #include <unistd.h>  // sleep()
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <iostream>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "metadata_cache.h"
 #include "redis_metadata.h"
 
 #define FAIL(x) printf("[FAIL]: " #x "\n")
@@ -508,6 +512,17 @@ int main(int argc, char** argv) {
     return 1;
   }
 
+  // Every variant of the grandparent, regardless of bin
+  std::vector<std::string> gpar_all_var =
+      rmd.get_all_gpar_variants(gparent_model);
+  if (std::find(gpar_all_var.begin(), gpar_all_var.end(),
+                test_mod_variant.model_name) != gpar_all_var.end()) {
+    PASS("All grandparent variants");
+  } else {
+    FAIL("All grandparent variants");
+    return 1;
+  }
+
   // Test setting an executor to CPU only
   rc = rmd.set_exec_onlycpu(sample_exec[3]);
   if (!rc) {
@@ -1005,6 +1020,49 @@ int main(int argc, char** argv) {
     FAIL("Inferentia model running");
     return 1;
   }
+
+  // Test the pipelined batch APIs on the running Inferentia variant
+  std::vector<std::vector<std::string>> info_multi = rmd.get_model_info_multi(
+      {test_inferentia_mod_variant.model_name, "not_a_model"},
+      {"framework", "max_batch"});
+  if ((info_multi.size() == 2) &&
+      (info_multi[0][0] == test_inferentia_mod_variant.framework) &&
+      (info_multi[0][1] == std::to_string(test_inferentia_mod_variant.batch)) &&
+      (info_multi[1][0] == "FAIL") && (info_multi[1][1] == "FAIL")) {
+    PASS("Get model info (batch)");
+  } else {
+    FAIL("Get model info (batch)");
+    return 1;
+  }
+
+  std::vector<int8_t> running_multi = rmd.is_model_running_multi(
+      {test_inferentia_mod_variant.model_name, "not_a_model"}, sample_exec[4]);
+  if ((running_multi.size() == 2) && (running_multi[0] == 1) &&
+      (running_multi[1] == -1)) {
+    PASS("Model running (batch)");
+  } else {
+    FAIL("Model running (batch)");
+    return 1;
+  }
+
+  start = std::chrono::high_resolution_clock::now();
+  rc = rmd.update_model_stats_batch(
+      sample_exec[4], {{test_inferentia_mod_variant.model_name, 42.0, 7.0}});
+  stop = std::chrono::high_resolution_clock::now();
+  duration =
+      std::chrono::duration_cast<std::chrono::microseconds>(stop - start);
+  std::cout << "Time taken by update_model_stats_batch: " << duration.count()
+            << " microseconds" << std::endl;
+  std::vector<double> qps_multi = rmd.get_model_qps_multi(
+      sample_exec[4], {test_inferentia_mod_variant.model_name});
+  if (!rc && (qps_multi.size() == 1) && (qps_multi[0] == 42.0) &&
+      (rmd.get_model_avglat(sample_exec[4],
+                            test_inferentia_mod_variant.model_name) == 7.0)) {
+    PASS("Update model stats (batch)");
+  } else {
+    FAIL("Update model stats (batch)");
+    return 1;
+  }
   int8_t is_inferentia_parent_running = rmd.is_parent_model_running(parent_model);
   if (is_inferentia_parent_running) {
     PASS("Inferentia parent still running");
@@ -1041,6 +1099,72 @@ int main(int argc, char** argv) {
     return 1;
   }
 
+  // Test the read-through metadata cache: a second read must be a hit
+  MetadataCache mdc({"localhost", "6379"}, &rmd);
+  res_str = mdc.get_model_info(test_inferentia_mod_variant.model_name,
+                               "framework");
+  res_str = mdc.get_model_info(test_inferentia_mod_variant.model_name,
+                               "framework");
+  if ((res_str == test_inferentia_mod_variant.framework) && mdc.enabled() &&
+      (mdc.hits() == 1) && (mdc.misses() == 1)) {
+    PASS("Metadata cache read-through");
+  } else {
+    FAIL("Metadata cache read-through");
+    return 1;
+  }
+
+  // Deleting the model must invalidate the cached entry
+  rc = rmd.delete_model(test_inferentia_mod_variant.model_name);
+  usleep(100000);  // Give the keyspace notification time to arrive
+  res_str = mdc.get_model_info(test_inferentia_mod_variant.model_name,
+                               "framework");
+  if (!rc && (res_str == "FAIL")) {
+    PASS("Metadata cache invalidation");
+  } else {
+    FAIL("Metadata cache invalidation");
+    return 1;
+  }
+
+  // Concurrency benchmark: read throughput as threads (and connections)
+  // grow. Each thread gets its own pooled connection, so reads should scale
+  // roughly linearly until Redis itself saturates.
+  const int bench_reads_per_thread = 2000;
+  const int bench_threads[] = {1, 2, 4, 8};
+  double base_ops = 0;
+  bool bench_ok = true;
+  std::cout << "Threads, ReadsPerSec, Speedup" << std::endl;
+  for (int nthreads : bench_threads) {
+    RedisMetadata bench_rmd({"localhost", "6379"}, nthreads);
+    int16_t expected = bench_rmd.get_num_executors();
+    std::atomic<int> bad_reads(0);
+    std::vector<std::thread> workers;
+    start = std::chrono::high_resolution_clock::now();
+    for (int t = 0; t < nthreads; ++t) {
+      workers.push_back(std::thread([&bench_rmd, &bad_reads, expected,
+                                     bench_reads_per_thread]() {
+        for (int i = 0; i < bench_reads_per_thread; ++i) {
+          if (bench_rmd.get_num_executors() != expected) { bad_reads++; }
+        }
+      }));
+    }
+    for (auto& w : workers) { w.join(); }
+    stop = std::chrono::high_resolution_clock::now();
+    duration =
+        std::chrono::duration_cast<std::chrono::microseconds>(stop - start);
+    double ops = (nthreads * bench_reads_per_thread) /
+                 (duration.count() / 1000000.0);
+    if (nthreads == 1) { base_ops = ops; }
+    std::cout << nthreads << ", " << ops << ", " << ops / base_ops
+              << std::endl;
+    if (bad_reads.load() > 0) { bench_ok = false; }
+  }
+  if (bench_ok) {
+    PASS("Concurrent reads through the connection pool");
+  } else {
+    FAIL("Concurrent reads through the connection pool");
+    return 1;
+  }
+
   std::cout << "All tests passed!!" << std::endl;
   std::cout << "Average time to complete a transaction: " << total_us / 12.0;
   std::cout << " microseconds" << std::endl;
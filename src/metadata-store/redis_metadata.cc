@@ -21,9 +21,13 @@
  */
 
 #include <algorithm>  // find
+#include <cerrno>
+#include <cstdlib>
+#include <condition_variable>
 #include <exception>  // If connection to Redis fails in constructor
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <sstream>
 
 #include "redis_metadata.h"
@@ -55,13 +59,15 @@ int RedisMetadata::get_model_exec_info(
     std::string* task,
     std::string* exec_path,
     std::string* entry_point,
-    std::string* env_path) {
+    std::string* env_path,
+    std::string* exec_protocol,
+    std::string* version) {
 
   // Redis key: model:<model_name>
   std::string key = "model:" + model_name;
 
   try {
-    // auto future = rdx_.command<std::vector<std::string>>(
+    // auto future = rdx().command<std::vector<std::string>>(
     //     {"HMGET",
     //      key,
     //      "framework",
@@ -79,17 +85,35 @@ std::vector<std::string> cmd = {
       "task",
       "exec_path",
       "entry_point",
-      "env_path"
+      "env_path",
+      "exec_protocol",
+      "version"
   };
 
-// ✅ move-only Command handled correctly
-  auto& cmd_handle = rdx_.commandSync<std::vector<std::string>>(cmd);
-
-  // ✅ reply() returns the actual vector
-  std::vector<std::string> values = cmd_handle.reply();
+  // Read as a raw reply: exec_protocol and version may be nil, which a
+  // std::vector<std::string> reply would reject as a whole
+  std::vector<std::string> values;
+  bool complete = false;
+  pipeline<redisReply*>({cmd}, [&](size_t, Command<redisReply*>& c) {
+    if (!c.ok()) { return; }
+    redisReply* r = c.reply();
+    if ((r == nullptr) || (r->type != REDIS_REPLY_ARRAY) ||
+        (r->elements != 7)) {
+      return;
+    }
+    complete = true;
+    for (size_t j = 0; j < r->elements; ++j) {
+      redisReply* e = r->element[j];
+      if (e->type == REDIS_REPLY_STRING) {
+        values.emplace_back(e->str, e->len);
+      } else {
+        values.emplace_back();
+        if (j < 5) { complete = false; }
+      }
+    }
+  });
 
- 
-  if (values.size() != 5) {
+  if (!complete) {
     return -1;
   }
 
@@ -98,6 +122,8 @@ std::vector<std::string> cmd = {
   *exec_path   = values[2];
   *entry_point = values[3];
   *env_path    = values[4];
+  if (exec_protocol != nullptr) { *exec_protocol = values[5]; }
+  if (version != nullptr) { *version = values[6]; }
 
   return 0;
  
@@ -115,13 +141,9 @@ std::vector<std::string> cmd = {
 
 const struct Address RedisMetadata::empty_addr = {"0", "0"};
 
-RedisMetadata::RedisMetadata(struct Address redis_server)
-    : redis_server_(redis_server) {
-  // Initialize connection to Redis server
-  uint16_t redis_port = stoi(redis_server_.port);
-  if (!rdx_.connect(redis_server_.ip, redis_port)) {
-    throw std::runtime_error("Failed to connect to Redis server");
-  }
+RedisMetadata::RedisMetadata(struct Address redis_server, const int pool_size)
+    : redis_server_(redis_server), pool_(redis_server, pool_size) {
+  // Connections to the Redis server are opened by the pool
   std::cout << "[Redis Metadata]: Successfully connected" << std::endl;
 }
 
@@ -129,12 +151,12 @@ int8_t RedisMetadata::add_executor_addr(const std::string& executor_name,
                                         const struct Address& addr) {
   const std::string exec_addr = addr.ip + ":" + addr.port;
   Command<std::string>& c_exec_addr =
-      rdx_.commandSync<std::string>({"SET", executor_name, exec_addr});
+      rdx().commandSync<std::string>({"SET", executor_name, exec_addr});
   if (!c_exec_addr.ok()) { return -1; }
 
   // Add to all executor set
   Command<int>& c_add_exec =
-      rdx_.commandSync<int>({"SADD", ALLEXEC_SET, executor_name});
+      rdx().commandSync<int>({"SADD", ALLEXEC_SET, executor_name});
   if (!c_add_exec.ok()) { return -1; }
 
   // Call update_cpu_util and update_gpu_util for initialization to 0
@@ -159,7 +181,7 @@ const struct Address RedisMetadata::get_executor_addr(
 
   std::string return_ip, return_port;
   Command<std::string>& c_exec_addr =
-      rdx_.commandSync<std::string>({"GET", executor_name});
+      rdx().commandSync<std::string>({"GET", executor_name});
   if (!c_exec_addr.ok()) { return empty_addr; }
   std::string reply = c_exec_addr.reply();
 
@@ -173,7 +195,7 @@ int8_t RedisMetadata::add_executor_instid(const std::string& executor_name,
                                           const std::string& instid) {
   const std::string instid_name = executor_name + "-" + INSTID_SUFF;
   Command<std::string>& c_exec_instid =
-      rdx_.commandSync<std::string>({"SET", instid_name, instid});
+      rdx().commandSync<std::string>({"SET", instid_name, instid});
   if (!c_exec_instid.ok()) { return -1; }
 
   return 0;
@@ -190,7 +212,7 @@ std::string RedisMetadata::get_executor_instid(
 
   const std::string instid_name = executor_name + "-" + INSTID_SUFF;
   Command<std::string>& c_exec_instid =
-      rdx_.commandSync<std::string>({"GET", instid_name});
+      rdx().commandSync<std::string>({"GET", instid_name});
   if (!c_exec_instid.ok()) { return "FAIL"; }
 
   std::string reply = c_exec_instid.reply();
@@ -209,7 +231,7 @@ int8_t RedisMetadata::set_exec_onlycpu(const std::string& executor_name) {
 
   // The actual value of exec_cpu doesn't matter; it's simply a flag
   Command<std::string>& c_exec_cpu =
-      rdx_.commandSync<std::string>({"SET", exec_cpu, "1"});
+      rdx().commandSync<std::string>({"SET", exec_cpu, "1"});
   if (!c_exec_cpu.ok()) { return -1; }
 
   // Update the gpu and inferentia utilization to be over 100 to
@@ -218,7 +240,7 @@ int8_t RedisMetadata::set_exec_onlycpu(const std::string& executor_name) {
   if (update_inferentia_util(executor_name, 101.0, 0) == -1) { return -1; }
 
   // Increment the CPU executor counter
-  Command<int>& c_numcpuexec = rdx_.commandSync<int>({"INCR", CPUEXEC_KEY});
+  Command<int>& c_numcpuexec = rdx().commandSync<int>({"INCR", CPUEXEC_KEY});
   if (!c_numcpuexec.ok()) { return -1; }
 
   return 0;
@@ -252,7 +274,7 @@ int8_t RedisMetadata::set_exec_inferentia(const std::string& executor_name) {
 
   // The actual value of exec_inferentia doesn't matter; it's simply a flag
   Command<std::string>& c_exec_inferentia =
-      rdx_.commandSync<std::string>({"SET", exec_inferentia, "1"});
+      rdx().commandSync<std::string>({"SET", exec_inferentia, "1"});
   if (!c_exec_inferentia.ok()) { return -1; }
 
   // Update the gpu utilization to be over 100 to make it get skipped
@@ -261,7 +283,7 @@ int8_t RedisMetadata::set_exec_inferentia(const std::string& executor_name) {
   if (update_inferentia_util(executor_name, 0.0, 0) == -1) { return -1; }
 
   // Increment the Inferentia executor counter
-  Command<int>& c_numinferentiaexec = rdx_.commandSync<int>({"INCR", INFERENTIAEXEC_KEY});
+  Command<int>& c_numinferentiaexec = rdx().commandSync<int>({"INCR", INFERENTIAEXEC_KEY});
   if (!c_numinferentiaexec.ok()) { return -1; }
 
   return 0;
@@ -296,7 +318,7 @@ int8_t RedisMetadata::set_exec_slack(const std::string& executor_name,
 
   // Default is 0. Otherwise, set to the variant that is running on it
   Command<std::string>& c_exec_slack =
-      rdx_.commandSync<std::string>({"SET", exec_slack, model_variant});
+      rdx().commandSync<std::string>({"SET", exec_slack, model_variant});
   if (!c_exec_slack.ok()) { return -1; }
 
   return 0;
@@ -316,7 +338,7 @@ std::string RedisMetadata::is_exec_slack(const std::string& executor_name) {
   if (!key_exists(exec_slack)) { return "NS"; }
 
   Command<std::string>& c_exec_slack =
-      rdx_.commandSync<std::string>({"GET", exec_slack});
+      rdx().commandSync<std::string>({"GET", exec_slack});
   if (!c_exec_slack.ok()) { return "FAIL"; }
 
   std::string reply = c_exec_slack.reply();
@@ -340,11 +362,11 @@ int8_t RedisMetadata::blacklist_executor(const std::string& executor_name,
 
   // The actual value of blist_name doesn't matter; it's simply a flag
   Command<std::string>& c_exec_blist =
-      rdx_.commandSync<std::string>({"SET", blist_name, "1"});
+      rdx().commandSync<std::string>({"SET", blist_name, "1"});
   if (!c_exec_blist.ok()) { return -1; }
 
   // Now set a TTL
-  Command<int>& c_exec_expire = rdx_.commandSync<int>(
+  Command<int>& c_exec_expire = rdx().commandSync<int>(
       {"EXPIRE", blist_name, std::to_string(expire_time)});
   if (!c_exec_expire.ok()) { return -1; }
 
@@ -362,7 +384,7 @@ bool RedisMetadata::is_blacklisted(const std::string& executor_name) {
   }
 
   const std::string blist_name = executor_name + "-" + BLIST_SUFF;
-  Command<int>& c_exec_exists = rdx_.commandSync<int>({"EXISTS", blist_name});
+  Command<int>& c_exec_exists = rdx().commandSync<int>({"EXISTS", blist_name});
   if (!c_exec_exists.ok()) { return -1; }
 
   int reply = c_exec_exists.reply();
@@ -376,21 +398,21 @@ bool RedisMetadata::is_blacklisted(const std::string& executor_name) {
 
 int8_t RedisMetadata::set_vm_scale() {
   Command<std::string>& c_vmscale =
-      rdx_.commandSync<std::string>({"SET", VMSCALE_KEY, "1"});
+      rdx().commandSync<std::string>({"SET", VMSCALE_KEY, "1"});
   if (!c_vmscale.ok()) { return -1; }
   return 0;
 }
 
 int8_t RedisMetadata::unset_vm_scale() {
   Command<std::string>& c_vmscale =
-      rdx_.commandSync<std::string>({"SET", VMSCALE_KEY, "0"});
+      rdx().commandSync<std::string>({"SET", VMSCALE_KEY, "0"});
   if (!c_vmscale.ok()) { return -1; }
   return 0;
 }
 
 int8_t RedisMetadata::vm_scale_status() {
   Command<std::string>& c_vmscale =
-      rdx_.commandSync<std::string>({"GET", VMSCALE_KEY});
+      rdx().commandSync<std::string>({"GET", VMSCALE_KEY});
   if (!c_vmscale.ok()) { return -1; }
 
   int8_t reply = std::stoi(c_vmscale.reply());
@@ -400,21 +422,21 @@ int8_t RedisMetadata::vm_scale_status() {
 
 int8_t RedisMetadata::set_slack_scale() {
   Command<std::string>& c_slackscale =
-      rdx_.commandSync<std::string>({"SET", SLACKSCALE_KEY, "1"});
+      rdx().commandSync<std::string>({"SET", SLACKSCALE_KEY, "1"});
   if (!c_slackscale.ok()) { return -1; }
   return 0;
 }
 
 int8_t RedisMetadata::unset_slack_scale() {
   Command<std::string>& c_slackscale =
-      rdx_.commandSync<std::string>({"SET", SLACKSCALE_KEY, "0"});
+      rdx().commandSync<std::string>({"SET", SLACKSCALE_KEY, "0"});
   if (!c_slackscale.ok()) { return -1; }
   return 0;
 }
 
 int8_t RedisMetadata::slack_scale_status() {
   Command<std::string>& c_slackscale =
-      rdx_.commandSync<std::string>({"GET", SLACKSCALE_KEY});
+      rdx().commandSync<std::string>({"GET", SLACKSCALE_KEY});
   if (!c_slackscale.ok()) { return -1; }
 
   int8_t reply = std::stoi(c_slackscale.reply());
@@ -426,74 +448,58 @@ int8_t RedisMetadata::delete_executor(const std::string& executor_name) {
   // Delete CPU only key if applicable
   const std::string exec_cpu = executor_name + "-" + CPUEXEC_SUFF;
   if (is_exec_onlycpu(executor_name)) {
-    Command<int>& c_exec_cpu_del = rdx_.commandSync<int>({"DEL", exec_cpu});
+    Command<int>& c_exec_cpu_del = rdx().commandSync<int>({"DEL", exec_cpu});
     if (!c_exec_cpu_del.ok()) { return -1; }
 
     // Decrement the CPU executor counter
-    Command<int>& c_numcpuexec = rdx_.commandSync<int>({"DECR", CPUEXEC_KEY});
+    Command<int>& c_numcpuexec = rdx().commandSync<int>({"DECR", CPUEXEC_KEY});
     if (!c_numcpuexec.ok()) { return -1; }
   }
 
   // Delete Inferentia only key if applicable
   const std::string exec_inferentia = executor_name + "-" + INFERENTIAEXEC_SUFF;
   if (is_exec_inferentia(executor_name)) {
-    Command<int>& c_exec_inferentia_del = rdx_.commandSync<int>({"DEL", exec_inferentia});
+    Command<int>& c_exec_inferentia_del = rdx().commandSync<int>({"DEL", exec_inferentia});
     if (!c_exec_inferentia_del.ok()) { return -1; }
 
     // Decrement the Inferentia executor counter
-    Command<int>& c_numinferentiaexec = rdx_.commandSync<int>({"DECR", INFERENTIAEXEC_KEY});
+    Command<int>& c_numinferentiaexec = rdx().commandSync<int>({"DECR", INFERENTIAEXEC_KEY});
     if (!c_numinferentiaexec.ok()) { return -1; }
   }
 
   // Delete slack key if applicable
   const std::string exec_slack = executor_name + "-" + SLACK_SUFF;
   if (key_exists(executor_name)) {
-    Command<int>& c_exec_slack_del = rdx_.commandSync<int>({"DEL", exec_slack});
+    Command<int>& c_exec_slack_del = rdx().commandSync<int>({"DEL", exec_slack});
     if (!c_exec_slack_del.ok()) { return -1; }
   }
 
-  // Delete from CPU utilization sorted set
-  Command<int>& c_exec_cpu_del =
-      rdx_.commandSync<int>({"ZREM", CPUUTIL_SET, executor_name});
-  if (!c_exec_cpu_del.ok()) { return -1; }
-
-  // Delete from GPU utilization sorted set
-  Command<int>& c_exec_gpu_del =
-      rdx_.commandSync<int>({"ZREM", GPUUTIL_SET, executor_name});
-  if (!c_exec_gpu_del.ok()) { return -1; }
-
-  // Delete from Inferentia utilization sorted set
-  Command<int>& c_exec_inferentia_del =
-      rdx_.commandSync<int>({"ZREM", INFERENTIAUTIL_SET, executor_name});
-  if (!c_exec_inferentia_del.ok()) { return -1; }
-
-  // Delete from all executor set
-  Command<int>& c_all_exec_del =
-      rdx_.commandSync<int>({"SREM", ALLEXEC_SET, executor_name});
-  if (!c_all_exec_del.ok()) { return -1; }
+  // Delete from the CPU/GPU/Inferentia utilization sorted sets and from the
+  // all executor set in one pipeline
+  if (pipeline_ok({{"ZREM", CPUUTIL_SET, executor_name},
+                   {"ZREM", GPUUTIL_SET, executor_name},
+                   {"ZREM", INFERENTIAUTIL_SET, executor_name},
+                   {"SREM", ALLEXEC_SET, executor_name}}) < 0) {
+    return -1;
+  }
 
   // Set all models that were running on it to be no longer running
   const std::string exec_mvar_name = executor_name + "-" + EXECMVAR_SUFF;
   Command<std::set<std::string>>& c_exec_models =
-      rdx_.commandSync<std::set<std::string>>({"SMEMBERS", exec_mvar_name});
+      rdx().commandSync<std::set<std::string>>({"SMEMBERS", exec_mvar_name});
   if (!c_exec_models.ok()) { return -1; }
 
   std::set<std::string> reply = c_exec_models.reply();
   for (auto mod : reply) { remove_running_model(executor_name, mod); }
 
-  // Delete executor-to-model set
+  // Delete executor-to-model set, executor-to-model variant set and
+  // executor-address (now safe)
   const std::string exec_mod_name = executor_name + "-" + EXECMOD_SUFF;
-  Command<int>& c_exec_mod_del = rdx_.commandSync<int>({"DEL", exec_mod_name});
-  if (!c_exec_mod_del.ok()) { return -1; }
-
-  // Delete executor-to-model variant set
-  Command<int>& c_exec_mvar_del =
-      rdx_.commandSync<int>({"DEL", exec_mvar_name});
-  if (!c_exec_mvar_del.ok()) { return -1; }
-
-  // Delete executor-address (now safe)
-  Command<int>& c_exec_del = rdx_.commandSync<int>({"DEL", executor_name});
-  if (!c_exec_del.ok()) { return -1; }
+  if (pipeline_ok({{"DEL", exec_mod_name},
+                   {"DEL", exec_mvar_name},
+                   {"DEL", executor_name}}) < 0) {
+    return -1;
+  }
 
   return 0;
 }
@@ -504,7 +510,7 @@ int16_t RedisMetadata::get_num_executors() {
 
   // Check length of CPU utilization set.
   Command<long long int>& c_numexec =
-      rdx_.commandSync<long long int>({"ZCARD", CPUUTIL_SET});
+      rdx().commandSync<long long int>({"ZCARD", CPUUTIL_SET});
   if (!c_numexec.ok()) { return -1; }
 
   long long int numexec_reply = c_numexec.reply();
@@ -517,7 +523,7 @@ int16_t RedisMetadata::get_num_cpu_executors() {
   if (!key_exists(CPUEXEC_KEY)) { return 0; }
 
   Command<std::string>& c_numcpuexec =
-      rdx_.commandSync<std::string>({"GET", CPUEXEC_KEY});
+      rdx().commandSync<std::string>({"GET", CPUEXEC_KEY});
   if (!c_numcpuexec.ok()) { return -1; }
 
   int8_t reply = std::stoi(c_numcpuexec.reply());
@@ -530,7 +536,7 @@ int16_t RedisMetadata::get_num_inferentia_executors() {
   if (!key_exists(INFERENTIAEXEC_KEY)) { return 0; }
 
   Command<std::string>& c_numinferentiaexec =
-      rdx_.commandSync<std::string>({"GET", INFERENTIAEXEC_KEY});
+      rdx().commandSync<std::string>({"GET", INFERENTIAEXEC_KEY});
   if (!c_numinferentiaexec.ok()) { return -1; }
 
   int8_t reply = std::stoi(c_numinferentiaexec.reply());
@@ -540,7 +546,7 @@ int16_t RedisMetadata::get_num_inferentia_executors() {
 
 std::vector<std::string> RedisMetadata::get_all_executors() {
   Command<std::vector<std::string>>& c_allexec_set =
-      rdx_.commandSync<std::vector<std::string>>({"SMEMBERS", ALLEXEC_SET});
+      rdx().commandSync<std::vector<std::string>>({"SMEMBERS", ALLEXEC_SET});
   if (!c_allexec_set.ok()) { return {}; }
 
   std::vector<std::string> reply = c_allexec_set.reply();
@@ -558,7 +564,7 @@ int8_t RedisMetadata::add_gparent_model(const std::string& gparent_model_name) {
 
   // Add to grandparent model set
   Command<int>& c_add_model =
-      rdx_.commandSync<int>({"SADD", GMOD_SET, gparent_model_name});
+      rdx().commandSync<int>({"SADD", GMOD_SET, gparent_model_name});
   if (!c_add_model.ok()) { return -1; }
   return 0; // PNB: Diffusion model debugging; suggested solution (2025.12.23)
 }
@@ -573,7 +579,7 @@ int8_t RedisMetadata::add_parent_model(const std::string& parent_model_name) {
 
   // Add to model set
   Command<int>& c_add_model =
-      rdx_.commandSync<int>({"SADD", MODEL_SET, parent_model_name});
+      rdx().commandSync<int>({"SADD", MODEL_SET, parent_model_name});
   if (!c_add_model.ok()) { return -1; }
   return 0; // PNB: Diffusion model debugging; suggested solution (2025.12.23)
 }
@@ -597,99 +603,6 @@ int8_t RedisMetadata::add_model(
     return -1;
   }
 
-  // Add to all model variant set
-  Command<int>& c_add_model =
-      rdx_.commandSync<int>({"SADD", MODELVAR_SET, model_name});
-  if (!c_add_model.ok()) { return -1; }
-
-  // Link grandparent model->model variant
-  const std::string var_gpar_name = model_name + "-" + GPARENT_SUFF;
-  Command<std::string>& c_var_gpar =
-      rdx_.commandSync<std::string>({"SET", var_gpar_name, gparent_model_name});
-  if (!c_var_gpar.ok()) { return -1; }
-
-  // Link model->model variant
-  const std::string var_par_name = model_name + "-" + PARENT_SUFF;
-  Command<std::string>& c_var_par =
-      rdx_.commandSync<std::string>({"SET", var_par_name, parent_model_name});
-  if (!c_var_par.ok()) { return -1; }
-
-  // Add to model->model variant set that is sorted by inference latency
-  const std::string par_child_name = parent_model_name + "-" + MODVAR_SUFF;
-
-
-  Command<int>& c_var_par_sset = rdx_.commandSync<int>(
-      {"ZADD", par_child_name, std::to_string(inf_latency), model_name});
-  if (!c_var_par_sset.ok()) { return -1; }
-
-  // // Create model info hash lookup table
-  // const std::string model_info_name = model_name + "-" + MODINFO_SUFF;
-  // Command<std::string>& c_modinfo_htable = rdx_.commandSync<std::string>(
-  //     {"HMSET",        model_info_name,
-  //      "comp_size",    std::to_string(comp_size),
-  //      "dataset",      dataset,
-  //      "submitter",    submitter,
-  //      "framework",    framework,
-  //      "task",         task,
-  //      "container_image", containerimage,             // PNB: for diffusion model implementation (2025.12.22)
-  //      "container_port", std::to_string(containerport), // PNB: for diffusion model implementation (2025.12.22)
-  //      "max_batch",    std::to_string(max_batch),
-  //      "load_latency", std::to_string(load_latency),
-  //      "inf_latency",  std::to_string(inf_latency),
-  //      "peak_memory",  std::to_string(peak_memory),
-  //      "img_dim",      std::to_string(img_dimensions),
-  //      "slope",        std::to_string(slope),
-  //      "intercept",    std::to_string(intercept)});
-
-
-  // Create model info hash lookup table
-  const std::string model_info_name = model_name + "-" + MODINFO_SUFF;
-  std::vector<std::string> cmd = {
-       "HMSET",        model_info_name,
-       "comp_size",    std::to_string(comp_size),
-       "dataset",      dataset,
-       "submitter",    submitter,
-       "framework",    framework,
-       "task",         task,
-       "container_image", container_image,             // PNB: for diffusion model implementation (2025.12.22)
-       "container_port", std::to_string(container_port), // PNB: for diffusion model implementation (2025.12.22)
-       "max_batch",    std::to_string(max_batch),
-       "load_latency", std::to_string(load_latency),
-       "inf_latency",  std::to_string(inf_latency),
-       "peak_memory",  std::to_string(peak_memory),
-       "img_dim",      std::to_string(img_dimensions),
-       "slope",        std::to_string(slope),
-       "intercept",    std::to_string(intercept)};
-  Command<std::string>& c_modinfo_htable = rdx_.commandSync<std::string>(cmd);
-
-
-  if (!c_modinfo_htable.ok()) { return -1; }
-
-  // Add to parent model's load latency set
-  const std::string load_lat_name = parent_model_name + LOADLAT_SUFF;
-  Command<int>& c_load_lat_sset = rdx_.commandSync<int>(
-      {"ZADD", load_lat_name, std::to_string(load_latency), model_name});
-  if (!c_load_lat_sset.ok()) { return -1.0; }
-
-  // Add to parent model's inference latency set
-  const std::string inf_lat_name = parent_model_name + INFLAT_SUFF;
-  Command<int>& c_inf_lat_sset = rdx_.commandSync<int>(
-      {"ZADD", inf_lat_name, std::to_string(inf_latency), model_name});
-  if (!c_inf_lat_sset.ok()) { return -1.0; }
-
-  // Add to parent model's total latency set
-  const std::string tot_lat_name = parent_model_name + TOTLAT_SUFF;
-  Command<int>& c_tot_lat_sset = rdx_.commandSync<int>(
-      {"ZADD", tot_lat_name, std::to_string(load_latency + inf_latency),
-       model_name});
-  if (!c_tot_lat_sset.ok()) { return -1.0; }
-
-  // Add to parent model's accuracy set
-  const std::string model_acc_name = parent_model_name + ACCURACY_SUFF;
-  Command<int>& c_acc_sset = rdx_.commandSync<int>(
-      {"ZADD", model_acc_name, std::to_string(accuracy), model_name});
-  if (!c_acc_sset.ok()) { return -1; }
-
   // Find which grandparent accuracy bin it belongs to
   double min_acc, max_acc;
   int i = -1;
@@ -705,19 +618,58 @@ int8_t RedisMetadata::add_model(
 
   std::string bin_num = std::to_string(i);
 
+  const std::string var_gpar_name = model_name + "-" + GPARENT_SUFF;
+  const std::string var_par_name = model_name + "-" + PARENT_SUFF;
+  const std::string par_child_name = parent_model_name + "-" + MODVAR_SUFF;
+  const std::string model_info_name = model_name + "-" + MODINFO_SUFF;
+  const std::string load_lat_name = parent_model_name + LOADLAT_SUFF;
+  const std::string inf_lat_name = parent_model_name + INFLAT_SUFF;
+  const std::string tot_lat_name = parent_model_name + TOTLAT_SUFF;
+  const std::string model_acc_name = parent_model_name + ACCURACY_SUFF;
   const std::string gpar_acc_name =
       gparent_model_name + "-" + bin_num + "-" + GPARACC_SUFF;
-
-  // Now add it to the respective accuracy bin set
-  Command<int>& c_gpar_acc_sset = rdx_.commandSync<int>(
-      {"ZADD", gpar_acc_name, std::to_string(accuracy), model_name});
-  if (!c_gpar_acc_sset.ok()) { return -1; }
-
-  // Save the bin number for removing during model deletion
   const std::string gpar_bin_name = model_name + "-" + GPARACCBIN_SUFF;
-  Command<std::string>& c_bin_num =
-      rdx_.commandSync<std::string>({"SET", gpar_bin_name, bin_num});
-  if (!c_bin_num.ok()) { return -1; }
+
+  // All writes are independent, so they go out as one pipeline
+  std::vector<std::vector<std::string>> cmds = {
+      // Add to all model variant set
+      {"SADD", MODELVAR_SET, model_name},
+      // Link grandparent model->model variant
+      {"SET", var_gpar_name, gparent_model_name},
+      // Link model->model variant
+      {"SET", var_par_name, parent_model_name},
+      // Add to model->model variant set that is sorted by inference latency
+      {"ZADD", par_child_name, std::to_string(inf_latency), model_name},
+      // Create model info hash lookup table
+      {"HMSET",           model_info_name,
+       "comp_size",       std::to_string(comp_size),
+       "dataset",         dataset,
+       "submitter",       submitter,
+       "framework",       framework,
+       "task",            task,
+       "container_image", container_image,             // PNB: for diffusion model implementation (2025.12.22)
+       "container_port",  std::to_string(container_port), // PNB: for diffusion model implementation (2025.12.22)
+       "max_batch",       std::to_string(max_batch),
+       "load_latency",    std::to_string(load_latency),
+       "inf_latency",     std::to_string(inf_latency),
+       "peak_memory",     std::to_string(peak_memory),
+       "img_dim",         std::to_string(img_dimensions),
+       "slope",           std::to_string(slope),
+       "intercept",       std::to_string(intercept)},
+      // Add to parent model's load latency set
+      {"ZADD", load_lat_name, std::to_string(load_latency), model_name},
+      // Add to parent model's inference latency set
+      {"ZADD", inf_lat_name, std::to_string(inf_latency), model_name},
+      // Add to parent model's total latency set
+      {"ZADD", tot_lat_name, std::to_string(load_latency + inf_latency),
+       model_name},
+      // Add to parent model's accuracy set
+      {"ZADD", model_acc_name, std::to_string(accuracy), model_name},
+      // Now add it to the respective accuracy bin set
+      {"ZADD", gpar_acc_name, std::to_string(accuracy), model_name},
+      // Save the bin number for removing during model deletion
+      {"SET", gpar_bin_name, bin_num}};
+  if (pipeline_ok(cmds) < 0) { return -1; }
 
   // Initialize model load/unload
   if (unset_model_load_unload(model_name) < 0) { return -1; }
@@ -731,7 +683,7 @@ int8_t RedisMetadata::add_model(
 std::string RedisMetadata::get_parent_model(const std::string& model_name) {
   const std::string var_par_name = model_name + "-" + PARENT_SUFF;
   Command<std::string>& c_var_par =
-      rdx_.commandSync<std::string>({"GET", var_par_name});
+      rdx().commandSync<std::string>({"GET", var_par_name});
   if (!c_var_par.ok()) { return "FAIL"; }
   std::string reply = c_var_par.reply();
 
@@ -742,7 +694,7 @@ std::vector<std::string> RedisMetadata::get_all_model_variants(
     const std::string& parent_model_name) {
   const std::string var_par_name = parent_model_name + "-" + MODVAR_SUFF;
   Command<std::vector<std::string>>& c_all_var =
-      rdx_.commandSync<std::vector<std::string>>(
+      rdx().commandSync<std::vector<std::string>>(
           {"ZRANGE", var_par_name, "0", "-1"});
   if (!c_all_var.ok()) { return {}; }
 
@@ -755,7 +707,7 @@ std::vector<std::string> RedisMetadata::get_all_parent_models(
     const std::string& task, const std::string& dataset) {
   std::vector<std::string> valid_parent_models;
   Command<std::vector<std::string>>& c_parmod_set =
-      rdx_.commandSync<std::vector<std::string>>({"SMEMBERS", MODEL_SET});
+      rdx().commandSync<std::vector<std::string>>({"SMEMBERS", MODEL_SET});
   if (!c_parmod_set.ok()) { return {}; }
 
   std::vector<std::string> reply = c_parmod_set.reply();
@@ -793,7 +745,7 @@ bool RedisMetadata::model_registered(const std::string& model_name) {
 
 std::vector<std::string> RedisMetadata::get_all_running_models() {
   Command<std::vector<std::string>>& c_runmod_set =
-      rdx_.commandSync<std::vector<std::string>>({"SMEMBERS", RUNMODS_SET});
+      rdx().commandSync<std::vector<std::string>>({"SMEMBERS", RUNMODS_SET});
   if (!c_runmod_set.ok()) {
     return {};  // TODO: return more valid error
   }
@@ -812,7 +764,7 @@ double RedisMetadata::get_load_lat(const std::string& model_name) {
   const std::string load_lat_name = parent_model + LOADLAT_SUFF;
 
   Command<std::string>& c_load_lat_sset =
-      rdx_.commandSync<std::string>({"ZSCORE", load_lat_name, model_name});
+      rdx().commandSync<std::string>({"ZSCORE", load_lat_name, model_name});
   if (!c_load_lat_sset.ok()) { return -1.0; }
   std::string reply = c_load_lat_sset.reply();
 
@@ -828,7 +780,7 @@ double RedisMetadata::get_inf_lat(const std::string& model_name) {
   const std::string inf_lat_name = parent_model + INFLAT_SUFF;
 
   Command<std::string>& c_inf_lat_sset =
-      rdx_.commandSync<std::string>({"ZSCORE", inf_lat_name, model_name});
+      rdx().commandSync<std::string>({"ZSCORE", inf_lat_name, model_name});
   if (!c_inf_lat_sset.ok()) { return -1.0; }
   std::string reply = c_inf_lat_sset.reply();
 
@@ -844,7 +796,7 @@ double RedisMetadata::get_accuracy(const std::string& model_name) {
   const std::string model_acc_name = parent_model + ACCURACY_SUFF;
 
   Command<std::string>& c_acc_sset =
-      rdx_.commandSync<std::string>({"ZSCORE", model_acc_name, model_name});
+      rdx().commandSync<std::string>({"ZSCORE", model_acc_name, model_name});
   if (!c_acc_sset.ok()) { return -1.0; }
   std::string reply = c_acc_sset.reply();
 
@@ -857,7 +809,7 @@ std::vector<std::string> RedisMetadata::inf_lat_bin(
   const std::string inf_lat_name = parent_model_name + INFLAT_SUFF;
 
   Command<std::vector<std::string>>& c_lat_bin =
-      rdx_.commandSync<std::vector<std::string>>(
+      rdx().commandSync<std::vector<std::string>>(
           {"ZRANGEBYSCORE", inf_lat_name, std::to_string(min_lat),
            std::to_string(max_lat), "LIMIT", "0", std::to_string(max_results)});
   if (!c_lat_bin.ok()) { return {}; }
@@ -873,7 +825,7 @@ std::vector<std::string> RedisMetadata::tot_lat_bin(
   const std::string tot_lat_name = parent_model_name + TOTLAT_SUFF;
 
   Command<std::vector<std::string>>& c_lat_bin =
-      rdx_.commandSync<std::vector<std::string>>(
+      rdx().commandSync<std::vector<std::string>>(
           {"ZRANGEBYSCORE", tot_lat_name, std::to_string(min_lat),
            std::to_string(max_lat), "LIMIT", "0", std::to_string(max_results)});
   if (!c_lat_bin.ok()) { return {}; }
@@ -889,7 +841,7 @@ std::vector<std::string> RedisMetadata::par_acc_bin(
   const std::string model_acc_name = parent_model_name + ACCURACY_SUFF;
 
   Command<std::vector<std::string>>& c_acc_bin =
-      rdx_.commandSync<std::vector<std::string>>(
+      rdx().commandSync<std::vector<std::string>>(
           {"ZRANGEBYSCORE", model_acc_name, std::to_string(min_acc), "+inf",
            "LIMIT", "0", std::to_string(max_results)});
   if (!c_acc_bin.ok()) { return {}; }
@@ -926,7 +878,7 @@ std::vector<std::string> RedisMetadata::gpar_acc_bin(
         grandparent_model_name + "-" + std::to_string(i) + "-" + GPARACC_SUFF;
 
     Command<std::vector<std::string>>& c_gpar_acc_bin =
-        rdx_.commandSync<std::vector<std::string>>(
+        rdx().commandSync<std::vector<std::string>>(
             {"ZRANGEBYSCORE", gpar_acc_name, std::to_string(min_acc), "+inf",
              "LIMIT", "0", std::to_string(max_results)});
     if (!c_gpar_acc_bin.ok()) { return {}; }
@@ -941,6 +893,25 @@ std::vector<std::string> RedisMetadata::gpar_acc_bin(
   return {};
 }
 
+std::vector<std::string> RedisMetadata::get_all_gpar_variants(
+    const std::string& grandparent_model_name) {
+  std::vector<std::string> all_var;
+  for (int i = 0; i < num_gpar_bins; ++i) {
+    const std::string gpar_acc_name =
+        grandparent_model_name + "-" + std::to_string(i) + "-" + GPARACC_SUFF;
+
+    Command<std::vector<std::string>>& c_gpar_var =
+        rdx().commandSync<std::vector<std::string>>(
+            {"ZRANGE", gpar_acc_name, "0", "-1"});
+    if (!c_gpar_var.ok()) { return {}; }
+
+    const std::vector<std::string>& reply = c_gpar_var.reply();
+    all_var.insert(all_var.end(), reply.begin(), reply.end());
+  }
+
+  return all_var;
+}
+
 int8_t RedisMetadata::add_running_model(const std::string& executor_name,
                                         const std::string& model_name) {
   // Check that model variant exists
@@ -959,41 +930,41 @@ int8_t RedisMetadata::add_running_model(const std::string& executor_name,
 
   const std::string model_qps_name = model_name + "-" + MODQPS_SUFF;
   Command<int>& c_modqps_sset =
-      rdx_.commandSync<int>({"ZADD", model_qps_name, "0.0", executor_name});
+      rdx().commandSync<int>({"ZADD", model_qps_name, "0.0", executor_name});
   if (!c_modqps_sset.ok()) { return -1; }
 
   // Update executor-to-model variant set
   const std::string exec_mvar_name = executor_name + "-" + EXECMVAR_SUFF;
   Command<int>& c_exec_mvar_set =
-      rdx_.commandSync<int>({"SADD", exec_mvar_name, model_name});
+      rdx().commandSync<int>({"SADD", exec_mvar_name, model_name});
   if (!c_exec_mvar_set.ok()) { return -1; }
 
   // Update executor-to-model set
   const std::string exec_mod_name = executor_name + "-" + EXECMOD_SUFF;
   Command<int>& c_exec_mod_set =
-      rdx_.commandSync<int>({"SADD", exec_mod_name, parent_model});
+      rdx().commandSync<int>({"SADD", exec_mod_name, parent_model});
   if (!c_exec_mod_set.ok()) { return -1; }
 
   // Update running model variants
   const std::string running_modvar = model_name + "-" + RUNMVARS_SUFF;
   Command<int>& c_runningmvar_set =
-      rdx_.commandSync<int>({"INCR", running_modvar});
+      rdx().commandSync<int>({"INCR", running_modvar});
   if (!c_runningmvar_set.ok()) { return -1; }
 
   // Add to all running model variants list
   Command<int>& c_allrunning_set =
-      rdx_.commandSync<int>({"SADD", RUNMODS_SET, model_name});
+      rdx().commandSync<int>({"SADD", RUNMODS_SET, model_name});
   if (!c_allrunning_set.ok()) { return -1; }
 
   // Update running model
   const std::string running_mods = parent_model + "-" + RUNMODS_SUFF;
   Command<int>& c_runningmod_set =
-      rdx_.commandSync<int>({"INCR", running_mods});
+      rdx().commandSync<int>({"INCR", running_mods});
   if (!c_runningmod_set.ok()) { return -1; }
 
   // Update parent-model variant running set
   const std::string parent_child_name = parent_model + "-" + RUNCHILD_SUFF;
-  Command<std::string>& c_parent_child_set = rdx_.commandSync<std::string>(
+  Command<std::string>& c_parent_child_set = rdx().commandSync<std::string>(
       {"ZINCRBY", parent_child_name, "1", model_name});
   if (!c_parent_child_set.ok()) { return -1; }
 
@@ -1002,11 +973,11 @@ int8_t RedisMetadata::add_running_model(const std::string& executor_name,
       executor_name + "-" + parent_model + "-" + RUNCHIEX_SUFF;
   if (key_exists(exec_parent_child_name)) {
     Command<int>& c_exec_parent_child_set =
-        rdx_.commandSync<int>({"INCR", exec_parent_child_name});
+        rdx().commandSync<int>({"INCR", exec_parent_child_name});
     if (!c_exec_parent_child_set.ok()) { return -1; }
   } else {
     Command<std::string>& c_set_exec_par_child_set =
-        rdx_.commandSync<std::string>({"SET", exec_parent_child_name, "1"});
+        rdx().commandSync<std::string>({"SET", exec_parent_child_name, "1"});
     if (!c_set_exec_par_child_set.ok()) { return -1; }
   }
 
@@ -1051,7 +1022,7 @@ int8_t RedisMetadata::remove_running_model(const std::string& executor_name,
   // Remove from executor's running model variant list
   const std::string exec_mvar_name = executor_name + "-" + EXECMVAR_SUFF;
   Command<int>& c_exec_mvar_set =
-      rdx_.commandSync<int>({"SREM", exec_mvar_name, model_name});
+      rdx().commandSync<int>({"SREM", exec_mvar_name, model_name});
   if (!c_exec_mvar_set.ok()) { return -1; }
 
   // Get parent model
@@ -1061,7 +1032,7 @@ int8_t RedisMetadata::remove_running_model(const std::string& executor_name,
   const std::string exec_parent_child_name =
       executor_name + "-" + parent_model + "-" + RUNCHIEX_SUFF;
   Command<int>& c_exec_parent_child_set =
-      rdx_.commandSync<int>({"DECR", exec_parent_child_name});
+      rdx().commandSync<int>({"DECR", exec_parent_child_name});
   if (!c_exec_parent_child_set.ok()) { return -1; }
 
   // Remove executor's running parent model set and counter if no children are
@@ -1071,71 +1042,71 @@ int8_t RedisMetadata::remove_running_model(const std::string& executor_name,
     // Remove executor's running parent model list
     const std::string exec_mod_name = executor_name + "-" + EXECMOD_SUFF;
     Command<int>& c_execmod_set =
-        rdx_.commandSync<int>({"SREM", exec_mod_name, parent_model});
+        rdx().commandSync<int>({"SREM", exec_mod_name, parent_model});
     if (!c_execmod_set.ok()) { return -1; }
 
     // Remove counter
     Command<int>& c_exec_par_mod_count =
-        rdx_.commandSync<int>({"DEL", exec_parent_child_name});
+        rdx().commandSync<int>({"DEL", exec_parent_child_name});
     if (!c_exec_par_mod_count.ok()) { return -1; }
   }
 
   // Remove executor from model's QPS set
   const std::string model_qps_name = model_name + "-" + MODQPS_SUFF;
   Command<int>& c_mod_qps_del =
-      rdx_.commandSync<int>({"ZREM", model_qps_name, executor_name});
+      rdx().commandSync<int>({"ZREM", model_qps_name, executor_name});
   if (!c_mod_qps_del.ok()) { return -1; }
 
   // Remove executor from model's average latency set
   const std::string model_avglat_name = model_name + "-" + MODAVGLAT_SUFF;
   Command<int>& c_mod_avglat_del =
-      rdx_.commandSync<int>({"ZREM", model_avglat_name, executor_name});
+      rdx().commandSync<int>({"ZREM", model_avglat_name, executor_name});
   if (!c_mod_avglat_del.ok()) { return -1; }
 
   // Delete model variant-executor avglat key
   const std::string blist_mod_name =
       executor_name + "-" + model_name + "-" + BLISTMOD_SUFF;
-  Command<int>& c_blist_mod = rdx_.commandSync<int>({"DEL", blist_mod_name});
+  Command<int>& c_blist_mod = rdx().commandSync<int>({"DEL", blist_mod_name});
   if (!c_blist_mod.ok()) { return -1; }
 
   // Decrement running models
   const std::string running_mods = parent_model + "-" + RUNMODS_SUFF;
-  Command<int>& c_runningmod = rdx_.commandSync<int>({"DECR", running_mods});
+  Command<int>& c_runningmod = rdx().commandSync<int>({"DECR", running_mods});
   if (!c_runningmod.ok()) { return -1; }
 
   int16_t runmod_reply = c_runningmod.reply();
   if (runmod_reply == 0) {  // Not running anywhere, delete
-    Command<int>& c_del_rmod = rdx_.commandSync<int>({"DEL", running_mods});
+    Command<int>& c_del_rmod = rdx().commandSync<int>({"DEL", running_mods});
     if (!c_del_rmod.ok()) { return -1; }
 
     Command<int>& c_allrunning_set =
-        rdx_.commandSync<int>({"SREM", RUNMODS_SET, model_name});
+        rdx().commandSync<int>({"SREM", RUNMODS_SET, model_name});
     if (!c_allrunning_set.ok()) { return -1; }
   }
 
   // Decrement running model variants
   const std::string running_modvar = model_name + "-" + RUNMVARS_SUFF;
   Command<int>& c_runningmodvar =
-      rdx_.commandSync<int>({"DECR", running_modvar});
+      rdx().commandSync<int>({"DECR", running_modvar});
   if (!c_runningmodvar.ok()) { return -1; }
 
   int16_t runmodvar_reply = c_runningmodvar.reply();
   if (runmodvar_reply == 0) {  // Not running anywhere, delete
     Command<int>& c_del_rmodvar =
-        rdx_.commandSync<int>({"DEL", running_modvar});
+        rdx().commandSync<int>({"DEL", running_modvar});
     if (!c_del_rmodvar.ok()) { return -1; }
   }
 
   // Decrement parent-model variant running set
   const std::string parent_child_name = parent_model + "-" + RUNCHILD_SUFF;
-  Command<std::string>& c_parent_child_set = rdx_.commandSync<std::string>(
+  Command<std::string>& c_parent_child_set = rdx().commandSync<std::string>(
       {"ZINCRBY", parent_child_name, "-1", model_name});
   if (!c_parent_child_set.ok()) { return -1; }
 
   int16_t pc_reply = std::stoi(c_parent_child_set.reply());
   if (pc_reply == 0) {  // No versions of this model are running.
     Command<int>& c_del_parent_child =
-        rdx_.commandSync<int>({"ZREM", parent_child_name, model_name});
+        rdx().commandSync<int>({"ZREM", parent_child_name, model_name});
     if (!c_del_parent_child.ok()) { return -1; }
   }
 
@@ -1228,7 +1199,7 @@ std::vector<std::string> RedisMetadata::get_parent_models_on_executor(
     const std::string& executor_name) {
   const std::string exec_mod_name = executor_name + "-" + EXECMOD_SUFF;
   Command<std::vector<std::string>>& c_execmod_set =
-      rdx_.commandSync<std::vector<std::string>>({"SMEMBERS", exec_mod_name});
+      rdx().commandSync<std::vector<std::string>>({"SMEMBERS", exec_mod_name});
   if (!c_execmod_set.ok()) {
     return {};  // TODO: return more valid error
   }
@@ -1242,7 +1213,7 @@ std::vector<std::string> RedisMetadata::get_variants_on_executor(
     const std::string& executor_name) {
   const std::string exec_mvar_name = executor_name + "-" + EXECMVAR_SUFF;
   Command<std::vector<std::string>>& c_execmvar_set =
-      rdx_.commandSync<std::vector<std::string>>({"SMEMBERS", exec_mvar_name});
+      rdx().commandSync<std::vector<std::string>>({"SMEMBERS", exec_mvar_name});
   if (!c_execmvar_set.ok()) {
     return {};  // TODO: return more valid error
   }
@@ -1291,7 +1262,7 @@ std::string RedisMetadata::get_model_info(const std::string& model_name,
 
   // Look-up based on metadata name
   Command<std::string>& c_md =
-      rdx_.commandSync<std::string>({"HGET", model_info_name, info});
+      rdx().commandSync<std::string>({"HGET", model_info_name, info});
   if (!c_md.ok()) { return "FAIL"; }
   std::string reply = c_md.reply();
 
@@ -1317,7 +1288,7 @@ int8_t RedisMetadata::update_parentmodel_qps(
   // Update each parent model's sorted set
   for (auto am : agg_map) {
     const std::string model_qps_name = am.first + "-" + MODQPS_SUFF;
-    Command<int>& c_mod_qps_sset = rdx_.commandSync<int>(
+    Command<int>& c_mod_qps_sset = rdx().commandSync<int>(
         {"ZADD", model_qps_name, std::to_string(am.second), executor_name});
     if (!c_mod_qps_sset.ok()) { return -1; }
   }
@@ -1337,7 +1308,7 @@ int8_t RedisMetadata::update_model_qps(const std::string& executor_name,
 
   // Add to sorted set
   const std::string model_qps_name = model_name + "-" + MODQPS_SUFF;
-  Command<int>& c_mod_qps_sset = rdx_.commandSync<int>(
+  Command<int>& c_mod_qps_sset = rdx().commandSync<int>(
       {"ZADD", model_qps_name, std::to_string(qps), executor_name});
   if (!c_mod_qps_sset.ok()) { return -1; }
 
@@ -1351,7 +1322,7 @@ double RedisMetadata::get_model_qps(const std::string& executor_name,
 
   const std::string model_qps_name = model_name + "-" + MODQPS_SUFF;
   Command<std::string>& c_modqps_sset =
-      rdx_.commandSync<std::string>({"ZSCORE", model_qps_name, executor_name});
+      rdx().commandSync<std::string>({"ZSCORE", model_qps_name, executor_name});
   if (!c_modqps_sset.ok()) { return -1.0; }
   std::string reply = c_modqps_sset.reply();
 
@@ -1371,7 +1342,7 @@ std::vector<std::string> RedisMetadata::min_qps_name(
   const std::string model_qps_name = model_name + "-" + MODQPS_SUFF;
   // Set stays sorted, so we request the bottom element
   Command<std::vector<std::string>>& c_min_qps =
-      rdx_.commandSync<std::vector<std::string>>(
+      rdx().commandSync<std::vector<std::string>>(
           {"ZRANGEBYSCORE", model_qps_name, "-inf", "+inf", "LIMIT", "0",
            std::to_string(max_results)});
   if (!c_min_qps.ok()) { return {}; }
@@ -1393,7 +1364,7 @@ double RedisMetadata::get_min_qps(const std::string& model_name) {
   const std::string model_qps_name = model_name + "-" + MODQPS_SUFF;
   // Set stays sorted, so we request the bottom element
   Command<std::vector<std::string>>& c_min_qps =
-      rdx_.commandSync<std::vector<std::string>>(
+      rdx().commandSync<std::vector<std::string>>(
           {"ZRANGEBYSCORE", model_qps_name, "-inf", "+inf", "LIMIT", "0", "1"});
   if (!c_min_qps.ok()) { return -1.0; }
 
@@ -1417,7 +1388,7 @@ int8_t RedisMetadata::update_model_avglat(const std::string& executor_name,
 
   // Add to sorted set
   const std::string model_avglat_name = model_name + "-" + MODAVGLAT_SUFF;
-  Command<int>& c_mod_avglat_sset = rdx_.commandSync<int>(
+  Command<int>& c_mod_avglat_sset = rdx().commandSync<int>(
       {"ZADD", model_avglat_name, std::to_string(avg_lat), executor_name});
   if (!c_mod_avglat_sset.ok()) { return -1; }
 
@@ -1430,7 +1401,7 @@ double RedisMetadata::get_model_avglat(const std::string& executor_name,
   if (!modelvar_exists(model_name)) { return -1.0; }
 
   const std::string model_avglat_name = model_name + "-" + MODAVGLAT_SUFF;
-  Command<std::string>& c_mod_avglat_sset = rdx_.commandSync<std::string>(
+  Command<std::string>& c_mod_avglat_sset = rdx().commandSync<std::string>(
       {"ZSCORE", model_avglat_name, executor_name});
   if (!c_mod_avglat_sset.ok()) { return -1.0; }
   std::string reply = c_mod_avglat_sset.reply();
@@ -1450,7 +1421,7 @@ int8_t RedisMetadata::set_model_avglat_blacklist(
   const std::string blist_mod_name =
       executor_name + "-" + model_name + "-" + BLISTMOD_SUFF;
   Command<std::string>& c_blist_mod =
-      rdx_.commandSync<std::string>({"SET", blist_mod_name, "1"});
+      rdx().commandSync<std::string>({"SET", blist_mod_name, "1"});
   if (!c_blist_mod.ok()) { return -1; }
   return 0;
 }
@@ -1467,7 +1438,7 @@ int8_t RedisMetadata::unset_model_avglat_blacklist(
   const std::string blist_mod_name =
       executor_name + "-" + model_name + "-" + BLISTMOD_SUFF;
   Command<std::string>& c_blist_mod =
-      rdx_.commandSync<std::string>({"SET", blist_mod_name, "0"});
+      rdx().commandSync<std::string>({"SET", blist_mod_name, "0"});
   if (!c_blist_mod.ok()) { return -1; }
   return 0;
 }
@@ -1484,7 +1455,7 @@ int8_t RedisMetadata::get_model_avglat_blacklist(
   const std::string blist_mod_name =
       executor_name + "-" + model_name + "-" + BLISTMOD_SUFF;
   Command<std::string>& c_blist_mod =
-      rdx_.commandSync<std::string>({"GET", blist_mod_name});
+      rdx().commandSync<std::string>({"GET", blist_mod_name});
   if (!c_blist_mod.ok()) { return -1; }
 
   int8_t reply = std::stoi(c_blist_mod.reply());
@@ -1505,7 +1476,7 @@ int8_t RedisMetadata::set_parent_scaledown(
   const std::string scaledown_name =
       executor_name + "-" + parent_model_name + "-" + SDOWN_SUFF;
   Command<std::string>& c_sdown_pmod =
-      rdx_.commandSync<std::string>({"SET", scaledown_name, "1"});
+      rdx().commandSync<std::string>({"SET", scaledown_name, "1"});
   if (!c_sdown_pmod.ok()) { return -1; }
   return 0;
 }
@@ -1523,7 +1494,7 @@ int8_t RedisMetadata::unset_parent_scaledown(
   const std::string scaledown_name =
       executor_name + "-" + parent_model_name + "-" + SDOWN_SUFF;
   Command<std::string>& c_sdown_pmod =
-      rdx_.commandSync<std::string>({"SET", scaledown_name, "0"});
+      rdx().commandSync<std::string>({"SET", scaledown_name, "0"});
   if (!c_sdown_pmod.ok()) { return -1; }
   return 0;
 }
@@ -1541,7 +1512,7 @@ int8_t RedisMetadata::get_parent_scaledown(
   const std::string scaledown_name =
       executor_name + "-" + parent_model_name + "-" + SDOWN_SUFF;
   Command<std::string>& c_sdown_pmod =
-      rdx_.commandSync<std::string>({"GET", scaledown_name});
+      rdx().commandSync<std::string>({"GET", scaledown_name});
   if (!c_sdown_pmod.ok()) { return -1; }
 
   int8_t reply = std::stoi(c_sdown_pmod.reply());
@@ -1555,7 +1526,7 @@ int8_t RedisMetadata::set_model_load_unload(const std::string& model_name) {
 
   const std::string load_unl_name = model_name + "-" + LOADUNL_SUFF;
   Command<std::string>& c_loadunl_mod =
-      rdx_.commandSync<std::string>({"SET", load_unl_name, "1"});
+      rdx().commandSync<std::string>({"SET", load_unl_name, "1"});
   if (!c_loadunl_mod.ok()) { return -1; }
   return 0;
 }
@@ -1566,7 +1537,7 @@ int8_t RedisMetadata::unset_model_load_unload(const std::string& model_name) {
 
   const std::string load_unl_name = model_name + "-" + LOADUNL_SUFF;
   Command<std::string>& c_loadunl_mod =
-      rdx_.commandSync<std::string>({"SET", load_unl_name, "0"});
+      rdx().commandSync<std::string>({"SET", load_unl_name, "0"});
   if (!c_loadunl_mod.ok()) { return -1; }
   return 0;
 }
@@ -1577,7 +1548,7 @@ int8_t RedisMetadata::get_model_load_unload(const std::string& model_name) {
 
   const std::string load_unl_name = model_name + "-" + LOADUNL_SUFF;
   Command<std::string>& c_loadunl_mod =
-      rdx_.commandSync<std::string>({"GET", load_unl_name});
+      rdx().commandSync<std::string>({"GET", load_unl_name});
   if (!c_loadunl_mod.ok()) { return -1; }
 
   int8_t reply = std::stoi(c_loadunl_mod.reply());
@@ -1599,18 +1570,18 @@ int8_t RedisMetadata::delete_model(const std::string& model_name) {
   // Remove model info hash lookup table
   const std::string model_info_name = model_name + "-" + MODINFO_SUFF;
   Command<int>& c_del_modinfo_htable =
-      rdx_.commandSync<int>({"DEL", model_info_name});
+      rdx().commandSync<int>({"DEL", model_info_name});
   if (!c_del_modinfo_htable.ok()) { return -1; }
 
   // Remove model load/unload key
   const std::string load_unl_name = model_name + "-" + LOADUNL_SUFF;
-  Command<int>& c_del_loadunl = rdx_.commandSync<int>({"DEL", load_unl_name});
+  Command<int>& c_del_loadunl = rdx().commandSync<int>({"DEL", load_unl_name});
   if (!c_del_loadunl.ok()) { return -1; }
 
   // Check if the model was running
   const std::string model_qps_name = model_name + "-" + MODQPS_SUFF;
   Command<std::set<std::string>>& c_exec_qps =
-      rdx_.commandSync<std::set<std::string>>(
+      rdx().commandSync<std::set<std::string>>(
           {"ZRANGE", model_qps_name, "0", "-1"});
   if (!c_exec_qps.ok()) { return -1; }
 
@@ -1618,33 +1589,33 @@ int8_t RedisMetadata::delete_model(const std::string& model_name) {
   for (auto exec : reply) { remove_running_model(exec, model_name); }
 
   // Remove model QPS set
-  Command<int>& c_mod_qps_del = rdx_.commandSync<int>({"DEL", model_qps_name});
+  Command<int>& c_mod_qps_del = rdx().commandSync<int>({"DEL", model_qps_name});
   if (!c_mod_qps_del.ok()) { return -1; }
 
   // Remove from model set
   Command<int>& c_del_model_set =
-      rdx_.commandSync<int>({"SREM", MODELVAR_SET, model_name});
+      rdx().commandSync<int>({"SREM", MODELVAR_SET, model_name});
   if (!c_del_model_set.ok()) { return -1; }
 
   // Remove grandparent model->model variant key
   const std::string var_gpar_name = model_name + "-" + GPARENT_SUFF;
-  Command<int>& c_var_gpar = rdx_.commandSync<int>({"DEL", var_gpar_name});
+  Command<int>& c_var_gpar = rdx().commandSync<int>({"DEL", var_gpar_name});
   if (!c_var_gpar.ok()) { return -1; }
 
   // Remove model->model variant key
   const std::string var_par_name = model_name + "-" + PARENT_SUFF;
-  Command<int>& c_var_par = rdx_.commandSync<int>({"DEL", var_par_name});
+  Command<int>& c_var_par = rdx().commandSync<int>({"DEL", var_par_name});
   if (!c_var_par.ok()) { return -1; }
 
   // Remove from grandparent accuracy bin
   const std::string gpar_bin_name = model_name + "-" + GPARACCBIN_SUFF;
-  Command<int>& c_bin_num = rdx_.commandSync<int>({"DEL", gpar_bin_name});
+  Command<int>& c_bin_num = rdx().commandSync<int>({"DEL", gpar_bin_name});
   if (!c_bin_num.ok()) { return -1; }
 
   // Remove from parent's list of children
   const std::string par_child_name = parent_model + "-" + MODVAR_SUFF;
   Command<int>& c_var_par_rem =
-      rdx_.commandSync<int>({"ZREM", par_child_name, model_name});
+      rdx().commandSync<int>({"ZREM", par_child_name, model_name});
   if (!c_var_par_rem.ok()) { return -1; }
 
   // Check if deleting this model causes the parent to only have PyTorch models
@@ -1662,7 +1633,7 @@ int8_t RedisMetadata::update_cpu_util(const std::string& executor_name,
   }
 
   // Add to sorted set
-  Command<int>& c_cpu_sset = rdx_.commandSync<int>(
+  Command<int>& c_cpu_sset = rdx().commandSync<int>(
       {"ZADD", CPUUTIL_SET, std::to_string(utilization), executor_name});
   if (!c_cpu_sset.ok()) { return -1; }
 
@@ -1678,7 +1649,7 @@ int8_t RedisMetadata::update_gpu_util(const std::string& executor_name,
   }
 
   // Add to sorted set
-  Command<int>& c_gpu_sset = rdx_.commandSync<int>(
+  Command<int>& c_gpu_sset = rdx().commandSync<int>(
       {"ZADD", GPUUTIL_SET, std::to_string(utilization), executor_name});
   if (!c_gpu_sset.ok()) { return -1; }
 
@@ -1694,7 +1665,7 @@ int8_t RedisMetadata::update_inferentia_util(const std::string& executor_name,
   }
 
   // Add to sorted set
-  Command<int>& c_inferentia_sset = rdx_.commandSync<int>(
+  Command<int>& c_inferentia_sset = rdx().commandSync<int>(
       {"ZADD", INFERENTIAUTIL_SET, std::to_string(utilization), executor_name});
   if (!c_inferentia_sset.ok()) { return -1; }
 
@@ -1706,7 +1677,7 @@ double RedisMetadata::get_cpu_util(const std::string& executor_name) {
   if (!key_exists(executor_name)) { return -1.0; }
 
   Command<std::string>& c_cpu_util =
-      rdx_.commandSync<std::string>({"ZSCORE", CPUUTIL_SET, executor_name});
+      rdx().commandSync<std::string>({"ZSCORE", CPUUTIL_SET, executor_name});
   if (!c_cpu_util.ok()) { return -1.0; }
   std::string reply = c_cpu_util.reply();
 
@@ -1718,7 +1689,7 @@ double RedisMetadata::get_gpu_util(const std::string& executor_name) {
   if (!key_exists(executor_name)) { return -1.0; }
 
   Command<std::string>& c_gpu_util =
-      rdx_.commandSync<std::string>({"ZSCORE", GPUUTIL_SET, executor_name});
+      rdx().commandSync<std::string>({"ZSCORE", GPUUTIL_SET, executor_name});
   if (!c_gpu_util.ok()) { return -1.0; }
   std::string reply = c_gpu_util.reply();
 
@@ -1730,7 +1701,7 @@ double RedisMetadata::get_inferentia_util(const std::string& executor_name) {
   if (!key_exists(executor_name)) { return -1.0; }
 
   Command<std::string>& c_inferentia_util =
-      rdx_.commandSync<std::string>({"ZSCORE", INFERENTIAUTIL_SET, executor_name});
+      rdx().commandSync<std::string>({"ZSCORE", INFERENTIAUTIL_SET, executor_name});
   if (!c_inferentia_util.ok()) { return -1.0; }
   std::string reply = c_inferentia_util.reply();
 
@@ -1741,7 +1712,7 @@ std::vector<std::string> RedisMetadata::max_cpu_util_name(
     const double& max_thresh, const int8_t& max_results) {
   // Set stays sorted, so we request the top element
   Command<std::vector<std::string>>& c_cpu_util =
-      rdx_.commandSync<std::vector<std::string>>(
+      rdx().commandSync<std::vector<std::string>>(
           {"ZREVRANGEBYSCORE", CPUUTIL_SET, std::to_string(max_thresh), "-inf",
            "LIMIT", "0", std::to_string(max_results)});
   if (!c_cpu_util.ok()) { return {}; }
@@ -1755,7 +1726,7 @@ std::vector<std::string> RedisMetadata::min_cpu_util_name(
     const int8_t& max_results) {
   // Set stays sorted, so we request the bottom element
   Command<std::vector<std::string>>& c_cpu_util =
-      rdx_.commandSync<std::vector<std::string>>({"ZRANGEBYSCORE", CPUUTIL_SET,
+      rdx().commandSync<std::vector<std::string>>({"ZRANGEBYSCORE", CPUUTIL_SET,
                                                   "-inf", "+inf", "LIMIT", "0",
                                                   std::to_string(max_results)});
   if (!c_cpu_util.ok()) { return {}; }
@@ -1768,7 +1739,7 @@ std::vector<std::string> RedisMetadata::min_cpu_util_name(
 double RedisMetadata::get_min_cpu_util() {
   // Set stays sorted, so we request the bottom element
   Command<std::vector<std::string>>& c_cpu_util =
-      rdx_.commandSync<std::vector<std::string>>(
+      rdx().commandSync<std::vector<std::string>>(
           {"ZRANGEBYSCORE", CPUUTIL_SET, "-inf", "+inf", "LIMIT", "0", "1"});
   if (!c_cpu_util.ok()) { return -1.0; }
 
@@ -1784,7 +1755,7 @@ std::vector<std::string> RedisMetadata::max_gpu_util_name(
     const double& max_thresh, const int8_t& max_results) {
   // Set stays sorted, so we request the top element
   Command<std::vector<std::string>>& c_gpu_util =
-      rdx_.commandSync<std::vector<std::string>>(
+      rdx().commandSync<std::vector<std::string>>(
           {"ZREVRANGEBYSCORE", GPUUTIL_SET, std::to_string(max_thresh), "-inf",
            "LIMIT", "0", std::to_string(max_results)});
   if (!c_gpu_util.ok()) { return {}; }
@@ -1798,7 +1769,7 @@ std::vector<std::string> RedisMetadata::min_gpu_util_name(
     const int8_t& max_results) {
   // Set stays sorted, so we request the bottom element
   Command<std::vector<std::string>>& c_gpu_util =
-      rdx_.commandSync<std::vector<std::string>>({"ZRANGEBYSCORE", GPUUTIL_SET,
+      rdx().commandSync<std::vector<std::string>>({"ZRANGEBYSCORE", GPUUTIL_SET,
                                                   "-inf", "+inf", "LIMIT", "0",
                                                   std::to_string(max_results)});
   if (!c_gpu_util.ok()) { return {}; }
@@ -1811,7 +1782,7 @@ std::vector<std::string> RedisMetadata::min_gpu_util_name(
 double RedisMetadata::get_min_gpu_util() {
   // Set stays sorted, so we request the bottom element
   Command<std::vector<std::string>>& c_gpu_util =
-      rdx_.commandSync<std::vector<std::string>>(
+      rdx().commandSync<std::vector<std::string>>(
           {"ZRANGEBYSCORE", GPUUTIL_SET, "-inf", "+inf", "LIMIT", "0", "1"});
   if (!c_gpu_util.ok()) { return -1.0; }
 
@@ -1827,7 +1798,7 @@ std::vector<std::string> RedisMetadata::max_inferentia_util_name(
     const double& max_thresh, const int8_t& max_results) {
   // Set stays sorted, so we request the top element
   Command<std::vector<std::string>>& c_inferentia_util =
-      rdx_.commandSync<std::vector<std::string>>(
+      rdx().commandSync<std::vector<std::string>>(
           {"ZREVRANGEBYSCORE", INFERENTIAUTIL_SET, std::to_string(max_thresh), "-inf",
            "LIMIT", "0", std::to_string(max_results)});
   if (!c_inferentia_util.ok()) { return {}; }
@@ -1841,7 +1812,7 @@ std::vector<std::string> RedisMetadata::min_inferentia_util_name(
     const int8_t& max_results) {
   // Set stays sorted, so we request the bottom element
   Command<std::vector<std::string>>& c_inferentia_util =
-      rdx_.commandSync<std::vector<std::string>>({"ZRANGEBYSCORE", INFERENTIAUTIL_SET,
+      rdx().commandSync<std::vector<std::string>>({"ZRANGEBYSCORE", INFERENTIAUTIL_SET,
                                                   "-inf", "+inf", "LIMIT", "0",
                                                   std::to_string(max_results)});
   if (!c_inferentia_util.ok()) { return {}; }
@@ -1854,7 +1825,7 @@ std::vector<std::string> RedisMetadata::min_inferentia_util_name(
 double RedisMetadata::get_min_inferentia_util() {
   // Set stays sorted, so we request the bottom element
   Command<std::vector<std::string>>& c_inferentia_util =
-      rdx_.commandSync<std::vector<std::string>>(
+      rdx().commandSync<std::vector<std::string>>(
           {"ZRANGEBYSCORE", INFERENTIAUTIL_SET, "-inf", "+inf", "LIMIT", "0", "1"});
   if (!c_inferentia_util.ok()) { return -1.0; }
 
@@ -1866,6 +1837,140 @@ double RedisMetadata::get_min_inferentia_util() {
   return min_util;
 }
 
+std::vector<std::vector<std::string>> RedisMetadata::get_model_info_multi(
+    const std::vector<std::string>& model_names,
+    const std::vector<std::string>& infos) {
+  std::vector<std::vector<std::string>> result(
+      model_names.size(), std::vector<std::string>(infos.size(), "FAIL"));
+  if (model_names.empty() || infos.empty()) { return result; }
+
+  // One HMGET per model. A missing hash or field comes back as nil
+  std::vector<std::vector<std::string>> cmds;
+  for (const std::string& mn : model_names) {
+    std::vector<std::string> cmd = {"HMGET", mn + "-" + MODINFO_SUFF};
+    cmd.insert(cmd.end(), infos.begin(), infos.end());
+    cmds.push_back(cmd);
+  }
+
+  pipeline<redisReply*>(cmds, [&](size_t i, Command<redisReply*>& c) {
+    if (!c.ok()) { return; }
+    redisReply* r = c.reply();
+    if ((r == nullptr) || (r->type != REDIS_REPLY_ARRAY)) { return; }
+    for (size_t j = 0; (j < r->elements) && (j < infos.size()); ++j) {
+      redisReply* e = r->element[j];
+      if (e->type == REDIS_REPLY_STRING) {
+        result[i][j] = std::string(e->str, e->len);
+      }
+    }
+  });
+
+  return result;
+}
+
+std::vector<int8_t> RedisMetadata::is_model_running_multi(
+    const std::vector<std::string>& model_names,
+    const std::string& executor_name) {
+  std::vector<int8_t> result(model_names.size(), -1);
+  if (model_names.empty()) { return result; }
+
+  // For each model: registered check, then the running check
+  std::vector<std::vector<std::string>> cmds;
+  for (const std::string& mn : model_names) {
+    cmds.push_back({"SISMEMBER", MODELVAR_SET, mn});
+    if (executor_name.empty()) {
+      cmds.push_back({"EXISTS", mn + "-" + RUNMVARS_SUFF});
+    } else {
+      cmds.push_back({"SISMEMBER", executor_name + "-" + EXECMVAR_SUFF, mn});
+    }
+  }
+
+  std::vector<int> replies(cmds.size(), 0);
+  pipeline<int>(cmds, [&](size_t i, Command<int>& c) {
+    if (c.ok()) { replies[i] = c.reply(); }
+  });
+
+  for (size_t i = 0; i < model_names.size(); ++i) {
+    if (replies[2 * i] != 1) {
+      std::cout << "[Redis Metadata]: " << model_names[i]
+                << " is not registered" << std::endl;
+      continue;
+    }
+    result[i] = (replies[2 * i + 1] == 1) ? 1 : 0;
+  }
+
+  return result;
+}
+
+std::vector<double> RedisMetadata::get_model_qps_multi(
+    const std::string& executor_name,
+    const std::vector<std::string>& model_names) {
+  std::vector<double> result(model_names.size(), -1.0);
+  if (model_names.empty()) { return result; }
+
+  // ZSCORE of an unregistered model's (nonexistent) set is nil, which fails
+  // the command and leaves -1.0. The callbacks run on the event loop thread,
+  // so a value that does not parse is treated as missing rather than thrown.
+  std::vector<std::vector<std::string>> cmds;
+  for (const std::string& mn : model_names) {
+    cmds.push_back({"ZSCORE", mn + "-" + MODQPS_SUFF, executor_name});
+  }
+
+  pipeline<std::string>(cmds, [&](size_t i, Command<std::string>& c) {
+    if (!c.ok()) { return; }
+    const std::string& reply = c.reply();
+    char* end = nullptr;
+    errno = 0;
+    const double qps = strtod(reply.c_str(), &end);
+    if ((errno == 0) && !reply.empty() && (*end == '\0')) { result[i] = qps; }
+  });
+
+  return result;
+}
+
+int8_t RedisMetadata::update_model_stats_batch(
+    const std::string& executor_name, const std::vector<ModelStats>& stats) {
+  if (stats.empty()) { return 0; }
+
+  // Checks that the model is registered and sets both of its scores in one
+  // command, so the whole batch is a single pipelined round trip. Returns 0
+  // for an unregistered model.
+  static const std::string update_script =
+      "if redis.call('SISMEMBER', KEYS[1], ARGV[1]) == 0 then return 0 end "
+      "redis.call('ZADD', KEYS[2], ARGV[2], ARGV[4]) "
+      "redis.call('ZADD', KEYS[3], ARGV[3], ARGV[4]) "
+      "return 1";
+
+  std::vector<std::vector<std::string>> cmds;
+  for (const ModelStats& ms : stats) {
+    cmds.push_back({"EVAL", update_script, "3", MODELVAR_SET,
+                    ms.model_name + "-" + MODQPS_SUFF,
+                    ms.model_name + "-" + MODAVGLAT_SUFF, ms.model_name,
+                    std::to_string(ms.qps), std::to_string(ms.avg_lat),
+                    executor_name});
+  }
+
+  // 1: updated, 0: not registered, -1: the command failed
+  std::vector<int> updated(stats.size(), -1);
+  pipeline<int>(cmds, [&](size_t i, Command<int>& c) {
+    if (c.ok()) { updated[i] = c.reply(); }
+  });
+
+  int8_t rc = 0;
+  for (size_t i = 0; i < stats.size(); ++i) {
+    if (updated[i] == 1) { continue; }
+    if (updated[i] == 0) {
+      std::cout << "[Redis Metadata]: " << stats[i].model_name
+                << " does not exist" << std::endl;
+    } else {
+      std::cout << "[Redis Metadata]: Failed to update the stats of "
+                << stats[i].model_name << std::endl;
+    }
+    rc = -1;
+  }
+
+  return rc;
+}
+
 bool RedisMetadata::is_empty_address(const struct Address& addr) {
   return ((addr.ip == empty_addr.ip) && (addr.port == empty_addr.port));
 }
@@ -1877,7 +1982,7 @@ const std::string RedisMetadata::Address_to_str(const struct Address& addr) {
 /*********************** Private Functions ***********************/
 
 bool RedisMetadata::key_exists(const std::string& key) {
-  Command<int>& c_exists = rdx_.commandSync<int>({"EXISTS", key});
+  Command<int>& c_exists = rdx().commandSync<int>({"EXISTS", key});
   int reply = c_exists.reply();
   if (reply == 1) {
     return true;
@@ -1888,7 +1993,7 @@ bool RedisMetadata::key_exists(const std::string& key) {
 
 bool RedisMetadata::set_member(const std::string& key,
                                const std::string& field) {
-  Command<int>& c_exists = rdx_.commandSync<int>({"SISMEMBER", key, field});
+  Command<int>& c_exists = rdx().commandSync<int>({"SISMEMBER", key, field});
   int reply = c_exists.reply();
   if (reply == 1) {
     return true;
@@ -1911,7 +2016,7 @@ bool RedisMetadata::modelvar_exists(const std::string& model) {
 
 bool RedisMetadata::hash_exists(const std::string& key,
                                 const std::string& field) {
-  Command<int>& c_exists = rdx_.commandSync<int>({"HEXISTS", key, field});
+  Command<int>& c_exists = rdx().commandSync<int>({"HEXISTS", key, field});
   int reply = c_exists.reply();
   if (reply == 1) {
     return true;
@@ -1936,12 +2041,51 @@ int8_t RedisMetadata::check_pytorch_status(const std::string& model) {
   const std::string pt_parent = model + "-" + PTONLY_SUFF;
   if (all_pt) {
     Command<std::string>& c_ptonly_set =
-        rdx_.commandSync<std::string>({"SET", pt_parent, "1"});
+        rdx().commandSync<std::string>({"SET", pt_parent, "1"});
     if (!c_ptonly_set.ok()) { return -1; }
   } else {
-    Command<int>& c_ptonly_del = rdx_.commandSync<int>({"DEL", pt_parent});
+    Command<int>& c_ptonly_del = rdx().commandSync<int>({"DEL", pt_parent});
     if (!c_ptonly_del.ok()) { return -1; }
   }
 
   return 0;
 }
+
+template <class ReplyT>
+void RedisMetadata::pipeline(
+    const std::vector<std::vector<std::string>>& cmds,
+    const std::function<void(size_t, Command<ReplyT>&)>& on_reply) {
+  if (cmds.empty()) { return; }
+
+  std::mutex pipe_mutex;
+  std::condition_variable pipe_cv;
+  size_t pending = cmds.size();
+
+  // Callbacks run on the redox event loop thread. Replies arrive in order,
+  // but the counter is what tells us the last one is in.
+  Redox& conn = rdx();
+  for (size_t i = 0; i < cmds.size(); ++i) {
+    conn.command<ReplyT>(cmds[i], [&, i](Command<ReplyT>& c) {
+      std::lock_guard<std::mutex> lock(pipe_mutex);
+      on_reply(i, c);
+      if (--pending == 0) { pipe_cv.notify_one(); }
+    });
+  }
+
+  std::unique_lock<std::mutex> lock(pipe_mutex);
+  pipe_cv.wait(lock, [&] { return pending == 0; });
+}
+
+int8_t RedisMetadata::pipeline_ok(
+    const std::vector<std::vector<std::string>>& cmds) {
+  bool all_ok = true;
+  pipeline<redisReply*>(cmds, [&](size_t i, Command<redisReply*>& c) {
+    if (!c.ok()) {
+      std::cout << "[Redis Metadata]: Pipelined " << cmds[i][0]
+                << " failed" << std::endl;
+      all_ok = false;
+    }
+  });
+
+  return all_ok ? 0 : -1;
+}
@@ -24,6 +24,7 @@
 #define REDIS_METADATA_H
 
 #include <cstdint>
+#include <functional>
 #include <set>
 #include <string>
 #include <utility>  // pair
@@ -31,6 +32,8 @@
 
 #include <redox.hpp>
 
+#include "redis_connection_pool.h"
+
 // INFaaS metadata suffixes and set names
 #define VMSCALE_KEY "vmscale"
 #define SLACKSCALE_KEY "slackscale"
@@ -80,6 +83,13 @@ struct Address {
   std::string port;
 };
 
+// Per-model statistics a worker reports in one update_model_stats_batch call
+struct ModelStats {
+  std::string model_name;
+  double qps;
+  double avg_lat;
+};
+
 // Accuracy bins for grandparent models.
 // Bins are allocated as {n,n+1} pairs (so there is one less bin than #values)
 static const double gpar_accuracy_bins[] = {0.0, 50.0, 70.0, 75.0, 78.0, 100.0};
@@ -87,7 +97,9 @@ static const int8_t num_gpar_bins = 5;
 
 class RedisMetadata {
 public:
-  RedisMetadata(struct Address redis_server);
+  // pool_size: number of Redis connections shared by this process' threads
+  RedisMetadata(struct Address redis_server,
+                const int pool_size = default_redis_pool_size);
 
 
   bool get_model(const std::string& model_name, ModelRecord* record);// PNB: Public equivalent to "bool get_model(const std::string& model_name, ModelRecord* record);"
@@ -247,6 +259,11 @@ public:
       const std::string& grandparent_model_name, const double& min_acc,
       const int8_t& max_results = 5);
 
+  // Get every model variant of a grandparent, in accuracy order across all
+  // of its accuracy bins
+  std::vector<std::string> get_all_gpar_variants(
+      const std::string& grandparent_model_name);
+
   // Add running model variant on an executor
   int8_t add_running_model(const std::string& executor_name,
                            const std::string& model_name);
@@ -410,6 +427,31 @@ public:
   // Get minimum Inferentia utilization across all executors
   double get_min_inferentia_util();
 
+  //// Batch APIs. Each call sends all of its commands back to back on one
+  //// connection (redox pipelines them), so a whole candidate set costs a
+  //// single network round trip instead of one per model.
+
+  // Get several info fields of several model variants. result[i][j] is field
+  // j of model i, or "FAIL" if the variant or the field does not exist
+  std::vector<std::vector<std::string>> get_model_info_multi(
+      const std::vector<std::string>& model_names,
+      const std::vector<std::string>& infos);
+
+  // Same as is_model_running for each model (-1 if not registered)
+  std::vector<int8_t> is_model_running_multi(
+      const std::vector<std::string>& model_names,
+      const std::string& executor_name = "");
+
+  // Same as get_model_qps for each model on one executor (-1.0 if missing)
+  std::vector<double> get_model_qps_multi(
+      const std::string& executor_name,
+      const std::vector<std::string>& model_names);
+
+  // Update QPS and average latency of several models on one executor.
+  // Unregistered models are skipped and make the call return -1
+  int8_t update_model_stats_batch(const std::string& executor_name,
+                                  const std::vector<ModelStats>& stats);
+
   // Convenient function to check if Address is empty Address
   static bool is_empty_address(const struct Address& addr);
 
@@ -421,13 +463,19 @@ public:
   // PNB: Methods added for DIFS (2026.01.20)
   //=========================================
 
+  // Reads how a worker runs model_name from the model:<name> hash. All
+  // fields but exec_protocol and version are required; exec_protocol
+  // ("argv" or "shm", see ModelSpec in worker/process_executor.h) comes
+  // back empty, meaning "argv", if unset, and so does version.
   int get_model_exec_info(
     const std::string& model_name,
     std::string* framework,
     std::string* task,
     std::string* exec_path,
     std::string* entry_point,
-    std::string* env_path);
+    std::string* env_path,
+    std::string* exec_protocol = nullptr,
+    std::string* version = nullptr);
 
 private:
   bool key_exists(const std::string& key);
@@ -439,11 +487,24 @@ private:
 
   int8_t check_pytorch_status(const std::string& model);
 
+  // Connection of the calling thread
+  redox::Redox& rdx() { return pool_.get(); }
+
+  // Send all commands without waiting for each reply and block until every
+  // reply has arrived. on_reply(i, c) is called (serialized) for command i.
+  template <class ReplyT>
+  void pipeline(
+      const std::vector<std::vector<std::string>>& cmds,
+      const std::function<void(size_t, redox::Command<ReplyT>&)>& on_reply);
+
+  // Pipeline commands whose replies are only checked for errors. Returns -1
+  // if any of them failed.
+  int8_t pipeline_ok(const std::vector<std::vector<std::string>>& cmds);
+
   static const struct Address empty_addr;
 
   struct Address redis_server_;
-  redox::Redox rdx_;
-  redox::Redox redis_;
+  RedisConnectionPool pool_;
 };
 
 #endif
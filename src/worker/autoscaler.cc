@@ -36,6 +36,7 @@
 //#include <aws/s3/S3Client.h>
 
 #include "autoscaler.h"
+#include "common/async_log.h"
 #include "common_model_util.h"
 //#include "include/constants.h"
 #include "constants.h" //PNB: (2025.11.28)
@@ -98,7 +99,7 @@ int64_t getFreeMemory() {
 // This simulate what most of serving systems are doing: a fixed number of
 // replicas.
 void StaticScaler(const std::string& worker_name,
-                  std::unique_ptr<RedisMetadata>& rmd, std::ofstream& logfile) {
+                  std::unique_ptr<RedisMetadata>& rmd, std::ostream& logfile) {
   std::vector<std::string> running_modvars =
       rmd->get_variants_on_executor(worker_name);
   for (auto& modvar : running_modvars) {
@@ -153,7 +154,7 @@ void StaticScaler(const std::string& worker_name,
 // w_curr. scale_count: how many replicas we need to scale, negative number
 // means scaling down.
 int8_t checkModvar(const std::string& worker_name, const std::string& modvar,
-                   std::unique_ptr<RedisMetadata>& rmd, std::ofstream& logfile,
+                   std::unique_ptr<RedisMetadata>& rmd, std::ostream& logfile,
                    int* avg_batch, double* weighted_delta_qps,
                    std::string* hardware, double* mod_load_lat,
                    std::string* framework, int* scale_count) {
@@ -259,7 +260,7 @@ int8_t checkModvar(const std::string& worker_name, const std::string& modvar,
 // container/instance and no migration to better hardware/model variants.
 void IndividualScaler(const std::string& worker_name,
                       std::unique_ptr<RedisMetadata>& rmd,
-                      std::ofstream& logfile) {
+                      std::ostream& logfile) {
   std::vector<std::string> running_modvars =
       rmd->get_variants_on_executor(worker_name);
   for (auto& modvar : running_modvars) {
@@ -305,7 +306,7 @@ struct ModvarScaleInfo {
 // than 1 replica of GPU model or out of memory
 int8_t checkFastest(const std::string& worker_name,
                     const std::string& fastest_var,
-                    std::unique_ptr<RedisMetadata>& rmd, std::ofstream& logfile,
+                    std::unique_ptr<RedisMetadata>& rmd, std::ostream& logfile,
                     int max_batch, double sum_wdelta_qps,
                     std::string down_var, std::string* fastest_hw,
                     double* fastest_loadlat, int* fastest_count) {
@@ -426,7 +427,7 @@ int8_t checkFastest(const std::string& worker_name,
 
 // Scale per parent model.
 void InfaasScaler(const std::string& worker_name,
-                  std::unique_ptr<RedisMetadata>& rmd, std::ofstream& logfile) {
+                  std::unique_ptr<RedisMetadata>& rmd, std::ostream& logfile) {
   std::vector<std::string> running_parents =
       rmd->get_parent_models_on_executor(worker_name);
   logfile << "INFaaS Scaler" << std::endl;
@@ -698,7 +699,7 @@ void InfaasScaler(const std::string& worker_name,
 
 // Scale per parent model, for Inferentia workers.
 void InfaasNeuronScaler(const std::string& worker_name,
-                  std::unique_ptr<RedisMetadata>& rmd, std::ofstream& logfile) {
+                  std::unique_ptr<RedisMetadata>& rmd, std::ostream& logfile) {
   std::vector<std::string> running_parents =
       rmd->get_parent_models_on_executor(worker_name);
   logfile << "INFaaS Neuron Scaler" << std::endl;
@@ -981,12 +982,50 @@ void InfaasNeuronScaler(const std::string& worker_name,
 }
 }  // namespace
 
-std::mutex Autoscaler::gpu_mutex_;
-std::mutex Autoscaler::cpu_mutex_;
-std::mutex Autoscaler::infa_mutex_;
-std::deque<ScaleRequest> Autoscaler::gpu_scale_reqs_;
-std::deque<ScaleRequest> Autoscaler::cpu_scale_reqs_;
-std::deque<ScaleRequest> Autoscaler::infa_scale_reqs_;
+void ScaleRequestQueue::Push(const ScaleRequest& req) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    reqs_.push_back(req);
+  }
+  cv_.notify_one();
+}
+
+bool ScaleRequestQueue::Replace(const ScaleRequest& req) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& queued : reqs_) {
+    if (queued.model_name == req.model_name) {
+      queued = req;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ScaleRequestQueue::Pop(ScaleRequest* req) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this] { return shutdown_ || !reqs_.empty(); });
+  if (shutdown_) { return false; }
+  *req = std::move(reqs_.front());
+  reqs_.pop_front();
+  return true;
+}
+
+void ScaleRequestQueue::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutdown_ = true;
+    reqs_.clear();
+  }
+  cv_.notify_all();
+}
+
+ScaleRequestQueue Autoscaler::gpu_scale_reqs_;
+ScaleRequestQueue Autoscaler::cpu_scale_reqs_;
+ScaleRequestQueue Autoscaler::infa_scale_reqs_;
+std::mutex Autoscaler::arbiter_mutex_;
+std::condition_variable Autoscaler::arbiter_cv_;
+bool Autoscaler::stats_updated_ = false;
+bool Autoscaler::shutdown_ = false;
 std::map<std::string, std::atomic<bool>> Autoscaler::model_available_;
 std::map<std::string, std::atomic<int>> Autoscaler::model_num_scaledown_;
 std::map<std::string, int> Autoscaler::model_avg_batch_;
@@ -1003,13 +1042,26 @@ void Autoscaler::AutoscalerArbiter(const std::string& worker_name,
                                    const AutoscalerType& atype,
                                    std::unique_ptr<RedisMetadata>& rmd) {
   // Log to file "INFaaS/logs/worker/autoscaler_arbiter.log"
-  std::ofstream logfile;
-  logfile.open(infaas_log_dir + "/worker/autoscaler_arbiter.log");
+  infaas::internal::LogStream logfile(
+      infaas_log_dir + "/worker/autoscaler_arbiter.log");
   logfile << "AutoscalerArbiter " << worker_name << "; type " << atype
           << std::endl;
-  int sleep_interval = 1000;
+  // Runs whenever the qpsMonitor has pushed new stats; the timeout only
+  // covers a monitor that has nothing to report.
+  int max_interval = 2000;
   while (true) {
-    std::this_thread::sleep_for(std::chrono::milliseconds(sleep_interval));
+    {
+      std::unique_lock<std::mutex> lock(arbiter_mutex_);
+      auto woken = [] { return stats_updated_ || shutdown_; };
+      if (atype == AUTOSCALE_NONE) {
+        arbiter_cv_.wait(lock, woken);
+      } else {
+        arbiter_cv_.wait_for(lock, std::chrono::milliseconds(max_interval),
+                             woken);
+      }
+      if (shutdown_) { break; }
+      stats_updated_ = false;
+    }
     switch (atype) {
       case AUTOSCALE_STATIC:
         StaticScaler(worker_name, rmd, logfile);
@@ -1035,113 +1087,85 @@ void Autoscaler::AutoscalerArbiter(const std::string& worker_name,
         break;
     }
   }
+  logfile << "AutoscalerArbiter shut down!" << std::endl;
 }
 
-int8_t Autoscaler::setScaleRequestGpu(const std::string& model_name, int count,
-                                      const std::string down_var) {
-  // Don't generate request if the model is being scaled
-  bool success = false;
-  bool expected = false;
-  success = model_available_[model_name].compare_exchange_strong(
-      expected, true, std::memory_order_acq_rel);
-  if (!success) { return -1; }
+void Autoscaler::notifyStatsUpdated() {
+  {
+    std::lock_guard<std::mutex> lock(arbiter_mutex_);
+    stats_updated_ = true;
+  }
+  arbiter_cv_.notify_one();
+}
 
+void Autoscaler::Shutdown() {
   {
-    std::lock_guard<std::mutex> lock(gpu_mutex_);
-    gpu_scale_reqs_.push_back(ScaleRequest{model_name, count, down_var});
+    std::lock_guard<std::mutex> lock(arbiter_mutex_);
+    shutdown_ = true;
   }
-  return 0;
+  arbiter_cv_.notify_all();
+  gpu_scale_reqs_.Shutdown();
+  cpu_scale_reqs_.Shutdown();
+  infa_scale_reqs_.Shutdown();
 }
 
-int8_t Autoscaler::setScaleRequestCpu(const std::string& model_name,
-                                      int count) {
+int8_t Autoscaler::pushScaleRequest(ScaleRequestQueue* queue,
+                                    const ScaleRequest& req) {
+  // A model whose request has not been picked up yet gets the newer one
+  if (queue->Replace(req)) { return 0; }
+
   // Don't generate request if the model is being scaled
   bool success = false;
   bool expected = false;
-  success = model_available_[model_name].compare_exchange_strong(
+  success = model_available_[req.model_name].compare_exchange_strong(
       expected, true, std::memory_order_acq_rel);
   if (!success) { return -1; }
 
-  {
-    std::lock_guard<std::mutex> lock(cpu_mutex_);
-    cpu_scale_reqs_.push_back(ScaleRequest{model_name, count});
-  }
+  queue->Push(req);
   return 0;
 }
 
+int8_t Autoscaler::setScaleRequestGpu(const std::string& model_name, int count,
+                                      const std::string down_var) {
+  return pushScaleRequest(&gpu_scale_reqs_,
+                          ScaleRequest{model_name, count, down_var});
+}
+
+int8_t Autoscaler::setScaleRequestCpu(const std::string& model_name,
+                                      int count) {
+  return pushScaleRequest(&cpu_scale_reqs_, ScaleRequest{model_name, count});
+}
+
 int8_t Autoscaler::setScaleRequestInfa(const std::string& model_name,
                                        int count, const std::string down_var) {
-  // Don't generate request if the model is being scaled
-  bool success = false;
-  bool expected = false;
-  success = model_available_[model_name].compare_exchange_strong(
-      expected, true, std::memory_order_acq_rel);
-  if (!success) { return -1; }
-
-  {
-    std::lock_guard<std::mutex> lock(infa_mutex_);
-    infa_scale_reqs_.push_back(ScaleRequest{model_name, count, down_var});
-  }
-  return 0;
+  return pushScaleRequest(&infa_scale_reqs_,
+                          ScaleRequest{model_name, count, down_var});
 }
 
 
-// Pop one scale request from the queue.
+// Pop one scale request from the queue, waiting for one if it is empty.
 int8_t Autoscaler::popScaleRequestGpu(ScaleRequest* reqs) {
-  int8_t res = 0;
-  {
-    std::lock_guard<std::mutex> lock(gpu_mutex_);
-    if (gpu_scale_reqs_.size() == 0) {
-      // failed to pop;
-      return -1;
-    } else {
-      *reqs = gpu_scale_reqs_.front();
-      gpu_scale_reqs_.pop_front();
-    }
-  }
+  if (!gpu_scale_reqs_.Pop(reqs)) { return -1; }
   if (reqs->count < 0) {
     model_num_scaledown_[reqs->model_name].fetch_add(-reqs->count);
   }
-
-  return res;
+  return 0;
 }
 
 int8_t Autoscaler::popScaleRequestCpu(ScaleRequest* reqs) {
-  int8_t res = 0;
-  {
-    std::lock_guard<std::mutex> lock(cpu_mutex_);
-    if (cpu_scale_reqs_.size() == 0) {
-      // failed to pop;
-      return -1;
-    } else {
-      *reqs = cpu_scale_reqs_.front();
-      cpu_scale_reqs_.pop_front();
-    }
-  }
+  if (!cpu_scale_reqs_.Pop(reqs)) { return -1; }
   if (reqs->count < 0) {
     model_num_scaledown_[reqs->model_name].fetch_add(-reqs->count);
   }
-
-  return res;
+  return 0;
 }
 
 int8_t Autoscaler::popScaleRequestInfa(ScaleRequest* reqs) {
-  int8_t res = 0;
-  {
-    std::lock_guard<std::mutex> lock(infa_mutex_);
-    if (infa_scale_reqs_.size() == 0) {
-      // failed to pop;
-      return -1;
-    } else {
-      *reqs = infa_scale_reqs_.front();
-      infa_scale_reqs_.pop_front();
-    }
-  }
+  if (!infa_scale_reqs_.Pop(reqs)) { return -1; }
   if (reqs->count < 0) {
     model_num_scaledown_[reqs->model_name].fetch_add(-reqs->count);
   }
-
-  return res;
+  return 0;
 }
 
 void Autoscaler::GpuAutoscalerDaemon(const std::string& worker_name,
@@ -1151,96 +1175,92 @@ void Autoscaler::GpuAutoscalerDaemon(const std::string& worker_name,
 				     std::unique_ptr<localfs::S3Client>& s3c // PNB: when in LOCAL_MODE/OFFLINE 'local::S3Client' replaces 'Aws::S3:S3Client'
 				     ) {
   // Log to the file "INFaaS/logs/gpu_autoscaler_daemon.log"
-  std::ofstream logfile;
-  logfile.open(infaas_log_dir + "/worker/gpu_autoscaler_daemon.log");
+  infaas::internal::LogStream logfile(
+      infaas_log_dir + "/worker/gpu_autoscaler_daemon.log");
   // Set nice value = 10 to be a lower priority.
   int curr_nice = nice(10);
   logfile << "Set GpuAutoscalerDaemon thread nice = " << curr_nice << std::endl;
-  int sleep_interval = 500;  // Sleep 500 msec.
 
   GpuModelManager manager(worker_name);
-  while (true) {
-    // Get one scaling request from the front, process one request at a time.
-    int8_t res;
-    ScaleRequest reqs;
-    while (popScaleRequestGpu(&reqs) == 0) {
-      std::string model_name = reqs.model_name;
-      std::string trt_down_var = reqs.down_var;
-      auto count = reqs.count;
-      logfile << "Model name: " << model_name << "; count = " << reqs.count
-              << std::endl;
-      // numReplicas = -1 means the model is currently being loaded. Should
-      // round to 0.
-      int curr_reps = std::max(0, GpuModelManager::numReplicas(model_name));
-      int after_reps = std::max(0, (int)(curr_reps + count));
-
-      // Don't scale down until we reach the backed up threshold.
-      int curr_backups = model_num_scaledown_[model_name].load();
-      int scale_down_delay = GPU_SCALE_DOWN_DELAY;
-      if (model_name.find("gnmt") != std::string::npos) {
-        scale_down_delay = NLP_SCALE_DOWN_DELAY;
-      }
+  // Get one scaling request from the front, process one request at a time.
+  ScaleRequest reqs;
+  while (popScaleRequestGpu(&reqs) == 0) {
+    std::string model_name = reqs.model_name;
+    std::string trt_down_var = reqs.down_var;
+    auto count = reqs.count;
+    logfile << "Model name: " << model_name << "; count = " << reqs.count
+            << std::endl;
+    // numReplicas = -1 means the model is currently being loaded. Should
+    // round to 0.
+    int curr_reps = std::max(0, GpuModelManager::numReplicas(model_name));
+    int after_reps = std::max(0, (int)(curr_reps + count));
+
+    // Don't scale down until we reach the backed up threshold.
+    int curr_backups = model_num_scaledown_[model_name].load();
+    int scale_down_delay = GPU_SCALE_DOWN_DELAY;
+    if (model_name.find("gnmt") != std::string::npos) {
+      scale_down_delay = NLP_SCALE_DOWN_DELAY;
+    }
 
-      if ((count < 0) && (curr_backups <= scale_down_delay)) {
-        logfile << "Scale down requests not enough: " << curr_backups
-                << "; No change for " << model_name << std::endl;
-        model_available_[model_name].store(false);
-        continue;
-      } else {
-        // Clean up the backup counter
-        model_num_scaledown_[model_name].store(0);
-      }
+    if ((count < 0) && (curr_backups <= scale_down_delay)) {
+      logfile << "Scale down requests not enough: " << curr_backups
+              << "; No change for " << model_name << std::endl;
+      model_available_[model_name].store(false);
+      continue;
+    } else {
+      // Clean up the backup counter
+      model_num_scaledown_[model_name].store(0);
+    }
 
-      logfile << "Change from " << curr_reps << " to " << after_reps
-              << std::endl;
-      int8_t res = -1;
-      // Unload the model if it reaches 0.
-      if (after_reps == 0) {
-        if (!trt_down_var.empty()) {
-          logfile << "Downgrading to " << trt_down_var << std::endl;
-
-          auto down_hw = ChooseHardware(trt_down_var, rmd);
-          if (down_hw == "CPU") {
-            logfile << "Will be handeled by parent scale down method."
-                    << std::endl;
+    logfile << "Change from " << curr_reps << " to " << after_reps
+            << std::endl;
+    int8_t res = -1;
+    // Unload the model if it reaches 0.
+    if (after_reps == 0) {
+      if (!trt_down_var.empty()) {
+        logfile << "Downgrading to " << trt_down_var << std::endl;
+
+        auto down_hw = ChooseHardware(trt_down_var, rmd);
+        if (down_hw == "CPU") {
+          logfile << "Will be handeled by parent scale down method."
+                  << std::endl;
+        } else {
+          std::string model_url =
+              bucket_prefix + infaas_buckets_dir + "/" + trt_down_var;
+          res = manager.LoadModel(model_url, trt_down_var, rmd, s3c);
+          if (res >= 0) {
+            logfile << "Loaded downgrade model " << trt_down_var << std::endl;
           } else {
-            std::string model_url =
-                bucket_prefix + infaas_buckets_dir + "/" + trt_down_var;
-            res = manager.LoadModel(model_url, trt_down_var, rmd, s3c);
-            if (res >= 0) {
-              logfile << "Loaded downgrade model " << trt_down_var << std::endl;
-            } else {
-              logfile << "Failed to load downgrade model " << trt_down_var
-                      << std::endl;
-            }
+            logfile << "Failed to load downgrade model " << trt_down_var
+                    << std::endl;
           }
-        } else {
-          logfile << "No model to downgrade to, unloading." << std::endl;
-        }
-        res = manager.UnloadModel(model_name, rmd);
-      } else if (curr_reps == 0) {
-        std::string model_url =
-            bucket_prefix + infaas_buckets_dir + "/" + model_name;
-        res = manager.LoadModel(model_url, model_name, rmd, s3c);
-      } else if (after_reps > 0) {
-        // NOTE: multiple GPU replicas can cause bad performance.
-        if (after_reps <= GPU_MAX_REPLICAS) {
-          res = GpuModelManager::changeNumReplicas(model_name, after_reps);
-        } else {
-          logfile << "Exceeding GPU max number of replicas: "
-                  << GPU_MAX_REPLICAS << std::endl;
         }
+      } else {
+        logfile << "No model to downgrade to, unloading." << std::endl;
       }
-      if (res >= 0) {
-        logfile << "Finished scaling for model " << model_name << std::endl;
+      res = manager.UnloadModel(model_name, rmd);
+    } else if (curr_reps == 0) {
+      std::string model_url =
+          bucket_prefix + infaas_buckets_dir + "/" + model_name;
+      res = manager.LoadModel(model_url, model_name, rmd, s3c);
+    } else if (after_reps > 0) {
+      // NOTE: multiple GPU replicas can cause bad performance.
+      if (after_reps <= GPU_MAX_REPLICAS) {
+        res = GpuModelManager::changeNumReplicas(model_name, after_reps);
       } else {
-        logfile << "Failed to scale for model " << model_name << std::endl;
+        logfile << "Exceeding GPU max number of replicas: "
+                << GPU_MAX_REPLICAS << std::endl;
       }
-      // release the lock anyway.
-      model_available_[model_name].store(false);
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(sleep_interval));
+    if (res >= 0) {
+      logfile << "Finished scaling for model " << model_name << std::endl;
+    } else {
+      logfile << "Failed to scale for model " << model_name << std::endl;
+    }
+    // release the lock anyway.
+    model_available_[model_name].store(false);
   }
+  logfile << "GpuAutoscalerDaemon shut down!" << std::endl;
 }
 
 void Autoscaler::CpuAutoscalerDaemon(const std::string& worker_name,
@@ -1250,84 +1270,80 @@ void Autoscaler::CpuAutoscalerDaemon(const std::string& worker_name,
 				     std::unique_ptr<localfs::S3Client>& s3c // PNB: when in LOCAL_MODE/OFFLINE 'local::S3Client' replaces 'Aws::S3:S3Client'
 				     ) {
   // Log to the file "INFaaS/logs/cpu_autoscaler_daemon.log"
-  std::ofstream logfile;
-  logfile.open(infaas_log_dir + "/worker/cpu_autoscaler_daemon.log");
+  infaas::internal::LogStream logfile(
+      infaas_log_dir + "/worker/cpu_autoscaler_daemon.log");
 
   // Set nice value = 10 to be a lower priority.
   int curr_nice = nice(10);
   logfile << "Set CpuAutoscalerDaemon thread nice = " << curr_nice << std::endl;
-  int sleep_interval = 500;  // Sleep 500 msec.
 
   CpuModelManager manager(worker_name);
-  while (true) {
-    int8_t res;
-    ScaleRequest reqs;
-    // Get one scaling request from the front, process one request at a time.
-    while (popScaleRequestCpu(&reqs) == 0) {
-      std::string model_name = reqs.model_name;
-      auto count = reqs.count;
-      logfile << "Model name: " << model_name << "; count = " << reqs.count
-              << std::endl;
-      auto curr_reps = CpuModelManager::numReplicas(model_name);
-      auto after_reps = (int)curr_reps + count;
-
-      // Don't scale down until we reach the backed up threshold.
-      int curr_backups = model_num_scaledown_[model_name].load();
-      int scale_down_delay = CPU_SCALE_DOWN_DELAY;
-      if (model_name.find("gnmt") != std::string::npos) {
-        scale_down_delay = NLP_SCALE_DOWN_DELAY;
-      }
-      if ((count < 0) && (curr_backups <= scale_down_delay)) {
-        logfile << "Scale down requests not enough: " << curr_backups
-                << "; No change for " << model_name << std::endl;
-        model_available_[model_name].store(false);
-        continue;
-      } else {
-        // Clean up the backup counter
-        model_num_scaledown_[model_name].store(0);
-      }
+  // Get one scaling request from the front, process one request at a time.
+  ScaleRequest reqs;
+  while (popScaleRequestCpu(&reqs) == 0) {
+    std::string model_name = reqs.model_name;
+    auto count = reqs.count;
+    logfile << "Model name: " << model_name << "; count = " << reqs.count
+            << std::endl;
+    auto curr_reps = CpuModelManager::numReplicas(model_name);
+    auto after_reps = (int)curr_reps + count;
+
+    // Don't scale down until we reach the backed up threshold.
+    int curr_backups = model_num_scaledown_[model_name].load();
+    int scale_down_delay = CPU_SCALE_DOWN_DELAY;
+    if (model_name.find("gnmt") != std::string::npos) {
+      scale_down_delay = NLP_SCALE_DOWN_DELAY;
+    }
+    if ((count < 0) && (curr_backups <= scale_down_delay)) {
+      logfile << "Scale down requests not enough: " << curr_backups
+              << "; No change for " << model_name << std::endl;
+      model_available_[model_name].store(false);
+      continue;
+    } else {
+      // Clean up the backup counter
+      model_num_scaledown_[model_name].store(0);
+    }
 
-      logfile << "Change from " << curr_reps << " to " << after_reps
-              << std::endl;
-      if (count > 0) {
-        int after_reps = std::max(0, (int)(curr_reps + count));
-        if (after_reps > CPU_MAX_REPLICAS) {
-          logfile << "Exceeds maximum CPU replicas." << std::endl;
-        } else {
-          // Load count models
-          for (int i = 0; i < count; ++i) {
-            std::string model_url =
-                bucket_prefix + infaas_buckets_dir + "/" + model_name;
-            std::string container_name =
-                model_name + "_online_" + std::to_string(curr_reps + i);
-            logfile << "Loading " << container_name << std::endl;
-            auto res = manager.LoadModel(model_url, model_name, rmd, s3c,
-                                         container_name, true);
-            if (res < 0) {
-              logfile << "Failed to load " << container_name << std::endl;
-            }
-          }
-        }
-      } else if (count < 0) {
-        int to_unload = std::min(-count, (int)curr_reps);
-        // Unload count models in reverse order
-        for (int i = 1; i <= to_unload; ++i) {
+    logfile << "Change from " << curr_reps << " to " << after_reps
+            << std::endl;
+    if (count > 0) {
+      int after_reps = std::max(0, (int)(curr_reps + count));
+      if (after_reps > CPU_MAX_REPLICAS) {
+        logfile << "Exceeds maximum CPU replicas." << std::endl;
+      } else {
+        // Load count models
+        for (int i = 0; i < count; ++i) {
+          std::string model_url =
+              bucket_prefix + infaas_buckets_dir + "/" + model_name;
           std::string container_name =
-              model_name + "_online_" + std::to_string(curr_reps - i);
-          logfile << "Unloading " << container_name << std::endl;
-          auto res = manager.UnloadModel(model_name, rmd, container_name, true);
+              model_name + "_online_" + std::to_string(curr_reps + i);
+          logfile << "Loading " << container_name << std::endl;
+          auto res = manager.LoadModel(model_url, model_name, rmd, s3c,
+                                       container_name, true);
           if (res < 0) {
-            logfile << "Failed to unload " << container_name << std::endl;
+            logfile << "Failed to load " << container_name << std::endl;
           }
         }
       }
-      // release the lock.
-      model_available_[model_name].store(false);
-
-      logfile << "Finished scaling for model " << model_name << std::endl;
+    } else if (count < 0) {
+      int to_unload = std::min(-count, (int)curr_reps);
+      // Unload count models in reverse order
+      for (int i = 1; i <= to_unload; ++i) {
+        std::string container_name =
+            model_name + "_online_" + std::to_string(curr_reps - i);
+        logfile << "Unloading " << container_name << std::endl;
+        auto res = manager.UnloadModel(model_name, rmd, container_name, true);
+        if (res < 0) {
+          logfile << "Failed to unload " << container_name << std::endl;
+        }
+      }
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(sleep_interval));
+    // release the lock.
+    model_available_[model_name].store(false);
+
+    logfile << "Finished scaling for model " << model_name << std::endl;
   }
+  logfile << "CpuAutoscalerDaemon shut down!" << std::endl;
 }
 
 void Autoscaler::InfaAutoscalerDaemon(const std::string& worker_name,
@@ -1337,98 +1353,94 @@ void Autoscaler::InfaAutoscalerDaemon(const std::string& worker_name,
 				     std::unique_ptr<localfs::S3Client>& s3c // PNB: when in LOCAL_MODE/OFFLINE 'local::S3Client' replaces 'Aws::S3:S3Client'
 				      ) {
   // Log to the file "INFaaS/logs/inferentia_autoscaler_daemon.log"
-  std::ofstream logfile;
-  logfile.open(infaas_log_dir + "/worker/inferentia_autoscaler_daemon.log");
+  infaas::internal::LogStream logfile(
+      infaas_log_dir + "/worker/inferentia_autoscaler_daemon.log");
 
   // Set nice value = 10 to be a lower priority.
   int curr_nice = nice(10);
   logfile << "Set InfaAutoscalerDaemon thread nice = " << curr_nice << std::endl;
-  int sleep_interval = 500;  // Sleep 500 msec.
 
   InfaModelManager manager(worker_name);
-  while (true) {
-    int8_t res;
-    ScaleRequest reqs;
-    // Get one scaling request from the front, process one request at a time.
-    while (popScaleRequestInfa(&reqs) == 0) {
-      std::string model_name = reqs.model_name;
-      std::string infa_down_var = reqs.down_var;
-      auto count = reqs.count;
-      logfile << "Model name: " << model_name << "; count = " << reqs.count
-              << std::endl;
-      auto curr_reps = InfaModelManager::numReplicas(model_name);
-      auto after_reps = (int)curr_reps + count;
-
-      // Don't scale down until we reach the backed up threshold.
-      int curr_backups = model_num_scaledown_[model_name].load();
-      int scale_down_delay = INFA_SCALE_DOWN_DELAY;
-      if (model_name.find("gnmt") != std::string::npos) {
-        scale_down_delay = NLP_SCALE_DOWN_DELAY;
-      }
+  // Get one scaling request from the front, process one request at a time.
+  ScaleRequest reqs;
+  while (popScaleRequestInfa(&reqs) == 0) {
+    std::string model_name = reqs.model_name;
+    std::string infa_down_var = reqs.down_var;
+    auto count = reqs.count;
+    logfile << "Model name: " << model_name << "; count = " << reqs.count
+            << std::endl;
+    auto curr_reps = InfaModelManager::numReplicas(model_name);
+    auto after_reps = (int)curr_reps + count;
+
+    // Don't scale down until we reach the backed up threshold.
+    int curr_backups = model_num_scaledown_[model_name].load();
+    int scale_down_delay = INFA_SCALE_DOWN_DELAY;
+    if (model_name.find("gnmt") != std::string::npos) {
+      scale_down_delay = NLP_SCALE_DOWN_DELAY;
+    }
 
-      if ((count < 0) && (curr_backups <= scale_down_delay)) {
-        logfile << "Scale down requests not enough: " << curr_backups
-                << "; No change for " << model_name << std::endl;
-        model_available_[model_name].store(false);
-        continue;
-      } else {
-        // Clean up the backup counter
-        model_num_scaledown_[model_name].store(0);
-      }
+    if ((count < 0) && (curr_backups <= scale_down_delay)) {
+      logfile << "Scale down requests not enough: " << curr_backups
+              << "; No change for " << model_name << std::endl;
+      model_available_[model_name].store(false);
+      continue;
+    } else {
+      // Clean up the backup counter
+      model_num_scaledown_[model_name].store(0);
+    }
 
-      logfile << "Change from " << curr_reps << " to " << after_reps
-              << std::endl;
-      if (count > 0) {
-        int after_reps = std::max(0, (int)(curr_reps + count));
-        if (after_reps > INFA_MAX_REPLICAS) {
-          logfile << "Exceeds maximum Inferentia replicas." << std::endl;
-        } else {
-          // Load count models
-          for (int i = 0; i < count; ++i) {
-            std::string model_url =
-                bucket_prefix + infaas_buckets_dir + "/" + model_name;
-            std::string container_name =
-                model_name + "_online_" + std::to_string(curr_reps + i);
-            logfile << "Loading " << container_name << std::endl;
-            auto res = manager.LoadModel(model_url, model_name, rmd, s3c,
-                                         container_name);
-            if (res < 0) {
-              logfile << "Failed to load " << container_name << std::endl;
-            }
-          }
-        }
-      } else if (count < 0) {
-        int after_reps = std::max(0, (int)(curr_reps + count));
-        // TODO: for now, we assume Inferentia will only downgrade to CPU.
-        if ((after_reps == 0) && (!infa_down_var.empty())) {
-          logfile << "Downgrading to " << infa_down_var << std::endl;
-          auto down_hw = ChooseHardware(infa_down_var, rmd);
-          if (down_hw == "CPU") {
-            logfile << "Will be handled by parent scale down method." << std::endl;
-          } else {
-            logfile << "Currently dont't support downgrading to "
-                    << infa_down_var << std::endl;
-          }
-        }
-        int to_unload = std::min(-count, (int)curr_reps);
-        // Unload count models in reverse order
-        for (int i = 1; i <= to_unload; ++i) {
+    logfile << "Change from " << curr_reps << " to " << after_reps
+            << std::endl;
+    if (count > 0) {
+      int after_reps = std::max(0, (int)(curr_reps + count));
+      if (after_reps > INFA_MAX_REPLICAS) {
+        logfile << "Exceeds maximum Inferentia replicas." << std::endl;
+      } else {
+        // Load count models
+        for (int i = 0; i < count; ++i) {
+          std::string model_url =
+              bucket_prefix + infaas_buckets_dir + "/" + model_name;
           std::string container_name =
-              model_name + "_online_" + std::to_string(curr_reps - i);
-          logfile << "Unloading " << container_name << std::endl;
-          auto res = manager.UnloadModel(model_name, rmd, container_name);
+              model_name + "_online_" + std::to_string(curr_reps + i);
+          logfile << "Loading " << container_name << std::endl;
+          auto res = manager.LoadModel(model_url, model_name, rmd, s3c,
+                                       container_name);
           if (res < 0) {
-            logfile << "Failed to unload " << container_name << std::endl;
+            logfile << "Failed to load " << container_name << std::endl;
           }
         }
       }
-      // release the lock.
-      model_available_[model_name].store(false);
-
-      logfile << "Finished scaling for model " << model_name << std::endl;
+    } else if (count < 0) {
+      int after_reps = std::max(0, (int)(curr_reps + count));
+      // TODO: for now, we assume Inferentia will only downgrade to CPU.
+      if ((after_reps == 0) && (!infa_down_var.empty())) {
+        logfile << "Downgrading to " << infa_down_var << std::endl;
+        auto down_hw = ChooseHardware(infa_down_var, rmd);
+        if (down_hw == "CPU") {
+          logfile << "Will be handled by parent scale down method." << std::endl;
+        } else {
+          logfile << "Currently dont't support downgrading to "
+                  << infa_down_var << std::endl;
+        }
+      }
+      int to_unload = std::min(-count, (int)curr_reps);
+      // Unload count models in reverse order
+      for (int i = 1; i <= to_unload; ++i) {
+        std::string container_name =
+            model_name + "_online_" + std::to_string(curr_reps - i);
+        logfile << "Unloading " << container_name << std::endl;
+        auto res = manager.UnloadModel(model_name, rmd, container_name);
+        if (res < 0) {
+          logfile << "Failed to unload " << container_name << std::endl;
+        }
+      }
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(sleep_interval));
+    // release the lock.
+    model_available_[model_name].store(false);
+
+    logfile << "Finished scaling for model " << model_name << std::endl;
   }
+  logfile << "InfaAutoscalerDaemon shut down!" << std::endl;
 }
 
 }  // namespace internal
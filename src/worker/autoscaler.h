@@ -25,6 +25,7 @@
 #define AUTOSCALER_H
 
 #include <atomic>
+#include <condition_variable>
 #include <cstdint>
 #include <deque>
 #include <iostream>
@@ -43,14 +44,38 @@
 
 namespace infaas {
 namespace internal {
-// We should have a sign for threads to stop. e.g., model_name =
-// "infaas_stop", and count = "INT_MAX"
 struct ScaleRequest {
   std::string model_name;
   int count;
   std::string down_var;
 };
 
+// Scale requests waiting for a daemon. Pop blocks until a request arrives,
+// so a daemon acts on it at once and sleeps while there is nothing to do.
+// Thread-safe.
+class ScaleRequestQueue {
+public:
+  ScaleRequestQueue() : shutdown_(false) {}
+
+  void Push(const ScaleRequest& req);
+
+  // If a request for req.model_name is still waiting, replaces it with req
+  // (the newer decision wins) and returns true; returns false otherwise.
+  bool Replace(const ScaleRequest& req);
+
+  // Waits for the next request. Returns false once the queue is shut down.
+  bool Pop(ScaleRequest* req);
+
+  // Wakes every waiting Pop; pending requests are dropped.
+  void Shutdown();
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<ScaleRequest> reqs_;
+  bool shutdown_;
+};
+
 // None means do not autoscale; static means never scale down below the slack
 // size; individual is scaling each model variant; and INFaaS is our per parent
 // model algorithm.
@@ -116,22 +141,33 @@ bool scaleDownWithStorage(const std::string& model,
   static int8_t setScaleRequestInfa(const std::string& model_name, int count,
                                     const std::string infa_down_var = "");
 
-  // Pop one scale request from the queue.
-  // Return 0 means success, return -1 means the queue is empty or error
-  // happened.
+  // Pop one scale request from the queue, waiting for one if it is empty.
+  // Return 0 means success, return -1 means the autoscaler is shutting down.
   static int8_t popScaleRequestGpu(ScaleRequest* reqs);
   static int8_t popScaleRequestCpu(ScaleRequest* reqs);
   static int8_t popScaleRequestInfa(ScaleRequest* reqs);
   static int getAvgBatch(const std::string& model_name);
   static void setAvgBatch(const std::string& model_name, int batch);
 
+  // Fresh model stats are in the metadata store: run the arbiter now rather
+  // than at its next periodic check.
+  static void notifyStatsUpdated();
+
+  // Stops the arbiter and the daemons once their current step is done.
+  static void Shutdown();
+
 private:
-  static std::mutex gpu_mutex_;
-  static std::mutex cpu_mutex_;
-  static std::mutex infa_mutex_;
-  static std::deque<ScaleRequest> gpu_scale_reqs_;
-  static std::deque<ScaleRequest> cpu_scale_reqs_;
-  static std::deque<ScaleRequest> infa_scale_reqs_;
+  // Queues req, or updates the request of the same model still waiting.
+  static int8_t pushScaleRequest(ScaleRequestQueue* queue,
+                                 const ScaleRequest& req);
+
+  static ScaleRequestQueue gpu_scale_reqs_;
+  static ScaleRequestQueue cpu_scale_reqs_;
+  static ScaleRequestQueue infa_scale_reqs_;
+  static std::mutex arbiter_mutex_;
+  static std::condition_variable arbiter_cv_;
+  static bool stats_updated_;
+  static bool shutdown_;
   // If true, the model is available to scale, otherwise, the model is blocked
   // and no more actions can be done.
   static std::map<std::string, std::atomic<bool>> model_available_;
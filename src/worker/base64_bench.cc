@@ -0,0 +1,111 @@
+// Microbenchmark of the base64 codec used on the model I/O path against the
+// scalar implementation in include/base64.h.
+//
+// Usage: base64_bench [iterations]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "include/base64.h"
+#include "worker/base64_codec.h"
+
+using infaas::internal::BASE64_URL;
+
+namespace {
+
+// From a single small input up to a batch of images
+const size_t input_sizes[] = {1 << 10, 64 << 10, 1 << 20, 8 << 20};
+
+template <typename Fn>
+double TimeMs(const int iterations, Fn fn) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) { fn(); }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count() /
+         iterations;
+}
+
+void Report(const char* name, const size_t bytes, const double ms,
+            const double baseline_ms) {
+  printf("  %-28s %9.4f ms %9.1f MB/s %6.1fx\n", name, ms,
+         bytes / (ms * 1000.0), baseline_ms / ms);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int iterations = (argc > 1) ? atoi(argv[1]) : 20;
+  if (iterations <= 0) {
+    fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+    return 1;
+  }
+  printf("Vector kernels: %s\n", infaas::internal::Base64Implementation());
+
+  std::mt19937 rng(42);
+  for (const size_t size : input_sizes) {
+    std::string input(size, 0);
+    for (char& c : input) { c = static_cast<char>(rng()); }
+    const unsigned char* raw =
+        reinterpret_cast<const unsigned char*>(input.data());
+
+    // What QueryModelOnline did: encode, then two passes for URL-safety
+    std::string reference;
+    const double old_encode = TimeMs(iterations, [&] {
+      reference = base64_encode(raw, input.size());
+      std::replace(reference.begin(), reference.end(), '+', '-');
+      std::replace(reference.begin(), reference.end(), '/', '_');
+    });
+
+    std::string encoded(infaas::internal::Base64EncodedLength(size), 0);
+    const double scalar_encode = TimeMs(iterations, [&] {
+      infaas::internal::Base64EncodeScalar(raw, size, &encoded[0],
+                                           BASE64_URL);
+    });
+    const double fast_encode = TimeMs(iterations, [&] {
+      infaas::internal::Base64Encode(raw, size, &encoded[0], BASE64_URL);
+    });
+    if (encoded != reference) {
+      fprintf(stderr, "Encoding of %zu bytes differs\n", size);
+      return 1;
+    }
+
+    // include/base64.h only decodes the standard alphabet
+    std::string standard = base64_encode(raw, input.size());
+    std::string decoded_old;
+    const double old_decode =
+        TimeMs(iterations, [&] { decoded_old = base64_decode(standard); });
+
+    std::vector<uint8_t> decoded(
+        infaas::internal::Base64DecodedMaxLength(encoded.size()));
+    int64_t n = 0;
+    const double scalar_decode = TimeMs(iterations, [&] {
+      n = infaas::internal::Base64DecodeScalar(encoded.data(), encoded.size(),
+                                               decoded.data(), BASE64_URL);
+    });
+    const double fast_decode = TimeMs(iterations, [&] {
+      n = infaas::internal::Base64Decode(encoded.data(), encoded.size(),
+                                         decoded.data(), BASE64_URL);
+    });
+    if ((n != static_cast<int64_t>(size)) ||
+        (memcmp(input.data(), decoded.data(), size) != 0) ||
+        (decoded_old != input)) {
+      fprintf(stderr, "Decoding of %zu bytes differs\n", size);
+      return 1;
+    }
+
+    printf("%zu bytes:\n", size);
+    Report("encode base64.h + replace", size, old_encode, old_encode);
+    Report("encode scalar", size, scalar_encode, old_encode);
+    Report("encode", size, fast_encode, old_encode);
+    Report("decode base64.h", size, old_decode, old_decode);
+    Report("decode scalar", size, scalar_decode, old_decode);
+    Report("decode", size, fast_decode, old_decode);
+  }
+  return 0;
+}
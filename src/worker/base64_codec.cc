@@ -0,0 +1,391 @@
+#include "worker/base64_codec.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define INFAAS_BASE64_X86 1
+#include <immintrin.h>
+#endif
+
+namespace infaas {
+namespace internal {
+
+namespace {
+
+const char standard_chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+const char url_chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+inline const char* AlphabetChars(const Base64Alphabet alphabet) {
+  return (alphabet == BASE64_URL) ? url_chars : standard_chars;
+}
+
+// 6-bit value of every byte, -1 for bytes outside the alphabet
+struct DecodeTables {
+  int8_t table[2][256];
+  DecodeTables() {
+    for (int a = 0; a < 2; ++a) {
+      const char* chars = AlphabetChars(static_cast<Base64Alphabet>(a));
+      for (int c = 0; c < 256; ++c) { table[a][c] = -1; }
+      for (int v = 0; v < 64; ++v) {
+        table[a][static_cast<uint8_t>(chars[v])] = static_cast<int8_t>(v);
+      }
+    }
+  }
+};
+
+const int8_t* DecodeTable(const Base64Alphabet alphabet) {
+  static const DecodeTables tables;
+  return tables.table[alphabet == BASE64_URL ? 1 : 0];
+}
+
+// Characters left once up to two '=' are taken off a padded encoding
+size_t DataLength(const char* in, size_t len) {
+  if ((len % 4 != 0) || (len == 0)) { return len; }
+  if (in[len - 1] == '=') { --len; }
+  if (in[len - 1] == '=') { --len; }
+  return len;
+}
+
+/*
+ * The vector kernels work on whole blocks and return how much input they
+ * consumed (a multiple of 3 bytes, or of 4 characters); the scalar code
+ * finishes the rest. A decode kernel stops at the first block holding a
+ * character outside the alphabet and leaves the error to the scalar code.
+ *
+ * Encoding follows Muła and Lemire, "Faster Base64 Encoding and Decoding
+ * Using AVX2 Instructions": each 3-byte group is spread over a 32-bit lane,
+ * the four 6-bit indices are moved into place with two multiplies, and the
+ * ASCII offset of each index's range comes from a 16-entry pshufb table.
+ * Decoding maps characters to values with range compares (so both
+ * alphabets share one kernel) and packs them with pmaddubsw/pmaddwd.
+ */
+typedef size_t (*EncodeKernel)(const uint8_t* in, const size_t len, char* out,
+                               const Base64Alphabet alphabet);
+typedef size_t (*DecodeKernel)(const char* in, const size_t len, uint8_t* out,
+                               const Base64Alphabet alphabet);
+
+size_t EncodeNone(const uint8_t*, const size_t, char*, const Base64Alphabet) {
+  return 0;
+}
+
+size_t DecodeNone(const char*, const size_t, uint8_t*, const Base64Alphabet) {
+  return 0;
+}
+
+#ifdef INFAAS_BASE64_X86
+
+__attribute__((target("ssse3"))) inline __m128i EncodeShiftTable(
+    const Base64Alphabet alphabet) {
+  const char* chars = AlphabetChars(alphabet);
+  return _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                       '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                       '0' - 52, static_cast<char>(chars[62] - 62),
+                       static_cast<char>(chars[63] - 63), 'A', 0, 0);
+}
+
+// 12 bytes (in the low 12 of 16) to 16 characters
+__attribute__((target("ssse3"))) inline __m128i EncodeBlock(
+    __m128i in, const __m128i shift_table) {
+  in = _mm_shuffle_epi8(
+      in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+  const __m128i hi = _mm_mulhi_epu16(
+      _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)),
+      _mm_set1_epi32(0x04000040));
+  const __m128i lo = _mm_mullo_epi16(
+      _mm_and_si128(in, _mm_set1_epi32(0x003f03f0)),
+      _mm_set1_epi32(0x01000010));
+  const __m128i indices = _mm_or_si128(hi, lo);
+  // 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12
+  __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+  const __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+  range = _mm_or_si128(range, _mm_and_si128(upper, _mm_set1_epi8(13)));
+  return _mm_add_epi8(indices, _mm_shuffle_epi8(shift_table, range));
+}
+
+// 16 characters to 12 bytes, written as 16 (the last 4 are garbage).
+// Returns false if a character is outside the alphabet.
+__attribute__((target("ssse3"))) inline bool DecodeBlock(
+    const __m128i in, const char c62, const char c63, uint8_t* out) {
+  const __m128i upper =
+      _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('A' - 1)),
+                    _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), in));
+  const __m128i lower =
+      _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('a' - 1)),
+                    _mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), in));
+  const __m128i digit =
+      _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('0' - 1)),
+                    _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), in));
+  const __m128i is62 = _mm_cmpeq_epi8(in, _mm_set1_epi8(c62));
+  const __m128i is63 = _mm_cmpeq_epi8(in, _mm_set1_epi8(c63));
+  const __m128i valid = _mm_or_si128(
+      _mm_or_si128(upper, lower),
+      _mm_or_si128(digit, _mm_or_si128(is62, is63)));
+  if (_mm_movemask_epi8(valid) != 0xffff) { return false; }
+
+  __m128i shift = _mm_and_si128(upper, _mm_set1_epi8(-'A'));
+  shift = _mm_or_si128(shift, _mm_and_si128(lower, _mm_set1_epi8(26 - 'a')));
+  shift = _mm_or_si128(shift, _mm_and_si128(digit, _mm_set1_epi8(52 - '0')));
+  shift = _mm_or_si128(
+      shift, _mm_and_si128(is62, _mm_set1_epi8(static_cast<char>(62 - c62))));
+  shift = _mm_or_si128(
+      shift, _mm_and_si128(is63, _mm_set1_epi8(static_cast<char>(63 - c63))));
+  const __m128i values = _mm_add_epi8(in, shift);
+
+  // abcd -> (a << 6 | b, c << 6 | d) -> a << 18 | b << 12 | c << 6 | d
+  const __m128i pairs =
+      _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+  const __m128i words = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+  const __m128i bytes = _mm_shuffle_epi8(
+      words, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1,
+                           -1));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out), bytes);
+  return true;
+}
+
+__attribute__((target("ssse3"))) size_t EncodeSsse3(
+    const uint8_t* in, const size_t len, char* out,
+    const Base64Alphabet alphabet) {
+  const __m128i shift_table = EncodeShiftTable(alphabet);
+  size_t i = 0;
+  // Each block loads 16 bytes and uses 12
+  for (; len - i >= 16; i += 12, out += 16) {
+    const __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                     EncodeBlock(block, shift_table));
+  }
+  return i;
+}
+
+__attribute__((target("ssse3"))) size_t DecodeSsse3(
+    const char* in, const size_t len, uint8_t* out,
+    const Base64Alphabet alphabet) {
+  const char* chars = AlphabetChars(alphabet);
+  size_t i = 0;
+  // Each block stores 16 bytes for 12; the 8 characters kept back make sure
+  // the extra 4 still land inside the output
+  for (; len - i >= 24; i += 16, out += 12) {
+    const __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    if (!DecodeBlock(block, chars[62], chars[63], out)) { break; }
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) size_t EncodeAvx2(
+    const uint8_t* in, const size_t len, char* out,
+    const Base64Alphabet alphabet) {
+  const __m128i shift_table128 = EncodeShiftTable(alphabet);
+  const __m256i shift_table = _mm256_broadcastsi128_si256(shift_table128);
+  const __m256i spread = _mm256_broadcastsi128_si256(
+      _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+  size_t i = 0;
+  // 24 bytes per block, 12 per 128-bit lane
+  for (; len - i >= 28; i += 24, out += 32) {
+    __m256i block = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i))),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 12)), 1);
+    block = _mm256_shuffle_epi8(block, spread);
+    const __m256i hi = _mm256_mulhi_epu16(
+        _mm256_and_si256(block, _mm256_set1_epi32(0x0fc0fc00)),
+        _mm256_set1_epi32(0x04000040));
+    const __m256i lo = _mm256_mullo_epi16(
+        _mm256_and_si256(block, _mm256_set1_epi32(0x003f03f0)),
+        _mm256_set1_epi32(0x01000010));
+    const __m256i indices = _mm256_or_si256(hi, lo);
+    __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+    const __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+    range = _mm256_or_si256(range, _mm256_and_si256(upper,
+                                                    _mm256_set1_epi8(13)));
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i*>(out),
+        _mm256_add_epi8(indices, _mm256_shuffle_epi8(shift_table, range)));
+  }
+  return i + EncodeSsse3(in + i, len - i, out, alphabet);
+}
+
+__attribute__((target("avx2"))) size_t DecodeAvx2(
+    const char* in, const size_t len, uint8_t* out,
+    const Base64Alphabet alphabet) {
+  const char* chars = AlphabetChars(alphabet);
+  const char c62 = chars[62];
+  const char c63 = chars[63];
+  const __m256i pack = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+  size_t i = 0;
+  // 32 characters per block, stored as two 16-byte halves for 24 bytes
+  for (; len - i >= 40; i += 32, out += 24) {
+    const __m256i block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+    const __m256i upper =
+        _mm256_and_si256(_mm256_cmpgt_epi8(block, _mm256_set1_epi8('A' - 1)),
+                         _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), block));
+    const __m256i lower =
+        _mm256_and_si256(_mm256_cmpgt_epi8(block, _mm256_set1_epi8('a' - 1)),
+                         _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), block));
+    const __m256i digit =
+        _mm256_and_si256(_mm256_cmpgt_epi8(block, _mm256_set1_epi8('0' - 1)),
+                         _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), block));
+    const __m256i is62 = _mm256_cmpeq_epi8(block, _mm256_set1_epi8(c62));
+    const __m256i is63 = _mm256_cmpeq_epi8(block, _mm256_set1_epi8(c63));
+    const __m256i valid = _mm256_or_si256(
+        _mm256_or_si256(upper, lower),
+        _mm256_or_si256(digit, _mm256_or_si256(is62, is63)));
+    if (_mm256_movemask_epi8(valid) != -1) { break; }
+
+    __m256i shift = _mm256_and_si256(upper, _mm256_set1_epi8(-'A'));
+    shift = _mm256_or_si256(
+        shift, _mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a')));
+    shift = _mm256_or_si256(
+        shift, _mm256_and_si256(digit, _mm256_set1_epi8(52 - '0')));
+    shift = _mm256_or_si256(
+        shift, _mm256_and_si256(
+                   is62, _mm256_set1_epi8(static_cast<char>(62 - c62))));
+    shift = _mm256_or_si256(
+        shift, _mm256_and_si256(
+                   is63, _mm256_set1_epi8(static_cast<char>(63 - c63))));
+    const __m256i values = _mm256_add_epi8(block, shift);
+    const __m256i pairs =
+        _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+    const __m256i words =
+        _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+    const __m256i bytes = _mm256_shuffle_epi8(words, pack);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                     _mm256_castsi256_si128(bytes));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 12),
+                     _mm256_extracti128_si256(bytes, 1));
+  }
+  return i + DecodeSsse3(in + i, len - i, out, alphabet);
+}
+
+#endif  // INFAAS_BASE64_X86
+
+struct Kernels {
+  const char* name;
+  EncodeKernel encode;
+  DecodeKernel decode;
+};
+
+Kernels SelectKernels() {
+#ifdef INFAAS_BASE64_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return Kernels{"avx2", EncodeAvx2, DecodeAvx2};
+  }
+  if (__builtin_cpu_supports("ssse3")) {
+    return Kernels{"ssse3", EncodeSsse3, DecodeSsse3};
+  }
+#endif
+  return Kernels{"scalar", EncodeNone, DecodeNone};
+}
+
+const Kernels& SelectedKernels() {
+  static const Kernels kernels = SelectKernels();
+  return kernels;
+}
+
+}  // namespace
+
+size_t Base64EncodeScalar(const void* in, const size_t len, char* out,
+                          const Base64Alphabet alphabet) {
+  const uint8_t* src = static_cast<const uint8_t*>(in);
+  const char* chars = AlphabetChars(alphabet);
+  char* dst = out;
+  size_t i = 0;
+  for (; len - i >= 3; i += 3) {
+    const uint32_t v = (src[i] << 16) | (src[i + 1] << 8) | src[i + 2];
+    *dst++ = chars[v >> 18];
+    *dst++ = chars[(v >> 12) & 0x3f];
+    *dst++ = chars[(v >> 6) & 0x3f];
+    *dst++ = chars[v & 0x3f];
+  }
+  if (i < len) {
+    const uint32_t v =
+        (src[i] << 16) | ((i + 1 < len) ? (src[i + 1] << 8) : 0);
+    *dst++ = chars[v >> 18];
+    *dst++ = chars[(v >> 12) & 0x3f];
+    *dst++ = (i + 1 < len) ? chars[(v >> 6) & 0x3f] : '=';
+    *dst++ = '=';
+  }
+  return dst - out;
+}
+
+int64_t Base64DecodeScalar(const char* in, const size_t len, uint8_t* out,
+                           const Base64Alphabet alphabet) {
+  const size_t data_len = DataLength(in, len);
+  if (data_len % 4 == 1) { return -1; }
+  const int8_t* table = DecodeTable(alphabet);
+  uint8_t* dst = out;
+  size_t i = 0;
+  for (; data_len - i >= 4; i += 4) {
+    const int32_t a = table[static_cast<uint8_t>(in[i])];
+    const int32_t b = table[static_cast<uint8_t>(in[i + 1])];
+    const int32_t c = table[static_cast<uint8_t>(in[i + 2])];
+    const int32_t d = table[static_cast<uint8_t>(in[i + 3])];
+    if ((a | b | c | d) < 0) { return -1; }
+    const uint32_t v = (a << 18) | (b << 12) | (c << 6) | d;
+    *dst++ = static_cast<uint8_t>(v >> 16);
+    *dst++ = static_cast<uint8_t>(v >> 8);
+    *dst++ = static_cast<uint8_t>(v);
+  }
+  if (i < data_len) {
+    // 2 or 3 characters left: 1 or 2 bytes
+    const int32_t a = table[static_cast<uint8_t>(in[i])];
+    const int32_t b = table[static_cast<uint8_t>(in[i + 1])];
+    const int32_t c =
+        (data_len - i == 3) ? table[static_cast<uint8_t>(in[i + 2])] : 0;
+    if ((a | b | c) < 0) { return -1; }
+    const uint32_t v = (a << 18) | (b << 12) | (c << 6);
+    *dst++ = static_cast<uint8_t>(v >> 16);
+    if (data_len - i == 3) { *dst++ = static_cast<uint8_t>(v >> 8); }
+  }
+  return dst - out;
+}
+
+size_t Base64Encode(const void* in, const size_t len, char* out,
+                    const Base64Alphabet alphabet) {
+  const uint8_t* src = static_cast<const uint8_t*>(in);
+  const size_t done = SelectedKernels().encode(src, len, out, alphabet);
+  const size_t written = done / 3 * 4;
+  return written +
+         Base64EncodeScalar(src + done, len - done, out + written, alphabet);
+}
+
+void Base64Encode(const void* in, const size_t len, std::string* out,
+                  const Base64Alphabet alphabet) {
+  const size_t old_size = out->size();
+  out->resize(old_size + Base64EncodedLength(len));
+  Base64Encode(in, len, &(*out)[old_size], alphabet);
+}
+
+int64_t Base64Decode(const char* in, const size_t len, uint8_t* out,
+                     const Base64Alphabet alphabet) {
+  // Padding is left to the scalar code
+  const size_t done =
+      SelectedKernels().decode(in, DataLength(in, len), out, alphabet);
+  const int64_t rest =
+      Base64DecodeScalar(in + done, len - done, out + done / 4 * 3, alphabet);
+  if (rest < 0) { return -1; }
+  return done / 4 * 3 + rest;
+}
+
+int8_t Base64Decode(const std::string& in, std::string* out,
+                    const Base64Alphabet alphabet) {
+  const size_t old_size = out->size();
+  out->resize(old_size + Base64DecodedMaxLength(in.size()));
+  const int64_t n =
+      Base64Decode(in.data(), in.size(),
+                   reinterpret_cast<uint8_t*>(&(*out)[old_size]), alphabet);
+  if (n < 0) {
+    out->resize(old_size);
+    return -1;
+  }
+  out->resize(old_size + n);
+  return 0;
+}
+
+const char* Base64Implementation() { return SelectedKernels().name; }
+
+}  // namespace internal
+}  // namespace infaas
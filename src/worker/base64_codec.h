@@ -0,0 +1,76 @@
+#pragma once
+
+#ifndef INFAAS_BASE64_CODEC_H_
+#define INFAAS_BASE64_CODEC_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace infaas {
+namespace internal {
+
+/**
+ * Base64 encoder/decoder for model inputs and outputs.
+ *
+ * Works on caller-sized buffers, so a request body can be laid out once and
+ * encoded in place. Uses AVX2 or SSSE3 when the CPU has them (checked once,
+ * at runtime) and a table-driven scalar loop otherwise; all paths produce
+ * the same bytes.
+ */
+enum Base64Alphabet {
+  BASE64_STANDARD = 0,  // '+' and '/' (RFC 4648 section 4)
+  BASE64_URL = 1,       // '-' and '_' (RFC 4648 section 5)
+};
+
+// Length of the padded encoding of len bytes.
+inline size_t Base64EncodedLength(const size_t len) {
+  return ((len + 2) / 3) * 4;
+}
+
+// Upper bound on the bytes a len-character encoding decodes to.
+inline size_t Base64DecodedMaxLength(const size_t len) {
+  return ((len + 3) / 4) * 3;
+}
+
+/**
+ * Encodes len bytes of in into out, padding with '='. out must have room for
+ * Base64EncodedLength(len) characters; no terminator is written.
+ *
+ * @return the number of characters written.
+ */
+size_t Base64Encode(const void* in, const size_t len, char* out,
+                    const Base64Alphabet alphabet = BASE64_STANDARD);
+
+// Appends the encoding of len bytes of in to *out.
+void Base64Encode(const void* in, const size_t len, std::string* out,
+                  const Base64Alphabet alphabet = BASE64_STANDARD);
+
+/**
+ * Decodes len characters of in into out. Trailing '=' padding is optional.
+ * out must have room for Base64DecodedMaxLength(len) bytes.
+ *
+ * @return the number of bytes written, or -1 if in is not valid base64 in
+ *         the given alphabet.
+ */
+int64_t Base64Decode(const char* in, const size_t len, uint8_t* out,
+                     const Base64Alphabet alphabet = BASE64_STANDARD);
+
+// Appends the decoding of in to *out. Returns 0 on success, -1 if in is not
+// valid base64 (out is then left unchanged).
+int8_t Base64Decode(const std::string& in, std::string* out,
+                    const Base64Alphabet alphabet = BASE64_STANDARD);
+
+// The instruction set the codec picked: "avx2", "ssse3" or "scalar".
+const char* Base64Implementation();
+
+// The scalar paths alone, for comparison against the dispatched ones.
+size_t Base64EncodeScalar(const void* in, const size_t len, char* out,
+                          const Base64Alphabet alphabet = BASE64_STANDARD);
+int64_t Base64DecodeScalar(const char* in, const size_t len, uint8_t* out,
+                           const Base64Alphabet alphabet = BASE64_STANDARD);
+
+}  // namespace internal
+}  // namespace infaas
+
+#endif  // INFAAS_BASE64_CODEC_H_
@@ -0,0 +1,194 @@
+#include "worker/batch_scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <tuple>
+
+#include "common/async_log.h"
+
+namespace infaas {
+namespace internal {
+
+bool BatchKey::operator<(const BatchKey& other) const {
+  return std::tie(model, steps, cfg_scale, width, height) <
+         std::tie(other.model, other.steps, other.cfg_scale, other.width,
+                  other.height);
+}
+
+BatchScheduler::BatchScheduler(ExecuteFn execute, const int max_delay_ms)
+    : execute_(execute), max_delay_ms_(max_delay_ms) {}
+
+int BatchScheduler::Submit(const BatchKey& key, const ModelSpec& spec,
+                           const int max_batch,
+                           const std::vector<BufferView>& inputs,
+                           std::vector<std::string>* outputs,
+                           const int timeout_ms,
+                           const std::vector<InputParams>& params,
+                           const CancelledFn& cancelled) {
+  if (max_batch <= 1 || inputs.size() >= (size_t)max_batch) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      Stats& s = stats_[key.model];
+      s.batches++;
+      s.batched_reqs++;
+      s.batched_inputs += inputs.size();
+    }
+    return execute_(spec, inputs, outputs, timeout_ms, params);
+  }
+
+  Pending me;
+  me.inputs = &inputs;
+  me.params = &params;
+  me.cancelled = &cancelled;
+  me.deadline = (timeout_ms > 0)
+                    ? Clock::now() + std::chrono::milliseconds(timeout_ms)
+                    : Clock::time_point::max();
+  me.outputs = outputs;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  Queue& q = queues_[key];
+  me.leader = q.reqs.empty();
+  q.reqs.push_back(&me);
+  q.queued_inputs += inputs.size();
+  stats_[key.model].queue_depth++;
+  if (q.queued_inputs >= (size_t)max_batch) { cv_.notify_all(); }
+
+  // Followers wait until a leader ran their batch, or until they are
+  // promoted to lead the next one.
+  cv_.wait(lock, [&me] { return me.done || me.leader; });
+  if (me.done) { return me.rc; }
+
+  // Leader: wait for the batch to fill or the delay to run out.
+  auto deadline = Clock::now() + std::chrono::milliseconds(max_delay_ms_);
+  cv_.wait_until(lock, deadline, [&q, max_batch] {
+    return q.queued_inputs >= (size_t)max_batch;
+  });
+
+  // Take requests in arrival order while they fit (always at least one).
+  // Cancelled and expired ones leave the queue without running, this one
+  // included: its thread still runs the batch for the others.
+  std::vector<Pending*> batch;
+  size_t batch_inputs = 0;
+  size_t dropped = 0;
+  const Clock::time_point now = Clock::now();
+  while (!q.reqs.empty()) {
+    Pending* p = q.reqs.front();
+    const bool expired = (p->deadline <= now);
+    if (expired || (*p->cancelled && (*p->cancelled)())) {
+      q.queued_inputs -= p->inputs->size();
+      q.reqs.pop_front();
+      p->outputs->assign(1, expired ? "Model execution timed out"
+                                    : "Cancelled");
+      p->rc = 1;
+      p->done = true;
+      ++dropped;
+      continue;
+    }
+    if (!batch.empty() &&
+        batch_inputs + p->inputs->size() > (size_t)max_batch) {
+      break;
+    }
+    batch.push_back(p);
+    batch_inputs += p->inputs->size();
+    q.queued_inputs -= p->inputs->size();
+    q.reqs.pop_front();
+  }
+  if (dropped > 0) { cv_.notify_all(); }
+  Stats& s = stats_[key.model];
+  s.queue_depth -= batch.size() + dropped;
+
+  // Whoever is left starts collecting the next batch right away.
+  if (!q.reqs.empty()) {
+    q.reqs.front()->leader = true;
+    cv_.notify_all();
+  } else {
+    // Keys come from the queries; do not keep one around for each
+    queues_.erase(key);
+  }
+  if (batch.empty()) { return me.rc; }
+  s.batches++;
+  s.batched_reqs += batch.size();
+  s.batched_inputs += batch_inputs;
+  lock.unlock();
+
+  RunBatch(spec, batch);
+
+  lock.lock();
+  for (Pending* p : batch) { p->done = true; }
+  cv_.notify_all();
+  return me.rc;
+}
+
+BatchScheduler::Stats BatchScheduler::GetStats(const std::string& model) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_[model];
+}
+
+/*********************** Private Functions ***********************/
+
+void BatchScheduler::RunBatch(const ModelSpec& spec,
+                              std::vector<Pending*>& batch) {
+  if (batch.size() == 1) {
+    batch[0]->rc = execute_(spec, *batch[0]->inputs, batch[0]->outputs,
+                            TimeoutMs(batch[0]->deadline), *batch[0]->params);
+    return;
+  }
+
+  std::vector<BufferView> inputs;
+  std::vector<InputParams> params;
+  bool all_params = true;  // Params go along only if every input has them
+  Clock::time_point deadline = Clock::time_point::min();
+  for (Pending* p : batch) {
+    inputs.insert(inputs.end(), p->inputs->begin(), p->inputs->end());
+    params.insert(params.end(), p->params->begin(), p->params->end());
+    all_params = all_params && (p->params->size() == p->inputs->size());
+    deadline = std::max(deadline, p->deadline);
+  }
+  if (!all_params) { params.clear(); }
+  std::vector<std::string> outputs;
+  int rc = execute_(spec, inputs, &outputs, TimeoutMs(deadline), params);
+
+  if (rc == 0 && outputs.size() == inputs.size()) {
+    // Scatter: each request gets as many outputs as it sent inputs.
+    size_t next = 0;
+    for (Pending* p : batch) {
+      p->outputs->clear();
+      for (size_t i = 0; i < p->inputs->size(); ++i) {
+        p->outputs->push_back(std::move(outputs[next++]));
+      }
+      p->rc = 0;
+    }
+    return;
+  }
+
+  // A batch that ran out of time leaves none of its requests time for a
+  // second run; otherwise each one that has time left runs on its own
+  const bool timed_out = (Clock::now() >= deadline);
+  INFAAS_LOG(WARN) << "[BatchScheduler] Batch of " << batch.size() << " for "
+                   << spec.model_name << " failed (rc=" << rc << ", "
+                   << outputs.size() << " outputs for " << inputs.size()
+                   << " inputs)"
+                   << (timed_out ? "; out of time"
+                                 : "; running requests one by one");
+  for (Pending* p : batch) {
+    p->outputs->clear();
+    if (timed_out || (Clock::now() >= p->deadline)) {
+      p->outputs->push_back("Model execution timed out");
+      p->rc = 1;
+      continue;
+    }
+    p->rc = execute_(spec, *p->inputs, p->outputs, TimeoutMs(p->deadline),
+                     *p->params);
+  }
+}
+
+int BatchScheduler::TimeoutMs(const Clock::time_point deadline) {
+  if (deadline == Clock::time_point::max()) { return 0; }
+  auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+      deadline - Clock::now());
+  // Already past it: fail fast rather than run without a bound
+  return std::max<int64_t>(1, left.count());
+}
+
+}  // namespace internal
+}  // namespace infaas
@@ -0,0 +1,138 @@
+#pragma once
+
+#ifndef INFAAS_BATCH_SCHEDULER_H_
+#define INFAAS_BATCH_SCHEDULER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "process_executor.h"
+#include "shm_transport.h"
+
+namespace infaas {
+namespace internal {
+
+// Requests may only share an execution if all of these match. The seed
+// and guidance scale also travel with every input (InputParams), so the
+// model applies each request's own values.
+struct BatchKey {
+  std::string model;
+  int32_t steps;
+  float cfg_scale;
+  int32_t width;
+  int32_t height;
+
+  bool operator<(const BatchKey& other) const;
+};
+
+/**
+ * Groups concurrent online requests for the same model and generation
+ * parameters into one model execution.
+ *
+ * The first request to arrive at an empty queue leads the batch: it waits
+ * until max_batch inputs are queued or max_delay_ms has passed, runs every
+ * queued request it can fit as one execution, and hands each caller its
+ * share of the outputs (one output per input, in order). No dispatcher
+ * thread is needed; other callers just block until their batch is done.
+ *
+ * If a batched execution fails or returns the wrong number of outputs, each
+ * request in it that still has time left is run again on its own, so one
+ * bad request cannot fail its neighbours. A batch that failed by running
+ * out of time is not retried.
+ *
+ * A batch runs until the latest deadline of its requests; the model's
+ * deadline is passed to ExecuteFn as timeout_ms. The params of the batched
+ * requests are concatenated like their inputs (one record per input).
+ *
+ * A request whose caller has gone away (CancelledFn), or whose deadline
+ * passed, while it was queued is dropped when its batch is formed, so it
+ * takes no room in the batch. A queue is removed once it is empty.
+ */
+class BatchScheduler {
+public:
+  using ExecuteFn = std::function<int(const ModelSpec&,
+                                      const std::vector<BufferView>&,
+                                      std::vector<std::string>*,
+                                      const int timeout_ms,
+                                      const std::vector<InputParams>&)>;
+  // Returns true once the caller no longer wants the result
+  using CancelledFn = std::function<bool()>;
+
+  // Per-model counters for qpsMonitor. batches/batched_inputs are totals
+  // since start; queue_depth is the current number of waiting requests.
+  struct Stats {
+    uint64_t queue_depth = 0;
+    uint64_t batches = 0;
+    uint64_t batched_reqs = 0;
+    uint64_t batched_inputs = 0;
+  };
+
+  BatchScheduler(ExecuteFn execute, const int max_delay_ms = 20);
+
+  /**
+   * Runs a request, batched with compatible concurrent requests.
+   *
+   * @param max_batch  Most inputs one execution may take (from metadata).
+   *                   Requests of models with max_batch <= 1 run directly.
+   * @param timeout_ms How long the request may take, from now; <= 0 leaves
+   *                   it to ExecuteFn.
+   * @param params     Generation parameters, one per input (or none).
+   * @param cancelled  Checked when the request's batch is formed; a
+   *                   cancelled request is not run (optional).
+   *
+   * @return The model's return code; outputs holds this request's outputs,
+   *         or the error message on failure.
+   */
+  int Submit(const BatchKey& key, const ModelSpec& spec, const int max_batch,
+             const std::vector<BufferView>& inputs,
+             std::vector<std::string>* outputs, const int timeout_ms = 0,
+             const std::vector<InputParams>& params =
+                 std::vector<InputParams>(),
+             const CancelledFn& cancelled = nullptr);
+
+  Stats GetStats(const std::string& model);
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Pending {
+    const std::vector<BufferView>* inputs;
+    const std::vector<InputParams>* params;
+    const CancelledFn* cancelled;
+    Clock::time_point deadline;  // max() if none
+    std::vector<std::string>* outputs;
+    int rc = 0;
+    bool done = false;
+    bool leader = false;
+  };
+
+  struct Queue {
+    std::deque<Pending*> reqs;
+    size_t queued_inputs = 0;
+  };
+
+  void RunBatch(const ModelSpec& spec, std::vector<Pending*>& batch);
+  // ExecuteFn's timeout_ms for a run that may last until deadline
+  static int TimeoutMs(const Clock::time_point deadline);
+
+  ExecuteFn execute_;
+  const int max_delay_ms_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::map<BatchKey, Queue> queues_;
+  std::map<std::string, Stats> stats_;
+};
+
+}  // namespace internal
+}  // namespace infaas
+
+#endif  // INFAAS_BATCH_SCHEDULER_H_
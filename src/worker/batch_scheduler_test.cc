@@ -0,0 +1,244 @@
+// Tests of BatchScheduler with a stand-in model that echoes its inputs:
+// batches fill up or flush after the delay, cancelled and expired requests
+// are left out, and a failed batch falls back to running its requests one
+// by one, unless it ran out of time.
+//
+// Usage: batch_scheduler_test
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "worker/batch_scheduler.h"
+
+#define FAIL(x) printf("[FAIL]: %s\n", x)
+#define PASS(x) printf("[PASS]: %s\n", x)
+
+using infaas::internal::BatchKey;
+using infaas::internal::BatchScheduler;
+using infaas::internal::BufferView;
+using infaas::internal::InputParams;
+
+namespace {
+
+// Stand-in model. Echoes each input; an input "bad" fails any batch it is
+// in, and an input "slow" makes the execution outlast its timeout and fail.
+class EchoModel {
+public:
+  int Execute(const std::vector<BufferView>& inputs,
+              std::vector<std::string>* outputs, const int timeout_ms) {
+    bool bad = false;
+    bool slow = false;
+    std::vector<std::string> echoed;
+    for (const BufferView& in : inputs) {
+      echoed.push_back(std::string(in.data, in.size));
+      bad = bad || (echoed.back() == "bad");
+      slow = slow || (echoed.back() == "slow");
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      runs_.push_back(echoed.size());
+    }
+    if (slow) {
+      usleep((timeout_ms + 20) * 1000);
+      outputs->assign(1, "Model execution timed out");
+      return 1;
+    }
+    if (bad) {
+      outputs->assign(1, "Bad input");
+      return 1;
+    }
+    *outputs = echoed;
+    return 0;
+  }
+
+  // Sizes of the executions so far, then forgets them
+  std::vector<size_t> TakeRuns() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<size_t> runs;
+    runs.swap(runs_);
+    return runs;
+  }
+
+private:
+  std::mutex mutex_;
+  std::vector<size_t> runs_;
+};
+
+struct Result {
+  int rc = -1;
+  std::vector<std::string> outputs;
+};
+
+double MsSince(const std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+}  // namespace
+
+int main() {
+  EchoModel model;
+  const int max_delay_ms = 200;
+  BatchScheduler scheduler(
+      [&model](const ModelSpec&, const std::vector<BufferView>& inputs,
+               std::vector<std::string>* outputs, const int timeout_ms,
+               const std::vector<InputParams>&) {
+        return model.Execute(inputs, outputs, timeout_ms);
+      },
+      max_delay_ms);
+
+  ModelSpec spec;
+  spec.model_name = "echo";
+  BatchKey key;
+  key.model = "echo";
+  key.steps = 20;
+  key.cfg_scale = 7.5;
+  key.width = 512;
+  key.height = 512;
+
+  // Submits name as a one-input request after delay_ms, on its own thread
+  std::vector<std::thread> threads;
+  auto submit = [&](const std::string& name, const int delay_ms,
+                    const int max_batch, const int timeout_ms,
+                    const bool cancelled, Result* result) {
+    threads.push_back(std::thread([=, &scheduler, &key, &spec] {
+      usleep(delay_ms * 1000);
+      std::vector<BufferView> inputs = {{name.data(), name.size()}};
+      result->rc = scheduler.Submit(key, spec, max_batch, inputs,
+                                    &result->outputs, timeout_ms, {},
+                                    [cancelled] { return cancelled; });
+    }));
+  };
+  auto join = [&threads] {
+    for (auto& t : threads) { t.join(); }
+    threads.clear();
+  };
+  auto echoed = [](const Result& r, const std::string& name) {
+    return (r.rc == 0) && (r.outputs.size() == 1) && (r.outputs[0] == name);
+  };
+
+  // A full batch runs at once, without waiting out the delay
+  {
+    Result r[4];
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 4; ++i) {
+      submit("in" + std::to_string(i), 0, 4, 0, false, &r[i]);
+    }
+    join();
+    const std::vector<size_t> runs = model.TakeRuns();
+    bool ok = (runs == std::vector<size_t>{4}) && (MsSince(start) < 150.0);
+    for (int i = 0; i < 4; ++i) {
+      ok = ok && echoed(r[i], "in" + std::to_string(i));
+    }
+    if (!ok) {
+      FAIL("Batch runs once it is full");
+      return 1;
+    }
+    PASS("Batch runs once it is full");
+  }
+
+  // A batch that does not fill up runs once the delay is over
+  {
+    Result a, b;
+    const auto start = std::chrono::steady_clock::now();
+    submit("a", 0, 8, 0, false, &a);
+    submit("b", 20, 8, 0, false, &b);
+    join();
+    const double elapsed_ms = MsSince(start);
+    if ((model.TakeRuns() != std::vector<size_t>{2}) || !echoed(a, "a") ||
+        !echoed(b, "b") || (elapsed_ms < max_delay_ms - 5) ||
+        (elapsed_ms > max_delay_ms + 150)) {
+      FAIL("Batch runs after the delay");
+      return 1;
+    }
+    PASS("Batch runs after the delay");
+  }
+
+  // A cancelled leader is left out, but its thread still runs the batch for
+  // the requests that joined it
+  {
+    Result leader, f1, f2;
+    submit("leader", 0, 8, 0, true, &leader);
+    submit("f1", 20, 8, 0, false, &f1);
+    submit("f2", 20, 8, 0, false, &f2);
+    join();
+    if ((model.TakeRuns() != std::vector<size_t>{2}) || (leader.rc == 0) ||
+        (leader.outputs != std::vector<std::string>{"Cancelled"}) ||
+        !echoed(f1, "f1") || !echoed(f2, "f2")) {
+      FAIL("Cancelled leader");
+      return 1;
+    }
+    PASS("Cancelled leader");
+  }
+
+  // A request whose deadline passes while it is queued does not run
+  {
+    Result expired, kept;
+    submit("expired", 0, 8, 50, false, &expired);
+    submit("kept", 10, 8, 0, false, &kept);
+    join();
+    if ((model.TakeRuns() != std::vector<size_t>{1}) || (expired.rc == 0) ||
+        (expired.outputs !=
+         std::vector<std::string>{"Model execution timed out"}) ||
+        !echoed(kept, "kept")) {
+      FAIL("Expired request is dropped from its batch");
+      return 1;
+    }
+    PASS("Expired request is dropped from its batch");
+  }
+
+  // A failed batch runs its requests one by one, so only the bad one fails
+  {
+    Result good1, bad, good2;
+    submit("good1", 0, 8, 0, false, &good1);
+    submit("bad", 20, 8, 0, false, &bad);
+    submit("good2", 20, 8, 0, false, &good2);
+    join();
+    if ((model.TakeRuns() != std::vector<size_t>{3, 1, 1, 1}) ||
+        !echoed(good1, "good1") || !echoed(good2, "good2") || (bad.rc == 0) ||
+        (bad.outputs != std::vector<std::string>{"Bad input"})) {
+      FAIL("Failed batch falls back to single runs");
+      return 1;
+    }
+    PASS("Failed batch falls back to single runs");
+  }
+
+  // A batch that failed by running out of time is not run again
+  {
+    Result slow, other;
+    submit("slow", 0, 8, 300, false, &slow);
+    submit("other", 20, 8, 300, false, &other);
+    join();
+    const std::string timed_out = "Model execution timed out";
+    if ((model.TakeRuns() != std::vector<size_t>{2}) || (slow.rc == 0) ||
+        (other.rc == 0) || (other.outputs != std::vector<std::string>{
+                                                 timed_out})) {
+      FAIL("Timed-out batch is not retried");
+      return 1;
+    }
+    PASS("Timed-out batch is not retried");
+  }
+
+  // Nothing is left queued, and the counters add up
+  const BatchScheduler::Stats stats = scheduler.GetStats("echo");
+  if ((stats.queue_depth != 0) || (stats.batches != 6) ||
+      (stats.batched_reqs != 14) || (stats.batched_inputs != 14)) {
+    printf("depth %lu, batches %lu, requests %lu, inputs %lu\n",
+           (unsigned long)stats.queue_depth, (unsigned long)stats.batches,
+           (unsigned long)stats.batched_reqs,
+           (unsigned long)stats.batched_inputs);
+    FAIL("Stats");
+    return 1;
+  }
+  PASS("Stats");
+
+  printf("All tests passed!!\n");
+  return 0;
+}
@@ -10,6 +10,8 @@ namespace internal {
 static const std::string kLocalModelBaseDir = "/tmp/infaas/models";
 static const std::string kLocalInputBaseDir = "/tmp/infaas/input";
 static const std::string kLocalOutputBaseDir = "/tmp/infaas/output";
+// Online result cache segments, one subdirectory per worker
+static const std::string kLocalResultCacheDir = "/tmp/infaas/result_cache";
 
 }  // namespace internal
 }  // namespace infaas
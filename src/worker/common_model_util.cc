@@ -26,9 +26,13 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <cstdio>
 #include <deque>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <memory>
 #include <set>
@@ -37,6 +41,9 @@
 #include <random>
 #include <cstdlib>
 #include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
 
 // PNB 2025.11.28 - Local paths
 #include "common_local_paths.h"
@@ -51,7 +58,11 @@
 // #endif
 
 #include "common_model_util.h"
-#include "include/base64.h"
+#include "common/async_log.h"
+#include "model_executor.h"
+#include "base64_codec.h"
+#include "curl_handle_pool.h"
+#include "json_stream.h"
 //#include "include/constants.h"
 #include "constants.h"  // PNB: (2025.11.28)
 #include "include/json.hpp"
@@ -85,6 +96,11 @@ using infaas::internal::QueryOfflineRequest;
 using infaas::internal::QueryOfflineResponse;
 using infaas::internal::InfaasRequestStatusEnum;
 using infaas::internal::Autoscaler;
+using infaas::internal::Base64EncodedLength;
+using infaas::internal::BASE64_URL;
+using infaas::internal::CurlHandlePool;
+using infaas::internal::JsonWriter;
+using infaas::internal::ReadPredictions;
 
 // ================================================
 // CONSTANTS AND GLOBAL VARIABLES
@@ -332,6 +348,8 @@ namespace CpuModelManager {
     std::map<std::string, int> nametoport;
     std::set<int, std::greater<int>> usedports;
     std::mutex updatemutex;
+    // Connections to the REST-backed containers, kept alive per port
+    CurlHandlePool curlpool;
     
     size_t numReplicas(const std::string& modelname) {
         return modeltonamesonline[modelname].size();
@@ -635,6 +653,7 @@ namespace CpuModelManager {
             int portnum = ntpit->second;
             nametoport.erase(ntpit);
             usedports.erase(portnum);
+            curlpool.DropPort(portnum);
         }
         
         int8_t isrunning = -1;
@@ -732,8 +751,8 @@ namespace CpuModelManager {
         }
         
         int portnum = nametoport[instancename];
-        std::cout << "Serve with instance " << instancename << " port number " 
-                  << std::to_string(portnum) << std::endl;
+        INFAAS_LOG(INFO) << "Serve with instance " << instancename << " port number " 
+                         << std::to_string(portnum);
         
         auto framework = rmd->get_model_info(modelname, "framework");
 	Address destaddr;
@@ -754,109 +773,96 @@ namespace CpuModelManager {
             uint64_t time1 = get_curr_timestamp(), time2;
             Status status = stub->QueryOnline(&context, request, &response);
             time2 = get_curr_timestamp();
-            printf("[common_model_util.cc] Pytorch inference time %.4lf ms.\n",
-                   get_duration_ms(time1, time2));
+            INFAAS_LOG(INFO) << "[common_model_util.cc] Pytorch inference time " << std::fixed
+                             << std::setprecision(4) << get_duration_ms(time1, time2) << " ms.";
         } else if (framework == "tensorflow-cpu") {
-            const google::protobuf::RepeatedPtrField<std::string>& rawinput = request.raw_input();
             const auto& raw_input = request.raw_input(); // PNB: (2025.12.27)
 	    size_t batchsize = raw_input.size();
             
-            CURL* curl = curl_easy_init();
+            CURL* curl = curlpool.Acquire(portnum);
             if (!curl) {
                 std::cerr << "failed to post request to model " << modelname << std::endl;
                 return -1;
             }
             
+            // Bodies are built into per-thread buffers that keep their capacity
+            static thread_local std::string curlreqs;
+            static thread_local std::string readbuff;
+            curlreqs.clear();
+            readbuff.clear();
+            
             uint64_t time1 = get_curr_timestamp();
-            std::string curlreqs = "{\"instances\":[";
+            size_t reqsize = 32;
+            for (size_t idx = 0; idx < batchsize; idx++) {
+                reqsize += 8 + Base64EncodedLength(raw_input.Get(idx).size());
+            }
+            curlreqs.reserve(reqsize);
             
-            // Encode each input as base64
+            // Encode each input as URL-safe base64, straight into the body
+            JsonWriter reqwriter(&curlreqs);
+            reqwriter.BeginObject().Key("instances", 9).BeginArray();
             for (size_t idx = 0; idx < batchsize; idx++) {
-
-	      // PNB: (2025.12.27)
-		const std::string& s = raw_input.Get(idx);
-                const char* rawptr = s.data();
-                unsigned int rawsize = s.size();
-		
-		
-                unsigned char const* bytestoencode = 
-                reinterpret_cast<unsigned char const*>(rawptr);
-                std::string base64str = base64_encode(bytestoencode, rawsize);
-                std::replace(base64str.begin(), base64str.end(), '+', '-');
-                std::replace(base64str.begin(), base64str.end(), '/', '_');
-                
-                if (idx > 0) curlreqs += ",";
-                curlreqs += "\"b64:" + base64str + "\"";
+                const std::string& s = raw_input.Get(idx);
+                reqwriter.Base64(s.data(), s.size(), "b64:", BASE64_URL);
             }
-            curlreqs += "]}";
+            reqwriter.EndArray().EndObject();
             
-            std::cout << "curlreqs string size " << curlreqs.size() << std::endl;
+            INFAAS_LOG(DEBUG) << "curlreqs string size " << curlreqs.size();
             uint64_t timeb64encode = get_curr_timestamp();
-            printf("[common_model_util.cc] TF-CPU base64 encode time %.4lf ms.\n",
-                   get_duration_ms(time1, timeb64encode));
+            INFAAS_LOG(INFO) << "[common_model_util.cc] TF-CPU base64 encode time " << std::fixed
+                             << std::setprecision(4) << get_duration_ms(time1, timeb64encode) << " ms.";
             
-            std::string readbuff;
             std::string tfurl = "http://localhost:" + std::to_string(portnum) + 
                                "/v1/models/" + modelname + ":predict";
             
             // Now post the request
-            struct curl_slist* curllist = NULL;
-            curllist = curl_slist_append(curllist, "Content-Type: application/json");
-            curllist = curl_slist_append(curllist, "charset: utf-8");
+            static curl_slist* const curllist = [] {
+                curl_slist* list = curl_slist_append(NULL, "Content-Type: application/json");
+                return curl_slist_append(list, "charset: utf-8");
+            }();
             
             curl_easy_setopt(curl, CURLOPT_URL, tfurl.c_str());
             curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 1L);
             curl_easy_setopt(curl, CURLOPT_HTTPHEADER, curllist);
             curl_easy_setopt(curl, CURLOPT_POSTFIELDS, curlreqs.c_str());
-            curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, curlreqs.length());
-            curl_easy_setopt(curl, CURLOPT_POST, 1);
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)curlreqs.length());
+            curl_easy_setopt(curl, CURLOPT_POST, 1L);
             
-            // Callback function to write response
-            auto CurlWriteCallBack = [](void* contents, size_t size, size_t nmemb, std::string* userp) {
-                userp->append((char*)contents, size * nmemb);
+            // Callback function to write response; varargs need a plain function pointer
+            curl_write_callback curlwritecallback = [](char* contents, size_t size, size_t nmemb, void* userp) {
+                static_cast<std::string*>(userp)->append(contents, size * nmemb);
                 return size * nmemb;
             };
-            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, CurlWriteCallBack);
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curlwritecallback);
             curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readbuff);
             curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
             
             CURLcode curlres = curl_easy_perform(curl);
-            
-            // Process output
-            if (readbuff.size() > 1000) std::cout << "Readbuff " << readbuff << std::endl;
-            json bodyjs = json::parse(readbuff);
-            auto predjs = bodyjs["predictions"];
-            
-            // One batch at a time.
-            float* predv = nullptr;
-            for (json::iterator it = predjs.begin(); it != predjs.end(); ++it) {
-                std::cout << "Size " << it->size() << std::endl;
-                if (predv) delete[] predv;
-                predv = new float[it->size()];
-                
-                // Turn the string of floating points into raw bytes.
-                int cntit = 0;
-                for (auto& i : *it) {
-                    predv[cntit++] = std::stof(i.dump());
-                }
-                response.add_raw_output(reinterpret_cast<const char*>(predv), 
-                                  it->size() * sizeof(float));
+            curlpool.Release(portnum, curl, curlres == CURLE_OK);
+            if (curlres != CURLE_OK) {
+                std::cerr << "failed to post request to model " << modelname << ": "
+                          << curl_easy_strerror(curlres) << std::endl;
+                return -1;
             }
-            if (predv) delete[] predv;
             
-            curl_easy_cleanup(curl);
-            curl_slist_free_all(curllist);
+            // Process output: one raw output of packed floats per prediction
+            if (readbuff.size() > 1000) INFAAS_LOG(DEBUG) << "Readbuff " << readbuff;
+            std::string readerr;
+            if (ReadPredictions(readbuff, response.mutable_raw_output(), &readerr) != 0) {
+                std::cerr << "Bad response from model " << modelname << ": " << readerr << std::endl;
+                return -1;
+            }
             
             time2 = get_curr_timestamp();
-            printf("[common_model_util.cc] TF-CPU inference time %.4lf ms.\n",
-                   get_duration_ms(time1, time2));
+            INFAAS_LOG(INFO) << "[common_model_util.cc] TF-CPU inference time " << std::fixed
+                             << std::setprecision(4) << get_duration_ms(time1, time2) << " ms.";
         } else {
             std::cerr << "Don't support framework " << framework << std::endl;
             return -1;
         }
         
-        std::cout << "rawoutput batch size " << response.raw_output_size() 
-                  << " each dimension " << response.raw_output(0).size() << std::endl;
+        INFAAS_LOG(INFO) << "rawoutput batch size " << response.raw_output_size() 
+                         << " each dimension " << response.raw_output(0).size();
         return 0;
     }
     
@@ -1288,6 +1294,98 @@ bool CommonModelUtil::HasBlacklisted() {
 // DiffusionModelManager definitions  PNB: (2026.01.08)
 // ============================================================
 
+namespace {
+
+// Images waiting to be written, in bytes; past this, copies are dropped
+const size_t spool_max_bytes = 256 << 20;
+
+// Writes copies of generated images on a background thread, so a reply
+// never waits for the disk. Each image goes to a temporary file that is
+// renamed into place, so a reader never sees a partial image.
+class ImageSpooler {
+public:
+  static ImageSpooler& Get() {
+    static ImageSpooler* spooler = new ImageSpooler();  // Outlives static dtors
+    return *spooler;
+  }
+
+  std::string dir() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dir_;
+  }
+
+  void set_dir(const std::string& dir) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    dir_ = dir;
+  }
+
+  void Write(const std::string& path, const std::string& image) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (pending_bytes_ + image.size() > spool_max_bytes) {
+        INFAAS_LOG(WARN) << "[LOG]: Image spool full, not keeping " << path;
+        return;
+      }
+      pending_bytes_ += image.size();
+      pending_.emplace_back(path, image);
+      if (!started_) {
+        started_ = true;
+        std::thread(&ImageSpooler::Run, this).detach();
+      }
+    }
+    cv_.notify_one();
+  }
+
+private:
+  void Run() {
+    while (true) {
+      std::pair<std::string, std::string> item;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return !pending_.empty(); });
+        item.swap(pending_.front());
+        pending_.pop_front();
+        pending_bytes_ -= item.second.size();
+      }
+      const std::string tmp = item.first + ".tmp";
+      std::ofstream f(tmp, std::ios::binary);
+      f.write(item.second.data(), item.second.size());
+      f.close();
+      if (!f || (rename(tmp.c_str(), item.first.c_str()) != 0)) {
+        INFAAS_LOG(WARN) << "[LOG]: Failed to write " << item.first;
+        remove(tmp.c_str());
+      }
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::string dir_;
+  std::deque<std::pair<std::string, std::string>> pending_;
+  size_t pending_bytes_ = 0;
+  bool started_ = false;
+};
+
+// A path for one image of model in dir, unique to this worker process
+std::string ImagePath(const std::string& dir, const std::string& model) {
+  static std::atomic<uint64_t> next_image(0);
+  return dir + "/" + model + "-" + std::to_string(getpid()) + "-" +
+         std::to_string(next_image.fetch_add(1)) + ".png";
+}
+
+int8_t ReadImage(const std::string& path, std::string* bytes) {
+  std::ifstream f(path, std::ios::binary | std::ios::ate);
+  if (!f) { return -1; }
+  const std::streamoff size = f.tellg();
+  if (size <= 0) { return -1; }
+  bytes->resize(size);
+  f.seekg(0);
+  f.read(&(*bytes)[0], size);
+  return f ? 0 : -1;
+}
+
+}  // namespace
+
 // LoadModel defintion  
 int DiffusionModelManager::LoadModel(
     const std::string& model,
@@ -1310,36 +1408,74 @@ int DiffusionModelManager::Generate( // PNB: added (2026).01.15)
     int width,
     int height,
     std::string& png_bytes,
-    std::string& output_path) {
-
-  // Example: invoke local diffusion server
-  std::string cmd =
-      "python3 generate.py "
-      "--prompt \"" + prompt + "\" "
-      "--steps " + std::to_string(steps) +
-      " --width " + std::to_string(width) +
-      " --height " + std::to_string(height) +
-      " --output /tmp/out.png";
-
-  if (system(cmd.c_str()) != 0) {
+    std::string& output_path,
+    std::unique_ptr<RedisMetadata>& rm) {
+  output_path.clear();
+
+  ModelSpec spec;
+  spec.model_name = model;
+  if (rm->get_model_exec_info(model, &spec.framework, &spec.task,
+                              &spec.exec_path, &spec.entry_point,
+                              &spec.env_path, &spec.exec_protocol) != 0) {
+    INFAAS_LOG(ERROR) << "[LOG]: No execution metadata for " << model;
     return -1;
   }
+  const std::string dir = ImageSpooler::Get().dir();
+
+  if (spec.shm_protocol()) {
+    json params;
+    params["prompt"] = prompt;
+    params["steps"] = steps;
+    params["width"] = width;
+    params["height"] = height;
+    const std::string input = params.dump();
+
+    std::vector<std::string> outputs;
+    int rc = ExecuteModel(spec, {{input.data(), input.size()}}, &outputs);
+    if ((rc != 0) || (outputs.size() != 1) || outputs[0].empty()) {
+      INFAAS_LOG(ERROR) << "[LOG]: " << model << " generation failed: "
+                        << (outputs.empty() ? "no output" : outputs[0]);
+      return -1;
+    }
+    png_bytes.swap(outputs[0]);
 
-  output_path = "/tmp/out.png";
-
-  // Read PNG into memory
-  std::ifstream f(output_path, std::ios::binary);
-  if (!f) return -1;
-
-  png_bytes.assign(
-      std::istreambuf_iterator<char>(f),
-      std::istreambuf_iterator<char>());
+    if (!dir.empty()) {
+      output_path = ImagePath(dir, model);
+      ImageSpooler::Get().Write(output_path, png_bytes);
+    }
+    return 0;
+  }
 
+  // The entry point writes the image to --output: a path unique to this
+  // request, removed once read unless images are kept
+  const std::string path = ImagePath(dir.empty() ? "/tmp" : dir, model);
+  std::vector<std::string> argv = {spec.env_path + "/bin/python3",
+                                   spec.entry_point,
+                                   "--prompt", prompt,
+                                   "--steps", std::to_string(steps),
+                                   "--width", std::to_string(width),
+                                   "--height", std::to_string(height),
+                                   "--output", path};
+  std::string stderr_out;
+  int rc = ForkAndExec(argv, nullptr, &stderr_out);
+  if ((rc != 0) || ReadImage(path, &png_bytes)) {
+    INFAAS_LOG(ERROR) << "[LOG]: " << model << " generation failed: "
+                      << stderr_out;
+    remove(path.c_str());
+    return -1;
+  }
+  if (dir.empty()) {
+    remove(path.c_str());
+  } else {
+    output_path = path;
+  }
   return 0;
 }
 
+void DiffusionModelManager::SetOutputDir(const std::string& dir) {
+  ImageSpooler::Get().set_dir(dir);
+}
 
-  
   // UnloadModel definition 
 int DiffusionModelManager::UnloadModel(
     const std::string& model,
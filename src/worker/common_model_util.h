@@ -77,6 +77,23 @@ public:
       const std::string& model,
       std::unique_ptr<RedisMetadata>& rm);
 
+  // Generates one image with model's entry point (its model:<name> hash in
+  // Redis, see ModelSpec) and returns the encoded image in png_bytes.
+  //
+  // An "argv" entry point (e.g. generate.py) is run one-shot as
+  //   <env_path>/bin/python3 <entry_point> --prompt <p> --steps <n>
+  //       --width <w> --height <h> --output <path>
+  // and must write the image to <path>. The path is unique to the request,
+  // in the SetOutputDir directory if one was set (and then returned in
+  // output_path), or else a temporary file that is removed once read.
+  //
+  // An "shm" entry point gets one input, the JSON object
+  //   {"prompt": <p>, "steps": <n>, "width": <w>, "height": <h>}
+  // and returns the encoded image as its only output, on a warm model
+  // process if it can be kept warm. The image comes straight from the
+  // process's output region and, with SetOutputDir set, is also written in
+  // the background to a path unique to the request, returned in
+  // output_path (empty otherwise).
   static int Generate( // PNB: added (2026).01.15)
       const std::string& model,
       const std::string& prompt,
@@ -84,7 +101,12 @@ public:
       int width,
       int height,
       std::string& png_bytes,
-      std::string& output_path);
+      std::string& output_path,
+      std::unique_ptr<RedisMetadata>& rm);
+
+  // Directory Generate keeps a copy of every image in; empty (the default)
+  // keeps none.
+  static void SetOutputDir(const std::string& dir);
   
   static int UnloadModel(
       const std::string& model,
@@ -0,0 +1,57 @@
+#include "worker/curl_handle_pool.h"
+
+namespace infaas {
+namespace internal {
+
+CurlHandlePool::CurlHandlePool(const size_t max_idle_per_port)
+    : max_idle_per_port_(max_idle_per_port) {}
+
+CurlHandlePool::~CurlHandlePool() {
+  for (auto& port_handles : idle_) {
+    for (CURL* handle : port_handles.second) { curl_easy_cleanup(handle); }
+  }
+}
+
+CURL* CurlHandlePool::Acquire(const int port) {
+  CURL* handle = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = idle_.find(port);
+    if ((it != idle_.end()) && !it->second.empty()) {
+      handle = it->second.back();
+      it->second.pop_back();
+    }
+  }
+  if (handle == nullptr) { return curl_easy_init(); }
+  curl_easy_reset(handle);
+  return handle;
+}
+
+void CurlHandlePool::Release(const int port, CURL* handle,
+                             const bool reusable) {
+  if (handle == nullptr) { return; }
+  if (reusable) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<CURL*>& handles = idle_[port];
+    if (handles.size() < max_idle_per_port_) {
+      handles.push_back(handle);
+      return;
+    }
+  }
+  curl_easy_cleanup(handle);
+}
+
+void CurlHandlePool::DropPort(const int port) {
+  std::vector<CURL*> handles;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = idle_.find(port);
+    if (it == idle_.end()) { return; }
+    handles.swap(it->second);
+    idle_.erase(it);
+  }
+  for (CURL* handle : handles) { curl_easy_cleanup(handle); }
+}
+
+}  // namespace internal
+}  // namespace infaas
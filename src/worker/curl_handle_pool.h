@@ -0,0 +1,52 @@
+#pragma once
+
+#ifndef INFAAS_CURL_HANDLE_POOL_H_
+#define INFAAS_CURL_HANDLE_POOL_H_
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <curl/curl.h>
+
+namespace infaas {
+namespace internal {
+
+/**
+ * Idle libcurl easy handles, kept per model container port. A handle keeps
+ * its connection open after a transfer, so taking one back out for the same
+ * port reuses the connection (HTTP keep-alive) instead of setting up a new
+ * one for every query. Thread-safe.
+ */
+class CurlHandlePool {
+public:
+  explicit CurlHandlePool(const size_t max_idle_per_port = 8);
+  ~CurlHandlePool();
+
+  /**
+   * Takes an idle handle for port, or makes a new one. The handle's options
+   * are reset to libcurl's defaults; its open connection is kept.
+   *
+   * @return the handle, or nullptr if libcurl could not make one.
+   */
+  CURL* Acquire(const int port);
+
+  /**
+   * Gives a handle back after a transfer. Pass reusable = false after a
+   * transport error, so the handle (and its connection) is closed instead.
+   */
+  void Release(const int port, CURL* handle, const bool reusable = true);
+
+  // Closes the idle handles of port, e.g. once its container is gone.
+  void DropPort(const int port);
+
+private:
+  const size_t max_idle_per_port_;
+  std::mutex mutex_;
+  std::unordered_map<int, std::vector<CURL*>> idle_;
+};
+
+}  // namespace internal
+}  // namespace infaas
+
+#endif  // INFAAS_CURL_HANDLE_POOL_H_
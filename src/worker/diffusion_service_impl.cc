@@ -8,9 +8,14 @@
 #include "diffusion_service_impl.h"
 #include "common_model_util.h"
 
+#include <utility>
+
 namespace infaas {
 namespace internal {
 
+DiffusionServiceImpl::DiffusionServiceImpl(const struct Address& redis_addr)
+    : rm_(new RedisMetadata(redis_addr)) {}
+
 grpc::Status DiffusionServiceImpl::Generate(
     grpc::ServerContext*,
     const DiffusionRequest* request,
@@ -33,7 +38,8 @@ grpc::Status DiffusionServiceImpl::Generate(
         request->width(),
         request->height(),
         png_bytes,
-        output_path);
+        output_path,
+        rm_);
 
     if (ret != 0) {
       response->set_status("ERROR");
@@ -41,7 +47,7 @@ grpc::Status DiffusionServiceImpl::Generate(
       return grpc::Status::OK;
     }
 
-    response->set_image_png(png_bytes);
+    response->set_image_png(std::move(png_bytes));
     response->set_image_path(output_path);
     response->set_status("OK");
     return grpc::Status::OK;
@@ -7,17 +7,26 @@
 
 #pragma once
 
+#include <memory>
+
 #include "diffusion_service.grpc.pb.h"
+#include "metadata-store/redis_metadata.h"
 
 namespace infaas {
 namespace internal {
 
 class DiffusionServiceImpl final : public DiffusionService::Service {
  public:
+  // Models' execution metadata is read from the Redis at redis_addr
+  explicit DiffusionServiceImpl(const struct Address& redis_addr);
+
   grpc::Status Generate(
       grpc::ServerContext* context,
       const DiffusionRequest* request,
       DiffusionReply* response) override;
+
+ private:
+  std::unique_ptr<RedisMetadata> rm_;
 };
 
 }  // namespace internal
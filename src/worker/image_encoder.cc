@@ -0,0 +1,183 @@
+#include "worker/image_encoder.h"
+
+#include <time.h>
+
+#include <cstring>
+#include <exception>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace infaas {
+namespace internal {
+
+namespace {
+
+const int default_png_level = 3;  // zlib's sweet spot for speed vs size
+const int default_quality = 90;   // JPEG and WebP
+
+uint64_t ThreadCpuUs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+bool IsRawImage(const std::string& output) {
+  if (output.size() < sizeof(RawImageHeader)) { return false; }
+  RawImageHeader header;
+  memcpy(&header, output.data(), sizeof(header));
+  return header.magic == raw_image_magic;
+}
+
+}  // namespace
+
+ImageEncoder::ImageEncoder(const int num_threads)
+    : running_(true), images_(0), raw_bytes_(0), encoded_bytes_(0),
+      encode_us_(0) {
+  for (int i = 0; i < (num_threads > 0 ? num_threads : 1); ++i) {
+    threads_.push_back(std::thread(&ImageEncoder::Run, this));
+  }
+}
+
+ImageEncoder::~ImageEncoder() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  cv_.notify_all();
+  for (std::thread& t : threads_) { t.join(); }
+}
+
+int8_t ImageEncoder::Encode(const ImageFormat format, const int quality,
+                            std::vector<std::string>* outputs) {
+  if (format == IMAGE_RAW) { return 0; }
+  std::vector<size_t> raw;
+  for (size_t i = 0; i < outputs->size(); ++i) {
+    if (IsRawImage((*outputs)[i])) { raw.push_back(i); }
+  }
+  if (raw.empty()) { return 0; }
+
+  // The caller waits for its own images only
+  std::mutex done_mutex;
+  std::condition_variable done_cv;
+  size_t remaining = raw.size();
+  std::string error;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i : raw) {
+      std::string* output = &(*outputs)[i];
+      tasks_.push_back([&, output] {
+        std::string task_error;
+        bool ok = EncodeOne(format, quality, output, &task_error);
+        std::lock_guard<std::mutex> done_lock(done_mutex);
+        if (!ok && error.empty()) { error.swap(task_error); }
+        if (--remaining == 0) { done_cv.notify_one(); }
+      });
+    }
+  }
+  cv_.notify_all();
+
+  std::unique_lock<std::mutex> done_lock(done_mutex);
+  done_cv.wait(done_lock, [&] { return remaining == 0; });
+  if (!error.empty()) {
+    outputs->assign(1, error);
+    return -1;
+  }
+  return 0;
+}
+
+ImageEncoder::Stats ImageEncoder::GetStats() const {
+  Stats stats;
+  stats.images = images_.load(std::memory_order_relaxed);
+  stats.raw_bytes = raw_bytes_.load(std::memory_order_relaxed);
+  stats.encoded_bytes = encoded_bytes_.load(std::memory_order_relaxed);
+  stats.encode_us = encode_us_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+/*********************** Private Functions ***********************/
+
+void ImageEncoder::Run() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return !running_ || !tasks_.empty(); });
+      if (tasks_.empty()) { return; }
+      task.swap(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+bool ImageEncoder::EncodeOne(const ImageFormat format, const int quality,
+                             std::string* output, std::string* error) {
+  RawImageHeader header;
+  memcpy(&header, output->data(), sizeof(header));
+  const uint64_t pixel_bytes =
+      (uint64_t)header.width * header.height * header.channels;
+  if (((header.channels != 1) && (header.channels != 3) &&
+       (header.channels != 4)) ||
+      (output->size() - sizeof(header) != pixel_bytes)) {
+    *error = "Malformed raw image from the model";
+    return false;
+  }
+
+  const char* ext;
+  std::vector<int> params;
+  switch (format) {
+  case IMAGE_JPEG:
+    ext = ".jpg";
+    params = {cv::IMWRITE_JPEG_QUALITY,
+              quality > 0 ? quality : default_quality};
+    break;
+  case IMAGE_WEBP:
+    ext = ".webp";
+    params = {cv::IMWRITE_WEBP_QUALITY,
+              quality > 0 ? quality : default_quality};
+    break;
+  default:
+    ext = ".png";
+    params = {cv::IMWRITE_PNG_COMPRESSION,
+              quality > 0 ? quality : default_png_level};
+    break;
+  }
+
+  const uint64_t start = ThreadCpuUs();
+  std::vector<uchar> encoded;
+  try {
+    // OpenCV wants BGR(A); JPEG has no alpha
+    cv::Mat pixels(header.height, header.width, CV_8UC(header.channels),
+                   &(*output)[sizeof(header)]);
+    cv::Mat image;
+    if (header.channels == 1) {
+      image = pixels;
+    } else if ((header.channels == 4) && (format != IMAGE_JPEG)) {
+      cv::cvtColor(pixels, image, cv::COLOR_RGBA2BGRA);
+    } else {
+      cv::cvtColor(pixels, image,
+                   (header.channels == 4) ? cv::COLOR_RGBA2BGR
+                                          : cv::COLOR_RGB2BGR);
+    }
+    if (!cv::imencode(ext, image, encoded, params)) {
+      *error = std::string("Failed to encode ") + (ext + 1);
+      return false;
+    }
+  } catch (const std::exception& e) {
+    *error = std::string("Failed to encode ") + (ext + 1) + ": " + e.what();
+    return false;
+  }
+
+  encode_us_.fetch_add(ThreadCpuUs() - start, std::memory_order_relaxed);
+  images_.fetch_add(1, std::memory_order_relaxed);
+  raw_bytes_.fetch_add(output->size(), std::memory_order_relaxed);
+  encoded_bytes_.fetch_add(encoded.size(), std::memory_order_relaxed);
+  output->assign(reinterpret_cast<const char*>(encoded.data()),
+                 encoded.size());
+  return true;
+}
+
+}  // namespace internal
+}  // namespace infaas
@@ -0,0 +1,91 @@
+#pragma once
+
+#ifndef INFAAS_IMAGE_ENCODER_H_
+#define INFAAS_IMAGE_ENCODER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "query.pb.h"
+
+namespace infaas {
+namespace internal {
+
+/**
+ * A raw image as a model process returns it: this header, then
+ * height * width * channels bytes of 8-bit pixels, row major, channels
+ * interleaved (1 = gray, 3 = RGB, 4 = RGBA). See raw_image() in
+ * model_server.py.
+ */
+struct RawImageHeader {
+  uint32_t magic;
+  uint32_t width;
+  uint32_t height;
+  uint32_t channels;
+};
+
+static const uint32_t raw_image_magic = 0x44494649;  // "DIFI"
+
+/**
+ * Encodes the raw images of model outputs on a pool of threads, so the
+ * model process only hands over pixels and the format is picked per
+ * request. Outputs that are not raw images (a model that encodes its own
+ * output) are passed through unchanged.
+ */
+class ImageEncoder {
+public:
+  struct Stats {
+    uint64_t images;
+    uint64_t raw_bytes;
+    uint64_t encoded_bytes;
+    uint64_t encode_us;  // CPU time spent encoding, summed over threads
+  };
+
+  explicit ImageEncoder(const int num_threads);
+  ~ImageEncoder();
+
+  /**
+   * Encodes every raw image in outputs in place, in parallel. IMAGE_RAW
+   * leaves them as they are.
+   *
+   * @param quality  PNG compression level (1-9) or JPEG/WebP quality
+   *                 (1-100); 0 uses the default for the format.
+   *
+   * @return 0 on success, -1 if an image could not be encoded (outputs
+   *         then holds the error message).
+   */
+  int8_t Encode(const ImageFormat format, const int quality,
+                std::vector<std::string>* outputs);
+
+  Stats GetStats() const;
+
+private:
+  void Run();
+  // Encodes one image in place. Returns false with an error message in
+  // *error on failure.
+  bool EncodeOne(const ImageFormat format, const int quality,
+                 std::string* output, std::string* error);
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> tasks_;
+  bool running_;
+  std::vector<std::thread> threads_;
+
+  std::atomic<uint64_t> images_;
+  std::atomic<uint64_t> raw_bytes_;
+  std::atomic<uint64_t> encoded_bytes_;
+  std::atomic<uint64_t> encode_us_;
+};
+
+}  // namespace internal
+}  // namespace infaas
+
+#endif  // INFAAS_IMAGE_ENCODER_H_
@@ -0,0 +1,343 @@
+#include "worker/json_stream.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace infaas {
+namespace internal {
+
+/*********************** JsonWriter ***********************/
+
+JsonWriter::JsonWriter(std::string* out)
+    : out_(out), has_items_(0), depth_(0), after_key_(false) {}
+
+JsonWriter& JsonWriter::BeginObject() {
+  Open('{');
+  return *this;
+}
+
+JsonWriter& JsonWriter::EndObject() {
+  Close('}');
+  return *this;
+}
+
+JsonWriter& JsonWriter::BeginArray() {
+  Open('[');
+  return *this;
+}
+
+JsonWriter& JsonWriter::EndArray() {
+  Close(']');
+  return *this;
+}
+
+JsonWriter& JsonWriter::Key(const char* key, const size_t len) {
+  String(key, len);
+  out_->push_back(':');
+  after_key_ = true;
+  return *this;
+}
+
+JsonWriter& JsonWriter::String(const char* value, const size_t len) {
+  static const char hex[] = "0123456789abcdef";
+  Separate();
+  out_->push_back('"');
+  size_t run = 0;  // Start of the characters that need no escaping
+  for (size_t i = 0; i < len; ++i) {
+    const unsigned char c = static_cast<unsigned char>(value[i]);
+    if ((c >= 0x20) && (c != '"') && (c != '\\')) { continue; }
+    out_->append(value + run, i - run);
+    run = i + 1;
+    if ((c == '"') || (c == '\\')) {
+      out_->push_back('\\');
+      out_->push_back(static_cast<char>(c));
+    } else {
+      const char escaped[] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+      out_->append(escaped, sizeof(escaped));
+    }
+  }
+  out_->append(value + run, len - run);
+  out_->push_back('"');
+  return *this;
+}
+
+JsonWriter& JsonWriter::Base64(const void* data, const size_t len,
+                               const char* prefix,
+                               const Base64Alphabet alphabet) {
+  Separate();
+  const size_t prefix_len = strlen(prefix);
+  const size_t old_size = out_->size();
+  out_->resize(old_size + prefix_len + Base64EncodedLength(len) + 2);
+  char* pos = &(*out_)[old_size];
+  *pos++ = '"';
+  memcpy(pos, prefix, prefix_len);
+  pos += prefix_len;
+  pos += Base64Encode(data, len, pos, alphabet);
+  *pos = '"';
+  return *this;
+}
+
+JsonWriter& JsonWriter::Number(const double value) {
+  Separate();
+  if (!std::isfinite(value)) {
+    // JSON has no NaN or infinity
+    out_->append("null", 4);
+    return *this;
+  }
+  char buf[32];
+  const int n = snprintf(buf, sizeof(buf), "%.17g", value);
+  out_->append(buf, n);
+  return *this;
+}
+
+JsonWriter& JsonWriter::Int(const int64_t value) {
+  Separate();
+  char buf[24];
+  const int n = snprintf(buf, sizeof(buf), "%lld",
+                         static_cast<long long>(value));
+  out_->append(buf, n);
+  return *this;
+}
+
+/*********************** Private Functions ***********************/
+
+void JsonWriter::Separate() {
+  if (after_key_) {
+    after_key_ = false;
+    return;
+  }
+  if (depth_ == 0) { return; }
+  const uint64_t bit = 1ULL << ((depth_ - 1) % max_depth);
+  if (has_items_ & bit) { out_->push_back(','); }
+  has_items_ |= bit;
+}
+
+void JsonWriter::Open(const char c) {
+  Separate();
+  out_->push_back(c);
+  ++depth_;
+  has_items_ &= ~(1ULL << ((depth_ - 1) % max_depth));
+}
+
+void JsonWriter::Close(const char c) {
+  --depth_;
+  out_->push_back(c);
+}
+
+/*********************** ReadPredictions ***********************/
+
+namespace {
+
+const int max_nesting = 256;
+
+// Pulls tokens off a JSON document held in a NUL-terminated buffer
+class JsonScanner {
+public:
+  JsonScanner(const char* begin, const char* end)
+      : begin_(begin), pos_(begin), end_(end) {}
+
+  size_t offset() const { return pos_ - begin_; }
+
+  // Consumes c (after any whitespace) if it is next
+  bool Consume(const char c) {
+    SkipSpace();
+    if ((pos_ < end_) && (*pos_ == c)) {
+      ++pos_;
+      return true;
+    }
+    return false;
+  }
+
+  // Reads a string, unescaped, into *out; skips it if out is null
+  bool ReadString(std::string* out) {
+    if (!Consume('"')) { return false; }
+    if (out) { out->clear(); }
+    while (pos_ < end_) {
+      const char c = *pos_++;
+      if (c == '"') { return true; }
+      if (static_cast<unsigned char>(c) < 0x20) { return false; }
+      if (c != '\\') {
+        if (out) { out->push_back(c); }
+        continue;
+      }
+      if (pos_ >= end_) { return false; }
+      const char e = *pos_++;
+      char plain;
+      switch (e) {
+      case '"': plain = '"'; break;
+      case '\\': plain = '\\'; break;
+      case '/': plain = '/'; break;
+      case 'b': plain = '\b'; break;
+      case 'f': plain = '\f'; break;
+      case 'n': plain = '\n'; break;
+      case 'r': plain = '\r'; break;
+      case 't': plain = '\t'; break;
+      case 'u': {
+        if (end_ - pos_ < 4) { return false; }
+        char hex[5] = {pos_[0], pos_[1], pos_[2], pos_[3], '\0'};
+        char* hex_end;
+        const unsigned long code = strtoul(hex, &hex_end, 16);
+        if (hex_end != hex + 4) { return false; }
+        pos_ += 4;
+        if (out) { AppendUtf8(code, out); }
+        continue;
+      }
+      default:
+        return false;
+      }
+      if (out) { out->push_back(plain); }
+    }
+    return false;
+  }
+
+  bool ReadFloat(float* value) {
+    SkipSpace();
+    if ((pos_ >= end_) ||
+        ((*pos_ != '-') && ((*pos_ < '0') || (*pos_ > '9')))) {
+      return false;
+    }
+    char* number_end;
+    *value = strtof(pos_, &number_end);
+    if ((number_end == pos_) || (number_end > end_)) { return false; }
+    pos_ = number_end;
+    return true;
+  }
+
+  bool SkipValue(const int depth) {
+    if (depth > max_nesting) { return false; }
+    SkipSpace();
+    if (pos_ >= end_) { return false; }
+    switch (*pos_) {
+    case '"':
+      return ReadString(nullptr);
+    case '{':
+      ++pos_;
+      if (Consume('}')) { return true; }
+      do {
+        if (!ReadString(nullptr) || !Consume(':') || !SkipValue(depth + 1)) {
+          return false;
+        }
+      } while (Consume(','));
+      return Consume('}');
+    case '[':
+      ++pos_;
+      if (Consume(']')) { return true; }
+      do {
+        if (!SkipValue(depth + 1)) { return false; }
+      } while (Consume(','));
+      return Consume(']');
+    case 't':
+      return Literal("true", 4);
+    case 'f':
+      return Literal("false", 5);
+    case 'n':
+      return Literal("null", 4);
+    default:
+      float ignored;
+      return ReadFloat(&ignored);
+    }
+  }
+
+private:
+  void SkipSpace() {
+    while ((pos_ < end_) && ((*pos_ == ' ') || (*pos_ == '\n') ||
+                             (*pos_ == '\r') || (*pos_ == '\t'))) {
+      ++pos_;
+    }
+  }
+
+  bool Literal(const char* word, const size_t len) {
+    if ((static_cast<size_t>(end_ - pos_) < len) ||
+        (memcmp(pos_, word, len) != 0)) {
+      return false;
+    }
+    pos_ += len;
+    return true;
+  }
+
+  static void AppendUtf8(const unsigned long code, std::string* out) {
+    if (code < 0x80) {
+      out->push_back(static_cast<char>(code));
+    } else if (code < 0x800) {
+      out->push_back(static_cast<char>(0xc0 | (code >> 6)));
+      out->push_back(static_cast<char>(0x80 | (code & 0x3f)));
+    } else {
+      out->push_back(static_cast<char>(0xe0 | (code >> 12)));
+      out->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+      out->push_back(static_cast<char>(0x80 | (code & 0x3f)));
+    }
+  }
+
+  const char* begin_;
+  const char* pos_;
+  const char* end_;
+};
+
+// Appends the numbers of one prediction to out as packed floats
+bool AppendNumbers(JsonScanner* scanner, const int depth, std::string* out) {
+  if (depth > max_nesting) { return false; }
+  if (!scanner->Consume('[')) {
+    float value;
+    if (!scanner->ReadFloat(&value)) { return false; }
+    out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+    return true;
+  }
+  if (scanner->Consume(']')) { return true; }
+  do {
+    if (!AppendNumbers(scanner, depth + 1, out)) { return false; }
+  } while (scanner->Consume(','));
+  return scanner->Consume(']');
+}
+
+}  // namespace
+
+int8_t ReadPredictions(const std::string& body,
+                       google::protobuf::RepeatedPtrField<std::string>* outputs,
+                       std::string* error) {
+  const int start = outputs->size();
+  JsonScanner scanner(body.data(), body.data() + body.size());
+  std::string key;
+  std::string message;
+  bool has_predictions = false;
+  bool has_error = false;
+
+  bool ok = scanner.Consume('{');
+  if (ok && !scanner.Consume('}')) {
+    do {
+      ok = scanner.ReadString(&key) && scanner.Consume(':');
+      if (!ok) { break; }
+      if (key == "predictions") {
+        ok = scanner.Consume('[');
+        if (ok && !scanner.Consume(']')) {
+          do {
+            ok = AppendNumbers(&scanner, 0, outputs->Add());
+          } while (ok && scanner.Consume(','));
+          ok = ok && scanner.Consume(']');
+        }
+        has_predictions = ok;
+      } else if (key == "error") {
+        has_error = true;
+        ok = scanner.ReadString(&message);
+      } else {
+        ok = scanner.SkipValue(0);
+      }
+    } while (ok && scanner.Consume(','));
+    ok = ok && scanner.Consume('}');
+  }
+
+  if (ok && has_predictions && !has_error) { return 0; }
+  outputs->DeleteSubrange(start, outputs->size() - start);
+  if (has_error) {
+    *error = "Model returned an error: " + message;
+  } else if (!ok) {
+    *error = "Malformed response at byte " + std::to_string(scanner.offset());
+  } else {
+    *error = "Response has no predictions";
+  }
+  return -1;
+}
+
+}  // namespace internal
+}  // namespace infaas
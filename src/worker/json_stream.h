@@ -0,0 +1,80 @@
+#pragma once
+
+#ifndef INFAAS_JSON_STREAM_H_
+#define INFAAS_JSON_STREAM_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <google/protobuf/repeated_field.h>
+
+#include "base64_codec.h"
+
+namespace infaas {
+namespace internal {
+
+/**
+ * Writes JSON straight into a string, for the request bodies of REST-backed
+ * model containers. Commas are placed by the writer; values are written
+ * in place (base64 payloads included), so a body built into a string that
+ * is reused across requests does not allocate once it has grown to size.
+ *
+ * The writer does not check that the calls make a well-formed document.
+ */
+class JsonWriter {
+public:
+  // Appends to *out
+  explicit JsonWriter(std::string* out);
+
+  JsonWriter& BeginObject();
+  JsonWriter& EndObject();
+  JsonWriter& BeginArray();
+  JsonWriter& EndArray();
+  JsonWriter& Key(const char* key, const size_t len);
+  JsonWriter& Key(const std::string& key) {
+    return Key(key.data(), key.size());
+  }
+
+  JsonWriter& String(const char* value, const size_t len);
+  JsonWriter& String(const std::string& value) {
+    return String(value.data(), value.size());
+  }
+  // A string holding prefix followed by the base64 encoding of data
+  JsonWriter& Base64(const void* data, const size_t len,
+                     const char* prefix = "",
+                     const Base64Alphabet alphabet = BASE64_STANDARD);
+  JsonWriter& Number(const double value);
+  JsonWriter& Int(const int64_t value);
+
+private:
+  static const int max_depth = 64;
+
+  // Writes the comma owed before a value or key, if any
+  void Separate();
+  void Open(const char c);
+  void Close(const char c);
+
+  std::string* out_;
+  uint64_t has_items_;  // Bit per open level: something was written there
+  int depth_;
+  bool after_key_;
+};
+
+/**
+ * Reads the "predictions" of a TensorFlow Serving REST response into
+ * outputs without building a document: every prediction becomes one entry
+ * holding its numbers, flattened, as packed floats. A prediction may be a
+ * number or (nested) arrays of numbers.
+ *
+ * @return 0 on success, -1 if the body is malformed or carries an "error"
+ *         (*error then says why, and outputs is left as it was).
+ */
+int8_t ReadPredictions(const std::string& body,
+                       google::protobuf::RepeatedPtrField<std::string>* outputs,
+                       std::string* error);
+
+}  // namespace internal
+}  // namespace infaas
+
+#endif  // INFAAS_JSON_STREAM_H_
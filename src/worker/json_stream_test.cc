@@ -0,0 +1,210 @@
+// Tests of the JSON writer used for model container requests and of the
+// reader for TensorFlow Serving responses: structure, escaping, numbers,
+// base64 payloads, and bodies that are malformed or carry an error.
+//
+// Usage: json_stream_test
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <google/protobuf/repeated_field.h>
+
+#include "worker/json_stream.h"
+
+#define FAIL(x) printf("[FAIL]: %s\n", x)
+#define PASS(x) printf("[PASS]: %s\n", x)
+
+using infaas::internal::JsonWriter;
+using infaas::internal::ReadPredictions;
+
+namespace {
+
+typedef google::protobuf::RepeatedPtrField<std::string> Outputs;
+
+std::string Floats(const std::vector<float>& values) {
+  return std::string(reinterpret_cast<const char*>(values.data()),
+                     values.size() * sizeof(float));
+}
+
+// ReadPredictions on body must fail and leave outputs as they were
+bool Rejects(const std::string& body) {
+  Outputs outputs;
+  *outputs.Add() = "kept";
+  std::string error;
+  return (ReadPredictions(body, &outputs, &error) == -1) && !error.empty() &&
+         (outputs.size() == 1) && (outputs.Get(0) == "kept");
+}
+
+}  // namespace
+
+int main() {
+  // Commas and nesting are placed by the writer
+  {
+    std::string out;
+    JsonWriter w(&out);
+    w.BeginObject()
+        .Key("a").Int(1)
+        .Key("b").BeginArray()
+            .Int(-2).String("s").BeginObject().EndObject()
+            .BeginArray().EndArray()
+        .EndArray()
+        .Key("c").BeginObject().Key("d").Int(3).EndObject()
+        .EndObject();
+    if (out != "{\"a\":1,\"b\":[-2,\"s\",{},[]],\"c\":{\"d\":3}}") {
+      printf("%s\n", out.c_str());
+      FAIL("Writer structure");
+      return 1;
+    }
+    // The writer appends, so a reused body keeps what came before
+    std::string body = "prefix ";
+    JsonWriter(&body).BeginArray().Int(1).EndArray();
+    if (body != "prefix [1]") {
+      FAIL("Writer appends");
+      return 1;
+    }
+    PASS("Writer structure");
+  }
+
+  // Quotes, backslashes and control characters are escaped; everything else
+  // (UTF-8 included) is copied as is
+  {
+    const std::string raw =
+        std::string("q\"b\\n\nt\tc\x01\x1f/\xc3\xa9 end") + '\0' + "z";
+    std::string out;
+    JsonWriter(&out).String(raw).Key(std::string("k\"ey", 4));
+    const std::string expected =
+        "\"q\\\"b\\\\n\\u000at\\u0009c\\u0001\\u001f/\xc3\xa9 end\\u0000z\""
+        "\"k\\\"ey\":";
+    if (out != expected) {
+      printf("%s\n", out.c_str());
+      FAIL("Writer escaping");
+      return 1;
+    }
+
+    // What the writer escapes, the reader unescapes
+    std::string body;
+    JsonWriter(&body).BeginObject().Key("error").String(raw).EndObject();
+    Outputs outputs;
+    std::string error;
+    if ((ReadPredictions(body, &outputs, &error) != -1) ||
+        (error != "Model returned an error: " + raw)) {
+      FAIL("Escaping round trip");
+      return 1;
+    }
+    PASS("Writer escaping");
+  }
+
+  // Numbers keep full precision; JSON has no NaN or infinity
+  {
+    std::string out;
+    JsonWriter(&out)
+        .BeginArray()
+        .Number(0.1)
+        .Number(-2.5e-300)
+        .Number(NAN)
+        .Number(INFINITY)
+        .Int(-9223372036854775807LL)
+        .EndArray();
+    if (out != "[0.10000000000000001,-2.5e-300,null,null,"
+               "-9223372036854775807]") {
+      printf("%s\n", out.c_str());
+      FAIL("Writer numbers");
+      return 1;
+    }
+    PASS("Writer numbers");
+  }
+
+  // Base64 values are written in place, after their prefix
+  {
+    std::string out;
+    JsonWriter(&out)
+        .BeginObject()
+        .Key("b64").Base64("hi", 2)
+        .Key("img").Base64("\xff\xfe", 2, "data:image/png;base64,")
+        .EndObject();
+    if (out != "{\"b64\":\"aGk=\",\"img\":\"data:image/png;base64,//4=\"}") {
+      printf("%s\n", out.c_str());
+      FAIL("Writer base64");
+      return 1;
+    }
+    PASS("Writer base64");
+  }
+
+  // Each prediction becomes one output of packed floats, however nested
+  {
+    Outputs outputs;
+    std::string error;
+    const std::string body =
+        "{ \"model_version\": \"3\", \"meta\": {\"a\": [true, false, null, "
+        "{\"x\": \"}]\"}]},\n \"predictions\": [[1, 2.5], [[3], [-4e2]], 5, "
+        "[]] }";
+    if ((ReadPredictions(body, &outputs, &error) != 0) ||
+        (outputs.size() != 4) || (outputs.Get(0) != Floats({1.0f, 2.5f})) ||
+        (outputs.Get(1) != Floats({3.0f, -400.0f})) ||
+        (outputs.Get(2) != Floats({5.0f})) || !outputs.Get(3).empty()) {
+      printf("%s\n", error.c_str());
+      FAIL("Read predictions");
+      return 1;
+    }
+    Outputs none;
+    if ((ReadPredictions("{\"predictions\": []}", &none, &error) != 0) ||
+        (none.size() != 0)) {
+      FAIL("Read empty predictions");
+      return 1;
+    }
+    PASS("Read predictions");
+  }
+
+  // An error reported by the model, unescaped
+  {
+    Outputs outputs;
+    std::string error;
+    if ((ReadPredictions("{\"error\": \"bad \\\"input\\\" \\u00e9\\n\"}",
+                         &outputs, &error) != -1) ||
+        (error != "Model returned an error: bad \"input\" \xc3\xa9\n") ||
+        !Rejects("{\"predictions\": [1], \"error\": \"late\"}")) {
+      printf("%s\n", error.c_str());
+      FAIL("Read error");
+      return 1;
+    }
+    PASS("Read error");
+  }
+
+  // Malformed bodies fail without touching the outputs
+  {
+    const std::vector<std::string> bodies = {
+        "",
+        "not json",
+        "{}",
+        "{\"predictions\": [[1, 2",
+        "{\"predictions\": [1,]}",
+        "{\"predictions\": [1]",
+        "{\"predictions\": [\"x\"]}",
+        "{\"predictions\": [1] \"other\": 2}",
+        "{\"predictions\": 1}",
+        "{\"other\": tru, \"predictions\": [1]}",
+        "{\"other\": \"\\q\", \"predictions\": [1]}",
+        "{\"other\": \"\\u12\", \"predictions\": [1]}",
+        std::string("{\"other\": \"a\nb\", \"predictions\": [1]}"),
+        "{\"predictions\": [1], \"other\": {\"a\" 1}}",
+        "{\"predictions\": " + std::string(1000, '[') + "1" +
+            std::string(1000, ']') + "}",
+        "{\"other\": " + std::string(1000, '[') + std::string(1000, ']') +
+            ", \"predictions\": [1]}",
+    };
+    for (const std::string& body : bodies) {
+      if (!Rejects(body)) {
+        printf("Accepted: %.80s\n", body.c_str());
+        FAIL("Malformed bodies rejected");
+        return 1;
+      }
+    }
+    PASS("Malformed bodies rejected");
+  }
+
+  printf("All tests passed!!\n");
+  return 0;
+}
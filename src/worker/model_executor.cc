@@ -5,38 +5,181 @@ Purpose: For implementing executing model
 File: model_executor.cc
 */
 
+#include <memory>
+#include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "model_executor.h"
+#include "model_process_pool.h"
 #include "process_executor.h"
+#include "shm_transport.h"
 
+using infaas::internal::BufferView;
+using infaas::internal::CancelledFn;
+using infaas::internal::ExecOptions;
 using infaas::internal::ForkAndExec;
+using infaas::internal::InputParams;
+using infaas::internal::ModelProcessPool;
+using infaas::internal::PackBuffers;
+using infaas::internal::PreviewRequest;
+using infaas::internal::ProgressFn;
+using infaas::internal::SharedRegion;
+using infaas::internal::UnpackBuffers;
 
-int ExecuteModel(const ModelSpec& spec,
-                 const std::string& input,
-                 std::string* output) {
+static int16_t pool_procs_per_model = 1;
+static std::once_flag pool_once;
+static std::unique_ptr<ModelProcessPool> model_pool;
 
-  std::vector<std::string> argv;
+// Wall-clock limit for a one-shot run (load + inference) that has no
+// deadline of its own.
+static const int oneshot_timeout_ms = 600000;
 
-  // Python-based execution (diffusion included)
+void ConfigureModelProcessPool(const int16_t procs_per_model) {
+  pool_procs_per_model = procs_per_model;
+}
+
+// One-shot execution of an "argv" model: the inputs, concatenated, go on
+// the command line and stdout is the single output.
+static int ExecuteModelArgv(const ModelSpec& spec,
+                            const std::vector<BufferView>& inputs,
+                            std::vector<std::string>* outputs,
+                            const int timeout_ms) {
+  std::string input;
+  for (const BufferView& v : inputs) { input.append(v.data, v.size); }
+
+  std::vector<std::string> argv;
   argv.push_back(spec.env_path + "/bin/python3");
   argv.push_back(spec.entry_point);
   argv.push_back("--model");
   argv.push_back(spec.model_name);
-
   if (!input.empty()) {
     argv.push_back("--input");
     argv.push_back(input);
   }
 
+  ExecOptions options;
+  options.timeout_ms = (timeout_ms > 0) ? timeout_ms : oneshot_timeout_ms;
+
+  std::string stdout_out;
+  std::string stderr_out;
+  int rc = ForkAndExec(argv, &stdout_out, &stderr_out, options);
+  outputs->push_back(std::move((rc != 0) ? stderr_out : stdout_out));
+  return rc;
+}
+
+// One-shot execution of an "shm" model: start the interpreter, run a single
+// request, exit. Inputs are handed over as a shared-memory region
+// (--input-fd) and the model packs its outputs into another (--output-fd).
+// A model that leaves the output region empty has its stdout returned as
+// the single output.
+static int ExecuteModelOnce(const ModelSpec& spec,
+                            const std::vector<BufferView>& inputs,
+                            std::vector<std::string>* outputs,
+                            const int timeout_ms,
+                            const std::vector<InputParams>& params) {
+
+  SharedRegion input_region;
+  SharedRegion output_region;
+  if (PackBuffers("difs-input", inputs, params, &input_region) ||
+      output_region.Create("difs-output", 0)) {
+    outputs->push_back("Failed to set up shared memory");
+    return -1;
+  }
+
+  std::vector<std::string> argv;
+
+  // Python-based execution (diffusion included)
+  argv.push_back(spec.env_path + "/bin/python3");
+  argv.push_back(spec.entry_point);
+  argv.push_back("--model");
+  argv.push_back(spec.model_name);
+  argv.push_back("--input-fd");
+  argv.push_back(std::to_string(input_region.fd()));
+  argv.push_back("--output-fd");
+  argv.push_back(std::to_string(output_region.fd()));
+
+  ExecOptions options;
+  options.timeout_ms = (timeout_ms > 0) ? timeout_ms : oneshot_timeout_ms;
+  options.inherit_fds = {input_region.fd(), output_region.fd()};
+
+  std::string stdout_out;
   std::string stderr_out;
-  int rc = ForkAndExec(argv, output, &stderr_out);
+  int rc = ForkAndExec(argv, &stdout_out, &stderr_out, options);
 
   if (rc != 0) {
-    *output = stderr_out;
+    outputs->push_back(std::move(stderr_out));
     return rc;
   }
 
+  if (output_region.Remap()) {
+    outputs->push_back("Failed to map model output");
+    return -1;
+  }
+  if (output_region.size() == 0) {
+    outputs->push_back(std::move(stdout_out));
+    return 0;
+  }
+
+  std::vector<BufferView> views;
+  if (UnpackBuffers(output_region, &views)) {
+    outputs->push_back("Malformed model output region");
+    return -1;
+  }
+  outputs->reserve(views.size());
+  for (const BufferView& v : views) {
+    outputs->emplace_back(v.data, v.size);
+  }
   return 0;
 }
+
+int ExecuteModel(const ModelSpec& spec,
+                 const std::vector<BufferView>& inputs,
+                 std::vector<std::string>* outputs,
+                 const int timeout_ms,
+                 const std::vector<InputParams>& params) {
+  return ExecuteModelStreaming(spec, inputs, outputs, PreviewRequest(),
+                               nullptr, timeout_ms, params);
+}
+
+int ExecuteModelStreaming(const ModelSpec& spec,
+                          const std::vector<BufferView>& inputs,
+                          std::vector<std::string>* outputs,
+                          const PreviewRequest& preview,
+                          const ProgressFn& on_progress,
+                          const int timeout_ms,
+                          const std::vector<InputParams>& params) {
+
+  std::call_once(pool_once, [] {
+    model_pool.reset(new ModelProcessPool(pool_procs_per_model));
+  });
+
+  outputs->clear();
+  if (!spec.shm_protocol()) {
+    return ExecuteModelArgv(spec, inputs, outputs, timeout_ms);
+  }
+  int rc = model_pool->Execute(spec, inputs, outputs, timeout_ms, preview,
+                               on_progress, params);
+  if (rc != ModelProcessPool::pool_unavailable) {
+    return rc;
+  }
+
+  outputs->clear();
+  return ExecuteModelOnce(spec, inputs, outputs, timeout_ms, params);
+}
+
+int ExecuteModelStepped(const ModelSpec& spec,
+                        const std::vector<BufferView>& inputs,
+                        const uint32_t steps, const size_t max_inputs,
+                        std::vector<std::string>* outputs,
+                        const int timeout_ms,
+                        const std::vector<InputParams>& params,
+                        const CancelledFn& cancelled) {
+  if (!spec.shm_protocol()) { return ModelProcessPool::pool_unavailable; }
+  std::call_once(pool_once, [] {
+    model_pool.reset(new ModelProcessPool(pool_procs_per_model));
+  });
+  return model_pool->ExecuteStepped(spec, inputs, steps, max_inputs, outputs,
+                                    timeout_ms, params, cancelled);
+}
@@ -7,12 +7,59 @@ File: model_executor.h
 
 #pragma once //preprocessor directive that asks the compiler to include a header file only once and not repeat it; To prevent duplications..
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
+#include "model_process_pool.h"
 #include "process_executor.h"
+#include "shm_transport.h"
 
+// Sets how many warm processes each model may keep (default 1). Must be
+// called before the first ExecuteModel to take effect.
+void ConfigureModelProcessPool(const int16_t procs_per_model);
+
+// Runs one request the way spec.exec_protocol says (see ModelSpec). An
+// "shm" model uses a warm process from the model process pool, or a
+// one-shot fork+exec if its entry point cannot be kept warm; an "argv"
+// model always runs one-shot. On failure outputs holds the error message. The run fails once it takes
+// longer than timeout_ms (<= 0: the pool's start timeout), and the process
+// running it is killed. params, if given, holds the generation parameters
+// of every input and reaches an "shm" model with its inputs.
 int ExecuteModel(const ModelSpec& spec,
-		 const std::string& input,
-		 std::string* ouput
+		 const std::vector<infaas::internal::BufferView>& inputs,
+		 std::vector<std::string>* outputs,
+		 const int timeout_ms = 0,
+		 const std::vector<infaas::internal::InputParams>& params =
+		     std::vector<infaas::internal::InputParams>()
+		 );
+
+// Like ExecuteModel, but asks the model process for progress and hands every
+// PROGRESS frame to on_progress; returning false from it cancels the run.
+// Needs a warm "shm" process: one-shot runs cannot report progress, so they
+// run to completion without calling on_progress.
+int ExecuteModelStreaming(const ModelSpec& spec,
+		 const std::vector<infaas::internal::BufferView>& inputs,
+		 std::vector<std::string>* outputs,
+		 const infaas::internal::PreviewRequest& preview,
+		 const infaas::internal::ProgressFn& on_progress,
+		 const int timeout_ms = 0,
+		 const std::vector<infaas::internal::InputParams>& params =
+		     std::vector<infaas::internal::InputParams>()
+		 );
+
+// Runs a diffusion request step by step alongside the model's other stepped
+// requests (ModelProcessPool::ExecuteStepped), failing after timeout_ms as
+// ExecuteModel does, or at the next step once cancelled returns true.
+// Returns ModelProcessPool::pool_unavailable if the model cannot be stepped
+// (it is not an "shm" model, or its process does not support stepping); the
+// caller then runs it whole.
+int ExecuteModelStepped(const ModelSpec& spec,
+		 const std::vector<infaas::internal::BufferView>& inputs,
+		 const uint32_t steps, const size_t max_inputs,
+		 std::vector<std::string>* outputs,
+		 const int timeout_ms = 0,
+		 const std::vector<infaas::internal::InputParams>& params =
+		     std::vector<infaas::internal::InputParams>(),
+		 const infaas::internal::CancelledFn& cancelled = nullptr
 		 );
@@ -0,0 +1,981 @@
+#include "worker/model_process_pool.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+namespace infaas {
+namespace internal {
+namespace {
+
+// The fd number the model process finds its socket on.
+const int serve_fd = 3;
+const int ping_timeout_ms = 5000;
+const int stop_grace_ms = 2000;
+// Backoff before an unsupported model's first process is tried again
+const int start_retry_ms = 10000;
+const int max_start_retry_ms = 600000;
+
+// Waits until fd is readable. Returns false on timeout or error.
+bool WaitReadable(int fd, int timeout_ms) {
+  struct pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  while (true) {
+    int rc = poll(&pfd, 1, timeout_ms);
+    if (rc > 0) { return true; }
+    if (rc == 0) { return false; }
+    if (errno != EINTR) { return false; }
+  }
+}
+
+// Milliseconds left until deadline, rounded up, or 0 once it has passed
+int RemainingMs(const std::chrono::steady_clock::time_point deadline) {
+  auto left = std::chrono::duration_cast<std::chrono::microseconds>(
+      deadline - std::chrono::steady_clock::now());
+  return (left.count() > 0) ? (int)((left.count() + 999) / 1000) : 0;
+}
+
+int ReadFull(int fd, char* buf, size_t len, int timeout_ms) {
+  size_t done = 0;
+  while (done < len) {
+    if (!WaitReadable(fd, timeout_ms)) { return -1; }
+    ssize_t n = read(fd, buf + done, len - done);
+    if (n == 0) { return -1; }  // EOF: the process went away
+    if (n < 0) {
+      if (errno == EINTR || errno == EAGAIN) { continue; }
+      return -1;
+    }
+    done += n;
+  }
+  return 0;
+}
+
+int WriteFull(int fd, const char* buf, size_t len) {
+  size_t done = 0;
+  while (done < len) {
+    // MSG_NOSIGNAL: a dead peer must not SIGPIPE the whole worker.
+    ssize_t n = send(fd, buf + done, len - done, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) { continue; }
+      return -1;
+    }
+    done += n;
+  }
+  return 0;
+}
+
+}  // namespace
+
+int WriteFrame(int fd, uint32_t type, const char* data, uint64_t length) {
+  FrameHeader header;
+  header.magic = frame_magic;
+  header.type = type;
+  header.length = length;
+  if (WriteFull(fd, reinterpret_cast<const char*>(&header), sizeof(header))) {
+    return -1;
+  }
+  if (length > 0 && WriteFull(fd, data, length)) { return -1; }
+  return 0;
+}
+
+int WriteFrameFds(int fd, uint32_t type, const int* fds, int num_fds,
+                  const char* data, uint64_t length) {
+  FrameHeader header;
+  header.magic = frame_magic;
+  header.type = type;
+  header.length = length;
+
+  struct iovec iov;
+  iov.iov_base = &header;
+  iov.iov_len = sizeof(header);
+
+  std::vector<char> control(CMSG_SPACE(sizeof(int) * num_fds), 0);
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.data();
+  msg.msg_controllen = control.size();
+
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int) * num_fds);
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * num_fds);
+
+  ssize_t n;
+  do {
+    n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0) { return -1; }
+  // The descriptors went with the first byte; send any remainder plainly.
+  if (((size_t)n < sizeof(header)) &&
+      WriteFull(fd, reinterpret_cast<const char*>(&header) + n,
+                sizeof(header) - n)) {
+    return -1;
+  }
+  if (length > 0 && WriteFull(fd, data, length)) { return -1; }
+  return 0;
+}
+
+int ReadFrame(int fd, uint32_t* type, std::string* payload, int timeout_ms) {
+  FrameHeader header;
+  if (ReadFull(fd, reinterpret_cast<char*>(&header), sizeof(header),
+               timeout_ms)) {
+    return -1;
+  }
+  if (header.magic != frame_magic) {
+    std::cerr << "[ModelProcessPool] Bad frame magic" << std::endl;
+    return -1;
+  }
+  *type = header.type;
+  payload->resize(header.length);
+  if (header.length > 0 &&
+      ReadFull(fd, &(*payload)[0], header.length, timeout_ms)) {
+    return -1;
+  }
+  return 0;
+}
+
+ModelProcessPool::ModelProcessPool(const int16_t procs_per_model,
+                                   const int health_interval_ms,
+                                   const int start_timeout_ms,
+                                   const int hang_timeout_ms)
+    : procs_per_model_(procs_per_model > 0 ? procs_per_model : 1),
+      health_interval_ms_(health_interval_ms),
+      start_timeout_ms_(start_timeout_ms),
+      hang_timeout_ms_(hang_timeout_ms),
+      running_(true) {
+  health_thread_ = std::thread(&ModelProcessPool::HealthLoop, this);
+}
+
+ModelProcessPool::~ModelProcessPool() { Shutdown(); }
+
+void ModelProcessPool::SetPoolSize(const std::string& model_name,
+                                   const int16_t procs) {
+  std::lock_guard<std::mutex> lock(pool_mutex_);
+  groups_[model_name].pool_size = procs > 0 ? procs : 1;
+}
+
+size_t ModelProcessPool::NumProcesses(const std::string& model_name) {
+  std::lock_guard<std::mutex> lock(pool_mutex_);
+  auto it = groups_.find(model_name);
+  if (it == groups_.end()) { return 0; }
+  size_t live = 0;
+  for (const ModelProcess& p : it->second.procs) {
+    if (p.pid > 0) { live++; }
+  }
+  return live;
+}
+
+int ModelProcessPool::Execute(const ModelSpec& spec,
+                              const std::vector<BufferView>& inputs,
+                              std::vector<std::string>* outputs,
+                              const int timeout_ms,
+                              const PreviewRequest& preview,
+                              const ProgressFn& on_progress,
+                              const std::vector<InputParams>& params) {
+  outputs->clear();
+  SharedRegion input_region;
+  if (PackBuffers("difs-input", inputs, params, &input_region)) {
+    return pool_unavailable;
+  }
+
+  const Clock::time_point deadline =
+      Clock::now() + std::chrono::milliseconds(
+                         (timeout_ms > 0) ? timeout_ms : start_timeout_ms_);
+
+  // One retry: if the process dies mid-request it is replaced and the request
+  // is sent again on a fresh process.
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    ModelProcess proc;
+    const int checkout = Checkout(spec, deadline, &proc);
+    if (checkout == checkout_timed_out) {
+      outputs->push_back("Timed out waiting for a model process");
+      return 1;
+    }
+    if (checkout != 0) { return pool_unavailable; }
+
+    SharedRegion output_region;
+    int rc = output_region.Create("difs-output", 0);
+    uint32_t type = 0;
+    std::string payload;
+    if (rc == 0) {
+      int fds[2] = {input_region.fd(), output_region.fd()};
+      if (on_progress) {
+        rc = WriteFrameFds(proc.fd, FRAME_REQUEST, fds, 2,
+                           reinterpret_cast<const char*>(&preview),
+                           sizeof(preview));
+      } else {
+        rc = WriteFrameFds(proc.fd, FRAME_REQUEST, fds, 2);
+      }
+    }
+    // The caller waits until its deadline; the process gets until
+    // hang_deadline before it counts as hung
+    const Clock::time_point hang_deadline =
+        std::max(deadline, Clock::now() + std::chrono::milliseconds(
+                                              hang_timeout_ms_));
+    bool cancelled = false;
+    bool late = false;
+    while (rc == 0) {
+      if (!WaitReadable(proc.fd, RemainingMs(deadline))) {
+        late = true;
+        break;
+      }
+      rc = ReadFrame(proc.fd, &type, &payload, RemainingMs(hang_deadline));
+      if ((rc != 0) || (type != FRAME_PROGRESS)) { break; }
+      // Progress that arrives after a cancel is just drained
+      if (!on_progress || cancelled ||
+          (payload.size() < sizeof(ProgressHeader))) {
+        continue;
+      }
+      ProgressHeader header;
+      memcpy(&header, payload.data(), sizeof(header));
+      ModelProgress progress;
+      progress.index = header.index;
+      progress.step = header.step;
+      progress.total_steps = header.total_steps;
+      progress.preview = payload.substr(sizeof(header));
+      if (!on_progress(progress)) {
+        cancelled = true;
+        rc = WriteFrame(proc.fd, FRAME_CANCEL, nullptr, 0);
+      }
+    }
+
+    if (rc == 0 && (type == FRAME_RESPONSE || type == FRAME_ERROR)) {
+      Checkin(spec.model_name, proc);
+
+      if (type == FRAME_ERROR) {
+        outputs->push_back(std::move(payload));
+        return 1;
+      }
+      std::vector<BufferView> views;
+      if (output_region.Remap() || UnpackBuffers(output_region, &views)) {
+        outputs->push_back("Malformed model output region");
+        return 1;
+      }
+      outputs->reserve(views.size());
+      for (const BufferView& v : views) {
+        outputs->emplace_back(v.data, v.size);
+      }
+      return 0;
+    }
+    if (late) {
+      // Still working on the request: let it finish in the background
+      Abandon(spec.model_name, &proc, hang_deadline);
+      outputs->push_back("Model execution timed out");
+      return 1;
+    }
+
+    // The process crashed or broke the protocol: drop it, and retry unless
+    // the time is up.
+    Discard(spec.model_name, &proc);
+    if (Clock::now() >= deadline) {
+      outputs->push_back("Model execution timed out");
+      return 1;
+    }
+  }
+
+  outputs->push_back("Model process failed");
+  return 1;
+}
+
+int ModelProcessPool::ExecuteStepped(const ModelSpec& spec,
+                                     const std::vector<BufferView>& inputs,
+                                     const uint32_t steps,
+                                     const size_t max_inputs,
+                                     std::vector<std::string>* outputs,
+                                     const int timeout_ms,
+                                     const std::vector<InputParams>& params,
+                                     const CancelledFn& cancelled) {
+  outputs->clear();
+  {
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    if (!running_) { return pool_unavailable; }
+    ModelGroup& group = groups_[spec.model_name];
+    if (UnsupportedLocked(&group) || (group.steppable == 0)) {
+      return pool_unavailable;
+    }
+  }
+
+  StepRequest req;
+  req.steps = steps;
+  req.num_inputs = inputs.size();
+  req.deadline =
+      Clock::now() + std::chrono::milliseconds(
+                         (timeout_ms > 0) ? timeout_ms : start_timeout_ms_);
+  req.outputs = outputs;
+  req.cancelled = &cancelled;
+  if (PackBuffers("difs-input", inputs, params, &req.input_region) ||
+      req.output_region.Create("difs-output", 0)) {
+    return pool_unavailable;
+  }
+
+  std::unique_lock<std::mutex> lock(pool_mutex_);
+  StepLoop& loop = groups_[spec.model_name].loop;
+  req.id = next_step_id_++;
+  loop.joining.push_back(&req);
+  if (!loop.has_leader) {
+    loop.has_leader = true;
+    req.lead = true;
+  }
+  while (!req.done) {
+    if (req.lead) {
+      LeadSteps(spec, max_inputs, &req, lock);
+    } else {
+      step_cv_.wait(lock);
+    }
+  }
+  return req.rc;
+}
+
+void ModelProcessPool::Shutdown() {
+  std::vector<ModelProcess> to_stop;
+  {
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    if (!running_) { return; }
+    running_ = false;
+    for (auto& g : groups_) {
+      for (ModelProcess& p : g.second.procs) {
+        if ((p.pid > 0) && !draining_pids_.count(p.pid)) {
+          to_stop.push_back(p);
+        }
+      }
+      g.second.procs.clear();
+    }
+    // Nor is a process a drain thread waits on
+    for (pid_t pid : draining_pids_) { kill(pid, SIGKILL); }
+    // A model still loading is not waited for; its start thread sees EOF
+    for (pid_t pid : starting_pids_) { kill(pid, SIGKILL); }
+  }
+  health_cv_.notify_all();
+  pool_cv_.notify_all();
+  if (health_thread_.joinable()) { health_thread_.join(); }
+  for (ModelProcess& p : to_stop) { Stop(&p); }
+
+  std::unique_lock<std::mutex> lock(pool_mutex_);
+  pool_cv_.wait(lock,
+                [this] { return (starting_ == 0) && (draining_ == 0); });
+}
+
+/*********************** Private Functions ***********************/
+
+int ModelProcessPool::Checkout(const ModelSpec& spec,
+                               const Clock::time_point deadline,
+                               ModelProcess* proc) {
+  std::unique_lock<std::mutex> lock(pool_mutex_);
+  ModelGroup& group = groups_[spec.model_name];
+  if (group.pool_size == 0) { group.pool_size = procs_per_model_; }
+  group.spec = spec;
+
+  while (true) {
+    if (UnsupportedLocked(&group) || !running_) { return pool_unavailable; }
+    for (ModelProcess& p : group.procs) {
+      if (!p.busy && p.pid > 0) {
+        p.busy = true;
+        *proc = p;
+        return 0;
+      }
+    }
+    StartLocked(&group);
+    if (Clock::now() >= deadline) { return checkout_timed_out; }
+    pool_cv_.wait_until(lock, deadline);
+  }
+}
+
+void ModelProcessPool::Checkin(const std::string& model_name,
+                               const ModelProcess& proc) {
+  {
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    for (ModelProcess& p : groups_[model_name].procs) {
+      if (p.pid == proc.pid) { p.busy = false; }
+    }
+  }
+  pool_cv_.notify_one();
+}
+
+void ModelProcessPool::Discard(const std::string& model_name,
+                               ModelProcess* proc) {
+  std::cerr << "[ModelProcessPool] Process " << proc->pid << " for "
+            << model_name << " failed; restarting" << std::endl;
+  const pid_t pid = proc->pid;
+  // It may be stuck in the model, so it gets no grace period
+  kill(pid, SIGKILL);
+  Stop(proc);
+  {
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    ModelGroup& group = groups_[model_name];
+    Erase(&group, pid);
+    StartLocked(&group);
+  }
+  pool_cv_.notify_one();
+}
+
+void ModelProcessPool::Abandon(const std::string& model_name,
+                               ModelProcess* proc,
+                               const Clock::time_point hang_deadline) {
+  {
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    if (running_) {
+      draining_++;
+      draining_pids_.insert(proc->pid);
+      std::thread(&ModelProcessPool::Drain, this, model_name, *proc,
+                  hang_deadline)
+          .detach();
+      return;
+    }
+  }
+  Discard(model_name, proc);
+}
+
+void ModelProcessPool::Drain(const std::string model_name, ModelProcess proc,
+                             const Clock::time_point hang_deadline) {
+  // A request that reports progress stops at the CANCEL; any other runs to
+  // its end, and the process skips the CANCEL once back in its serve loop
+  int rc = WriteFrame(proc.fd, FRAME_CANCEL, nullptr, 0);
+  uint32_t type = 0;
+  std::string payload;
+  while (rc == 0) {
+    rc = ReadFrame(proc.fd, &type, &payload, RemainingMs(hang_deadline));
+    if ((rc != 0) || (type == FRAME_RESPONSE) || (type == FRAME_ERROR)) {
+      break;
+    }
+    if (type != FRAME_PROGRESS) { rc = -1; }
+  }
+  // Checked in under the same lock as the check, so Shutdown either sees
+  // it in the pool or leaves it to be stopped here
+  bool kept = false;
+  {
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    draining_pids_.erase(proc.pid);
+    if ((rc == 0) && running_) {
+      for (ModelProcess& p : groups_[model_name].procs) {
+        if (p.pid == proc.pid) {
+          p.busy = false;
+          kept = true;
+        }
+      }
+    }
+  }
+  if (!kept && (rc != 0)) {
+    Discard(model_name, &proc);
+  } else if (!kept) {
+    Stop(&proc);
+  }
+  // Notified under the lock: Shutdown may return as soon as it is released
+  std::lock_guard<std::mutex> lock(pool_mutex_);
+  draining_--;
+  pool_cv_.notify_all();
+}
+
+bool ModelProcessPool::UnsupportedLocked(ModelGroup* group) {
+  if (group->unsupported && (Clock::now() >= group->retry_at)) {
+    group->unsupported = false;
+  }
+  return group->unsupported;
+}
+
+void ModelProcessPool::StartLocked(ModelGroup* group) {
+  if (!running_ || UnsupportedLocked(group) ||
+      (group->procs.size() + group->starting >= (size_t)group->pool_size)) {
+    return;
+  }
+  group->starting++;
+  starting_++;
+  std::thread(&ModelProcessPool::Start, this, group->spec).detach();
+}
+
+void ModelProcessPool::Start(const ModelSpec spec) {
+  ModelProcess proc;
+  bool started = Spawn(spec, &proc);
+
+  std::unique_lock<std::mutex> lock(pool_mutex_);
+  if (started && !running_) {
+    lock.unlock();
+    Stop(&proc);
+    lock.lock();
+    started = false;
+  }
+  ModelGroup& group = groups_[spec.model_name];
+  group.starting--;
+  if (started) {
+    group.procs.push_back(proc);
+    group.steppable = proc.steppable ? 1 : 0;
+    group.failed_starts = 0;
+  } else if (running_ && (group.steppable < 0) && group.procs.empty() &&
+             (group.starting == 0)) {
+    // Never came up: the entry point may not speak the protocol, or the
+    // load failed for now (out of memory, GPU busy). Try again later.
+    const int backoff_ms = std::min<int64_t>(
+        (int64_t)start_retry_ms << std::min(group.failed_starts, 16),
+        max_start_retry_ms);
+    group.failed_starts++;
+    std::cerr << "[ModelProcessPool] " << spec.model_name
+              << " cannot run warm; using one-shot execution for "
+              << backoff_ms / 1000 << " s" << std::endl;
+    group.unsupported = true;
+    group.retry_at = Clock::now() + std::chrono::milliseconds(backoff_ms);
+  }
+  starting_--;
+  pool_cv_.notify_all();
+}
+
+void ModelProcessPool::LeadSteps(const ModelSpec& spec,
+                                 const size_t max_inputs, StepRequest* self,
+                                 std::unique_lock<std::mutex>& lock) {
+  StepLoop& loop = groups_[spec.model_name].loop;
+
+  if (loop.proc.pid <= 0) {
+    // Wait for a process as long as any queued request may
+    Clock::time_point deadline = self->deadline;
+    for (StepRequest* r : loop.joining) {
+      deadline = std::max(deadline, r->deadline);
+    }
+    ModelProcess proc;
+    lock.unlock();
+    int rc = Checkout(spec, deadline, &proc);
+    if ((rc == 0) && !proc.steppable) {
+      Checkin(spec.model_name, proc);
+      rc = pool_unavailable;
+    }
+    lock.lock();
+    if (rc != 0) {
+      // Nothing has run yet: send every queued request back to Execute, or
+      // fail them all if the wait ran out
+      for (StepRequest* r : loop.joining) {
+        if (rc == checkout_timed_out) {
+          r->outputs->assign(1, "Timed out waiting for a model process");
+          r->rc = 1;
+        } else {
+          r->rc = pool_unavailable;
+        }
+        r->done = true;
+      }
+      loop.joining.clear();
+      loop.has_leader = false;
+      step_cv_.notify_all();
+      return;
+    }
+    loop.proc = proc;
+  }
+
+  while (!self->done) {
+    // Requests join at the step boundary, while the batch has room; the
+    // loop always takes at least one so a large request cannot starve
+    std::vector<StepRequest*> joined;
+    const Clock::time_point now = Clock::now();
+    for (auto it = loop.joining.begin(); it != loop.joining.end();) {
+      const bool timed_out = ((*it)->deadline <= now);
+      if (!timed_out && !StepCancelled(*it)) {
+        ++it;
+        continue;
+      }
+      // Its time ran out, or its caller left, in the queue; do not start it
+      (*it)->outputs->assign(1, timed_out ? "Model execution timed out"
+                                          : "Cancelled");
+      (*it)->rc = 1;
+      (*it)->done = true;
+      it = loop.joining.erase(it);
+    }
+    // Running requests that are out of time, or whose callers left, stop
+    // taking part in the steps
+    for (auto it = loop.active.begin(); it != loop.active.end();) {
+      StepRequest* r = it->second;
+      const bool timed_out = (r->deadline <= now);
+      if (!timed_out && !StepCancelled(r)) {
+        ++it;
+        continue;
+      }
+      loop.leaving.push_back(r->id);
+      loop.active_inputs -= r->num_inputs;
+      r->outputs->assign(1, timed_out ? "Model execution timed out"
+                                      : "Cancelled");
+      r->rc = 1;
+      r->done = true;
+      it = loop.active.erase(it);
+    }
+    while (!loop.joining.empty() &&
+           (loop.active.empty() ||
+            (loop.active_inputs + loop.joining.front()->num_inputs <=
+             max_inputs))) {
+      StepRequest* r = loop.joining.front();
+      loop.joining.pop_front();
+      loop.active[r->id] = r;
+      loop.active_inputs += r->num_inputs;
+      joined.push_back(r);
+    }
+    if (loop.active.empty()) {
+      // Everything queued ran out of time or was cancelled, self included;
+      // the requests that left are dropped before the process is handed on
+      step_cv_.notify_all();
+      continue;
+    }
+    // Only this thread changes active, and its requests stay put until
+    // they are marked done, so the copy can be used without the lock
+    std::map<uint64_t, StepRequest*> active = loop.active;
+    std::vector<uint64_t> leaving;
+    leaving.swap(loop.leaving);
+    ModelProcess proc = loop.proc;
+    lock.unlock();
+
+    int rc = WriteLeaves(proc.fd, leaving);
+    for (StepRequest* r : joined) {
+      if (rc != 0) { break; }
+      JoinHeader header;
+      header.id = r->id;
+      header.steps = r->steps;
+      header.reserved = 0;
+      int fds[2] = {r->input_region.fd(), r->output_region.fd()};
+      rc = WriteFrameFds(proc.fd, FRAME_JOIN, fds, 2,
+                         reinterpret_cast<const char*>(&header),
+                         sizeof(header));
+      if (rc != 0) { break; }
+    }
+    uint32_t type = 0;
+    std::string payload;
+    if (rc == 0) { rc = WriteFrame(proc.fd, FRAME_STEP, nullptr, 0); }
+    // The step may take as long as a healthy process could; the requests
+    // whose deadlines pass meanwhile fail without waiting for it. This
+    // caller's own request is checked at the next boundary.
+    const Clock::time_point hang_deadline =
+        Clock::now() + std::chrono::milliseconds(hang_timeout_ms_);
+    bool hung = false;
+    while (rc == 0) {
+      Clock::time_point wake = hang_deadline;
+      for (auto& a : active) {
+        if (a.second != self) { wake = std::min(wake, a.second->deadline); }
+      }
+      const bool readable = WaitReadable(proc.fd, RemainingMs(wake));
+      const Clock::time_point checked = Clock::now();
+      if (readable) {
+        rc = ReadFrame(proc.fd, &type, &payload, RemainingMs(hang_deadline));
+        break;
+      }
+      if ((checked >= hang_deadline) || (checked < wake)) {
+        hung = (checked >= hang_deadline);
+        rc = -1;
+        break;
+      }
+      lock.lock();
+      for (auto it = active.begin(); it != active.end();) {
+        StepRequest* r = it->second;
+        if ((r == self) || (r->deadline > checked)) {
+          ++it;
+          continue;
+        }
+        loop.active.erase(r->id);
+        loop.active_inputs -= r->num_inputs;
+        loop.leaving.push_back(r->id);
+        r->outputs->assign(1, "Model execution timed out");
+        r->rc = 1;
+        r->done = true;
+        it = active.erase(it);
+      }
+      step_cv_.notify_all();
+      lock.unlock();
+    }
+    if ((rc == 0) && (type != FRAME_STEP_DONE)) { rc = -1; }
+
+    // Unpack the outputs of the requests that left
+    std::vector<StepRequest*> left;
+    for (size_t off = 0;
+         (rc == 0) && (off + sizeof(StepStatus) <= payload.size());
+         off += sizeof(StepStatus)) {
+      StepStatus status;
+      memcpy(&status, payload.data() + off, sizeof(status));
+      if (status.state == STEP_RUNNING) { continue; }
+      auto it = active.find(status.id);
+      if (it == active.end()) { continue; }
+      StepRequest* r = it->second;
+      std::vector<BufferView> views;
+      if (r->output_region.Remap() ||
+          UnpackBuffers(r->output_region, &views)) {
+        r->outputs->assign(1, "Malformed model output region");
+        r->rc = 1;
+      } else {
+        for (const BufferView& v : views) {
+          r->outputs->emplace_back(v.data, v.size);
+        }
+        r->rc = (status.state == STEP_FINISHED) ? 0 : 1;
+        if ((r->rc != 0) && r->outputs->empty()) {
+          r->outputs->push_back("Model step failed");
+        }
+      }
+      left.push_back(r);
+    }
+
+    if (rc != 0) {
+      // Every request in the loop was on the process: fail them all
+      Discard(spec.model_name, &proc);
+      lock.lock();
+      for (auto& a : loop.active) {
+        a.second->outputs->assign(1, hung ? "Model process hung"
+                                          : "Model process failed");
+        a.second->rc = 1;
+        a.second->done = true;
+      }
+      loop.active.clear();
+      loop.active_inputs = 0;
+      loop.leaving.clear();
+      loop.proc = {-1, -1, false, false};
+    } else {
+      lock.lock();
+      for (StepRequest* r : left) {
+        loop.active.erase(r->id);
+        loop.active_inputs -= r->num_inputs;
+        r->done = true;
+      }
+    }
+    step_cv_.notify_all();
+
+    if ((loop.proc.pid <= 0) && !self->done) {
+      // self was still queued when the process failed; start over
+      return;
+    }
+  }
+
+  // Hand the loop to another caller, or give the process back
+  StepRequest* next = nullptr;
+  if (!loop.active.empty()) {
+    next = loop.active.begin()->second;
+  } else if (!loop.joining.empty()) {
+    next = loop.joining.front();
+  }
+  if (next != nullptr) {
+    next->lead = true;
+    step_cv_.notify_all();
+    return;
+  }
+  loop.has_leader = false;
+  if (loop.proc.pid > 0) {
+    // The process keeps no state of requests that left
+    ModelProcess proc = loop.proc;
+    std::vector<uint64_t> leaving;
+    leaving.swap(loop.leaving);
+    loop.proc = {-1, -1, false, false};
+    lock.unlock();
+    if (WriteLeaves(proc.fd, leaving) == 0) {
+      Checkin(spec.model_name, proc);
+    } else {
+      Discard(spec.model_name, &proc);
+    }
+    lock.lock();
+  }
+}
+
+bool ModelProcessPool::StepCancelled(const StepRequest* r) {
+  return (*r->cancelled) && (*r->cancelled)();
+}
+
+int ModelProcessPool::WriteLeaves(const int fd,
+                                  const std::vector<uint64_t>& ids) {
+  for (const uint64_t id : ids) {
+    JoinHeader header;
+    header.id = id;
+    header.steps = 0;
+    header.reserved = 0;
+    if (WriteFrame(fd, FRAME_LEAVE, reinterpret_cast<const char*>(&header),
+                   sizeof(header))) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+bool ModelProcessPool::Spawn(const ModelSpec& spec, ModelProcess* proc) {
+  int sv[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0) {
+    perror("socketpair");
+    return false;
+  }
+
+  // Build argv before forking; only async-signal-safe calls in the child.
+  std::vector<std::string> args = {spec.env_path + "/bin/python3",
+                                   spec.entry_point,
+                                   "--model",
+                                   spec.model_name,
+                                   "--serve-fd",
+                                   std::to_string(serve_fd)};
+  std::vector<char*> exec_argv;
+  for (const auto& arg : args) {
+    exec_argv.push_back(const_cast<char*>(arg.c_str()));
+  }
+  exec_argv.push_back(nullptr);
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    close(sv[0]);
+    close(sv[1]);
+    return false;
+  }
+
+  if (pid == 0) {
+    // ---- CHILD PROCESS ----
+    if (sv[1] == serve_fd) {
+      fcntl(serve_fd, F_SETFD, 0);  // Keep it across exec
+    } else {
+      dup2(sv[1], serve_fd);  // dup2 clears FD_CLOEXEC
+    }
+    execvp(exec_argv[0], exec_argv.data());
+    _exit(127);
+  }
+
+  // ---- PARENT PROCESS ----
+  close(sv[1]);
+  {
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    if (running_) {
+      starting_pids_.insert(pid);
+    } else {
+      kill(pid, SIGKILL);  // Shut down while forking
+    }
+  }
+  proc->pid = pid;
+  proc->fd = sv[0];
+  proc->busy = false;
+  proc->steppable = false;
+
+  // Wait for the model to load.
+  uint32_t type = 0;
+  std::string payload;
+  const int ready = ReadFrame(proc->fd, &type, &payload, start_timeout_ms_);
+  {
+    // Before Stop reaps it, so Shutdown cannot kill a reused pid
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    starting_pids_.erase(pid);
+  }
+  if (ready || type != FRAME_READY) {
+    std::cerr << "[ModelProcessPool] " << spec.model_name
+              << " did not become ready" << std::endl;
+    Stop(proc);
+    return false;
+  }
+  uint32_t flags = 0;
+  if (payload.size() >= sizeof(flags)) {
+    memcpy(&flags, payload.data(), sizeof(flags));
+  }
+  proc->steppable = (flags & ready_steppable) != 0;
+
+  std::cout << "[LOG]: Started warm process " << pid << " for "
+            << spec.model_name << std::endl;
+  return true;
+}
+
+void ModelProcessPool::Stop(ModelProcess* proc) {
+  if (proc->pid <= 0) { return; }
+  WriteFrame(proc->fd, FRAME_SHUTDOWN, nullptr, 0);
+  close(proc->fd);
+
+  int status = 0;
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::milliseconds(stop_grace_ms);
+  while (waitpid(proc->pid, &status, WNOHANG) == 0) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      kill(proc->pid, SIGKILL);
+      waitpid(proc->pid, &status, 0);
+      break;
+    }
+    usleep(10000);
+  }
+  proc->pid = -1;
+  proc->fd = -1;
+}
+
+void ModelProcessPool::Erase(ModelGroup* group, pid_t pid) {
+  for (auto it = group->procs.begin(); it != group->procs.end(); ++it) {
+    if (it->pid == pid) {
+      group->procs.erase(it);
+      return;
+    }
+  }
+}
+
+void ModelProcessPool::HealthLoop() {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(pool_mutex_);
+      health_cv_.wait_for(lock,
+                          std::chrono::milliseconds(health_interval_ms_),
+                          [this] { return !running_; });
+      if (!running_) { return; }
+    }
+
+    // Check out every idle process so requests cannot race the ping.
+    std::vector<std::pair<std::string, ModelProcess>> idle;
+    std::vector<std::pair<std::string, ModelProcess>> extra;
+    std::vector<std::pair<std::string, ModelProcess>> dead;
+    {
+      std::lock_guard<std::mutex> lock(pool_mutex_);
+      for (auto& g : groups_) {
+        size_t live = 0;
+        for (ModelProcess& p : g.second.procs) {
+          if (p.pid <= 0) { continue; }
+          live++;
+          if (p.busy) { continue; }
+          p.busy = true;
+          if (live > (size_t)g.second.pool_size) {
+            extra.push_back(std::make_pair(g.first, p));
+          } else {
+            idle.push_back(std::make_pair(g.first, p));
+          }
+        }
+      }
+    }
+
+    for (auto& e : extra) {
+      Stop(&e.second);
+      std::lock_guard<std::mutex> lock(pool_mutex_);
+      Erase(&groups_[e.first], e.second.pid);
+    }
+
+    for (auto& i : idle) {
+      ModelProcess& p = i.second;
+      uint32_t type = 0;
+      std::string payload;
+      int status = 0;
+      bool alive = (waitpid(p.pid, &status, WNOHANG) == 0) &&
+                   (WriteFrame(p.fd, FRAME_PING, nullptr, 0) == 0) &&
+                   (ReadFrame(p.fd, &type, &payload, ping_timeout_ms) == 0) &&
+                   (type == FRAME_PONG);
+
+      if (alive) {
+        std::lock_guard<std::mutex> lock(pool_mutex_);
+        for (ModelProcess& gp : groups_[i.first].procs) {
+          if (gp.pid == p.pid) { gp.busy = false; }
+        }
+        continue;
+      }
+      std::cerr << "[ModelProcessPool] Process " << p.pid << " for "
+                << i.first << " failed its health check" << std::endl;
+      dead.push_back(i);
+      std::lock_guard<std::mutex> lock(pool_mutex_);
+      Erase(&groups_[i.first], p.pid);
+    }
+    pool_cv_.notify_all();
+
+    // Stop crashed processes without the lock, then restart them in the
+    // background so the model stays warm.
+    for (auto& d : dead) {
+      Stop(&d.second);
+      std::lock_guard<std::mutex> lock(pool_mutex_);
+      StartLocked(&groups_[d.first]);
+    }
+  }
+}
+
+}  // namespace internal
+}  // namespace infaas
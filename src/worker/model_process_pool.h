@@ -0,0 +1,362 @@
+#pragma once
+
+#ifndef INFAAS_MODEL_PROCESS_POOL_H_
+#define INFAAS_MODEL_PROCESS_POOL_H_
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "process_executor.h"
+#include "shm_transport.h"
+
+namespace infaas {
+namespace internal {
+
+/**
+ * Worker <-> model process protocol, for models registered with
+ * exec_protocol "shm" (see ModelSpec).
+ *
+ * The model process is started as
+ *   <env_path>/bin/python3 <entry_point> --model <name> --serve-fd 3
+ * and talks over the Unix socket on fd 3. Every message is a FrameHeader
+ * followed by `length` payload bytes (host byte order, same machine).
+ * The process sends READY once its model is loaded, then answers each
+ * REQUEST with RESPONSE or ERROR (payload = message), and each PING with
+ * PONG. SHUTDOWN asks it to exit.
+ *
+ * A REQUEST carries two descriptors (SCM_RIGHTS): a packed input region
+ * and an empty output region (shm_transport.h). The process maps the
+ * inputs, grows the output region to fit and packs its outputs there before
+ * answering RESPONSE.
+ *
+ * A REQUEST may also have a PreviewRequest payload asking for progress. The
+ * process then sends PROGRESS frames (ProgressHeader, then an encoded
+ * preview image, possibly empty) before its RESPONSE. Once the worker
+ * answers a PROGRESS with CANCEL, the process should stop and answer ERROR.
+ *
+ * A process whose READY payload has ready_steppable set can also be driven
+ * one denoising step at a time, so requests with different step counts
+ * share every step. JOIN (JoinHeader, plus the same two regions as a
+ * REQUEST) adds a request to the process's running set; nothing is sent
+ * back. STEP advances every request in the set by one step and is answered
+ * with STEP_DONE: one StepStatus per request it advanced or failed to
+ * start. A request leaves the set once it is reported FINISHED (outputs
+ * packed into its output region) or FAILED (its output region holds the
+ * error message as its only buffer). LEAVE (JoinHeader, steps unused)
+ * drops a request from the set without an answer, once its caller has gone
+ * away.
+ * See model_server.py for the Python side.
+ */
+enum FrameType : uint32_t {
+  FRAME_READY = 1,
+  FRAME_REQUEST = 2,
+  FRAME_RESPONSE = 3,
+  FRAME_ERROR = 4,
+  FRAME_PING = 5,
+  FRAME_PONG = 6,
+  FRAME_SHUTDOWN = 7,
+  FRAME_PROGRESS = 8,
+  FRAME_CANCEL = 9,
+  FRAME_JOIN = 10,
+  FRAME_STEP = 11,
+  FRAME_STEP_DONE = 12,
+  FRAME_LEAVE = 13
+};
+
+struct FrameHeader {
+  uint32_t magic;
+  uint32_t type;
+  uint64_t length;
+};
+
+static const uint32_t frame_magic = 0x44494653;  // "DIFS"
+
+// every: preview every this many steps (0 = progress only, no images)
+// max_size: longest side of a preview image, in pixels
+struct PreviewRequest {
+  uint32_t every;
+  uint32_t max_size;
+};
+
+struct ProgressHeader {
+  uint32_t index;  // Input the preview belongs to
+  uint32_t step;
+  uint32_t total_steps;
+};
+
+// A PROGRESS frame as handed to the caller of ModelProcessPool::Execute.
+struct ModelProgress {
+  uint32_t index;
+  uint32_t step;
+  uint32_t total_steps;
+  std::string preview;
+};
+
+// Called for every PROGRESS frame. Returning false cancels the request.
+typedef std::function<bool(const ModelProgress&)> ProgressFn;
+
+// Polled while a request waits or runs; returns true once its caller no
+// longer wants the result.
+typedef std::function<bool()> CancelledFn;
+
+// READY payload: uint32_t flags
+static const uint32_t ready_steppable = 1;
+
+struct JoinHeader {
+  uint64_t id;     // Chosen by the worker, unique per process
+  uint32_t steps;  // Denoising steps the request needs
+  uint32_t reserved;
+};
+
+enum StepState : uint32_t {
+  STEP_RUNNING = 0,
+  STEP_FINISHED = 1,
+  STEP_FAILED = 2
+};
+
+struct StepStatus {
+  uint64_t id;
+  uint32_t step;   // Steps done so far
+  uint32_t state;  // StepState
+};
+
+/**
+ * Writes one frame. Returns 0 on success, -1 on failure.
+ */
+int WriteFrame(int fd, uint32_t type, const char* data, uint64_t length);
+
+/**
+ * Writes a frame that passes num_fds descriptors to the peer, with an
+ * optional payload. Returns 0 on success, -1 on failure.
+ */
+int WriteFrameFds(int fd, uint32_t type, const int* fds, int num_fds,
+                  const char* data = nullptr, uint64_t length = 0);
+
+/**
+ * Reads one frame into type/payload. timeout_ms < 0 waits forever.
+ * Returns 0 on success, -1 on failure, EOF or timeout.
+ */
+int ReadFrame(int fd, uint32_t* type, std::string* payload, int timeout_ms);
+
+/**
+ * Keeps long-lived, warm executor processes per model so a query only pays
+ * for inference, not for interpreter startup and pipeline loading.
+ *
+ * Processes are started on first use, up to the model's pool size, and
+ * handed out one request at a time. A process loads its model on a thread of
+ * its own, so a request waits for a cold model only until its deadline and
+ * the load carries on for the requests after it. A request that runs past
+ * its deadline fails, but a late process is not a hung one: it is sent
+ * CANCEL and its reply is drained in the background, and it goes back to
+ * the pool once it answers. Only a process that does not answer within
+ * hang_timeout_ms is killed and replaced. A health thread pings idle
+ * processes, reaps crashed ones and restarts them. If a model's first
+ * process never comes up (the entry point does not speak the protocol, or
+ * the load failed), the model is marked unsupported and Execute returns
+ * pool_unavailable so the caller can fall back to a one-shot ForkAndExec.
+ * The mark expires, so a transient failure is retried, after a backoff
+ * that doubles with every failed start.
+ */
+class ModelProcessPool {
+public:
+  static const int pool_unavailable = -1;
+
+  ModelProcessPool(const int16_t procs_per_model = 1,
+                   const int health_interval_ms = 5000,
+                   const int start_timeout_ms = 600000,
+                   const int hang_timeout_ms = 300000);
+  ~ModelProcessPool();
+
+  // Change how many warm processes a model may use. Extra idle processes are
+  // stopped by the health thread.
+  void SetPoolSize(const std::string& model_name, const int16_t procs);
+
+  /**
+   * Runs one request on a warm process of spec.model_name. Inputs and
+   * outputs cross the process boundary in shared memory.
+   *
+   * timeout_ms bounds the whole request, including the wait for a process;
+   * <= 0 uses start_timeout_ms. It only bounds the caller's wait: a process
+   * still busy at the deadline is kept unless it runs past hang_timeout_ms.
+   *
+   * With on_progress set, the process is asked for progress frames as
+   * described by preview, and on_progress runs for each of them on the
+   * calling thread. params, if not empty, go in the input region with the
+   * inputs (see PackBuffers).
+   *
+   * @return 0 on success (outputs holds one entry per model output),
+   *         pool_unavailable if no warm process could be used, or 1 if the
+   *         model reported an error, was cancelled or timed out (outputs
+   *         holds the message).
+   */
+  int Execute(const ModelSpec& spec, const std::vector<BufferView>& inputs,
+              std::vector<std::string>* outputs, const int timeout_ms = 0,
+              const PreviewRequest& preview = PreviewRequest(),
+              const ProgressFn& on_progress = nullptr,
+              const std::vector<InputParams>& params =
+                  std::vector<InputParams>());
+
+  /**
+   * Runs one request of a model whose process can be driven step by step.
+   * The model's step loop holds one process: at every step boundary,
+   * queued requests join while the running ones hold fewer than
+   * max_inputs inputs, and each request leaves as soon as its own steps
+   * are done. As with BatchScheduler there is no dispatcher thread: a
+   * caller with a request in the loop drives it, and hands the loop to
+   * another caller when its request is done.
+   *
+   * timeout_ms and params are as for Execute. A request whose deadline
+   * passes fails at once, even mid-step, and leaves the loop at the next
+   * step boundary; the others keep stepping. Only a step that takes longer
+   * than hang_timeout_ms gets the process killed and replaced, failing
+   * every request in it. cancelled (optional) is checked at every step
+   * boundary: a cancelled request is not started, or leaves the loop, and
+   * fails.
+   *
+   * @return As Execute; pool_unavailable if the model cannot be stepped,
+   *         in which case the caller should use Execute.
+   */
+  int ExecuteStepped(const ModelSpec& spec,
+                     const std::vector<BufferView>& inputs,
+                     const uint32_t steps, const size_t max_inputs,
+                     std::vector<std::string>* outputs,
+                     const int timeout_ms = 0,
+                     const std::vector<InputParams>& params =
+                         std::vector<InputParams>(),
+                     const CancelledFn& cancelled = nullptr);
+
+  // Number of live processes for a model.
+  size_t NumProcesses(const std::string& model_name);
+
+  // Stops the health thread and all model processes.
+  void Shutdown();
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  // Checkout found no process before the deadline
+  static const int checkout_timed_out = -2;
+
+  struct ModelProcess {
+    pid_t pid;
+    int fd;
+    bool busy;
+    bool steppable;
+  };
+
+  // A request in a model's step loop. Lives on its caller's stack.
+  struct StepRequest {
+    uint64_t id;
+    uint32_t steps;
+    size_t num_inputs;
+    Clock::time_point deadline;
+    SharedRegion input_region;
+    SharedRegion output_region;
+    std::vector<std::string>* outputs;
+    const CancelledFn* cancelled;
+    int rc = 0;
+    bool done = false;
+    bool lead = false;  // This caller drives the loop
+  };
+
+  struct StepLoop {
+    std::deque<StepRequest*> joining;
+    std::map<uint64_t, StepRequest*> active;
+    size_t active_inputs = 0;
+    std::vector<uint64_t> leaving;  // Failed; LEAVE not sent yet
+    bool has_leader = false;
+    ModelProcess proc = {-1, -1, false, false};  // Checked out while running
+  };
+
+  struct ModelGroup {
+    ModelSpec spec;
+    int16_t pool_size = 0;  // 0 = use procs_per_model_
+    bool unsupported = false;
+    Clock::time_point retry_at;  // When an unsupported model is tried again
+    int failed_starts = 0;       // In a row, with no process up yet
+    int8_t steppable = -1;  // Unknown until a process has started
+    std::vector<ModelProcess> procs;
+    size_t starting = 0;  // Processes loading, not in procs yet
+    StepLoop loop;
+  };
+
+  // Hands out an idle process of spec.model_name, starting one if the pool
+  // has room. Returns 0, pool_unavailable, or checkout_timed_out if none was
+  // free by deadline.
+  int Checkout(const ModelSpec& spec, const Clock::time_point deadline,
+               ModelProcess* proc);
+  void Checkin(const std::string& model_name, const ModelProcess& proc);
+  // Stops a process that crashed, broke the protocol or hung, and starts a
+  // replacement.
+  void Discard(const std::string& model_name, ModelProcess* proc);
+  // Hands a process whose caller gave up on its request to a drain thread,
+  // which checks it back in once it answers, or discards it at
+  // hang_deadline.
+  void Abandon(const std::string& model_name, ModelProcess* proc,
+               const Clock::time_point hang_deadline);
+  // Body of a drain thread
+  void Drain(const std::string model_name, ModelProcess proc,
+             const Clock::time_point hang_deadline);
+
+  // Whether the group is marked unsupported; clears an expired mark.
+  // Caller holds the lock.
+  static bool UnsupportedLocked(ModelGroup* group);
+  // Starts a process for the group in the background if it has room.
+  // Caller holds the lock.
+  void StartLocked(ModelGroup* group);
+  // Body of a start thread: spawns the process and adds it to its group.
+  void Start(const ModelSpec spec);
+
+  // Drives the step loop of spec.model_name until self is done, then hands
+  // it on. Called and returns with lock held.
+  void LeadSteps(const ModelSpec& spec, const size_t max_inputs,
+                 StepRequest* self, std::unique_lock<std::mutex>& lock);
+  static bool StepCancelled(const StepRequest* r);
+  // Sends LEAVE for each of ids. Returns 0 on success, -1 on failure.
+  static int WriteLeaves(const int fd, const std::vector<uint64_t>& ids);
+
+  bool Spawn(const ModelSpec& spec, ModelProcess* proc);
+  static void Stop(ModelProcess* proc);
+  void HealthLoop();
+
+  // Removes the process with this pid from the group. Caller holds the lock.
+  static void Erase(ModelGroup* group, pid_t pid);
+
+  const int16_t procs_per_model_;
+  const int health_interval_ms_;
+  const int start_timeout_ms_;
+  const int hang_timeout_ms_;
+
+  std::mutex pool_mutex_;
+  // Start threads still running, and the processes they wait on. Shutdown
+  // kills those processes and waits for the threads.
+  size_t starting_ = 0;
+  std::set<pid_t> starting_pids_;
+  // Likewise for drain threads. Shutdown kills the processes they drain.
+  size_t draining_ = 0;
+  std::set<pid_t> draining_pids_;
+  std::condition_variable pool_cv_;
+  std::condition_variable step_cv_;  // A stepped request finished or leads
+  std::map<std::string, ModelGroup> groups_;
+  uint64_t next_step_id_ = 1;
+
+  bool running_;
+  std::condition_variable health_cv_;
+  std::thread health_thread_;
+};
+
+}  // namespace internal
+}  // namespace infaas
+
+#endif  // INFAAS_MODEL_PROCESS_POOL_H_
@@ -0,0 +1,405 @@
+"""
+Python side of the worker <-> model process protocol (model_process_pool.h).
+
+An entry point that wants to be kept warm by the worker accepts
+`--serve-fd N` and, when given, calls
+
+    model_server.serve(fd, handler)
+
+after loading its model. `handler(payload: bytes) -> bytes` is called once
+per request with the raw input. With `batch=True` the handler instead gets
+the list of inputs (memoryviews into shared memory) and returns a list of
+outputs. Raising an exception reports an error for that request only; the
+process keeps serving.
+
+If the handler also takes a `progress` keyword argument, it gets a Progress
+object for requests that stream previews (QueryOnlineStream), and None
+otherwise. Call `progress.step(step, total, preview)` after every denoising
+step; `preview()` should return the current image as encoded bytes no
+larger than `progress.max_size` pixels, and is only called on the steps the
+client wants a preview for. `step` raises Cancelled once the client is
+gone; let it propagate.
+
+If the handler takes a `params` keyword argument, it gets the generation
+parameters of the query (InternalDiffusionQuery): a list with one dict per
+input, with keys steps, guidance_scale, seed, width and height, or None if
+the query carried none. Batched inputs come from different queries, so
+each has its own seed and guidance scale.
+
+A diffusion model can also be driven one denoising step at a time, so that
+requests with different step counts share every step and each one leaves
+as soon as it is done. Pass `stepper=` to serve, an object with
+
+    state = stepper.start(inputs, steps)  # inputs: list of memoryviews
+    stepper.step(states)                  # one step for every state, batched
+    outputs = stepper.finish(state)       # after `steps` steps
+
+`start` may take `params` like the handler. `handler` still serves
+requests that are not stepped. A request whose query is cancelled leaves
+the loop before its last step; its state is just dropped.
+
+An image model should return `raw_image(width, height, channels, pixels)`
+rather than encoding the image itself: the worker then encodes it on its
+own threads in the format the query asks for (PNG, JPEG, WebP or raw).
+
+Inputs and outputs travel in memfd regions (shm_transport.h): a header
+{magic, count}, `count` uint64 sizes, then the payloads back to back. An
+input region with parameters has its own magic and one packed params
+record per input after the inputs.
+
+One-shot runs get `--input-fd N --output-fd M` instead; use
+`read_request(N)` (or `read_buffers(N)` for the inputs alone) and
+`write_buffers(M, outputs)`.
+"""
+
+import array
+import inspect
+import mmap
+import os
+import select
+import socket
+import struct
+import sys
+import traceback
+
+FRAME_READY = 1
+FRAME_REQUEST = 2
+FRAME_RESPONSE = 3
+FRAME_ERROR = 4
+FRAME_PING = 5
+FRAME_PONG = 6
+FRAME_SHUTDOWN = 7
+FRAME_PROGRESS = 8
+FRAME_CANCEL = 9
+FRAME_JOIN = 10
+FRAME_STEP = 11
+FRAME_STEP_DONE = 12
+FRAME_LEAVE = 13
+
+READY_STEPPABLE = 1
+STEP_RUNNING = 0
+STEP_FINISHED = 1
+STEP_FAILED = 2
+
+FRAME_MAGIC = 0x44494653  # "DIFS"
+REGION_MAGIC = 0x44494652  # "DIFR"
+REGION_PARAMS_MAGIC = 0x44494650  # "DIFP"
+# uint32 magic, uint32 type, uint64 length; native byte order like the worker
+HEADER = struct.Struct("=IIQ")
+# uint32 magic, uint32 count
+REGION_HEADER = struct.Struct("=II")
+# Params record of one input (InputParams): int32 steps,
+# float guidance_scale, int32 seed, int32 width, int32 height
+INPUT_PARAMS = struct.Struct("=ifiii")
+# REQUEST payload: uint32 every, uint32 max_size
+PREVIEW_REQUEST = struct.Struct("=II")
+# PROGRESS payload header: uint32 index, uint32 step, uint32 total_steps
+PROGRESS_HEADER = struct.Struct("=III")
+# READY payload: uint32 flags
+READY_PAYLOAD = struct.Struct("=I")
+# JOIN payload: uint64 id, uint32 steps, uint32 reserved
+JOIN_HEADER = struct.Struct("=QII")
+# One entry of a STEP_DONE payload: uint64 id, uint32 step, uint32 state
+STEP_STATUS = struct.Struct("=QII")
+# Raw image output: uint32 magic, uint32 width, uint32 height,
+# uint32 channels, then 8-bit RGB(A) or gray pixels (image_encoder.h)
+RAW_IMAGE_HEADER = struct.Struct("=IIII")
+RAW_IMAGE_MAGIC = 0x44494649  # "DIFI"
+MAX_FDS = 2
+DEFAULT_PREVIEW_SIZE = 256
+
+
+class Cancelled(Exception):
+    """The worker cancelled the request in progress."""
+
+
+class Progress(object):
+    """Reports the progress of one request back to the worker."""
+
+    def __init__(self, sock, every, max_size):
+        self._sock = sock
+        self.every = every
+        self.max_size = max_size or DEFAULT_PREVIEW_SIZE
+
+    def step(self, step, total, preview=None, index=0):
+        image = b""
+        if preview is not None and self.every > 0 and (
+                step % self.every == 0 or step == total):
+            image = preview()
+        write_frame(self._sock, FRAME_PROGRESS,
+                    PROGRESS_HEADER.pack(index, step, total) + image)
+        # The worker only ever sends CANCEL while a request runs
+        readable, _, _ = select.select([self._sock], [], [], 0)
+        if readable:
+            ftype, _ = read_frame(self._sock)
+            if ftype == FRAME_CANCEL:
+                raise Cancelled()
+
+
+def raw_image(width, height, channels, pixels):
+    """Wraps height x width x channels uint8 pixels (row major) as an output
+    the worker encodes."""
+    pixels = memoryview(pixels).cast("B")
+    if len(pixels) != width * height * channels:
+        raise ValueError("pixel buffer does not match the image size")
+    return RAW_IMAGE_HEADER.pack(RAW_IMAGE_MAGIC, width, height,
+                                 channels) + pixels.tobytes()
+
+
+def _read_exact(sock, n):
+    buf = bytearray(n)
+    view = memoryview(buf)
+    got = 0
+    while got < n:
+        r = sock.recv_into(view[got:], n - got)
+        if r == 0:
+            raise EOFError("worker closed the connection")
+        got += r
+    return bytes(buf)
+
+
+def _read_header(sock):
+    """Reads a frame header and any descriptors sent along with it."""
+    fds = array.array("i")
+    data, ancdata, _, _ = sock.recvmsg(
+        HEADER.size, socket.CMSG_SPACE(MAX_FDS * fds.itemsize))
+    if not data:
+        raise EOFError("worker closed the connection")
+    for level, ctype, cdata in ancdata:
+        if level == socket.SOL_SOCKET and ctype == socket.SCM_RIGHTS:
+            usable = len(cdata) - (len(cdata) % fds.itemsize)
+            fds.frombytes(cdata[:usable])
+    if len(data) < HEADER.size:
+        data += _read_exact(sock, HEADER.size - len(data))
+    return data, list(fds)
+
+
+def read_frame(sock):
+    ftype, payload, fds = read_frame_fds(sock)
+    for fd in fds:
+        os.close(fd)
+    return ftype, payload
+
+
+def read_frame_fds(sock):
+    header, fds = _read_header(sock)
+    magic, ftype, length = HEADER.unpack(header)
+    if magic != FRAME_MAGIC:
+        for fd in fds:
+            os.close(fd)
+        raise ValueError("bad frame magic")
+    payload = _read_exact(sock, length) if length else b""
+    return ftype, payload, fds
+
+
+def write_frame(sock, ftype, payload=b""):
+    sock.sendall(HEADER.pack(FRAME_MAGIC, ftype, len(payload)))
+    if payload:
+        sock.sendall(payload)
+
+
+def _params(view):
+    if len(view) != INPUT_PARAMS.size:
+        raise ValueError("bad params record")
+    steps, guidance_scale, seed, width, height = INPUT_PARAMS.unpack(view)
+    return {"steps": steps, "guidance_scale": guidance_scale, "seed": seed,
+            "width": width, "height": height}
+
+
+def _unpack(buf):
+    magic, count = REGION_HEADER.unpack_from(buf, 0)
+    if magic == REGION_MAGIC:
+        n = count
+    elif magic == REGION_PARAMS_MAGIC:
+        n = 2 * count
+    else:
+        raise ValueError("bad region magic")
+    sizes = struct.unpack_from("=%dQ" % n, buf, REGION_HEADER.size)
+    offset = REGION_HEADER.size + 8 * n
+    views = []
+    for size in sizes:
+        if offset + size > len(buf):
+            raise ValueError("truncated region")
+        views.append(buf[offset:offset + size])
+        offset += size
+    if n == count:
+        return views, None
+    return views[:count], [_params(v) for v in views[count:]]
+
+
+def read_request(fd):
+    """Maps a packed input region. Returns its inputs as memoryviews, and
+    their params (one dict per input) or None."""
+    size = os.fstat(fd).st_size
+    if size == 0:
+        return [], None
+    mm = mmap.mmap(fd, size, prot=mmap.PROT_READ)
+    return _unpack(memoryview(mm))
+
+
+def read_buffers(fd):
+    """Maps a packed region and returns its buffers as memoryviews."""
+    return read_request(fd)[0]
+
+
+def write_buffers(fd, outputs):
+    """Grows the region behind fd to fit and packs outputs into it."""
+    outputs = [o.encode() if isinstance(o, str) else o for o in outputs]
+    count = len(outputs)
+    total = REGION_HEADER.size + 8 * count + sum(len(o) for o in outputs)
+    os.ftruncate(fd, total)
+    mm = mmap.mmap(fd, total)
+    try:
+        REGION_HEADER.pack_into(mm, 0, REGION_MAGIC, count)
+        struct.pack_into("=%dQ" % count, mm, REGION_HEADER.size,
+                         *[len(o) for o in outputs])
+        offset = REGION_HEADER.size + 8 * count
+        for o in outputs:
+            mm[offset:offset + len(o)] = o
+            offset += len(o)
+    finally:
+        mm.close()
+
+
+def _takes(fn, name):
+    try:
+        return name in inspect.signature(fn).parameters
+    except (TypeError, ValueError):
+        return False
+
+
+def _handle(handler, batch, input_fd, output_fd, progress):
+    inputs, params = read_request(input_fd)
+    kwargs = {}
+    if _takes(handler, "progress"):
+        kwargs["progress"] = progress
+    if _takes(handler, "params"):
+        kwargs["params"] = params
+    if batch:
+        outputs = handler(inputs, **kwargs)
+    else:
+        out = handler(b"".join(bytes(i) for i in inputs), **kwargs)
+        outputs = [out]
+    write_buffers(output_fd, outputs)
+
+
+class _Stepped(object):
+    """A request in the step loop."""
+
+    def __init__(self, rid, steps, state, output_fd):
+        self.rid = rid
+        self.steps = steps
+        self.state = state
+        self.output_fd = output_fd
+        self.step = 0
+
+
+class _StepLoop(object):
+    def __init__(self, stepper):
+        self._stepper = stepper
+        self._active = []
+        self._reports = []  # Joins that failed, sent with the next STEP_DONE
+
+    def _fail(self, rid, step, output_fd, message):
+        try:
+            write_buffers(output_fd, [message])
+        except Exception:
+            traceback.print_exc(file=sys.stderr)
+        self._reports.append((rid, step, STEP_FAILED))
+
+    def join(self, payload, fds):
+        rid, steps, _ = JOIN_HEADER.unpack_from(payload)
+        if len(fds) != 2:
+            self._reports.append((rid, 0, STEP_FAILED))
+            return
+        try:
+            inputs, params = read_request(fds[0])
+            if _takes(self._stepper.start, "params"):
+                state = self._stepper.start(inputs, steps, params=params)
+            else:
+                state = self._stepper.start(inputs, steps)
+        except Exception:
+            traceback.print_exc(file=sys.stderr)
+            self._fail(rid, 0, fds[1], traceback.format_exc())
+            return
+        # The frame's descriptors are closed after it is handled
+        self._active.append(_Stepped(rid, steps, state, os.dup(fds[1])))
+
+    def leave(self, payload):
+        # The worker no longer wants the request: stop stepping it
+        rid, _, _ = JOIN_HEADER.unpack_from(payload)
+        for r in self._active:
+            if r.rid == rid:
+                os.close(r.output_fd)
+        self._active = [r for r in self._active if r.rid != rid]
+
+    def step(self, sock):
+        active, self._active = self._active, []
+        if active:
+            try:
+                self._stepper.step([r.state for r in active])
+            except Exception:
+                traceback.print_exc(file=sys.stderr)
+                message = traceback.format_exc()
+                for r in active:
+                    self._fail(r.rid, r.step, r.output_fd, message)
+                    os.close(r.output_fd)
+                active = []
+        for r in active:
+            r.step += 1
+            if r.step < r.steps:
+                self._active.append(r)
+                self._reports.append((r.rid, r.step, STEP_RUNNING))
+                continue
+            try:
+                write_buffers(r.output_fd, self._stepper.finish(r.state))
+                self._reports.append((r.rid, r.step, STEP_FINISHED))
+            except Exception:
+                traceback.print_exc(file=sys.stderr)
+                self._fail(r.rid, r.step, r.output_fd, traceback.format_exc())
+            os.close(r.output_fd)
+        reports, self._reports = self._reports, []
+        write_frame(sock, FRAME_STEP_DONE,
+                    b"".join(STEP_STATUS.pack(*r) for r in reports))
+
+
+def serve(fd, handler, batch=False, stepper=None):
+    sock = socket.socket(fileno=fd)
+    steps = _StepLoop(stepper) if stepper is not None else None
+    write_frame(sock, FRAME_READY,
+                READY_PAYLOAD.pack(READY_STEPPABLE if steps else 0))
+    while True:
+        try:
+            ftype, payload, fds = read_frame_fds(sock)
+        except EOFError:
+            return
+        try:
+            if ftype == FRAME_PING:
+                write_frame(sock, FRAME_PONG)
+            elif ftype == FRAME_SHUTDOWN:
+                return
+            elif ftype == FRAME_JOIN and steps is not None:
+                steps.join(payload, fds)
+            elif ftype == FRAME_STEP and steps is not None:
+                steps.step(sock)
+            elif ftype == FRAME_LEAVE and steps is not None:
+                steps.leave(payload)
+            elif ftype == FRAME_REQUEST:
+                try:
+                    if len(fds) != 2:
+                        raise ValueError("request without shared memory")
+                    progress = None
+                    if len(payload) >= PREVIEW_REQUEST.size:
+                        every, max_size = PREVIEW_REQUEST.unpack_from(payload)
+                        progress = Progress(sock, every, max_size)
+                    _handle(handler, batch, fds[0], fds[1], progress)
+                    write_frame(sock, FRAME_RESPONSE)
+                except Cancelled:
+                    write_frame(sock, FRAME_ERROR, b"cancelled")
+                except Exception:
+                    traceback.print_exc(file=sys.stderr)
+                    write_frame(sock, FRAME_ERROR,
+                                traceback.format_exc().encode())
+        finally:
+            for f in fds:
+                os.close(f)
@@ -1,10 +1,14 @@
 #include "worker/process_executor.h"
 
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
 #include <cerrno>
+#include <chrono>
 #include <cstring>
 #include <iostream>
 
@@ -13,56 +17,95 @@ using infaas::internal::ForkAndExec;
 namespace infaas {
 namespace internal {
 
-static void ReadFromFd(int fd, std::string* output) {
-  if (!output) return;
+// Bytes requested from the kernel per read().
+static const size_t read_chunk = 64 * 1024;
+
+// Reads whatever is available on fd. Data is read directly into the spare
+// space at the end of output (or discarded if output is null, the pipe must
+// still be drained). Returns false once the pipe hits EOF or an error.
+static bool ReadAvailable(int fd, std::string* output) {
+  static thread_local char discard[read_chunk];
+  while (true) {
+    ssize_t n;
+    if (output) {
+      size_t old_size = output->size();
+      output->resize(old_size + read_chunk);
+      n = read(fd, &(*output)[old_size], read_chunk);
+      output->resize(old_size + (n > 0 ? n : 0));
+    } else {
+      n = read(fd, discard, read_chunk);
+    }
+    if (n > 0) {
+      if ((size_t)n < read_chunk) { return true; }  // Drained for now
+      continue;
+    }
+    if (n == 0) { return false; }  // EOF
+    if (errno == EINTR) { continue; }
+    if (errno == EAGAIN || errno == EWOULDBLOCK) { return true; }
+    return false;
+  }
+}
 
-  char buffer[4096];
-  ssize_t n;
-  while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
-    output->append(buffer, n);
+static int WaitStatusToCode(int status) {
+  if (WIFEXITED(status)) {
+    return WEXITSTATUS(status);
+  } else if (WIFSIGNALED(status)) {
+    return 128 + WTERMSIG(status);
   }
+  return -1;
 }
 
 int ForkAndExec(const std::vector<std::string>& argv,
                 std::string* stdout_out,
-                std::string* stderr_out) {
+                std::string* stderr_out,
+                const ExecOptions& options) {
   if (argv.empty()) {
     return -1;
   }
 
+  // O_CLOEXEC: children forked concurrently by other threads must not
+  // inherit our pipes, or we would never see EOF on them.
   int stdout_pipe[2];
   int stderr_pipe[2];
 
-  if (pipe(stdout_pipe) < 0 || pipe(stderr_pipe) < 0) {
+  if (pipe2(stdout_pipe, O_CLOEXEC) < 0) {
+    perror("pipe");
+    return -1;
+  }
+  if (pipe2(stderr_pipe, O_CLOEXEC) < 0) {
     perror("pipe");
+    close(stdout_pipe[0]);
+    close(stdout_pipe[1]);
     return -1;
   }
 
+  // Build argv for execvp before forking
+  std::vector<char*> exec_argv;
+  exec_argv.reserve(argv.size() + 1);
+  for (const auto& arg : argv) {
+    exec_argv.push_back(const_cast<char*>(arg.c_str()));
+  }
+  exec_argv.push_back(nullptr);
+
   pid_t pid = fork();
   if (pid < 0) {
     perror("fork");
+    close(stdout_pipe[0]);
+    close(stdout_pipe[1]);
+    close(stderr_pipe[0]);
+    close(stderr_pipe[1]);
     return -1;
   }
 
   if (pid == 0) {
     // ---- CHILD PROCESS ----
 
-    // Redirect stdout
+    // Redirect stdout/stderr (dup2 clears close-on-exec on the new fds)
     dup2(stdout_pipe[1], STDOUT_FILENO);
     dup2(stderr_pipe[1], STDERR_FILENO);
-
-    close(stdout_pipe[0]);
-    close(stdout_pipe[1]);
-    close(stderr_pipe[0]);
-    close(stderr_pipe[1]);
-
-    // Build argv for execvp
-    std::vector<char*> exec_argv;
-    exec_argv.reserve(argv.size() + 1);
-    for (const auto& arg : argv) {
-      exec_argv.push_back(const_cast<char*>(arg.c_str()));
+    for (int fd : options.inherit_fds) {
+      fcntl(fd, F_SETFD, 0);  // Keep it across exec
     }
-    exec_argv.push_back(nullptr);
 
     execvp(exec_argv[0], exec_argv.data());
 
@@ -74,23 +117,74 @@ int ForkAndExec(const std::vector<std::string>& argv,
   // ---- PARENT PROCESS ----
   close(stdout_pipe[1]);
   close(stderr_pipe[1]);
+  fcntl(stdout_pipe[0], F_SETFL, O_NONBLOCK);
+  fcntl(stderr_pipe[0], F_SETFL, O_NONBLOCK);
 
-  ReadFromFd(stdout_pipe[0], stdout_out);
-  ReadFromFd(stderr_pipe[0], stderr_out);
+  if (stdout_out && options.stdout_reserve > 0) {
+    stdout_out->reserve(stdout_out->size() + options.stdout_reserve);
+  }
+  if (stderr_out && options.stderr_reserve > 0) {
+    stderr_out->reserve(stderr_out->size() + options.stderr_reserve);
+  }
 
-  close(stdout_pipe[0]);
-  close(stderr_pipe[0]);
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::milliseconds(options.timeout_ms);
+  bool timed_out = false;
+
+  // Drain both pipes until both report EOF
+  struct pollfd fds[2];
+  fds[0].fd = stdout_pipe[0];
+  fds[0].events = POLLIN;
+  fds[1].fd = stderr_pipe[0];
+  fds[1].events = POLLIN;
+  std::string* outs[2] = {stdout_out, stderr_out};
+  int open_fds = 2;
+
+  while (open_fds > 0) {
+    int wait_ms = -1;
+    if (options.timeout_ms > 0) {
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      deadline - std::chrono::steady_clock::now())
+                      .count();
+      if (left <= 0) {
+        timed_out = true;
+        break;
+      }
+      wait_ms = (int)left;
+    }
 
-  int status = 0;
-  waitpid(pid, &status, 0);
+    int rc = poll(fds, 2, wait_ms);
+    if (rc < 0) {
+      if (errno == EINTR) { continue; }
+      perror("poll");
+      break;
+    }
 
-  if (WIFEXITED(status)) {
-    return WEXITSTATUS(status);
-  } else if (WIFSIGNALED(status)) {
-    return 128 + WTERMSIG(status);
+    for (int i = 0; i < 2; ++i) {
+      if (fds[i].fd < 0 || fds[i].revents == 0) { continue; }
+      if (!ReadAvailable(fds[i].fd, outs[i])) {
+        close(fds[i].fd);
+        fds[i].fd = -1;  // poll ignores negative fds
+        open_fds--;
+      }
+    }
   }
 
-  return -1;
+  for (int i = 0; i < 2; ++i) {
+    if (fds[i].fd >= 0) { close(fds[i].fd); }
+  }
+
+  int status = 0;
+  if (timed_out) {
+    std::cerr << "[process_executor] " << argv[0] << " exceeded "
+              << options.timeout_ms << " ms; killing pid " << pid << std::endl;
+    kill(pid, SIGKILL);
+    waitpid(pid, &status, 0);
+    return exec_timed_out;
+  }
+
+  waitpid(pid, &status, 0);
+  return WaitStatusToCode(status);
 }
 
 }  // namespace internal
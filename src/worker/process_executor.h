@@ -3,30 +3,84 @@
 #ifndef INFAAS_PROCESS_EXECUTOR_H_
 #define INFAAS_PROCESS_EXECUTOR_H_
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
 namespace infaas {
 namespace internal {
 
+/**
+ * Returned by ForkAndExec when the child was killed for exceeding
+ * ExecOptions::timeout_ms.
+ */
+static const int exec_timed_out = -2;
+
+/**
+ * Options for ForkAndExec.
+ *
+ * timeout_ms      Wall-clock limit for the child; it is SIGKILLed when the
+ *                 limit is hit. 0 means no limit.
+ * stdout_reserve  Bytes to reserve in stdout_out up front (e.g., the expected
+ *                 image size) so large outputs are not reallocated.
+ * stderr_reserve  Same for stderr_out.
+ * inherit_fds     Descriptors the child keeps open across exec under the
+ *                 same numbers (e.g., shared-memory regions).
+ */
+struct ExecOptions {
+  int timeout_ms = 0;
+  size_t stdout_reserve = 0;
+  size_t stderr_reserve = 0;
+  std::vector<int> inherit_fds;
+};
+
 /**
  * Forks a child process and executes a command.
  *
+ * stdout and stderr are drained concurrently (poll), so a child that fills
+ * one pipe while the other is being read cannot block. Output is appended
+ * straight into the given strings, so a caller can pass a reply field (e.g.,
+ * raw_output) and avoid an extra copy.
+ *
  * @param argv        Command and arguments (argv[0] = executable)
  * @param stdout_out  Captured stdout (optional, may be nullptr)
  * @param stderr_out  Captured stderr (optional, may be nullptr)
+ * @param options     Timeout and buffer reservation
  *
- * @return Exit code of the child process, or -1 on failure
+ * @return Exit code of the child process, 128 + signal if it was killed by a
+ *         signal, exec_timed_out on timeout, or -1 on failure
  */
 int ForkAndExec(const std::vector<std::string>& argv,
                 std::string* stdout_out,
-                std::string* stderr_out);
+                std::string* stderr_out,
+                const ExecOptions& options = ExecOptions());
 
 }  // namespace internal
 }  // namespace infaas
 
 #endif  // INFAAS_PROCESS_EXECUTOR_H_
 
+// How a model is run, from its model:<name> hash in Redis
+// (RedisMetadata::get_model_exec_info). The worker starts the entry point as
+//   <env_path>/bin/python3 <entry_point> --model <name> ...
+// and what follows depends on exec_protocol:
+//
+//   "argv" (or unset)  One process per request, given the request's inputs
+//                      concatenated as --input <string> (omitted if empty).
+//                      Its stdout is the single output; a non-zero exit
+//                      fails the request with its stderr.
+//   "shm"              Inputs and outputs cross in shared memory, one buffer
+//                      each (shm_transport.h). The entry point is kept warm
+//                      with --serve-fd <fd> and the frame protocol in
+//                      model_process_pool.h, or, if it cannot be, run once
+//                      per request with --input-fd <fd> --output-fd <fd>.
+//                      model_server.py implements both sides.
+//
+// Only "shm" models are batched across requests or stepped.
+//
+// version is optional. Change it whenever the model's weights or code
+// change: cached results are keyed by it, and a model without one is never
+// served from the result cache.
 struct ModelSpec {
   std::string model_name;
   std::string framework;
@@ -34,4 +88,8 @@ struct ModelSpec {
   std::string exec_path;
   std::string entry_point;
   std::string env_path;
+  std::string exec_protocol;
+  std::string version;
+
+  bool shm_protocol() const { return exec_protocol == "shm"; }
 };
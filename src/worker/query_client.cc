@@ -20,7 +20,6 @@
  * SOFTWARE.
  */
 
-#include <sys/time.h>
 #include <cstdint>
 #include <iostream>
 #include <string>
@@ -37,12 +36,6 @@ static const int MAX_GRPC_DEADLINE = 10000;  // In msec = 10 seconds.
 namespace infaas {
 namespace internal {
 namespace {
-// Timestamp to millisecond duration.
-double ts_to_ms(const struct timeval& start, const struct timeval& end) {
-  return (end.tv_sec - start.tv_sec) * 1000.0 +
-         (end.tv_usec - start.tv_usec) / 1000.0;
-}
-
 void set_grpc_deadline(ClientContext* context,
                        int ddl_in_ms = MAX_GRPC_DEADLINE) {
   std::chrono::system_clock::time_point deadline =
@@ -50,6 +43,56 @@ void set_grpc_deadline(ClientContext* context,
   context->set_deadline(deadline);
 }
 
+// The worker request for a QueryOnline call
+void make_online_request(
+    const google::protobuf::RepeatedPtrField<std::string>& input,
+    const std::vector<std::string>& model, const std::string& submitter,
+    const int64_t latency, const double minacc, const double maxcost,
+    const InternalDiffusionQuery* diffusion, QueryOnlineRequest* request) {
+  QuerySLO query_slo;
+  query_slo.set_latencyinusec(latency);
+  query_slo.set_minaccuracy(minacc);
+  query_slo.set_maxcost(maxcost);
+
+  request->mutable_raw_input()->CopyFrom(input);
+  for (auto m : model) { request->add_model(m); }
+  request->mutable_slo()->CopyFrom(query_slo);
+  request->set_submitter(submitter);
+  if (diffusion) { request->mutable_diffusion()->CopyFrom(*diffusion); }
+}
+
+// Maps the outcome of a QueryOnline call to the status returned to callers
+InfaasRequestStatus online_result(
+    const Status& status, QueryOnlineResponse* reply,
+    google::protobuf::RepeatedPtrField<std::string>* output,
+    int64_t* queue_depth) {
+  if (queue_depth != nullptr) {
+    *queue_depth = status.ok() ? (int64_t)reply->queue_depth() : -1;
+  }
+
+  // Act upon its status.
+  InfaasRequestStatus request_status;
+  if (status.ok() &&
+      (reply->status().status() == InfaasRequestStatusEnum::SUCCESS)) {
+    output->Swap(reply->mutable_raw_output());
+    return reply->status();
+  } else if (status.error_code() == grpc::StatusCode::INVALID_ARGUMENT) {
+    // Internal error.
+    std::string errmsg = "INTERNAL FAILURE: " + reply->status().msg();
+    std::cerr << errmsg << std::endl;
+    request_status.set_status(InfaasRequestStatusEnum::INVALID);
+    request_status.set_msg(errmsg);
+    return request_status;
+  } else {
+    // RPC error
+    std::string errmsg = "RPC FAILURE: " + status.error_message();
+    std::cerr << errmsg << std::endl;
+    request_status.set_status(InfaasRequestStatusEnum::UNAVAILABLE);
+    request_status.set_msg(errmsg);
+    return request_status;
+  }
+}
+
 }  // namespace
 
 // Translate the function call to gRPC call.
@@ -58,58 +101,97 @@ InfaasRequestStatus QueryClient::QueryOnline(
     const std::vector<std::string>& model, const std::string submitter,
     google::protobuf::RepeatedPtrField<std::string>* output,
     const int64_t& latency, const double& minacc, const double& maxcost,
-    const int grpc_deadline) {
-  struct timeval time1, time2;
-  gettimeofday(&time1, NULL);
+    const int grpc_deadline, const InternalDiffusionQuery* diffusion,
+    int64_t* queue_depth, ClientContext* context) {
   // Data we are sending to the server.
-  QuerySLO query_slo;
-  query_slo.set_latencyinusec(latency);
-  query_slo.set_minaccuracy(minacc);
-  query_slo.set_maxcost(maxcost);
-
   QueryOnlineRequest request;
-
-  request.mutable_raw_input()->CopyFrom(input);
-  for (auto m : model) { request.add_model(m); }
-  request.mutable_slo()->CopyFrom(query_slo);
-  request.set_submitter(submitter);
+  make_online_request(input, model, submitter, latency, minacc, maxcost,
+                      diffusion, &request);
 
   QueryOnlineResponse reply;
 
   // Context for the client. It could be used to convey extra information to
   // the server and/or tweak certain RPC behaviors.
-  ClientContext context;
-  set_grpc_deadline(&context, grpc_deadline);
+  ClientContext own_context;
+  if (context == nullptr) { context = &own_context; }
+  set_grpc_deadline(context, grpc_deadline);
 
-  gettimeofday(&time2, NULL);
-  printf("[query_client.cc] Prepare QueryOnline request: %.4lf ms.\n",
-         ts_to_ms(time1, time2));
   // The actual RPC.
-  Status status = stub_->QueryOnline(&context, request, &reply);
+  Status status = stub_->QueryOnline(context, request, &reply);
 
-  gettimeofday(&time1, NULL);
-  printf("[query_client.cc] QueryOnline total: %.4lf ms.\n",
-         ts_to_ms(time2, time1));
+  return online_result(status, &reply, output, queue_depth);
+}
 
-  // Act upon its status.
-  InfaasRequestStatus request_status;
-  if (status.ok() &&
-      (reply.status().status() == InfaasRequestStatusEnum::SUCCESS)) {
-    *output = reply.raw_output();
+void QueryClient::AsyncQueryOnline(
+    grpc::CompletionQueue* cq, void* tag, AsyncOnlineCall* call,
+    const google::protobuf::RepeatedPtrField<std::string>& input,
+    const std::vector<std::string>& model, const std::string submitter,
+    const int64_t& latency, const double& minacc, const double& maxcost,
+    const int grpc_deadline, const InternalDiffusionQuery* diffusion) {
+  make_online_request(input, model, submitter, latency, minacc, maxcost,
+                      diffusion, &call->request);
+  set_grpc_deadline(&call->context, grpc_deadline);
+  call->reader =
+      stub_->PrepareAsyncQueryOnline(&call->context, call->request, cq);
+  call->reader->StartCall();
+  call->reader->Finish(&call->reply, &call->status, tag);
+}
 
-    gettimeofday(&time2, NULL);
-    printf("[query_client.cc] get output: %.4lf ms.\n", ts_to_ms(time1, time2));
-    fflush(stdout);
-    return reply.status();
-  } else if (status.error_code() == grpc::StatusCode::INVALID_ARGUMENT) {
-    // Internal error.
-    std::string errmsg = "INTERNAL FAILURE: " + reply.status().msg();
+InfaasRequestStatus QueryClient::FinishQueryOnline(
+    AsyncOnlineCall* call,
+    google::protobuf::RepeatedPtrField<std::string>* output,
+    int64_t* queue_depth) {
+  return online_result(call->status, &call->reply, output, queue_depth);
+}
+
+InfaasRequestStatus QueryClient::QueryOnlineStream(
+    const google::protobuf::RepeatedPtrField<std::string>& input,
+    const std::vector<std::string>& model, const std::string submitter,
+    google::protobuf::RepeatedPtrField<std::string>* output,
+    const PreviewFn& on_preview, const int64_t& latency, const double& minacc,
+    const double& maxcost, const int grpc_deadline,
+    const InternalDiffusionQuery* diffusion) {
+  QueryOnlineRequest request;
+  request.mutable_raw_input()->CopyFrom(input);
+  for (auto m : model) { request.add_model(m); }
+  request.mutable_slo()->set_latencyinusec(latency);
+  request.mutable_slo()->set_minaccuracy(minacc);
+  request.mutable_slo()->set_maxcost(maxcost);
+  request.set_submitter(submitter);
+  if (diffusion) { request.mutable_diffusion()->CopyFrom(*diffusion); }
+
+  ClientContext context;
+  set_grpc_deadline(&context, grpc_deadline);
+  std::unique_ptr<grpc::ClientReader<QueryOnlineProgress>> reader(
+      stub_->QueryOnlineStream(&context, request));
+
+  // Previews until the message with a status, which carries the outputs
+  QueryOnlineProgress msg;
+  QueryOnlineProgress result;
+  bool have_result = false;
+  while (reader->Read(&msg)) {
+    if (msg.has_status()) {
+      result.Swap(&msg);
+      have_result = true;
+    } else if (on_preview && !on_preview(msg)) {
+      context.TryCancel();
+    }
+  }
+  Status status = reader->Finish();
+
+  InfaasRequestStatus request_status;
+  if (status.ok() && have_result &&
+      (result.status().status() == InfaasRequestStatusEnum::SUCCESS)) {
+    output->Swap(result.mutable_raw_output());
+    return result.status();
+  } else if (have_result || (status.error_code() ==
+                             grpc::StatusCode::INVALID_ARGUMENT)) {
+    std::string errmsg = "INTERNAL FAILURE: " + result.status().msg();
     std::cerr << errmsg << std::endl;
     request_status.set_status(InfaasRequestStatusEnum::INVALID);
     request_status.set_msg(errmsg);
     return request_status;
   } else {
-    // RPC error
     std::string errmsg = "RPC FAILURE: " + status.error_message();
     std::cerr << errmsg << std::endl;
     request_status.set_status(InfaasRequestStatusEnum::UNAVAILABLE);
@@ -25,6 +25,8 @@
 #define QUERY_CLIENT_H
 
 #include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -39,16 +41,69 @@ namespace internal {
 
 class QueryClient {
 public:
+  // Gets every preview of QueryOnlineStream; returning false cancels the
+  // query.
+  typedef std::function<bool(const QueryOnlineProgress&)> PreviewFn;
+
   QueryClient(std::shared_ptr<Channel> channel)
       : stub_(Query::NewStub(channel)) {}
 
-  // QueryOnline request
+  // QueryOnline request. diffusion (optional) carries the generation
+  // parameters the worker batches requests by. queue_depth (optional) gets
+  // the number of requests the worker still had in flight when it replied,
+  // or -1 if no reply arrived. A caller that may need to cancel the call
+  // from another thread passes its own (fresh) context.
   InfaasRequestStatus QueryOnline(
       const google::protobuf::RepeatedPtrField<std::string>& input,
       const std::vector<std::string>& model, const std::string submitter,
       google::protobuf::RepeatedPtrField<std::string>* output,
       const int64_t& latency = 0, const double& minacc = 0,
-      const double& maxcost = 0, const int grpc_deadline = 10000);
+      const double& maxcost = 0, const int grpc_deadline = 10000,
+      const InternalDiffusionQuery* diffusion = nullptr,
+      int64_t* queue_depth = nullptr,
+      grpc::ClientContext* context = nullptr);
+
+  // One QueryOnline call in flight on a completion queue. It must stay alive
+  // until the call's tag comes out of the queue; context.TryCancel() cancels
+  // the call meanwhile.
+  struct AsyncOnlineCall {
+    grpc::ClientContext context;
+    QueryOnlineRequest request;
+    QueryOnlineResponse reply;
+    grpc::Status status;
+    std::unique_ptr<grpc::ClientAsyncResponseReader<QueryOnlineResponse>>
+        reader;
+  };
+
+  // Starts QueryOnline on cq without waiting for the worker. tag comes out
+  // of cq once the call is over; FinishQueryOnline then reads its result.
+  void AsyncQueryOnline(
+      grpc::CompletionQueue* cq, void* tag, AsyncOnlineCall* call,
+      const google::protobuf::RepeatedPtrField<std::string>& input,
+      const std::vector<std::string>& model, const std::string submitter,
+      const int64_t& latency = 0, const double& minacc = 0,
+      const double& maxcost = 0, const int grpc_deadline = 10000,
+      const InternalDiffusionQuery* diffusion = nullptr);
+
+  // The status QueryOnline would have returned for a call started by
+  // AsyncQueryOnline, with output and queue_depth (optional) set the same
+  // way.
+  static InfaasRequestStatus FinishQueryOnline(
+      AsyncOnlineCall* call,
+      google::protobuf::RepeatedPtrField<std::string>* output,
+      int64_t* queue_depth = nullptr);
+
+  // Like QueryOnline, but the worker streams previews while it generates;
+  // each one is handed to on_preview. Always runs on a warm model process
+  // and is never batched.
+  InfaasRequestStatus QueryOnlineStream(
+      const google::protobuf::RepeatedPtrField<std::string>& input,
+      const std::vector<std::string>& model, const std::string submitter,
+      google::protobuf::RepeatedPtrField<std::string>* output,
+      const PreviewFn& on_preview, const int64_t& latency = 0,
+      const double& minacc = 0, const double& maxcost = 0,
+      const int grpc_deadline = 10000,
+      const InternalDiffusionQuery* diffusion = nullptr);
 
   // QueryOffline request
   InfaasRequestStatus QueryOffline(const std::string& input_url,
@@ -22,11 +22,13 @@
 
 // This process is running on a worker machine to receive query requests from
 // INFaaS master.
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <deque>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <stdio.h>
@@ -61,6 +63,12 @@
 #include "local_storage_backend.h"//PNB: (2025.12.28)
 #include "model.pb.h" //PNB: (2026.01.16)
 #include "model_executor.h" //PNB (2026.01.20)
+#include "batch_scheduler.h"
+#include "result_cache.h"
+#include "image_encoder.h"
+#include "common_local_paths.h"
+#include "common/async_log.h"
+#include "common/query_key.h"
 
 #ifdef ENABLE_AWS
 using Aws::S3::S3Client;
@@ -69,6 +77,7 @@ using Aws::S3::S3Client;
 using grpc::Server;
 using grpc::ServerBuilder;
 using grpc::ServerContext;
+using grpc::ServerWriter;
 using grpc::Status;
 
 // PnB: (2025.12.27)
@@ -88,6 +97,13 @@ static const int MAX_GRPC_MESSAGE_SIZE = INT32_MAX;
 // threads in the future.
 static const int OFFLINE_THREAD_POOL_SIZE = 1;
 static const int AUTOSCALER_THREAD_POOL_SIZE = 1;
+// How long the first request of a batch waits for others to join, in msec.
+static const int batch_delay_ms = 20;
+// Disk budget of the online result cache, in MB, unless given on the
+// command line. 0 turns the cache off.
+static const uint64_t default_result_cache_mb = 0;
+// Threads encoding the raw images models return.
+static const int image_encode_threads = 4;
 
 // // PNB: Use this to do local autoscaling in place of AWS (2025.12.27)
 // LocalStorageBackend storage("/var/lib/infaas/models");
@@ -150,13 +166,60 @@ double getCPUutil() {
   return percent;
 }
 
+// Result cache key (DiffusionQueryKey). Empty if the output must not be
+// cached: it is not reproducible, or the model has no version to tell its
+// outputs from those of an updated model.
+std::string result_cache_key(const ModelSpec &spec,
+                             const QueryOnlineRequest &request) {
+  if (spec.version.empty()) { return ""; }
+  return DiffusionQueryKey(spec.model_name, spec.version, request);
+}
+
+// The generation parameters of a request, once for each of its inputs, for
+// the model to read with them. None if the request carries no diffusion
+// parameters.
+std::vector<InputParams> input_params(const QueryOnlineRequest &request) {
+  std::vector<InputParams> params;
+  if (!request.has_diffusion()) { return params; }
+  const InternalDiffusionQuery &q = request.diffusion();
+  InputParams p;
+  p.steps = q.steps();
+  p.guidance_scale = q.guidancescale();
+  p.seed = q.seed();
+  p.width = q.width();
+  p.height = q.height();
+  params.assign(request.raw_input_size(), p);
+  return params;
+}
+
+// Counts an online request as in flight for as long as it is handled, and
+// reports how many others are still in flight in its reply (if any), so the
+// frontend can route by queue depth without polling.
+class InflightScope {
+public:
+  InflightScope(std::atomic<uint32_t> *inflight, QueryOnlineResponse *reply)
+      : inflight_(inflight), reply_(reply) {
+    inflight_->fetch_add(1, std::memory_order_relaxed);
+  }
+  ~InflightScope() {
+    const uint32_t others =
+        inflight_->fetch_sub(1, std::memory_order_relaxed) - 1;
+    if (reply_ != nullptr) { reply_->set_queue_depth(others); }
+  }
+
+private:
+  std::atomic<uint32_t> *inflight_;
+  QueryOnlineResponse *reply_;
+};
+
 } // namespace
 
 // Implementation of the query service.
 class QueryServiceImpl final : public Query::Service {
 public:
   QueryServiceImpl(std::string worker_name, struct Address redis_addr,
-                   infaas::internal::AutoscalerType autoscaler_type)
+                   infaas::internal::AutoscalerType autoscaler_type,
+                   const uint64_t result_cache_mb)
       : worker_name_(worker_name), redis_addr_(redis_addr) {
     monitoring_run_ = true;
     redis_metadata_ =
@@ -178,6 +241,15 @@ public:
     s3cfg.requestTimeoutMs = 1000 * 60 * 3; // Request timeout = 3min.
     s3cfg.root_dir = "/var/lib/infaas/models";
     s3_client_ = std::unique_ptr<localfs::S3Client>(new localfs::S3Client(s3cfg));
+    rm_ = redis_metadata_.get();
+    batcher_ = std::unique_ptr<BatchScheduler>(
+        new BatchScheduler(ExecuteModel, batch_delay_ms));
+    encoder_ = std::unique_ptr<ImageEncoder>(
+        new ImageEncoder(image_encode_threads));
+    if (result_cache_mb > 0) {
+      result_cache_ = std::unique_ptr<ResultCache>(new ResultCache(
+          kLocalResultCacheDir + "/" + worker_name_, result_cache_mb << 20));
+    }
     
     qpsMonitorThread_ = new std::thread(&QueryServiceImpl::qpsMonitor, this);
     resourceMonitorThread_ =
@@ -214,6 +286,7 @@ public:
     for (int i = 0; i < OFFLINE_THREAD_POOL_SIZE; ++i) {
       offlineProcessPool_[i]->join();
     }
+    Autoscaler::Shutdown();
     for (int i = 0; i < autoscalerPool_.size(); ++i) {
       autoscalerPool_[i]->join();
     }
@@ -231,9 +304,23 @@ private:
   // Process Offline requests in the queue.
   void offlineProccess();
 
+  // Most inputs one execution of the model may take (metadata max_batch).
+  int getMaxBatch(const std::string& model_name);
+
+  // Fills spec with the execution metadata of model_name from Redis.
+  // Returns 0 on success, -1 if the model is unknown.
+  int8_t getModelSpec(const std::string& model_name, ModelSpec* spec);
+
   Status QueryOnline(ServerContext *context, const QueryOnlineRequest *request,
                      QueryOnlineResponse *reply) override;
 
+  // Runs the request on a warm model process, bypassing the batcher, and
+  // writes a preview after every PROGRESS frame. Stops the model process
+  // as soon as the client goes away.
+  Status QueryOnlineStream(ServerContext *context,
+                           const QueryOnlineRequest *request,
+                           ServerWriter<QueryOnlineProgress> *writer) override;
+
   Status QueryOffline(ServerContext *context,
                       const QueryOfflineRequest *request,
                       QueryOfflineResponse *reply) override;
@@ -271,6 +358,18 @@ private:
   static std::map<std::string, std::atomic<uint64_t>> model_total_slo_;
 
   RedisMetadata* rm_; //PNB: (2026.01.20)
+
+  // Batches concurrent online requests per model and generation parameters.
+  std::unique_ptr<BatchScheduler> batcher_;
+  // Outputs of reproducible online requests; null if disabled.
+  std::unique_ptr<ResultCache> result_cache_;
+  // Turns raw model images into the format each request asks for.
+  std::unique_ptr<ImageEncoder> encoder_;
+  // Online requests currently being handled; reported in every reply.
+  std::atomic<uint32_t> online_inflight_{0};
+  // Cached max_batch per model; it does not change once registered.
+  std::mutex max_batch_mutex_;
+  std::map<std::string, int> model_max_batch_;
 };
 
 std::map<std::string, std::atomic<uint64_t>>
@@ -286,12 +385,12 @@ Status QueryServiceImpl::Heartbeat(ServerContext *context,
                                    const HeartbeatRequest *request,
                                    HeartbeatResponse *reply) {
   if (request->status().status() != InfaasRequestStatusEnum::SUCCESS) {
-    std::cout << "Heartbeat request invalid status: "
-              << request->status().status() << std::endl;
+    INFAAS_LOG(WARN) << "Heartbeat request invalid status: "
+                     << request->status().status();
     reply->mutable_status()->set_status(InfaasRequestStatusEnum::INVALID);
     return Status::CANCELLED;
   }
-  std::cout << "Received heartbeat" << std::endl;
+  INFAAS_LOG(INFO) << "Received heartbeat";
   reply->mutable_status()->set_status(InfaasRequestStatusEnum::SUCCESS);
   return Status::OK;
 }
@@ -531,6 +630,7 @@ Status QueryServiceImpl::QueryOnline(
     ServerContext *context,
     const QueryOnlineRequest *request,
     QueryOnlineResponse *reply) {
+  InflightScope inflight(&online_inflight_, reply);
 
   // 1. Validate request
   if (request->model_size() == 0) {
@@ -544,26 +644,7 @@ Status QueryServiceImpl::QueryOnline(
 	ModelSpec spec;
 	std::string model_name = request->model(0);
 
-	// rm_ already exists in QueryServiceImpl (INFaaS standard)
-	spec.model_name = model_name;
-
-	// Pull execution metadata from Redis
-	std::string framework;
-	std::string task;
-	std::string exec_path;
-	std::string entry_point;
-	std::string env_path;
-
-	// RedisMetadata API (already present in your codebase)
-	int rc = rm_->get_model_exec_info(
-	    model_name,
-	    &framework,
-	    &task,
-	    &exec_path,
-	    &entry_point,
-	    &env_path);
-
-	if (rc != 0) {
+	if (getModelSpec(model_name, &spec) != 0) {
 
 	  auto* status = reply->mutable_status();
 	  status->set_status(InfaasRequestStatusEnum::INVALID);
@@ -571,21 +652,75 @@ Status QueryServiceImpl::QueryOnline(
 	  return grpc::Status::OK;
 	}
 
-	spec.framework   = framework;
-	spec.task        = task;
-	spec.exec_path   = exec_path;
-	spec.entry_point = entry_point;
-	spec.env_path    = env_path;
+  // A reproducible request that was answered before by this version of the
+  // model needs no execution
+  std::string cache_key;
+  if (result_cache_ != nullptr) {
+    cache_key = result_cache_key(spec, *request);
+  }
+  std::vector<std::string> outputs;
+  if (!cache_key.empty() && result_cache_->Lookup(cache_key, &outputs)) {
+    for (std::string& out : outputs) {
+      reply->add_raw_output()->swap(out);
+    }
+    reply->mutable_status()->set_status(
+        InfaasRequestStatusEnum::SUCCESS);
+    return Status::OK;
+  }
 
-  // 3. Execute model
-  std::string output;
-  std::string input;
+  // 3. Execute model; inputs go to the model as-is, one buffer each
+  std::vector<BufferView> inputs;
+  inputs.reserve(request->raw_input_size());
   for (const auto& s : request->raw_input()) {
-    input += s;
+    inputs.push_back({s.data(), s.size()});
+  }
+
+  // The frontend reads the latency SLO in ms (the unit of the registered
+  // latencies it is compared with); the model gets the same budget
+  const int timeout_ms = (int)std::min<int64_t>(
+      request->slo().latencyinusec(), std::numeric_limits<int>::max());
+  const std::vector<InputParams> params = input_params(*request);
+
+  BatchKey key;
+  key.model = model_name;
+  key.steps = request->diffusion().steps();
+  key.cfg_scale = request->diffusion().guidancescale();
+  key.width = request->diffusion().width();
+  key.height = request->diffusion().height();
+
+  // A hedged request whose twin already answered is cancelled by the
+  // frontend; do not spend a model execution on it. The batcher and the
+  // step loop check again while it waits for its turn.
+  auto cancelled = [context] { return context->IsCancelled(); };
+  if (cancelled()) {
+    reply->mutable_status()->set_status(InfaasRequestStatusEnum::UNAVAILABLE);
+    reply->mutable_status()->set_msg("Cancelled by the frontend");
+    return Status(grpc::StatusCode::CANCELLED, "Cancelled by the frontend");
   }
-  
-  int rc2 = ExecuteModel(spec, input, &output);
 
+  // A model that can be stepped shares every denoising step with its other
+  // requests, whatever their step counts; others are batched whole. "argv"
+  // models take the request's inputs as one string, so they run alone.
+  const int max_batch = spec.shm_protocol() ? getMaxBatch(model_name) : 1;
+  int rc2 = ModelProcessPool::pool_unavailable;
+  if (key.steps > 0) {
+    rc2 = ExecuteModelStepped(spec, inputs, key.steps, max_batch, &outputs,
+                              timeout_ms, params, cancelled);
+  }
+  if (rc2 == ModelProcessPool::pool_unavailable) {
+    rc2 = batcher_->Submit(key, spec, max_batch, inputs, &outputs,
+                           timeout_ms, params, cancelled);
+  }
+  if ((rc2 != 0) && cancelled()) {
+    reply->mutable_status()->set_status(InfaasRequestStatusEnum::UNAVAILABLE);
+    reply->mutable_status()->set_msg("Cancelled by the frontend");
+    return Status(grpc::StatusCode::CANCELLED, "Cancelled by the frontend");
+  }
+
+  if (rc2 == 0) {
+    rc2 = encoder_->Encode(request->diffusion().format(),
+                           request->diffusion().quality(), &outputs);
+  }
   if (rc2 != 0) {
     reply->mutable_status()->set_status(
         InfaasRequestStatusEnum::INVALID);
@@ -595,14 +730,103 @@ Status QueryServiceImpl::QueryOnline(
   }
 
   // 4. Return output
-  reply->add_raw_output(output);
+  if (!cache_key.empty()) { result_cache_->Insert(cache_key, outputs); }
+  for (std::string& out : outputs) {
+    reply->add_raw_output()->swap(out);
+  }
   reply->mutable_status()->set_status(
       InfaasRequestStatusEnum::SUCCESS);
 
   return Status::OK;
 }
 
-  
+
+Status QueryServiceImpl::QueryOnlineStream(
+    ServerContext *context,
+    const QueryOnlineRequest *request,
+    ServerWriter<QueryOnlineProgress> *writer) {
+  InflightScope inflight(&online_inflight_, nullptr);
+  QueryOnlineProgress result;
+
+  if (request->model_size() == 0) {
+    result.mutable_status()->set_status(InfaasRequestStatusEnum::INVALID);
+    result.mutable_status()->set_msg("No model specified");
+    writer->Write(result);
+    return Status(grpc::StatusCode::INVALID_ARGUMENT, "No model specified");
+  }
+  const std::string& model_name = request->model(0);
+
+  ModelSpec spec;
+  if (getModelSpec(model_name, &spec) != 0) {
+    result.mutable_status()->set_status(InfaasRequestStatusEnum::INVALID);
+    result.mutable_status()->set_msg("Model execution failed");
+    writer->Write(result);
+    return Status::OK;
+  }
+
+  std::string cache_key;
+  if (result_cache_ != nullptr) {
+    cache_key = result_cache_key(spec, *request);
+  }
+  std::vector<std::string> outputs;
+  if (!cache_key.empty() && result_cache_->Lookup(cache_key, &outputs)) {
+    for (std::string& out : outputs) {
+      result.add_raw_output()->swap(out);
+    }
+    result.mutable_status()->set_status(InfaasRequestStatusEnum::SUCCESS);
+    writer->Write(result);
+    return Status::OK;
+  }
+
+  std::vector<BufferView> inputs;
+  inputs.reserve(request->raw_input_size());
+  for (const auto& s : request->raw_input()) {
+    inputs.push_back({s.data(), s.size()});
+  }
+
+  // The model process calls back on this thread, so the writer is never
+  // used concurrently
+  const InternalDiffusionQuery& params = request->diffusion();
+  infaas::internal::PreviewRequest preview;
+  preview.every = std::max(0, params.previewevery());
+  preview.max_size = std::max(0, params.previewsize());
+  auto on_progress = [&](const infaas::internal::ModelProgress& p) {
+    if (context->IsCancelled()) { return false; }
+    QueryOnlineProgress msg;
+    msg.set_step(p.step);
+    msg.set_total_steps(p.total_steps);
+    msg.set_index(p.index);
+    if (!p.preview.empty()) { msg.set_preview(p.preview); }
+    return writer->Write(msg);
+  };
+
+  const int timeout_ms = (int)std::min<int64_t>(
+      request->slo().latencyinusec(), std::numeric_limits<int>::max());
+  int rc = ExecuteModelStreaming(spec, inputs, &outputs, preview,
+                                 on_progress, timeout_ms,
+                                 input_params(*request));
+  if (context->IsCancelled()) {
+    return Status(grpc::StatusCode::CANCELLED, "Cancelled by the client");
+  }
+  if (rc == 0) {
+    rc = encoder_->Encode(params.format(), params.quality(), &outputs);
+  }
+  if (rc != 0) {
+    result.mutable_status()->set_status(InfaasRequestStatusEnum::INVALID);
+    result.mutable_status()->set_msg("Model execution failed");
+    writer->Write(result);
+    return Status(grpc::StatusCode::INTERNAL, "Model execution failed");
+  }
+
+  if (!cache_key.empty()) { result_cache_->Insert(cache_key, outputs); }
+  for (std::string& out : outputs) {
+    result.add_raw_output()->swap(out);
+  }
+  result.mutable_status()->set_status(InfaasRequestStatusEnum::SUCCESS);
+  writer->Write(result);
+  return Status::OK;
+}
+
 Status QueryServiceImpl::QueryOffline(ServerContext *context,
                                       const QueryOfflineRequest *request,
                                       QueryOfflineResponse *reply) {
@@ -650,11 +874,11 @@ Status QueryServiceImpl::QueryOffline(ServerContext *context,
 void QueryServiceImpl::offlineProccess() {
   // Set nice value = 10 to be a lower priority.
   int curr_nice = nice(10);
-  std::cout << "Set offlineProcess thread nice = " << curr_nice << std::endl;
+  INFAAS_LOG(INFO) << "Set offlineProcess thread nice = " << curr_nice;
 
   uint64_t time1, time2;
   QueryOfflineRequest request;
-  std::cout << "Offline Process thread is ready " << std::endl;
+  INFAAS_LOG(INFO) << "Offline Process thread is ready ";
   int sleep_interval = 1000; // Sleep 1 sec.
   bool has_job = false;
   while (monitoring_run_) {
@@ -692,22 +916,53 @@ void QueryServiceImpl::offlineProccess() {
 
     time2 = get_curr_timestamp();
     double interval = get_duration_ms(time1, time2);
-    std::cout << "Process current offline query: " << interval << " ms."
+    INFAAS_LOG(INFO) << "Process current offline query: " << interval << " ms.";
+  }
+
+  INFAAS_LOG(INFO) << "Offline Processing thread shut off!";
+}
+
+int QueryServiceImpl::getMaxBatch(const std::string& model_name) {
+  {
+    std::lock_guard<std::mutex> lock(max_batch_mutex_);
+    auto it = model_max_batch_.find(model_name);
+    if (it != model_max_batch_.end()) { return it->second; }
+  }
+  int max_batch = 1;
+  std::string mb = redis_metadata_->get_model_info(model_name, "max_batch");
+  try {
+    max_batch = std::max(1, std::stoi(mb));
+  } catch (const std::exception& e) {
+    std::cerr << "No max_batch for " << model_name << "; not batching"
               << std::endl;
   }
+  std::lock_guard<std::mutex> lock(max_batch_mutex_);
+  model_max_batch_[model_name] = max_batch;
+  return max_batch;
+}
 
-  std::cout << "Offline Processing thread shut off!" << std::endl;
+int8_t QueryServiceImpl::getModelSpec(const std::string& model_name,
+                                      ModelSpec* spec) {
+  spec->model_name = model_name;
+  if (rm_->get_model_exec_info(model_name, &spec->framework, &spec->task,
+                               &spec->exec_path, &spec->entry_point,
+                               &spec->env_path, &spec->exec_protocol,
+                               &spec->version) != 0) {
+    return -1;
+  }
+  return 0;
 }
 
 void QueryServiceImpl::qpsMonitor() {
   // Log to the file "INFaaS/worker/qps_daemon.log"
-  std::ofstream logfile;
-  logfile.open(infaas_log_dir + "/worker/qps_daemon.log");
+  infaas::internal::LogStream logfile(
+      infaas_log_dir + "/worker/qps_daemon.log");
 
   // For experiment.
   std::ofstream explog;
   explog.open(infaas_log_dir + "/worker/infaas_exp_qps.log");
-  explog << "TimeStampInUsec, ModvarName, CurrQPS, NumReplicas" << std::endl;
+  // A data file rather than a log: buffered, and never filtered by level.
+  explog << "TimeStampInUsec, ModvarName, CurrQPS, NumReplicas" << "\n";
 
   // Set nice value = 10 to be a lower priority.
   int curr_nice = nice(10);
@@ -726,10 +981,24 @@ void QueryServiceImpl::qpsMonitor() {
       model_last_lat_; // the sum of latencies we've seen last time.
   std::map<std::string, uint64_t>
       model_last_slo_; // the sum of slo-latencies we've seen last time.
+  std::map<std::string, BatchScheduler::Stats>
+      model_last_exec_; // the executed batches we've seen last time.
+  ImageEncoder::Stats last_encode = encoder_->GetStats();
   while (monitoring_run_) {
     curr_time = get_curr_timestamp();
     logfile << "Logging QPS at timestamp: " << std::fixed << curr_time
             << std::endl;
+    ImageEncoder::Stats encode = encoder_->GetStats();
+    if (encode.images > last_encode.images) {
+      logfile << "Encoded images: " << encode.images - last_encode.images
+              << " ; raw bytes: " << encode.raw_bytes - last_encode.raw_bytes
+              << " ; encoded bytes: "
+              << encode.encoded_bytes - last_encode.encoded_bytes
+              << " ; encode CPU: "
+              << (encode.encode_us - last_encode.encode_us) / 1000.0
+              << "msec" << std::endl;
+    }
+    last_encode = encode;
     double interval = get_duration_ms(prev_time, curr_time);
     // Skip the very first interval
     if (interval >= sleep_interval) {
@@ -737,6 +1006,8 @@ void QueryServiceImpl::qpsMonitor() {
       std::vector<std::string> running_parents =
           redis_metadata_->get_parent_models_on_executor(worker_name_);
       bool has_blacklisted = false;
+      // Per-model QPS and avglat of this interval, flushed in one batch.
+      std::vector<ModelStats> model_stats;
       for (auto &parent_name : running_parents) {
         logfile << "Parent: " << parent_name << std::endl;
         std::vector<std::string> running_modvars =
@@ -813,6 +1084,16 @@ void QueryServiceImpl::qpsMonitor() {
           model_last_lat_[model_name] = curr_lat_cnt;
           model_last_slo_[model_name] = curr_slo_cnt;
           Autoscaler::setAvgBatch(model_name, curr_avg_batch);
+          // Batches the worker actually executed, and who is still queued.
+          BatchScheduler::Stats exec_stats = batcher_->GetStats(model_name);
+          BatchScheduler::Stats& last_exec = model_last_exec_[model_name];
+          double curr_exec_batch = 0;
+          if (exec_stats.batches > last_exec.batches) {
+            curr_exec_batch =
+                (exec_stats.batched_inputs - last_exec.batched_inputs) /
+                (double)(exec_stats.batches - last_exec.batches);
+          }
+          last_exec = exec_stats;
           logfile << "[Interval = " << interval << " ] ";
           logfile << "Model: " << model_name << " ; total count: " << curr_cnt
                   << " ; current QPS: " << curr_qps
@@ -820,30 +1101,21 @@ void QueryServiceImpl::qpsMonitor() {
                   << "; completed reqs: " << curr_comp_cnt
                   << "; avg latency: " << curr_avg_lat << "msec; curr_avg_slo "
                   << curr_avg_slo << "msec; current replicas: " << num_replicas
-                  << std::endl;
+                  << "; executed batch size: " << curr_exec_batch
+                  << "; queue depth: " << exec_stats.queue_depth << std::endl;
           // Log for experiment
           explog << curr_time << ", " << model_name << ", "
                  << curr_qps * (double)num_replicas << ", " << num_replicas
-                 << std::endl;
+                 << "\n";
           // NOTE: we used to have a race condition here: we log the QPS
           // for 1 replica, but the autoscaler reads QPS and multiply by 2
           // because the model just got loaded. Then we will read double the
           // QPS and hence inaccurate. We should directly log the actual QPS
           // here.
-          auto rs = redis_metadata_->update_model_qps(
-              worker_name_, model_name, curr_qps * (double)num_replicas);
-          if (rs < 0) {
-            logfile << "[qpsMonitor]Failed to update qps for model: "
-                    << model_name << ". Status: " << int(rs) << std::endl;
-          }
           // TODO: we may not need to update model avglat since the master
           // doesn't need it anymore. But let's leave it here right now.
-          rs = redis_metadata_->update_model_avglat(worker_name_, model_name,
-                                                    curr_avg_lat);
-          if (rs < 0) {
-            logfile << "[qpsMonitor]Failed to update avglat for model: "
-                    << model_name << ". Status: " << int(rs) << std::endl;
-          }
+          model_stats.push_back(
+              {model_name, curr_qps * (double)num_replicas, curr_avg_lat});
 
           // If the current model latency is 3x longer than the recorded one,
           // and the qps is 1.5x higher than the theoretical qps (avoid
@@ -891,8 +1163,8 @@ void QueryServiceImpl::qpsMonitor() {
                (curr_qps > blist_qps_heuristic * 1000.0 / inf_lat)) ||
               (curr_cnt - curr_comp_cnt >
                blist_queue_heuristic * num_replicas * 1000.0 / inf_lat)) {
-            rs = redis_metadata_->set_model_avglat_blacklist(worker_name_,
-                                                             model_name);
+            int8_t rs = redis_metadata_->set_model_avglat_blacklist(
+                worker_name_, model_name);
             if (rs < 0) {
               logfile << "[qpsMonitor] Failed to set blacklist for model: "
                       << model_name << std::endl;
@@ -904,8 +1176,8 @@ void QueryServiceImpl::qpsMonitor() {
                                                        inf_lat) &&
                      curr_avg_lat < inf_lat * blist_lat_unset_heuristic) {
             // The first term makes sure requests will not queue up.
-            rs = redis_metadata_->unset_model_avglat_blacklist(worker_name_,
-                                                               model_name);
+            int8_t rs = redis_metadata_->unset_model_avglat_blacklist(
+                worker_name_, model_name);
             if (rs < 0) {
               logfile << "[qpsMonitor] Failed to unset blacklist for model: "
                       << model_name << std::endl;
@@ -952,6 +1224,18 @@ void QueryServiceImpl::qpsMonitor() {
         }
         logfile << "\n" << std::endl;
       }
+      // Push all QPS and avglat updates in a single round trip.
+      if (!model_stats.empty()) {
+        auto rs = redis_metadata_->update_model_stats_batch(worker_name_,
+                                                            model_stats);
+        if (rs < 0) {
+          logfile << "[qpsMonitor]Failed to update qps/avglat for "
+                  << model_stats.size() << " models" << std::endl;
+        } else {
+          // Let the autoscaler react to the new load right away
+          Autoscaler::notifyStatsUpdated();
+        }
+      }
       // Set blacklisted to true/false after testing all parent models.
       // Cannot run offline if even there is one model got blacklisted.
       CommonModelUtil::SetBlacklisted(has_blacklisted);
@@ -960,13 +1244,12 @@ void QueryServiceImpl::qpsMonitor() {
     std::this_thread::sleep_for(std::chrono::milliseconds(sleep_interval));
   }
   logfile << "qpsMonitor shut down!" << std::endl;
-  logfile.close();
 }
 
 void QueryServiceImpl::resourceMonitor() {
   // Log to the file "INFaaS/worker/resource_daemon.log"
-  std::ofstream logfile;
-  logfile.open(infaas_log_dir + "/worker/resource_daemon.log");
+  infaas::internal::LogStream logfile(
+      infaas_log_dir + "/worker/resource_daemon.log");
 
   // Set nice value = 10 to be a lower priority.
   int curr_nice = nice(10);
@@ -1029,17 +1312,17 @@ void QueryServiceImpl::resourceMonitor() {
     std::this_thread::sleep_for(std::chrono::milliseconds(sleep_interval));
   }
   logfile << "resourceMonitor shut down!" << std::endl;
-  logfile.close();
 }
 
 } // namespace internal
 } // namespace infaas
 
 void RunExecutor(const std::string &worker_name, struct Address redis_addr,
-                 infaas::internal::AutoscalerType autoscaler_type) {
+                 infaas::internal::AutoscalerType autoscaler_type,
+                 const uint64_t result_cache_mb) {
   std::string server_address(query_exe_addr);
   infaas::internal::QueryServiceImpl service(worker_name, redis_addr,
-                                             autoscaler_type);
+                                             autoscaler_type, result_cache_mb);
 
   ServerBuilder builder;
   // Listen on the given address without any authentication mechanism.
@@ -1063,8 +1346,13 @@ void RunExecutor(const std::string &worker_name, struct Address redis_addr,
 int main(int argc, char **argv) {
   if (argc < 4) {
     std::cerr << "Usage: ./query_executor <worker_name> <redis_ip> "
-                 "<redis_port> [<autoscaler_type>]"
+                 "<redis_port> [<autoscaler_type>] [<procs_per_model>] "
+                 "[<result_cache_mb>]"
               << "autoscaler type: 0=NONE, 1=STATIC, 2=INDIVIDUAL, 3=INFaaS"
+              << "; procs_per_model: warm model processes per model "
+                 "(default 1)"
+              << "; result_cache_mb: disk budget of the result cache "
+                 "(default " << default_result_cache_mb << ", 0 = off)"
               << std::endl;
     exit(1);
   }
@@ -1100,8 +1388,23 @@ int main(int argc, char **argv) {
     }
   }
   std::cout << "Autoscaler type: " << autoscaler_type << std::endl;
+  if (argc > 5) {
+    int procs_per_model = std::stoi(argv[5]);
+    if (procs_per_model < 1) {
+      std::cerr << "Invalid procs_per_model: " << procs_per_model << std::endl;
+      exit(1);
+    }
+    ConfigureModelProcessPool(procs_per_model);
+    std::cout << "Warm processes per model: " << procs_per_model << std::endl;
+  }
+  uint64_t result_cache_mb = default_result_cache_mb;
+  if (argc > 6) {
+    result_cache_mb = std::stoull(argv[6]);
+    std::cout << "Result cache budget: " << result_cache_mb << " MB"
+              << std::endl;
+  }
   // Start the main executor deamon.
-  RunExecutor(worker_name, redis_addr, autoscaler_type);
+  RunExecutor(worker_name, redis_addr, autoscaler_type, result_cache_mb);
 
   return 0;
 }
@@ -0,0 +1,410 @@
+#include "worker/result_cache.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+
+#include "common/async_log.h"
+#include "worker/shm_transport.h"
+
+namespace infaas {
+namespace internal {
+
+namespace {
+
+// Every entry in a segment is an EntryHeader, the key, then the outputs
+// packed like a shared-memory region (shm_transport.h), padded to 8 bytes.
+// The magic is written last, so a torn entry is never read back.
+struct EntryHeader {
+  uint32_t magic;
+  uint32_t key_len;
+  uint64_t value_len;
+  uint64_t hash;
+};
+
+static const uint32_t entry_magic = 0x44494645;  // "DIFE"
+static const char* segment_prefix = "seg-";
+// Log the counters every this many lookups
+static const uint64_t stats_log_interval = 1000;
+
+uint64_t Align8(const uint64_t n) { return (n + 7) & ~7ULL; }
+
+uint64_t HashKey(const std::string& key) {
+  return std::hash<std::string>()(key);
+}
+
+// mkdir -p
+bool MakeDirs(const std::string& dir) {
+  for (size_t pos = dir.find('/', 1); ; pos = dir.find('/', pos + 1)) {
+    const std::string part = dir.substr(0, pos);
+    if ((mkdir(part.c_str(), 0755) != 0) && (errno != EEXIST)) {
+      return false;
+    }
+    if (pos == std::string::npos) { return true; }
+  }
+}
+
+size_t NextPow2(size_t n) {
+  size_t p = 1;
+  while (p < n) { p <<= 1; }
+  return p;
+}
+
+}  // namespace
+
+/*********************** FrequencySketch ***********************/
+
+FrequencySketch::FrequencySketch(const size_t width)
+    : mask_(NextPow2(std::max<size_t>(width, 64)) - 1),
+      additions_(0),
+      sample_size_(10 * (mask_ + 1)) {
+  counters_.assign(depth * (mask_ + 1), 0);
+}
+
+size_t FrequencySketch::Slot(const uint64_t hash, const int row) const {
+  // Derive one index per row from the 64-bit hash (double hashing)
+  const uint64_t h = (hash >> 32) + (uint64_t)row * (hash | 1);
+  return row * (mask_ + 1) + (h & mask_);
+}
+
+void FrequencySketch::Increment(const uint64_t hash) {
+  bool added = false;
+  for (int r = 0; r < depth; ++r) {
+    uint8_t& c = counters_[Slot(hash, r)];
+    if (c < max_count) {
+      c++;
+      added = true;
+    }
+  }
+  if (added && (++additions_ >= sample_size_)) { Age(); }
+}
+
+uint8_t FrequencySketch::Estimate(const uint64_t hash) const {
+  uint8_t est = max_count;
+  for (int r = 0; r < depth; ++r) {
+    est = std::min(est, counters_[Slot(hash, r)]);
+  }
+  return est;
+}
+
+void FrequencySketch::Age() {
+  for (uint8_t& c : counters_) { c >>= 1; }
+  additions_ /= 2;
+}
+
+/*********************** ResultCache ***********************/
+
+ResultCache::Segment::~Segment() {
+  if (base != nullptr) { munmap(base, size); }
+  if (evicted) { unlink(path.c_str()); }
+}
+
+ResultCache::ResultCache(const std::string& dir, const uint64_t max_bytes,
+                         const uint64_t segment_bytes)
+    : dir_(dir),
+      segment_bytes_(segment_bytes),
+      max_segments_(std::max<uint64_t>(2, max_bytes / segment_bytes)),
+      enabled_(false),
+      // Roughly one counter per entry the store can hold at 256 KB each
+      sketch_(max_segments_ * (segment_bytes / (256 << 10))),
+      next_seq_(0),
+      live_bytes_(0),
+      hits_(0),
+      misses_(0),
+      admitted_(0),
+      rejected_(0),
+      evicted_(0) {
+  if (!MakeDirs(dir_)) {
+    INFAAS_LOG(ERROR) << "[Result Cache]: Cannot create " << dir_
+                      << "; cache disabled";
+    return;
+  }
+
+  // Pick up the segments of a previous run, oldest first
+  std::vector<uint64_t> seqs;
+  DIR* d = opendir(dir_.c_str());
+  if (d == nullptr) {
+    INFAAS_LOG(ERROR) << "[Result Cache]: Cannot open " << dir_
+                      << "; cache disabled";
+    return;
+  }
+  while (struct dirent* ent = readdir(d)) {
+    const std::string name = ent->d_name;
+    if (name.compare(0, strlen(segment_prefix), segment_prefix) == 0) {
+      seqs.push_back(strtoull(name.c_str() + strlen(segment_prefix),
+                              nullptr, 10));
+    }
+  }
+  closedir(d);
+  std::sort(seqs.begin(), seqs.end());
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (uint64_t seq : seqs) {
+    std::shared_ptr<Segment> seg = OpenSegment(seq, false);
+    next_seq_ = seq + 1;
+    if (seg == nullptr) { continue; }
+    segments_.push_back(seg);
+    Recover(seg);
+    if (segments_.size() > max_segments_) { EvictOldest(); }
+  }
+
+  enabled_ = true;
+  INFAAS_LOG(INFO) << "[Result Cache]: " << index_.size()
+                   << " entries recovered from " << dir_ << ", budget "
+                   << max_segments_ << " x " << (segment_bytes_ >> 20)
+                   << " MB";
+}
+
+ResultCache::~ResultCache() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  index_.clear();
+  segments_.clear();
+}
+
+bool ResultCache::Lookup(const std::string& key,
+                         std::vector<std::string>* outputs) {
+  if (!enabled_) { return false; }
+  const uint64_t hash = HashKey(key);
+
+  Location loc;
+  bool found;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sketch_.Increment(hash);
+    auto it = index_.find(hash);
+    found = (it != index_.end());
+    if (found) { loc = it->second; }
+  }
+
+  // The segment stays mapped while loc holds it, even if it is evicted now.
+  // Another key with the same hash is a miss.
+  const bool hit = found && Matches(loc, key);
+  if (hit) {
+    const char* value =
+        loc.segment->base + loc.offset + sizeof(EntryHeader) + loc.key_len;
+    RegionHeader rh;
+    memcpy(&rh, value, sizeof(rh));
+    // The key length is arbitrary, so the sizes may be unaligned
+    const char* sizes = value + sizeof(RegionHeader);
+    const char* payload = sizes + rh.count * sizeof(uint64_t);
+    outputs->clear();
+    outputs->reserve(rh.count);
+    for (uint32_t i = 0; i < rh.count; ++i) {
+      uint64_t size;
+      memcpy(&size, sizes + i * sizeof(size), sizeof(size));
+      outputs->emplace_back(payload, size);
+      payload += size;
+    }
+    hits_++;
+  } else {
+    misses_++;
+  }
+  MaybeLogStats();
+  return hit;
+}
+
+bool ResultCache::Insert(const std::string& key,
+                         const std::vector<std::string>& outputs) {
+  if (!enabled_) { return false; }
+  const uint64_t hash = HashKey(key);
+
+  std::vector<BufferView> views;
+  views.reserve(outputs.size());
+  for (const std::string& out : outputs) {
+    views.push_back({out.data(), out.size()});
+  }
+  const uint64_t value_len = PackedSize(views);
+  const uint64_t entry_len =
+      Align8(sizeof(EntryHeader) + key.size() + value_len);
+
+  std::shared_ptr<Segment> seg;
+  uint64_t offset;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(hash);
+    if ((it != index_.end()) && Matches(it->second, key)) {
+      return true;  // Someone else stored it
+    }
+    if (entry_len > (segment_bytes_ / 4)) {
+      rejected_++;
+      return false;
+    }
+
+    // Once full, every entry takes the place of older ones
+    const bool full = (segments_.size() >= max_segments_);
+    if (full && !Admit(hash)) {
+      rejected_++;
+      return false;
+    }
+    if (segments_.empty() ||
+        (segments_.back()->tail + entry_len > segments_.back()->size)) {
+      if (full) { EvictOldest(); }
+      std::shared_ptr<Segment> fresh = OpenSegment(next_seq_++, true);
+      if (fresh == nullptr) { return false; }
+      segments_.push_back(fresh);
+    }
+
+    seg = segments_.back();
+    offset = seg->tail;
+    seg->tail += entry_len;
+  }
+
+  // Fill the reserved space without holding the lock
+  char* entry = seg->base + offset;
+  EntryHeader hdr = {0, (uint32_t)key.size(), value_len, hash};
+  memcpy(entry + sizeof(EntryHeader), key.data(), key.size());
+  char* value = entry + sizeof(EntryHeader) + key.size();
+  RegionHeader rh = {region_magic, (uint32_t)outputs.size()};
+  memcpy(value, &rh, sizeof(rh));
+  char* sizes = value + sizeof(RegionHeader);
+  char* payload = sizes + outputs.size() * sizeof(uint64_t);
+  for (const std::string& out : outputs) {
+    const uint64_t size = out.size();
+    memcpy(sizes, &size, sizeof(size));
+    sizes += sizeof(size);
+    memcpy(payload, out.data(), size);
+    payload += size;
+  }
+  memcpy(entry, &hdr, sizeof(hdr));
+  __atomic_store_n(reinterpret_cast<uint32_t*>(entry), entry_magic,
+                   __ATOMIC_RELEASE);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (seg->evicted) { return false; }  // Pushed out while we were copying
+  IndexEntry(hash, {seg, offset, (uint32_t)key.size(), value_len});
+  admitted_++;
+  return true;
+}
+
+ResultCache::Stats ResultCache::GetStats() {
+  Stats s;
+  s.hits = hits_;
+  s.misses = misses_;
+  s.admitted = admitted_;
+  s.rejected = rejected_;
+  s.evicted = evicted_;
+  std::lock_guard<std::mutex> lock(mutex_);
+  s.entries = index_.size();
+  s.bytes = live_bytes_;
+  return s;
+}
+
+/*********************** Private Functions ***********************/
+
+uint64_t ResultCache::EntryLen(const Location& loc) {
+  return Align8(sizeof(EntryHeader) + loc.key_len + loc.value_len);
+}
+
+bool ResultCache::Matches(const Location& loc, const std::string& key) {
+  return (loc.key_len == key.size()) &&
+         (memcmp(loc.segment->base + loc.offset + sizeof(EntryHeader),
+                 key.data(), key.size()) == 0);
+}
+
+void ResultCache::IndexEntry(const uint64_t hash, const Location& loc) {
+  auto it = index_.find(hash);
+  if (it != index_.end()) {
+    live_bytes_ -= EntryLen(it->second);
+    it->second = loc;
+  } else {
+    index_.emplace(hash, loc);
+  }
+  loc.segment->hashes.push_back(hash);
+  live_bytes_ += EntryLen(loc);
+}
+
+std::shared_ptr<ResultCache::Segment> ResultCache::OpenSegment(
+    const uint64_t seq, const bool create) {
+  std::shared_ptr<Segment> seg = std::make_shared<Segment>();
+  seg->seq = seq;
+  seg->path = dir_ + "/" + segment_prefix + std::to_string(seq);
+  seg->size = segment_bytes_;
+
+  int fd = open(seg->path.c_str(), O_RDWR | (create ? O_CREAT | O_TRUNC : 0),
+                0644);
+  if (fd < 0) {
+    INFAAS_LOG(WARN) << "[Result Cache]: Cannot open " << seg->path;
+    return nullptr;
+  }
+  // Sparse file: disk space is only used as entries are written
+  if (ftruncate(fd, seg->size) != 0) {
+    close(fd);
+    INFAAS_LOG(WARN) << "[Result Cache]: Cannot size " << seg->path;
+    return nullptr;
+  }
+  void* base =
+      mmap(nullptr, seg->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    INFAAS_LOG(WARN) << "[Result Cache]: Cannot map " << seg->path;
+    return nullptr;
+  }
+  seg->base = static_cast<char*>(base);
+  return seg;
+}
+
+void ResultCache::Recover(const std::shared_ptr<Segment>& seg) {
+  uint64_t offset = 0;
+  while (offset + sizeof(EntryHeader) <= seg->size) {
+    EntryHeader hdr;
+    memcpy(&hdr, seg->base + offset, sizeof(hdr));
+    const uint64_t entry_len =
+        Align8(sizeof(EntryHeader) + hdr.key_len + hdr.value_len);
+    if ((hdr.magic != entry_magic) || (offset + entry_len > seg->size)) {
+      break;
+    }
+    IndexEntry(hdr.hash, {seg, offset, hdr.key_len, hdr.value_len});
+    offset += entry_len;
+  }
+  // New entries go after the last good one, overwriting any torn tail
+  seg->tail = offset;
+}
+
+bool ResultCache::Admit(const uint64_t hash) {
+  const std::shared_ptr<Segment>& victim = segments_.front();
+  uint64_t total = 0;
+  uint64_t live = 0;
+  for (uint64_t h : victim->hashes) {
+    auto it = index_.find(h);
+    if ((it == index_.end()) || (it->second.segment != victim)) { continue; }
+    total += sketch_.Estimate(h);
+    live++;
+  }
+  if (live == 0) { return true; }
+  // Admit only keys asked for more often than what they would push out
+  return sketch_.Estimate(hash) * live > total;
+}
+
+void ResultCache::EvictOldest() {
+  std::shared_ptr<Segment> victim = segments_.front();
+  segments_.pop_front();
+  for (uint64_t h : victim->hashes) {
+    auto it = index_.find(h);
+    if ((it == index_.end()) || (it->second.segment != victim)) { continue; }
+    live_bytes_ -= EntryLen(it->second);
+    index_.erase(it);
+    evicted_++;
+  }
+  // The file goes away once the last reader lets go of the mapping
+  victim->evicted = true;
+}
+
+void ResultCache::MaybeLogStats() {
+  const uint64_t lookups = hits_ + misses_;
+  if ((lookups % stats_log_interval) != 0) { return; }
+  Stats s = GetStats();
+  INFAAS_LOG(INFO) << "[Result Cache]: hits=" << s.hits
+                   << " misses=" << s.misses << " admitted=" << s.admitted
+                   << " rejected=" << s.rejected << " evicted=" << s.evicted
+                   << " entries=" << s.entries << " bytes=" << s.bytes;
+}
+
+}  // namespace internal
+}  // namespace infaas
@@ -0,0 +1,152 @@
+#pragma once
+
+#ifndef INFAAS_RESULT_CACHE_H_
+#define INFAAS_RESULT_CACHE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace infaas {
+namespace internal {
+
+/**
+ * Approximate per-key request counts for TinyLFU admission: a count-min
+ * sketch of small saturating counters. All counters are halved once enough
+ * increments have been recorded, so old popularity fades.
+ */
+class FrequencySketch {
+public:
+  // width = counters per row (rounded up to a power of two)
+  explicit FrequencySketch(const size_t width);
+
+  void Increment(const uint64_t hash);
+  uint8_t Estimate(const uint64_t hash) const;
+
+private:
+  static const int depth = 4;
+  static const uint8_t max_count = 15;
+
+  size_t Slot(const uint64_t hash, const int row) const;
+  void Age();
+
+  std::vector<uint8_t> counters_;
+  size_t mask_;
+  size_t additions_;
+  size_t sample_size_;
+};
+
+/**
+ * Worker-local cache of query outputs, keyed by the full content of the
+ * request, so a repeated deterministic query is answered from memory.
+ *
+ * Entries are appended to fixed-size segment files under dir, which are
+ * mmap'd; an in-memory index maps the hash of a key to its entry, and the
+ * full key stored with the entry is compared before it is used, so two keys
+ * with the same hash never share outputs (the later one replaces the
+ * earlier). The store holds at most max_bytes of segments: when the newest
+ * segment is full, the oldest one is dropped together with its entries.
+ * Once the store is full, every insert is only admitted if the frequency
+ * sketch says its key is asked for more often than the entries of the
+ * oldest segment, which it will help push out (TinyLFU). Entries larger
+ * than a quarter of a segment are never admitted.
+ *
+ * Segments left by a previous run are indexed again on startup. All methods
+ * are thread-safe.
+ */
+class ResultCache {
+public:
+  struct Stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t admitted;
+    uint64_t rejected;
+    uint64_t evicted;  // Entries dropped with their segment
+    uint64_t entries;
+    uint64_t bytes;    // Bytes used by live entries
+  };
+
+  ResultCache(const std::string& dir, const uint64_t max_bytes,
+              const uint64_t segment_bytes = 64ULL << 20);
+  ~ResultCache();
+
+  // False if the cache directory could not be used; every lookup then misses
+  bool enabled() const { return enabled_; }
+
+  /**
+   * Looks up the outputs stored for key.
+   *
+   * @return true on a hit (outputs is replaced), false on a miss.
+   */
+  bool Lookup(const std::string& key, std::vector<std::string>* outputs);
+
+  /**
+   * Offers the outputs of key to the cache.
+   *
+   * @return true if they were stored, false if admission turned them down.
+   */
+  bool Insert(const std::string& key, const std::vector<std::string>& outputs);
+
+  Stats GetStats();
+
+private:
+  struct Segment {
+    uint64_t seq;
+    std::string path;
+    char* base = nullptr;
+    uint64_t size = 0;
+    uint64_t tail = 0;  // First unreserved byte
+    std::vector<uint64_t> hashes;  // Keys whose entries were put here
+    bool evicted = false;
+    ~Segment();
+  };
+
+  struct Location {
+    std::shared_ptr<Segment> segment;
+    uint64_t offset;
+    uint32_t key_len;
+    uint64_t value_len;
+  };
+
+  static uint64_t EntryLen(const Location& loc);
+  // Whether the entry at loc holds key
+  static bool Matches(const Location& loc, const std::string& key);
+
+  std::shared_ptr<Segment> OpenSegment(const uint64_t seq, const bool create);
+  // Points hash at a new entry, replacing (and uncounting) any older one
+  void IndexEntry(const uint64_t hash, const Location& loc);
+  // Rebuilds the index from the entries of a segment left by a previous run
+  void Recover(const std::shared_ptr<Segment>& segment);
+  // TinyLFU: should key (hash) replace the oldest segment's entries?
+  bool Admit(const uint64_t hash);
+  void EvictOldest();
+  void MaybeLogStats();
+
+  const std::string dir_;
+  const uint64_t segment_bytes_;
+  const size_t max_segments_;
+  bool enabled_;
+
+  std::mutex mutex_;  // Guards everything below except the counters
+  std::deque<std::shared_ptr<Segment>> segments_;  // Oldest first
+  std::unordered_map<uint64_t, Location> index_;
+  FrequencySketch sketch_;
+  uint64_t next_seq_;
+  uint64_t live_bytes_;
+
+  std::atomic<uint64_t> hits_;
+  std::atomic<uint64_t> misses_;
+  std::atomic<uint64_t> admitted_;
+  std::atomic<uint64_t> rejected_;
+  std::atomic<uint64_t> evicted_;
+};
+
+}  // namespace internal
+}  // namespace infaas
+
+#endif  // INFAAS_RESULT_CACHE_H_
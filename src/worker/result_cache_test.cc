@@ -0,0 +1,215 @@
+// Tests of ResultCache on a scratch directory: hits and misses, TinyLFU
+// admission once the store is full, the full-key check behind the hash
+// index, and reloading the segments of a previous run.
+//
+// Usage: result_cache_test
+
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "worker/result_cache.h"
+#include "worker/shm_transport.h"
+
+#define FAIL(x) printf("[FAIL]: %s\n", x)
+#define PASS(x) printf("[PASS]: %s\n", x)
+
+using infaas::internal::RegionHeader;
+using infaas::internal::ResultCache;
+using infaas::internal::region_magic;
+
+namespace {
+
+// Two segments of 4 KB; entries of about 950 bytes, four to a segment
+const uint64_t segment_bytes = 4096;
+const uint64_t max_bytes = 2 * segment_bytes;
+const std::string payload(900, 'x');
+
+// An entry as result_cache.cc lays it out in a segment
+struct EntryHeader {
+  uint32_t magic;
+  uint32_t key_len;
+  uint64_t value_len;
+  uint64_t hash;
+};
+const uint32_t entry_magic = 0x44494645;
+
+// Appends an entry for key, filed under hash, with one output
+void AppendEntry(std::string* segment, const std::string& key,
+                 const uint64_t hash, const std::string& output,
+                 const uint32_t magic = entry_magic) {
+  RegionHeader rh = {region_magic, 1};
+  const uint64_t size = output.size();
+  std::string value((const char*)&rh, sizeof(rh));
+  value.append((const char*)&size, sizeof(size));
+  value += output;
+  EntryHeader hdr = {magic, (uint32_t)key.size(), value.size(), hash};
+  std::string entry((const char*)&hdr, sizeof(hdr));
+  entry += key + value;
+  entry.resize((entry.size() + 7) & ~7ULL, '\0');
+  *segment += entry;
+}
+
+bool Hit(ResultCache* cache, const std::string& key,
+         const std::string& expected) {
+  std::vector<std::string> outputs;
+  return cache->Lookup(key, &outputs) && (outputs.size() == 1) &&
+         (outputs[0] == expected);
+}
+
+bool Miss(ResultCache* cache, const std::string& key) {
+  std::vector<std::string> outputs;
+  return !cache->Lookup(key, &outputs);
+}
+
+std::string MakeDir() {
+  char tmpl[] = "/tmp/result_cache_test.XXXXXX";
+  return (mkdtemp(tmpl) != nullptr) ? std::string(tmpl) : std::string();
+}
+
+void RemoveDir(const std::string& dir) {
+  const std::string cmd = "rm -rf '" + dir + "'";
+  if (system(cmd.c_str()) != 0) { printf("Could not remove %s\n", dir.c_str()); }
+}
+
+}  // namespace
+
+int main() {
+  const std::string dir = MakeDir();
+  if (dir.empty()) {
+    FAIL("Scratch directory");
+    return 1;
+  }
+
+  {
+    ResultCache cache(dir + "/store", max_bytes, segment_bytes);
+    if (!cache.enabled()) {
+      FAIL("Cache enabled");
+      return 1;
+    }
+
+    // Outputs come back as stored, several per entry included
+    const std::vector<std::string> multi = {"first", "", "third"};
+    std::vector<std::string> outputs;
+    if (cache.Lookup("multi", &outputs) || !cache.Insert("multi", multi) ||
+        !cache.Lookup("multi", &outputs) || (outputs != multi)) {
+      FAIL("Insert and lookup");
+      return 1;
+    }
+    if (!Miss(&cache, "mult") || !Miss(&cache, "multi2")) {
+      FAIL("Other keys miss");
+      return 1;
+    }
+    PASS("Insert and lookup");
+
+    // Entries over a quarter of a segment are never stored
+    if (cache.Insert("huge", {std::string(segment_bytes / 2, 'h')}) ||
+        !Miss(&cache, "huge")) {
+      FAIL("Oversized entry rejected");
+      return 1;
+    }
+    PASS("Oversized entry rejected");
+
+    // Fill the first segment (with "multi") and start the second; each key
+    // is asked for once first, as a miss
+    for (int i = 0; i < 5; ++i) {
+      const std::string key = "k" + std::to_string(i);
+      Miss(&cache, key);
+      if (!cache.Insert(key, {payload})) {
+        FAIL("Inserts admitted while the store has room");
+        return 1;
+      }
+    }
+    PASS("Inserts admitted while the store has room");
+
+    // The store is full now: a key nobody asked for does not get in, while
+    // one asked for more often than the oldest entries does
+    if (cache.Insert("cold", {payload}) || !Miss(&cache, "cold")) {
+      FAIL("Cold key rejected when full");
+      return 1;
+    }
+    PASS("Cold key rejected when full");
+
+    for (int i = 0; i < 4; ++i) {
+      const std::string key = "hot" + std::to_string(i);
+      for (int j = 0; j < 5; ++j) { Miss(&cache, key); }
+      if (!cache.Insert(key, {payload + key})) {
+        FAIL("Hot key admitted when full");
+        return 1;
+      }
+    }
+    // The last one needed a new segment, so the oldest went with its
+    // entries
+    ResultCache::Stats stats = cache.GetStats();
+    if (!Miss(&cache, "multi") || !Miss(&cache, "k0") ||
+        !Hit(&cache, "hot3", payload + "hot3") || (stats.evicted == 0)) {
+      FAIL("Hot key admitted when full");
+      return 1;
+    }
+    PASS("Hot key admitted when full");
+  }
+
+  // A new cache over the same directory indexes the surviving segments
+  {
+    ResultCache cache(dir + "/store", max_bytes, segment_bytes);
+    if (!cache.enabled() || !Hit(&cache, "hot0", payload + "hot0") ||
+        !Hit(&cache, "hot3", payload + "hot3") || !Miss(&cache, "k0") ||
+        !Miss(&cache, "cold")) {
+      FAIL("Segments reloaded");
+      return 1;
+    }
+    PASS("Segments reloaded");
+  }
+
+  // A segment holding an entry filed under another key's hash: the full
+  // key is compared, so the other key misses instead of getting its
+  // outputs. A torn entry ends the segment.
+  {
+    const std::string store = dir + "/forged";
+    if (mkdir(store.c_str(), 0755) != 0) {
+      FAIL("Forged segment");
+      return 1;
+    }
+    const uint64_t victim_hash = std::hash<std::string>()("victim");
+    std::string segment;
+    AppendEntry(&segment, "intruder", victim_hash, "intruder output");
+    AppendEntry(&segment, "own", std::hash<std::string>()("own"), "own output");
+    AppendEntry(&segment, "torn", std::hash<std::string>()("torn"),
+                "torn output", 0);
+    AppendEntry(&segment, "after", std::hash<std::string>()("after"),
+                "after output");
+    std::ofstream(store + "/seg-0", std::ios::binary) << segment;
+
+    ResultCache cache(store, max_bytes, segment_bytes);
+    if (!cache.enabled() || !Miss(&cache, "victim") ||
+        !Hit(&cache, "own", "own output")) {
+      FAIL("Key compare");
+      return 1;
+    }
+    // The colliding key may still be stored, and replaces the intruder
+    if (!cache.Insert("victim", {"victim output"}) ||
+        !Hit(&cache, "victim", "victim output")) {
+      FAIL("Key compare");
+      return 1;
+    }
+    PASS("Key compare");
+
+    if (!Miss(&cache, "torn") || !Miss(&cache, "after")) {
+      FAIL("Torn entry ends the segment");
+      return 1;
+    }
+    PASS("Torn entry ends the segment");
+  }
+
+  RemoveDir(dir);
+  printf("All tests passed!!\n");
+  return 0;
+}
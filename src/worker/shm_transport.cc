@@ -0,0 +1,164 @@
+#include "worker/shm_transport.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+
+namespace infaas {
+namespace internal {
+
+SharedRegion::SharedRegion() : fd_(-1), data_(nullptr), size_(0) {}
+
+SharedRegion::~SharedRegion() { Reset(); }
+
+SharedRegion::SharedRegion(SharedRegion&& other)
+    : fd_(other.fd_), data_(other.data_), size_(other.size_) {
+  other.fd_ = -1;
+  other.data_ = nullptr;
+  other.size_ = 0;
+}
+
+SharedRegion& SharedRegion::operator=(SharedRegion&& other) {
+  if (this != &other) {
+    Reset();
+    fd_ = other.fd_;
+    data_ = other.data_;
+    size_ = other.size_;
+    other.fd_ = -1;
+    other.data_ = nullptr;
+    other.size_ = 0;
+  }
+  return *this;
+}
+
+int SharedRegion::Create(const char* name, size_t size) {
+  Reset();
+  // MFD_CLOEXEC: the fd is only passed on deliberately (SCM_RIGHTS, or
+  // ExecOptions::inherit_fds for one-shot runs).
+  fd_ = memfd_create(name, MFD_CLOEXEC);
+  if (fd_ < 0) {
+    perror("memfd_create");
+    return -1;
+  }
+  if (size > 0 && ftruncate(fd_, size) < 0) {
+    perror("ftruncate");
+    Reset();
+    return -1;
+  }
+  return Remap();
+}
+
+int SharedRegion::Remap() {
+  if (fd_ < 0) { return -1; }
+  if (data_) {
+    munmap(data_, size_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+  struct stat st;
+  if (fstat(fd_, &st) < 0) {
+    perror("fstat");
+    return -1;
+  }
+  if (st.st_size == 0) { return 0; }
+  void* addr = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    fd_, 0);
+  if (addr == MAP_FAILED) {
+    perror("mmap");
+    return -1;
+  }
+  data_ = static_cast<char*>(addr);
+  size_ = st.st_size;
+  return 0;
+}
+
+void SharedRegion::Reset() {
+  if (data_) { munmap(data_, size_); }
+  if (fd_ >= 0) { close(fd_); }
+  fd_ = -1;
+  data_ = nullptr;
+  size_ = 0;
+}
+
+size_t PackedSize(const std::vector<BufferView>& bufs) {
+  size_t total = sizeof(RegionHeader) + bufs.size() * sizeof(uint64_t);
+  for (const BufferView& b : bufs) { total += b.size; }
+  return total;
+}
+
+int PackBuffers(const char* name, const std::vector<BufferView>& bufs,
+                SharedRegion* region) {
+  if (region->Create(name, PackedSize(bufs))) { return -1; }
+
+  char* p = region->data();
+  RegionHeader header;
+  header.magic = region_magic;
+  header.count = bufs.size();
+  memcpy(p, &header, sizeof(header));
+  p += sizeof(header);
+  for (const BufferView& b : bufs) {
+    uint64_t size = b.size;
+    memcpy(p, &size, sizeof(size));
+    p += sizeof(size);
+  }
+  for (const BufferView& b : bufs) {
+    if (b.size > 0) { memcpy(p, b.data, b.size); }
+    p += b.size;
+  }
+  return 0;
+}
+
+int PackBuffers(const char* name, const std::vector<BufferView>& bufs,
+                const std::vector<InputParams>& params, SharedRegion* region) {
+  if (params.empty()) { return PackBuffers(name, bufs, region); }
+  if (params.size() != bufs.size()) { return -1; }
+
+  std::vector<BufferView> all(bufs);
+  all.reserve(bufs.size() + params.size());
+  for (const InputParams& p : params) {
+    all.push_back({reinterpret_cast<const char*>(&p), sizeof(p)});
+  }
+  if (PackBuffers(name, all, region)) { return -1; }
+  RegionHeader header;
+  header.magic = region_params_magic;
+  header.count = bufs.size();
+  memcpy(region->data(), &header, sizeof(header));
+  return 0;
+}
+
+int UnpackBuffers(const SharedRegion& region, std::vector<BufferView>* views) {
+  views->clear();
+  const char* base = region.data();
+  size_t len = region.size();
+  RegionHeader header;
+  if (!base || len < sizeof(header)) { return -1; }
+  memcpy(&header, base, sizeof(header));
+  if (header.magic != region_magic) { return -1; }
+
+  size_t offset = sizeof(header);
+  if ((len - offset) / sizeof(uint64_t) < header.count) { return -1; }
+  size_t data_offset = offset + header.count * sizeof(uint64_t);
+
+  views->reserve(header.count);
+  for (uint32_t i = 0; i < header.count; ++i) {
+    uint64_t size;
+    memcpy(&size, base + offset + i * sizeof(uint64_t), sizeof(size));
+    if (size > len - data_offset) {
+      views->clear();
+      return -1;
+    }
+    BufferView v;
+    v.data = base + data_offset;
+    v.size = size;
+    views->push_back(v);
+    data_offset += size;
+  }
+  return 0;
+}
+
+}  // namespace internal
+}  // namespace infaas
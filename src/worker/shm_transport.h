@@ -0,0 +1,124 @@
+#pragma once
+
+#ifndef INFAAS_SHM_TRANSPORT_H_
+#define INFAAS_SHM_TRANSPORT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace infaas {
+namespace internal {
+
+/**
+ * Shared-memory transport between the worker and model processes.
+ *
+ * Inputs and outputs travel in anonymous memfd regions that are handed to
+ * the model process as file descriptors, so payloads are never placed on
+ * the command line or pushed through a pipe. A region holds any number of
+ * buffers, each described by a size prefix:
+ *
+ *   RegionHeader {magic, count}
+ *   uint64_t size[count]
+ *   payload[0] payload[1] ... payload[count - 1]   (back to back)
+ *
+ * An input region may also carry the generation parameters of every
+ * input. It then has region_params_magic, 2 * count sizes, and one
+ * InputParams record per input after the inputs:
+ *
+ *   RegionHeader {magic, count}
+ *   uint64_t size[2 * count]
+ *   payload[0] ... payload[count - 1]  params[0] ... params[count - 1]
+ *
+ * All integers are in host byte order (both ends run on the same machine).
+ * See model_server.py for the Python side.
+ */
+struct RegionHeader {
+  uint32_t magic;
+  uint32_t count;
+};
+
+static const uint32_t region_magic = 0x44494652;         // "DIFR"
+static const uint32_t region_params_magic = 0x44494650;  // "DIFP"
+
+// Generation parameters of one input (InternalDiffusionQuery). The inputs
+// of one request all carry that request's parameters, so requests with
+// different seeds or guidance scales can share an execution.
+struct InputParams {
+  int32_t steps;
+  float guidance_scale;
+  int32_t seed;
+  int32_t width;
+  int32_t height;
+};
+
+// A non-owning view of one buffer (a request input, or a mapped output).
+struct BufferView {
+  const char* data;
+  size_t size;
+};
+
+/**
+ * An owned memfd and its mapping. Move-only; unmaps and closes on
+ * destruction.
+ */
+class SharedRegion {
+public:
+  SharedRegion();
+  ~SharedRegion();
+  SharedRegion(SharedRegion&& other);
+  SharedRegion& operator=(SharedRegion&& other);
+  SharedRegion(const SharedRegion&) = delete;
+  SharedRegion& operator=(const SharedRegion&) = delete;
+
+  // Creates a new memfd of size bytes and maps it. size may be 0, in which
+  // case nothing is mapped (e.g., an output region the peer will fill).
+  // Returns 0 on success, -1 on failure.
+  int Create(const char* name, size_t size);
+
+  // Maps the region's current size (the peer may have grown it). Returns 0
+  // on success, -1 on failure.
+  int Remap();
+
+  void Reset();
+
+  int fd() const { return fd_; }
+  char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+private:
+  int fd_;
+  char* data_;
+  size_t size_;
+};
+
+// Bytes needed to pack these buffers.
+size_t PackedSize(const std::vector<BufferView>& bufs);
+
+/**
+ * Creates a region and copies bufs into it with their size prefixes.
+ * Returns 0 on success, -1 on failure.
+ */
+int PackBuffers(const char* name, const std::vector<BufferView>& bufs,
+                SharedRegion* region);
+
+/**
+ * Same, followed by one params record per buffer (region_params_magic).
+ * Empty params packs a plain region. Returns -1 if params is neither empty
+ * nor one per buffer.
+ */
+int PackBuffers(const char* name, const std::vector<BufferView>& bufs,
+                const std::vector<InputParams>& params, SharedRegion* region);
+
+/**
+ * Parses a packed region. views point into the region's mapping and stay
+ * valid while it is mapped. Returns 0 on success, -1 if the region is
+ * malformed.
+ */
+int UnpackBuffers(const SharedRegion& region, std::vector<BufferView>* views);
+
+}  // namespace internal
+}  // namespace infaas
+
+#endif  // INFAAS_SHM_TRANSPORT_H_